@@ -0,0 +1,109 @@
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+
+#include <core/debug.hpp>
+#include <core/standard.hpp>
+#include <core/types.hpp>
+#include <core/bits.hpp>
+#include <memory/core.hpp>
+
+#include <system/platform.hpp>
+#include <io/net/socket.hpp>
+#include <io/net/datagram_pool.hpp>
+
+// Loopback udp packets per second: one thread blasts fixed size datagrams with 
+// sendmmsg at a given batch size while the receiver drains with recvmmsg into 
+// pooled buffers. The gso row sends batch-many segments as one buffer and lets 
+// the kernel split them, the receiver taking them back coalesced through gro
+
+using namespace std;
+using namespace ceres;
+
+using clock_type = std::chrono::steady_clock;
+using datagram = io::net::socket::datagram;
+
+size_t const PAYLOAD_SIZE = 64;
+auto const DURATION = std::chrono::milliseconds {500};
+
+struct result
+{
+    size_t sent = 0;
+    size_t received = 0;
+};
+
+result run (size_t batch, bool offload)
+{
+    io::net::socket receiver {io::net::socket::type::UDP};
+    io::net::socket sender {io::net::socket::type::UDP};
+
+    int bufsize = 4 * 1024 * 1024;
+    timeval timeout {0, 100000};
+    system::socket::try_set_option (receiver.get_handle (), SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof (bufsize));
+    system::socket::try_set_option (receiver.get_handle (), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout));
+
+    receiver.bind ({"127.0.0.1:0"});
+    if (offload) receiver.set_receive_offload (true);
+    sender.connect (receiver.local_address ());
+
+    result r;
+    std::atomic<bool> done {false};
+
+    std::thread drain {[&] {
+        io::net::datagram_pool<> pool {io::net::socket::MAX_BATCH, offload? size_t {65536} : size_t {2048}};
+        datagram batch [io::net::socket::MAX_BATCH];
+        size_t n = pool.acquire (batch, io::net::socket::MAX_BATCH), received = 0;
+
+        while (!done || received > 0)
+        {
+            receiver.receive_batch (batch, n, received);
+            for (size_t i=0; i < received; ++i)
+                r.received += batch[i].segment? (batch[i].bytes + batch[i].segment - 1) / batch[i].segment : 1;
+        }
+
+        pool.release (batch, n);
+    }};
+
+    std::vector<uint8_t> payload (PAYLOAD_SIZE * batch);
+    std::vector<datagram> out (offload? 1 : batch);
+
+    for (size_t i=0; i < out.size (); ++i)
+    {
+        out[i].data = payload.data () + i * PAYLOAD_SIZE;
+        out[i].bytes = offload? payload.size () : PAYLOAD_SIZE;
+        out[i].segment = offload? PAYLOAD_SIZE : 0;
+    }
+
+    auto stop = clock_type::now () + DURATION;
+    while (clock_type::now () < stop)
+    {
+        size_t sent;
+        sender.send_batch (out.data (), out.size (), sent);
+        r.sent += offload? sent * batch : sent;
+    }
+
+    done = true;
+    drain.join ();
+
+    return r;
+}
+
+int main (int argc, char **argv)
+{
+    double seconds = std::chrono::duration<double> (DURATION).count ();
+
+    cout << setw (8) << "batch" << setw (16) << "sent pps" << setw (16) << "received pps" << setw (16) << "gso sent pps" << setw (16) << "gro recv pps" << endl;
+
+    for (size_t batch = 1; batch <= io::net::socket::MAX_BATCH; batch *= 2)
+    {
+        auto plain = run (batch, false);
+        auto offload = run (batch, true);
+
+        cout << fixed << setprecision (0)
+            << setw (8) << batch 
+            << setw (16) << plain.sent / seconds << setw (16) << plain.received / seconds
+            << setw (16) << offload.sent / seconds << setw (16) << offload.received / seconds << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,164 @@
+#include <iostream>
+#include <iomanip>
+
+#include <core/debug.hpp>
+#include <core/standard.hpp>
+#include <core/types.hpp>
+#include <core/bits.hpp>
+#include <memory/core.hpp>
+
+#include <system/platform.hpp>
+#include <io/net/socket.hpp>
+#include <io/net/service.hpp>
+
+// Loopback echo: a client and server connection ping-pong a fixed size message 
+// on one thread. Compares blocking syscalls per step against the async service 
+// on each backend, where a round trip is four ring entries and a couple of polls
+
+using namespace std;
+using namespace ceres;
+
+using clock_type = std::chrono::steady_clock;
+
+size_t const MESSAGE_SIZE = 64;
+size_t const ROUND_TRIPS = 200000;
+
+struct connection_pair
+{
+    io::net::socket listener {io::net::socket::type::TCP};
+    io::net::socket client {io::net::socket::type::TCP};
+    io::net::socket server;
+
+    connection_pair ()
+    {
+        listener.bind ({"127.0.0.1:0"});
+        listener.listen ();
+        client.connect (listener.local_address ());
+        listener.accept (server);
+    }
+};
+
+void report (char const *name, clock_type::duration elapsed, size_t ops)
+{
+    double ns = std::chrono::duration<double, std::nano> (elapsed).count ();
+
+    cout << setw (24) << left << name 
+        << setw (12) << right << fixed << setprecision (0) << (ROUND_TRIPS / (ns * 1e-9)) << " rt/s"
+        << setw (10) << setprecision (1) << (ns / ops) << " ns/op" << endl;
+}
+
+void bench_blocking ()
+{
+    connection_pair pair;
+    uint8_t outbuf [MESSAGE_SIZE] = {}, inbuf [MESSAGE_SIZE];
+    size_t moved;
+
+    auto start = clock_type::now ();
+
+    for (size_t i=0; i < ROUND_TRIPS; ++i)
+    {
+        pair.client.send ({outbuf, MESSAGE_SIZE}, moved);
+        for (size_t got = 0; got < MESSAGE_SIZE; got += moved)
+            pair.server.receive ({inbuf + got, MESSAGE_SIZE - got}, moved);
+
+        pair.server.send ({inbuf, MESSAGE_SIZE}, moved);
+        for (size_t got = 0; got < MESSAGE_SIZE; got += moved)
+            pair.client.receive ({outbuf + got, MESSAGE_SIZE - got}, moved);
+    }
+
+    report ("blocking syscalls", clock_type::now () - start, ROUND_TRIPS * 4);
+}
+
+struct echo
+{
+    io::net::service &service;
+    connection_pair &pair;
+    bool fixed;
+
+    uint8_t outbuf [MESSAGE_SIZE] = {};
+    uint8_t inbuf [MESSAGE_SIZE] = {};
+    size_t remaining = ROUND_TRIPS;
+    size_t got = 0;
+
+    echo (io::net::service &service, connection_pair &pair, bool fixed) : 
+        service (service), pair (pair), fixed (fixed) {}
+
+    void send (io::net::socket &s, uint8_t *buf, io::net::service::completion done)
+    {
+        if (fixed) service.send_fixed (s, buf == outbuf? 0 : 1, MESSAGE_SIZE, std::move (done));
+        else service.send (s, {buf, MESSAGE_SIZE}, std::move (done));
+    }
+
+    void receive (io::net::socket &s, uint8_t *buf, io::net::service::completion done)
+    {
+        if (fixed && got == 0) service.receive_fixed (s, buf == outbuf? 0 : 1, MESSAGE_SIZE, std::move (done));
+        else service.receive (s, {buf + got, MESSAGE_SIZE - got}, std::move (done));
+    }
+
+    void ping ()
+    {
+        if (remaining-- == 0) return;
+
+        send (pair.client, outbuf, [] (std::error_code const &, size_t) {});
+        receive (pair.server, inbuf, [this] (std::error_code const &e, size_t n) { on_ping (e, n); });
+    }
+
+    void on_ping (std::error_code const &error, size_t bytes)
+    {
+        if (error) return;
+        if ((got += bytes) < MESSAGE_SIZE)
+            return receive (pair.server, inbuf, [this] (std::error_code const &e, size_t n) { on_ping (e, n); });
+
+        got = 0;
+        send (pair.server, inbuf, [] (std::error_code const &, size_t) {});
+        receive (pair.client, outbuf, [this] (std::error_code const &e, size_t n) { on_pong (e, n); });
+    }
+
+    void on_pong (std::error_code const &error, size_t bytes)
+    {
+        if (error) return;
+        if ((got += bytes) < MESSAGE_SIZE)
+            return receive (pair.client, outbuf, [this] (std::error_code const &e, size_t n) { on_pong (e, n); });
+
+        got = 0;
+        ping ();
+    }
+};
+
+void bench_service (char const *name, io::net::service::backend preferred, bool fixed)
+{
+    io::net::service service {256, preferred};
+
+    if (!service || service.get_backend () != preferred)
+    {
+        cout << setw (24) << left << name << " unavailable" << endl;
+        return;
+    }
+
+    connection_pair pair;
+    echo e {service, pair, fixed};
+
+    if (fixed && service.register_buffers ({{e.outbuf, MESSAGE_SIZE}, {e.inbuf, MESSAGE_SIZE}}))
+    {
+        cout << setw (24) << left << name << " unable to register buffers" << endl;
+        return;
+    }
+
+    auto start = clock_type::now ();
+
+    e.ping ();
+    while (service.pending () > 0)
+        service.poll (std::chrono::milliseconds {100});
+
+    report (name, clock_type::now () - start, ROUND_TRIPS * 4);
+}
+
+int main (int argc, char **argv)
+{
+    bench_blocking ();
+    bench_service ("epoll", io::net::service::backend::EPOLL, false);
+    bench_service ("io_uring", io::net::service::backend::URING, false);
+    bench_service ("io_uring fixed buffers", io::net::service::backend::URING, true);
+
+    return 0;
+}
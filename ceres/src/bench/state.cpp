@@ -0,0 +1,107 @@
+#include <iostream>
+#include <iomanip>
+
+#include <core/debug.hpp>
+#include <core/standard.hpp>
+#include <core/types.hpp>
+#include <state/state.hpp>
+
+// Events per second through a 50 state, 50 event machine: singular_machine 
+// walks every state on each event through the recursive reactor, whereas 
+// table_machine jumps through one entry of its (state, event) table. A third 
+// of the pairs have a transition, each to a state further round the ring
+
+using namespace std;
+using namespace ceres;
+
+using clock_type = std::chrono::steady_clock;
+
+size_t const NSTATES = 50;
+size_t const NEVENTS = 50;
+size_t const ROUNDS = 200000;
+
+size_t transitions = 0;
+
+template <size_t E>
+struct bench_event 
+{
+    int value;
+};
+
+template <size_t S>
+struct bench_state
+{
+    int value = 0;
+
+    bench_state () {}
+
+    template <size_t E>
+    bench_state (bench_event<E> const &event) : value {event.value} 
+    { 
+        ++transitions; 
+    }
+};
+
+namespace traits
+{
+    namespace state
+    {
+        template <size_t S, size_t E> 
+        struct transition <bench_state<S>, bench_event<E>> 
+        { 
+            typedef typename std::conditional <(S * 7 + E) % 3 == 0, bench_state<(S + E + 1) % NSTATES>, null>::type next;
+        };
+    }
+}
+
+template <typename Indices>
+struct bench;
+
+template <size_t ...I>
+struct bench <core::indices <I...>>
+{
+    typedef state::singular_machine <bench_state<I>...> singular;
+    typedef state::table_machine <state::event_list <bench_event<I>...>, bench_state<I>...> table;
+
+    template <typename Machine>
+    static double run (size_t &count)
+    {
+        Machine machine;
+        transitions = 0;
+
+        auto start = clock_type::now ();
+
+        for (size_t round=0; round < ROUNDS; ++round)
+        {
+            int expand[] = {(machine.react (bench_event<I> {int (round)}), 0)...};
+            (void) expand;
+        }
+
+        std::chrono::duration<double> elapsed = clock_type::now () - start;
+        count = transitions;
+
+        return ROUNDS * NEVENTS / elapsed.count ();
+    }
+};
+
+int main (int argc, char **argv)
+{
+    typedef bench <core::make_indices <NSTATES>::type> machines;
+
+    size_t singular_transitions, table_transitions;
+    double singular = machines::run <machines::singular> (singular_transitions);
+    double table = machines::run <machines::table> (table_transitions);
+
+    cout << setw (12) << "machine" << setw (16) << "events/s" << setw (16) << "transitions" << endl;
+    cout << fixed << setprecision (0)
+        << setw (12) << "singular" << setw (16) << singular << setw (16) << singular_transitions << endl
+        << setw (12) << "table" << setw (16) << table << setw (16) << table_transitions << endl;
+
+    if (singular_transitions != table_transitions)
+    {
+        cout << "machines disagree" << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -13,6 +13,8 @@
 #include <utility>
 #include <memory>
 #include <thread>
+#include <chrono>
+#include <functional>
 
 #include <fstream>
 #include <system_error>
@@ -51,7 +51,6 @@ namespace ceres { namespace core {
     }
 
     //---------------------------------------------------------------------
-    // TODO alignment
 
     template <typename T>
     constexpr T max (T a, T b)
@@ -59,31 +58,110 @@ namespace ceres { namespace core {
         return (a > b)? a : b;
     }
             
+    template <typename T>
     constexpr size_t max_type_size () 
     { 
-        return 0; 
+        return sizeof(T);
     }
 
-    template <typename T, typename ...Ts>
+    template <typename T, typename U, typename ...Ts>
     constexpr size_t max_type_size () 
     { 
-        return max (sizeof(T), max_type_size());
+        return max (sizeof(T), max_type_size<U, Ts...>());
+    }
+
+    template <typename T>
+    constexpr size_t max_type_align () 
+    { 
+        return alignof(T);
+    }
+
+    template <typename T, typename U, typename ...Ts>
+    constexpr size_t max_type_align () 
+    { 
+        return max (alignof(T), max_type_align<U, Ts...>());
     }
 
     //---------------------------------------------------------------------
     // TODO alignment
 
+    template <typename T>
     constexpr size_t sum_type_size () 
     { 
-        return 0; 
+        return sizeof(T);
     }
 
-    template <typename T, typename ...Ts>
+    template <typename T, typename U, typename ...Ts>
     constexpr size_t sum_type_size () 
     { 
-        return sizeof(T) + sum_type_size();
+        return sizeof(T) + sum_type_size<U, Ts...>();
     }
 
+    //---------------------------------------------------------------------
+    // Compile-time integer sequences, built by halves so long ones stay
+    // within the template instantiation depth
+
+    template <size_t ...I>
+    struct indices 
+    {
+        typedef indices type;
+    };
+
+    template <typename Left, typename Right>
+    struct join_indices;
+
+    template <size_t ...L, size_t ...R>
+    struct join_indices <indices <L...>, indices <R...>>
+    {
+        typedef indices <L..., (sizeof...(L) + R)...> type;
+    };
+
+    template <size_t N>
+    struct make_indices : 
+        join_indices <typename make_indices <N/2>::type, typename make_indices <N - N/2>::type> {};
+
+    template <> struct make_indices <0u> : indices <> {};
+    template <> struct make_indices <1u> : indices <0> {};
+
+    //---------------------------------------------------------------------
+    // Position of a type within a list of types, or the length of the list
+
+    template <typename T, typename ...Ts>
+    struct type_index;
+
+    template <typename T>
+    struct type_index <T> 
+    { 
+        constexpr static size_t value = 0; 
+    };
+
+    template <typename T, typename ...Ts>
+    struct type_index <T, T, Ts...> 
+    { 
+        constexpr static size_t value = 0; 
+    };
+
+    template <typename T, typename U, typename ...Ts>
+    struct type_index <T, U, Ts...> 
+    { 
+        constexpr static size_t value = 1 + type_index <T, Ts...>::value; 
+    };
+
+    //---------------------------------------------------------------------
+    // Type at a position within a list of types
+
+    template <size_t N, typename T, typename ...Ts>
+    struct type_at 
+    { 
+        typedef typename type_at <N-1, Ts...>::type type; 
+    };
+
+    template <typename T, typename ...Ts>
+    struct type_at <0, T, Ts...> 
+    { 
+        typedef T type; 
+    };
+
     //---------------------------------------------------------------------
 
     template <size_t N> struct min_word_type {};
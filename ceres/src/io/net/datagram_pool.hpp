@@ -0,0 +1,90 @@
+#ifndef _IO_NET_DATAGRAM_POOL_HPP_
+#define _IO_NET_DATAGRAM_POOL_HPP_
+
+namespace ceres { namespace io { namespace net {
+
+    //=====================================================================
+    // Fixed count of equally sized receive buffers carved out of a single 
+    // allocation, handed to datagrams by pointer so the receive path never 
+    // touches the heap; not thread-safe
+
+    template <typename Allocator = std::allocator<uint8_t>>
+    class datagram_pool
+    {
+        public:
+            datagram_pool (size_t count, size_t size, Allocator const &allocator = Allocator {}) :
+                allocator_ (allocator), 
+                slab_ {allocator_.allocate (count * size), count * size},
+                size_ {size}
+            {
+                free_.reserve (count);
+                for (size_t i = count; i > 0; --i)
+                    free_.push_back (begin (slab_) + (i - 1) * size);
+            }
+
+            datagram_pool (datagram_pool const &) = delete;
+            datagram_pool &operator= (datagram_pool const &) = delete;
+
+            ~datagram_pool ()
+            {
+                ASSERTF (free_.size () == capacity (), "buffers still in use");
+                allocator_.deallocate (slab_.items, size (slab_));
+            }
+
+        public:
+            size_t buffer_size () const { return size_; }
+            size_t capacity () const { return size (slab_) / size_; }
+            size_t available () const { return free_.size (); }
+
+        public:
+            bool acquire (socket::datagram &d)
+            {
+                bool success = !free_.empty ();
+
+                if (success)
+                {
+                    d.data = free_.back ();
+                    d.capacity = size_;
+                    d.bytes = 0;
+                    d.segment = 0;
+                    free_.pop_back ();
+                }
+
+                return success;
+            }
+
+            void release (socket::datagram &d)
+            {
+                ASSERTF (contains (slab_, d.data), "not from this pool");
+
+                free_.push_back (d.data);
+                d.data = nullptr;
+                d.capacity = d.bytes = 0;
+            }
+
+            // fills as many datagrams as there are free buffers, returning how many
+            size_t acquire (socket::datagram *batch, size_t count)
+            {
+                size_t i = 0;
+                while (i < count && acquire (batch[i]))
+                    ++i;
+
+                return i;
+            }
+
+            void release (socket::datagram *batch, size_t count)
+            {
+                for (size_t i=0; i < count; ++i)
+                    release (batch[i]);
+            }
+
+        private:
+            Allocator               allocator_;
+            memory::buffer<uint8_t> slab_;
+            size_t                  size_;
+            std::vector<uint8_t *>  free_;
+    };
+
+} } }
+
+#endif
@@ -0,0 +1,454 @@
+#ifndef _IO_NET_SERVICE_HPP_
+#define _IO_NET_SERVICE_HPP_
+
+namespace ceres { namespace io { namespace net {
+
+    //=====================================================================
+    // Asynchronous socket operations, completed through callbacks run from
+    // poll(). Prefers io_uring: starting an operation only fills in a ring
+    // entry, one enter call per poll hands the whole batch to the kernel, and
+    // results are read straight off the shared completion ring. Falls back to
+    // epoll readiness plus nonblocking syscalls where io_uring is unavailable.
+    //
+    // Not thread-safe; owned and polled by a single thread. Buffers and sockets
+    // passed in must outlive their operation.
+
+    class service
+    {
+        public:
+            using completion = std::function<void (std::error_code const &, size_t)>;
+
+            enum class backend { NONE, URING, EPOLL };
+
+        public:
+            explicit service (uint32_t depth = 256, backend preferred = backend::URING)
+            {
+                if (preferred == backend::URING && system::uring::try_setup (depth, ring_))
+                    backend_ = backend::URING;
+                else if (system::epoll::try_create (poller_))
+                    backend_ = backend::EPOLL;
+                else
+                    system::load_last_error_code (error_);
+
+                events_.resize (depth);
+            }
+
+            service (service const &) = delete;
+            service &operator= (service const &) = delete;
+
+            ~service ()
+            {
+                if (backend_ == backend::URING)
+                    system::uring::try_teardown (ring_);
+                else if (backend_ == backend::EPOLL)
+                    system::epoll::try_close (poller_);
+            }
+
+        public:
+            operator bool () const { return !error_; }
+            std::error_code error () const { return error_; }
+            backend get_backend () const { return backend_; }
+            size_t pending () const { return ops_.size () - free_.size (); }
+
+        public:
+            // Pins buffers with the kernel once so fixed operations skip the per-op
+            // page lookups; the epoll backend just remembers them for indexing
+
+            std::error_code register_buffers (std::vector<memory::buffer<uint8_t>> const &buffers)
+            {
+                std::error_code error;
+                std::vector<iovec> vecs;
+
+                for (auto const &buf : buffers)
+                    vecs.push_back ({buf.items, buf.bytes});
+
+                if (backend_ == backend::URING && !registered_.empty ())
+                    system::uring::try_unregister_buffers (ring_);
+
+                // failing to pin (e.g. RLIMIT_MEMLOCK) leaves the service usable without them
+                if (backend_ == backend::URING &&
+                        !system::uring::try_register_buffers (ring_, vecs.data (), vecs.size ()))
+                    system::load_last_error_code (error);
+
+                registered_ = error? std::vector<iovec> {} : std::move (vecs);
+
+                return error;
+            }
+
+        public:
+            void send (socket &s, memory::buffer<uint8_t> const &buf, completion done)
+            {
+                start (operation::kind::SEND, s.handle_, buf.items, buf.bytes, -1, nullptr, std::move (done));
+            }
+
+            void receive (socket &s, memory::buffer<uint8_t> const &buf, completion done)
+            {
+                start (operation::kind::RECEIVE, s.handle_, buf.items, buf.bytes, -1, nullptr, std::move (done));
+            }
+
+            void send_fixed (socket &s, size_t index, size_t bytes, completion done)
+            {
+                auto data = static_cast<uint8_t *> (registered_.at (index).iov_base);
+                start (operation::kind::SEND, s.handle_, data, bytes, static_cast<int> (index), nullptr, std::move (done));
+            }
+
+            void receive_fixed (socket &s, size_t index, size_t bytes, completion done)
+            {
+                auto data = static_cast<uint8_t *> (registered_.at (index).iov_base);
+                start (operation::kind::RECEIVE, s.handle_, data, bytes, static_cast<int> (index), nullptr, std::move (done));
+            }
+
+            void accept (socket &listener, socket &accepted, completion done)
+            {
+                // readiness-based accept needs to fail fast rather than block the loop
+                if (backend_ == backend::EPOLL && !listener.is_nonblocking ())
+                    listener.set_nonblocking (true);
+
+                accepted.type_ = listener.type_;
+                start (operation::kind::ACCEPT, listener.handle_, nullptr, 0, -1, &accepted, std::move (done));
+            }
+
+        public:
+            // Submits queued operations, waits up to timeout if nothing has finished
+            // yet, then runs completion callbacks; returns the number that ran
+
+            size_t poll (std::chrono::milliseconds timeout = std::chrono::milliseconds {0})
+            {
+                if (backend_ == backend::URING)
+                    gather_uring (timeout);
+                else if (backend_ == backend::EPOLL)
+                    gather_epoll (timeout);
+
+                return deliver ();
+            }
+
+        private:
+            struct operation
+            {
+                enum class kind { NONE, SEND, RECEIVE, ACCEPT };
+
+                kind                op = kind::NONE;
+                socket::handle_type handle = socket::INVALID;
+                uint8_t            *data = nullptr;
+                size_t              bytes = 0;
+                int                 fixed = -1;
+                socket             *accepted = nullptr;
+                completion          done;
+            };
+
+            struct finished
+            {
+                uint32_t        slot;
+                std::error_code error;
+                size_t          bytes;
+            };
+
+            struct interest
+            {
+                std::vector<uint32_t> readers;
+                std::vector<uint32_t> writers;
+                uint32_t events = 0;
+            };
+
+            static const uint64_t TIMER = ~uint64_t {0};
+
+        private:
+            void start (operation::kind op, socket::handle_type handle, uint8_t *data, size_t bytes,
+                    int fixed, socket *accepted, completion done)
+            {
+                uint32_t slot = acquire ();
+                auto &o = ops_[slot];
+
+                o.op = op;
+                o.handle = handle;
+                o.data = data;
+                o.bytes = bytes;
+                o.fixed = fixed;
+                o.accepted = accepted;
+                o.done = std::move (done);
+
+                if (backend_ == backend::URING)
+                    start_uring (slot);
+                else if (backend_ == backend::EPOLL)
+                    start_epoll (slot);
+                else
+                    finished_.push_back ({slot, error_, 0});
+            }
+
+            uint32_t acquire ()
+            {
+                uint32_t slot;
+
+                if (free_.empty ())
+                {
+                    slot = static_cast<uint32_t> (ops_.size ());
+                    ops_.emplace_back ();
+                }
+                else
+                {
+                    slot = free_.back ();
+                    free_.pop_back ();
+                }
+
+                return slot;
+            }
+
+            size_t deliver ()
+            {
+                size_t count = 0;
+
+                // callbacks may start new operations, so take the batch out first
+                std::vector<finished> batch;
+                batch.swap (finished_);
+
+                for (auto const &f : batch)
+                {
+                    auto &o = ops_[f.slot];
+                    completion done = std::move (o.done);
+
+                    if (o.op == operation::kind::ACCEPT && !f.error)
+                        o.accepted->handle_ = static_cast<socket::handle_type> (f.bytes);
+
+                    o = operation {};
+                    free_.push_back (f.slot);
+
+                    if (done) done (f.error, f.error? 0 : f.bytes);
+                    ++count;
+                }
+
+                return count;
+            }
+
+        private:
+            void start_uring (uint32_t slot)
+            {
+                auto &o = ops_[slot];
+                auto entry = system::uring::try_get_entry (ring_);
+
+                // ring full, push what's queued to the kernel to make room
+                uint32_t submitted;
+                if (entry == nullptr && system::uring::try_submit (ring_, 0, submitted))
+                    entry = system::uring::try_get_entry (ring_);
+
+                if (entry == nullptr)
+                {
+                    finished_.push_back ({slot, std::make_error_code (std::errc::no_buffer_space), 0});
+                    return;
+                }
+
+                entry->fd = o.handle;
+                entry->user_data = slot;
+                entry->addr = reinterpret_cast<uintptr_t> (o.data);
+                entry->len = static_cast<uint32_t> (o.bytes);
+
+                switch (o.op)
+                {
+                    case operation::kind::SEND:
+                        entry->opcode = o.fixed < 0? IORING_OP_SEND : IORING_OP_WRITE_FIXED;
+                        entry->msg_flags = o.fixed < 0? MSG_NOSIGNAL : 0;
+                        break;
+
+                    case operation::kind::RECEIVE:
+                        entry->opcode = o.fixed < 0? IORING_OP_RECV : IORING_OP_READ_FIXED;
+                        break;
+
+                    case operation::kind::ACCEPT:
+                        entry->opcode = IORING_OP_ACCEPT;
+                        entry->accept_flags = SOCK_CLOEXEC;
+                        break;
+
+                    default:
+                        entry->opcode = IORING_OP_NOP;
+                        break;
+                }
+
+                if (o.fixed >= 0)
+                    entry->buf_index = static_cast<uint16_t> (o.fixed);
+            }
+
+            void gather_uring (std::chrono::milliseconds timeout)
+            {
+                // hand over the batch and take whatever is already done without waiting
+                enter_uring (0);
+
+                // nothing yet, bound the wait with a kernel timer so enter can't block past timeout
+                if (timeout.count () > 0 && finished_.empty () && pending () > 0)
+                {
+                    auto entry = system::uring::try_get_entry (ring_);
+                    if (entry != nullptr)
+                    {
+                        timer_.tv_sec = timeout.count () / 1000;
+                        timer_.tv_nsec = (timeout.count () % 1000) * 1000000;
+
+                        entry->opcode = IORING_OP_TIMEOUT;
+                        entry->addr = reinterpret_cast<uintptr_t> (&timer_);
+                        entry->len = 1;
+                        entry->user_data = TIMER;
+
+                        enter_uring (1);
+                    }
+                }
+            }
+
+            void enter_uring (uint32_t wait_for)
+            {
+                system::uring::result_type result;
+                uint32_t submitted;
+
+                // interrupted or cq backed up is transient, whatever did complete is reaped below
+                if (!system::uring::try_submit (ring_, wait_for, submitted) && 
+                        errno != EINTR && errno != EBUSY && errno != EAGAIN)
+                    system::load_last_error_code (error_);
+
+                while (system::uring::try_reap (ring_, result))
+                {
+                    if (result.user_data == TIMER)
+                        continue;
+
+                    std::error_code error;
+                    if (result.res < 0)
+                        error.assign (-result.res, std::system_category ());
+
+                    auto slot = static_cast<uint32_t> (result.user_data);
+                    finished_.push_back ({slot, error, error? 0 : static_cast<size_t> (result.res)});
+                }
+            }
+
+        private:
+            bool attempt (uint32_t slot)
+            {
+                auto &o = ops_[slot];
+
+                std::error_code error;
+                size_t bytes = 0;
+                bool success = true;
+
+                switch (o.op)
+                {
+                    case operation::kind::SEND:
+                        success = system::socket::try_send (o.handle, o.data, o.bytes, MSG_DONTWAIT, bytes);
+                        break;
+
+                    case operation::kind::RECEIVE:
+                        success = system::socket::try_recv (o.handle, o.data, o.bytes, MSG_DONTWAIT, bytes);
+                        break;
+
+                    case operation::kind::ACCEPT:
+                        {
+                            socket::handle_type accepted = socket::INVALID;
+                            success = system::socket::try_accept_nonblocking (o.handle, accepted);
+                            bytes = static_cast<size_t> (accepted);
+                        }
+                        break;
+
+                    default:
+                        break;
+                }
+
+                if (!success)
+                    system::load_last_error_code (error);
+
+                bool complete = !system::socket::would_block (error);
+                if (complete)
+                    finished_.push_back ({slot, error, bytes});
+
+                return complete;
+            }
+
+            void start_epoll (uint32_t slot)
+            {
+                auto &o = ops_[slot];
+                auto &wait = interests_[o.handle];
+                auto &queue = (o.op == operation::kind::SEND)? wait.writers : wait.readers;
+
+                // only try straight away if nothing is queued ahead, keeping fifo order
+                if (!queue.empty () || !attempt (slot))
+                {
+                    queue.push_back (slot);
+                    rearm (o.handle, wait);
+                }
+                else if (wait.readers.empty () && wait.writers.empty () && wait.events == 0)
+                    interests_.erase (o.handle);
+            }
+
+            void rearm (socket::handle_type handle, interest &wait)
+            {
+                uint32_t events =
+                    (wait.readers.empty ()? 0u : uint32_t {EPOLLIN}) |
+                    (wait.writers.empty ()? 0u : uint32_t {EPOLLOUT});
+
+                bool success = true;
+
+                if (events == wait.events)
+                    return;
+                else if (wait.events == 0)
+                    success = system::epoll::try_add (poller_, handle, events, handle);
+                else if (events == 0)
+                    success = system::epoll::try_remove (poller_, handle);
+                else
+                    success = system::epoll::try_modify (poller_, handle, events, handle);
+
+                if (!success)
+                    system::load_last_error_code (error_);
+
+                wait.events = events;
+            }
+
+            void drain (std::vector<uint32_t> &queue)
+            {
+                auto op = queue.begin ();
+                while (op != queue.end () && attempt (*op))
+                    ++op;
+
+                queue.erase (queue.begin (), op);
+            }
+
+            void gather_epoll (std::chrono::milliseconds timeout)
+            {
+                int count = 0;
+                int wait_ms = finished_.empty ()? static_cast<int> (timeout.count ()) : 0;
+
+                if (!system::epoll::try_wait (poller_, events_.data (), static_cast<int> (events_.size ()), wait_ms, count) && 
+                        errno != EINTR)
+                    system::load_last_error_code (error_);
+
+                for (int i=0; i < count; ++i)
+                {
+                    auto handle = static_cast<socket::handle_type> (events_[i].data.u64);
+                    auto found = interests_.find (handle);
+                    if (found == interests_.end ())
+                        continue;
+
+                    auto &wait = found->second;
+                    uint32_t ready = events_[i].events;
+                    bool failed = ready & (EPOLLERR | EPOLLHUP);
+
+                    if (failed || (ready & EPOLLIN)) drain (wait.readers);
+                    if (failed || (ready & EPOLLOUT)) drain (wait.writers);
+
+                    rearm (handle, wait);
+                    if (wait.events == 0)
+                        interests_.erase (found);
+                }
+            }
+
+        private:
+            backend                 backend_ = backend::NONE;
+            std::error_code         error_;
+
+            std::vector<operation>  ops_;
+            std::vector<uint32_t>   free_;
+            std::vector<finished>   finished_;
+            std::vector<iovec>      registered_;
+
+            system::uring::ring     ring_;
+            __kernel_timespec       timer_;
+
+            system::epoll::handle_type                  poller_ = system::epoll::INVALID;
+            std::vector<system::epoll::event_type>      events_;
+            std::map<socket::handle_type, interest>     interests_;
+    };
+
+} } }
+
+#endif
@@ -28,7 +28,7 @@ namespace ceres { namespace io { namespace net {
 
             static const handle_type INVALID = system::socket::INVALID;
 
-            enum class type { NONE, TCP, UDP }; // TODO: VDP et al.
+            enum class type { NONE, TCP, UDP, TCP6, UDP6 }; // TODO: VDP et al.
 
             class address
             {
@@ -39,8 +39,8 @@ namespace ceres { namespace io { namespace net {
                     address ()
                     {
                         std::memset (&address_, 0, sizeof (address_));
-                        address_.sin_family = AF_INET;
-                        error_ = std::errc::bad_address;
+                        address_.ss_family = AF_INET;
+                        error_ = std::make_error_code (std::errc::bad_address);
                     }
 
                     address (address const &other) = default;
@@ -48,16 +48,17 @@ namespace ceres { namespace io { namespace net {
                     ~address () = default;
 
                 public:
+                    // "a.b.c.d:port", "[v6]:port" or a bare v6 host
                     address (std::string const &addr)
                     {
-                        if (!system::socket::try_string_to_inet4 (addr, address_))
+                        if (!system::socket::try_string_to_inet (addr, address_))
                             system::load_last_error_code (error_);
                     }
 
                     operator std::string () const 
                     {
                         std::string result;
-                        system::socket::try_inet4_to_string (address_, result);
+                        system::socket::try_inet_to_string (address_, result);
                         return result;
                     }
 
@@ -72,6 +73,11 @@ namespace ceres { namespace io { namespace net {
                     }
 
                     size_type sockaddr_size () const
+                    {
+                        return is_inet6 ()? sizeof (sockaddr_in6) : sizeof (sockaddr_in);
+                    }
+
+                    size_type sockaddr_capacity () const
                     {
                         return sizeof (address_);
                     }
@@ -80,15 +86,20 @@ namespace ceres { namespace io { namespace net {
                     operator bool () const { return !error_; }
                     std::error_code error () const { return error_; }
 
+                    // marks storage written by the kernel (accept, recvfrom etc.) as valid
+                    void validate () { error_ = {}; }
+
                 public:
                     bool has_same_port (address const &other) const
                     {
-                        return address_.sin_port == other.address_.sin_port;
+                        return port () == other.port ();
                     }
 
                     bool has_same_host (address const &other) const
                     {
-                        return address_.sin_addr.s_addr == other.address_.sin_addr.s_addr;
+                        return address_.ss_family == other.address_.ss_family && (is_inet6 ()?
+                            std::memcmp (&inet6 ().sin6_addr, &other.inet6 ().sin6_addr, sizeof (in6_addr)) == 0 :
+                            inet4 ().sin_addr.s_addr == other.inet4 ().sin_addr.s_addr);
                     }
 
                     bool operator== (address const &other) const 
@@ -97,17 +108,45 @@ namespace ceres { namespace io { namespace net {
                     }
 
                 public:
-                    uint16_t port () const { return ntohs (address_.sin_port); }
-                    void set_port (uint16_t port) { address_.sin_port = htons (port); }
+                    int family () const { return address_.ss_family; }
+                    bool is_inet6 () const { return address_.ss_family == AF_INET6; }
 
-                    uint32_t host () const { return ntohl (address_.sin_addr.s_addr); }
-                    void set_host (uint32_t host) { address_.sin_addr.s_addr = htonl (host); }
+                    uint16_t port () const { return ntohs (is_inet6 ()? inet6 ().sin6_port : inet4 ().sin_port); }
+                    void set_port (uint16_t port) { (is_inet6 ()? inet6 ().sin6_port : inet4 ().sin_port) = htons (port); }
+
+                    // ipv4 only, ipv6 hosts read as zero
+                    uint32_t host () const { return is_inet6 ()? 0 : ntohl (inet4 ().sin_addr.s_addr); }
+                    void set_host (uint32_t host) { address_.ss_family = AF_INET; inet4 ().sin_addr.s_addr = htonl (host); }
+
+                private:
+                    sockaddr_in &inet4 () { return reinterpret_cast<sockaddr_in &> (address_); }
+                    sockaddr_in const &inet4 () const { return reinterpret_cast<sockaddr_in const &> (address_); }
+                    sockaddr_in6 &inet6 () { return reinterpret_cast<sockaddr_in6 &> (address_); }
+                    sockaddr_in6 const &inet6 () const { return reinterpret_cast<sockaddr_in6 const &> (address_); }
 
                 private:
                     native_type     address_;
                     std::error_code error_;
             };
 
+            //-----------------------------------------------------------------
+            // One datagram in a batch; storage is owned by the caller (see 
+            // datagram_pool). With a non-zero segment a send is split by the 
+            // kernel (gso) into segment sized packets, and a receive reports 
+            // how the kernel coalesced several packets into one buffer (gro)
+
+            struct datagram
+            {
+                uint8_t    *data = nullptr;     // payload storage
+                size_t      capacity = 0;       // bytes available at data when receiving
+                size_t      bytes = 0;          // payload bytes to send or received
+                uint16_t    segment = 0;        // gso/gro segment size, 0 when not split
+                address     peer;               // destination when sending, source when received
+            };
+
+            // datagrams handed to the kernel per sendmmsg/recvmmsg call
+            static const size_t MAX_BATCH = 64;
+
         public:
             socket () = default;
             socket (socket const &other) = default;
@@ -123,6 +162,7 @@ namespace ceres { namespace io { namespace net {
             {
                 *this = other;
                 other.invalidate ();
+                return *this;
             }
 
             socket (type kind) { open (kind); }
@@ -131,6 +171,8 @@ namespace ceres { namespace io { namespace net {
         public:
             void invalidate () { handle_ = INVALID; }
             socket::type get_type () const { return type_; }
+            handle_type get_handle () const { return handle_; }
+            bool is_nonblocking () const { return nonblocking_; }
 
         public:
             std::error_code open (type kind)
@@ -190,10 +232,222 @@ namespace ceres { namespace io { namespace net {
             {
                 address remote;
                 auto addr = (sockaddr *) remote;
-                auto size = remote.sockaddr_size ();
+                auto size = remote.sockaddr_capacity ();
 
                 if (!system::socket::try_accept (handle_, addr, size, accepted.handle_))
                     system::load_last_error_code (error_);
+                else
+                    remote.validate ();
+
+                return error_;
+            }
+
+            std::error_code set_nonblocking (bool enable)
+            {
+                if (system::socket::try_set_nonblocking (handle_, enable))
+                    nonblocking_ = enable;
+                else
+                    system::load_last_error_code (error_);
+
+                return error_;
+            }
+
+        public:
+            // NOTE: would-block results are returned but not latched into error(), 
+            // so a nonblocking socket stays usable after an empty read or full send
+
+            std::error_code send (memory::buffer<uint8_t> const &buf, size_t &sent)
+            {
+                std::error_code error;
+
+                if (!system::socket::try_send (handle_, buf.pointer, buf.bytes, 0, sent))
+                    system::load_last_error_code (error);
+
+                if (error && !system::socket::would_block (error))
+                    error_ = error;
+
+                return error;
+            }
+
+            std::error_code receive (memory::buffer<uint8_t> const &buf, size_t &received)
+            {
+                std::error_code error;
+
+                if (!system::socket::try_recv (handle_, buf.items, buf.bytes, 0, received))
+                    system::load_last_error_code (error);
+
+                if (error && !system::socket::would_block (error))
+                    error_ = error;
+
+                return error;
+            }
+
+        public:
+            std::error_code send_to (address const &remote, memory::buffer<uint8_t> const &buf, size_t &sent)
+            {
+                datagram d;
+                d.data = buf.items;
+                d.bytes = buf.bytes;
+                d.peer = remote;
+
+                std::error_code error = send_batch (&d, 1, sent);
+                sent = sent? d.bytes : 0;
+
+                return error;
+            }
+
+            std::error_code receive_from (address &remote, memory::buffer<uint8_t> const &buf, size_t &received)
+            {
+                datagram d;
+                d.data = buf.items;
+                d.capacity = buf.bytes;
+
+                std::error_code error = receive_batch (&d, 1, received);
+                received = received? d.bytes : 0;
+                remote = d.peer;
+
+                return error;
+            }
+
+            // Sends up to count datagrams with one sendmmsg per MAX_BATCH; sent 
+            // is the number of whole datagrams accepted by the kernel
+
+            std::error_code send_batch (datagram const *batch, size_t count, size_t &sent)
+            {
+                system::socket::batch_type headers [MAX_BATCH];
+                iovec vecs [MAX_BATCH];
+                control controls [MAX_BATCH];
+
+                std::error_code error;
+                bool proceed = true;
+                sent = 0;
+
+                while (proceed && sent < count)
+                {
+                    size_t n = std::min (count - sent, size_t {MAX_BATCH}), done = 0;
+                    std::memset (headers, 0, n * sizeof (headers[0]));
+
+                    for (size_t i=0; i < n; ++i)
+                    {
+                        auto const &d = batch[sent + i];
+                        auto &msg = headers[i].msg_hdr;
+
+                        vecs[i] = {d.data, d.bytes};
+                        msg.msg_iov = &vecs[i];
+                        msg.msg_iovlen = 1;
+
+                        // connected sockets send without an explicit peer
+                        if (d.peer)
+                        {
+                            msg.msg_name = const_cast<sockaddr *> ((sockaddr const *) d.peer);
+                            msg.msg_namelen = d.peer.sockaddr_size ();
+                        }
+
+                        if (d.segment > 0)
+                        {
+                            msg.msg_control = controls[i].bytes;
+                            msg.msg_controllen = sizeof (controls[i].bytes);
+
+                            auto cmsg = CMSG_FIRSTHDR (&msg);
+                            cmsg->cmsg_level = SOL_UDP;
+                            cmsg->cmsg_type = UDP_SEGMENT;
+                            cmsg->cmsg_len = CMSG_LEN (sizeof (uint16_t));
+                            std::memcpy (CMSG_DATA (cmsg), &d.segment, sizeof (uint16_t));
+                        }
+                    }
+
+                    if (!system::socket::try_send_batch (handle_, headers, n, 0, done))
+                        system::load_last_error_code (error);
+
+                    sent += done;
+                    proceed = !error && done == n;
+                }
+
+                if (error && !system::socket::would_block (error))
+                    error_ = error;
+
+                return error;
+            }
+
+            // Receives up to count datagrams into the caller's storage, waiting only 
+            // for the first; fills in bytes, source peer and gro segment size
+
+            std::error_code receive_batch (datagram *batch, size_t count, size_t &received)
+            {
+                system::socket::batch_type headers [MAX_BATCH];
+                iovec vecs [MAX_BATCH];
+                control controls [MAX_BATCH];
+
+                std::error_code error;
+                bool proceed = true;
+                received = 0;
+
+                while (proceed && received < count)
+                {
+                    size_t n = std::min (count - received, size_t {MAX_BATCH}), done = 0;
+                    std::memset (headers, 0, n * sizeof (headers[0]));
+
+                    for (size_t i=0; i < n; ++i)
+                    {
+                        auto &d = batch[received + i];
+                        auto &msg = headers[i].msg_hdr;
+
+                        vecs[i] = {d.data, d.capacity};
+                        msg.msg_iov = &vecs[i];
+                        msg.msg_iovlen = 1;
+                        msg.msg_name = (sockaddr *) d.peer;
+                        msg.msg_namelen = d.peer.sockaddr_capacity ();
+                        msg.msg_control = controls[i].bytes;
+                        msg.msg_controllen = sizeof (controls[i].bytes);
+                    }
+
+                    // block for the first chunk only, later chunks take what's already queued
+                    int flags = (received == 0)? MSG_WAITFORONE : MSG_DONTWAIT;
+                    if (!system::socket::try_recv_batch (handle_, headers, n, flags, done))
+                        system::load_last_error_code (error);
+
+                    for (size_t i=0; i < done; ++i)
+                    {
+                        auto &d = batch[received + i];
+                        auto &msg = headers[i].msg_hdr;
+
+                        d.bytes = headers[i].msg_len;
+                        d.segment = 0;
+                        d.peer.validate ();
+
+                        for (auto cmsg = CMSG_FIRSTHDR (&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR (&msg, cmsg))
+                        {
+                            if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+                            {
+                                int segment;
+                                std::memcpy (&segment, CMSG_DATA (cmsg), sizeof (segment));
+                                d.segment = static_cast<uint16_t> (segment);
+                            }
+                        }
+                    }
+
+                    received += done;
+                    proceed = !error && done == n;
+                }
+
+                // running dry after the first chunk isn't an error for the caller
+                if (received > 0 && system::socket::would_block (error))
+                    error = {};
+
+                if (error && !system::socket::would_block (error))
+                    error_ = error;
+
+                return error;
+            }
+
+            // lets the kernel hand over several same-flow packets as one buffer 
+            // (linux 5.0+); receive buffers should then be sized up to 64KiB
+            std::error_code set_receive_offload (bool enable)
+            {
+                int value = enable;
+
+                if (!system::socket::try_set_option (handle_, SOL_UDP, UDP_GRO, &value, sizeof (value)))
+                    system::load_last_error_code (error_);
 
                 return error_;
             }
@@ -203,10 +457,12 @@ namespace ceres { namespace io { namespace net {
             {
                 address local;
                 auto addr = (sockaddr *) local;
-                auto size = local.sockaddr_size ();
+                auto size = local.sockaddr_capacity ();
 
                 if (!system::socket::try_get_local_address (handle_, addr, size))
                     system::load_last_error_code (error_);
+                else
+                    local.validate ();
 
                 return local;
             }
@@ -215,10 +471,12 @@ namespace ceres { namespace io { namespace net {
             {
                 address remote;
                 auto addr = (sockaddr *) remote;
-                auto size = remote.sockaddr_size ();
+                auto size = remote.sockaddr_capacity ();
 
                 if (!system::socket::try_get_remote_address (handle_, addr, size))
                     system::load_last_error_code (error_);
+                else
+                    remote.validate ();
 
                 return remote;
             }
@@ -244,6 +502,18 @@ namespace ceres { namespace io { namespace net {
                         sockprot = IPPROTO_UDP;
                         break;
 
+                    case type::TCP6:
+                        sockfam = AF_INET6;
+                        socktype = SOCK_STREAM;
+                        sockprot = IPPROTO_TCP;
+                        break;
+
+                    case type::UDP6:
+                        sockfam = AF_INET6;
+                        socktype = SOCK_DGRAM;
+                        sockprot = IPPROTO_UDP;
+                        break;
+
                     default:
                         sockfam = socktype = sockprot = -1;
                         break;
@@ -251,9 +521,20 @@ namespace ceres { namespace io { namespace net {
             }
 
         private:
+            // ancillary data for one datagram, sized for a gso/gro segment size
+            union control
+            {
+                uint8_t bytes [CMSG_SPACE (sizeof (int))];
+                cmsghdr align;
+            };
+
+        private:
+            friend class service;
+
             handle_type     handle_ = INVALID;
             socket::type    type_ = type::NONE;
             std::error_code error_;
+            bool            nonblocking_ = false;
     };
 
 } } }
@@ -0,0 +1,68 @@
+#include <core/standard.hpp>
+
+#include <unistd.h>
+
+#include <platform/posix/epoll.hpp>
+#include <platform/posix/error.hpp>
+
+namespace ceres { namespace platform { namespace posix { namespace epoll {
+
+    bool try_create (handle_type &handle)
+    {
+        handle_type result = epoll_create1 (EPOLL_CLOEXEC);
+        bool success = result != INVALID;
+
+        if (success)
+            handle = result;
+
+        return success;
+    }
+
+    bool try_close (handle_type &handle)
+    {
+        using ::close;
+
+        int result = close (handle);
+        bool success = result == 0;
+
+        if (success)
+            handle = INVALID;
+
+        return success;
+    }
+
+    bool try_add (handle_type handle, int fd, uint32_t events, uint64_t data)
+    {
+        event_type event;
+        event.events = events;
+        event.data.u64 = data;
+
+        return epoll_ctl (handle, EPOLL_CTL_ADD, fd, &event) == 0;
+    }
+
+    bool try_modify (handle_type handle, int fd, uint32_t events, uint64_t data)
+    {
+        event_type event;
+        event.events = events;
+        event.data.u64 = data;
+
+        return epoll_ctl (handle, EPOLL_CTL_MOD, fd, &event) == 0;
+    }
+
+    bool try_remove (handle_type handle, int fd)
+    {
+        event_type event; // ignored, but pre-2.6.9 kernels require non-null
+        return epoll_ctl (handle, EPOLL_CTL_DEL, fd, &event) == 0;
+    }
+
+    bool try_wait (handle_type handle, event_type *events, int capacity, int timeout_ms, int &count)
+    {
+        int result = epoll_wait (handle, events, capacity, timeout_ms);
+        bool success = result >= 0;
+
+        count = success? result : 0;
+
+        return success;
+    }
+
+} } } }
@@ -0,0 +1,27 @@
+#ifndef _PLATFORM_POSIX_EPOLL_HPP_
+#define _PLATFORM_POSIX_EPOLL_HPP_
+
+#include <sys/epoll.h>
+
+// NOTE: linux-only readiness multiplexer; used as the portable fallback when the 
+// kernel doesn't offer io_uring (or it's disabled by seccomp/sysctl)
+
+namespace ceres { namespace platform { namespace posix { namespace epoll {
+
+    using handle_type = int;
+    using event_type = epoll_event;
+
+    static const handle_type INVALID = -1;
+
+    bool try_create (handle_type &handle);
+    bool try_close (handle_type &handle);
+
+    bool try_add (handle_type handle, int fd, uint32_t events, uint64_t data);
+    bool try_modify (handle_type handle, int fd, uint32_t events, uint64_t data);
+    bool try_remove (handle_type handle, int fd);
+
+    bool try_wait (handle_type handle, event_type *events, int capacity, int timeout_ms, int &count);
+
+} } } }
+
+#endif
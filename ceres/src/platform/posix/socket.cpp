@@ -1,5 +1,6 @@
 #include <core/standard.hpp>
 
+#include <fcntl.h>
 #include <unistd.h>
 #include <arpa/inet.h>
 
@@ -8,7 +9,7 @@
 
 namespace ceres { namespace platform { namespace posix { namespace socket {
 
-    bool try_string_to_inet4 (std::string const &str, address_type &addr)
+    bool try_string_to_inet4 (std::string const &str, sockaddr_in &addr)
     {
         using std::string;
         using std::stoul; // WARN: can throw
@@ -26,7 +27,7 @@ namespace ceres { namespace platform { namespace posix { namespace socket {
         return success;
     }
 
-    bool try_inet4_to_string (address_type const &addr, std::string &str)
+    bool try_inet4_to_string (sockaddr_in const &addr, std::string &str)
     {
         using std::to_string; // WARN: can throw
 
@@ -45,6 +46,68 @@ namespace ceres { namespace platform { namespace posix { namespace socket {
         return success;
     }
 
+    bool try_string_to_inet6 (std::string const &str, sockaddr_in6 &addr)
+    {
+        using std::string;
+        using std::stoul; // WARN: can throw
+
+        // accepts "[host]:port" or a bare "host"
+        string host = str;
+        size_t bracket = str.rfind (']');
+
+        if (!str.empty () && str.front () == '[' && bracket != string::npos)
+        {
+            host = str.substr (1, bracket - 1);
+            if (bracket + 1 < str.size () && str[bracket + 1] == ':')
+                addr.sin6_port = htons (stoul (str.substr (bracket + 2)));
+        }
+
+        int result = inet_pton (AF_INET6, host.c_str(), &addr.sin6_addr);
+        bool success = result > 0;
+
+        return success;
+    }
+
+    bool try_inet6_to_string (sockaddr_in6 const &addr, std::string &str)
+    {
+        using std::to_string; // WARN: can throw
+
+        char buf [INET6_ADDRSTRLEN];
+
+        char const *result = inet_ntop (AF_INET6, &addr.sin6_addr, buf, sizeof (buf));
+        bool success = result != nullptr;
+
+        if (success)
+        {
+            str = "[";
+            str += buf; 
+            str += "]:";
+            str += to_string (ntohs (addr.sin6_port));
+        }
+
+        return success;
+    }
+
+    bool try_string_to_inet (std::string const &str, address_type &addr)
+    {
+        // more than one colon can only be an ipv6 host
+        bool inet6 = str.find (':') != str.rfind (':') || (!str.empty () && str.front () == '[');
+
+        std::memset (&addr, 0, sizeof (addr));
+        addr.ss_family = inet6? AF_INET6 : AF_INET;
+
+        return inet6? 
+            try_string_to_inet6 (str, reinterpret_cast<sockaddr_in6 &> (addr)) :
+            try_string_to_inet4 (str, reinterpret_cast<sockaddr_in &> (addr));
+    }
+
+    bool try_inet_to_string (address_type const &addr, std::string &str)
+    {
+        return (addr.ss_family == AF_INET6)? 
+            try_inet6_to_string (reinterpret_cast<sockaddr_in6 const &> (addr), str) :
+            try_inet4_to_string (reinterpret_cast<sockaddr_in const &> (addr), str);
+    }
+
     bool try_open (int family, int type, int protocol, int &handle)
     {
         using ::socket;
@@ -135,4 +198,97 @@ namespace ceres { namespace platform { namespace posix { namespace socket {
         return success;
     }
 
+    bool try_set_nonblocking (handle_type handle, bool enable)
+    {
+        using ::fcntl;
+
+        int flags = fcntl (handle, F_GETFL, 0);
+        bool success = flags != INVALID;
+
+        if (success)
+        {
+            flags = enable? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+            success = fcntl (handle, F_SETFL, flags) != INVALID;
+        }
+
+        return success;
+    }
+
+    bool try_accept_nonblocking (handle_type handle, handle_type &accepted)
+    {
+        using ::accept4;
+
+        handle_type result = accept4 (handle, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        bool success = result != INVALID;
+
+        if (success)
+            accepted = result;
+
+        return success;
+    }
+
+    bool try_send (handle_type handle, void const *buf, size_t bytes, int flags, size_t &sent)
+    {
+        using ::send;
+
+        ssize_t result = send (handle, buf, bytes, flags | MSG_NOSIGNAL);
+        bool success = result >= 0;
+
+        sent = success? static_cast<size_t> (result) : 0;
+
+        return success;
+    }
+
+    bool try_recv (handle_type handle, void *buf, size_t bytes, int flags, size_t &received)
+    {
+        using ::recv;
+
+        ssize_t result = recv (handle, buf, bytes, flags);
+        bool success = result >= 0;
+
+        received = success? static_cast<size_t> (result) : 0;
+
+        return success;
+    }
+
+    bool try_send_batch (handle_type handle, batch_type *batch, size_t count, int flags, size_t &sent)
+    {
+        using ::sendmmsg;
+
+        int result = sendmmsg (handle, batch, static_cast<unsigned> (count), flags | MSG_NOSIGNAL);
+        bool success = result >= 0;
+
+        sent = success? static_cast<size_t> (result) : 0;
+
+        return success;
+    }
+
+    bool try_recv_batch (handle_type handle, batch_type *batch, size_t count, int flags, size_t &received)
+    {
+        using ::recvmmsg;
+
+        int result = recvmmsg (handle, batch, static_cast<unsigned> (count), flags, nullptr);
+        bool success = result >= 0;
+
+        received = success? static_cast<size_t> (result) : 0;
+
+        return success;
+    }
+
+    bool try_set_option (handle_type handle, int level, int name, void const *value, size_type size)
+    {
+        using ::setsockopt;
+
+        int result = setsockopt (handle, level, name, value, size);
+        bool success = result == 0;
+
+        return success;
+    }
+
+    bool would_block (std::error_code const &error)
+    {
+        return error == std::errc::operation_would_block || 
+            error == std::errc::resource_unavailable_try_again;
+    }
+
 } } } }
@@ -3,17 +3,25 @@
 
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/udp.h>
 
 namespace ceres { namespace platform { namespace posix { namespace socket {
 
     using handle_type = int;
     using size_type = socklen_t;
-    using address_type = sockaddr_in;
+    using address_type = sockaddr_storage;
+    using batch_type = mmsghdr;
 
     static const handle_type INVALID = -1;
 
-    bool try_string_to_inet4 (std::string const &str, address_type &addr);
-    bool try_inet4_to_string (address_type const &addr, std::string &str);
+    bool try_string_to_inet4 (std::string const &str, sockaddr_in &addr);
+    bool try_inet4_to_string (sockaddr_in const &addr, std::string &str);
+
+    bool try_string_to_inet6 (std::string const &str, sockaddr_in6 &addr);
+    bool try_inet6_to_string (sockaddr_in6 const &addr, std::string &str);
+
+    bool try_string_to_inet (std::string const &str, address_type &addr);
+    bool try_inet_to_string (address_type const &addr, std::string &str);
 
     bool try_open (int family, int type, int protocol, int &handle);
     bool try_close (handle_type &handle);
@@ -28,6 +36,19 @@ namespace ceres { namespace platform { namespace posix { namespace socket {
     bool try_get_local_address (handle_type handle, sockaddr *addr, size_type &size);
     bool try_get_remote_address (handle_type handle, sockaddr *addr, size_type &size);
 
+    bool try_set_nonblocking (handle_type handle, bool enable);
+    bool try_accept_nonblocking (handle_type handle, handle_type &accepted);
+
+    bool try_send (handle_type handle, void const *buf, size_t bytes, int flags, size_t &sent);
+    bool try_recv (handle_type handle, void *buf, size_t bytes, int flags, size_t &received);
+
+    bool try_send_batch (handle_type handle, batch_type *batch, size_t count, int flags, size_t &sent);
+    bool try_recv_batch (handle_type handle, batch_type *batch, size_t count, int flags, size_t &received);
+
+    bool try_set_option (handle_type handle, int level, int name, void const *value, size_type size);
+
+    bool would_block (std::error_code const &error);
+
 } } } }
 
  #endif
@@ -0,0 +1,194 @@
+#include <core/standard.hpp>
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <platform/posix/uring.hpp>
+#include <platform/posix/error.hpp>
+
+namespace ceres { namespace platform { namespace posix { namespace uring {
+
+    namespace {
+
+        // NOTE: ring indices are shared with the kernel, acquire/release pairs order our 
+        // reads of entries against the kernel's writes (and vice versa)
+
+        uint32_t load_acquire (uint32_t const *p) { return __atomic_load_n (p, __ATOMIC_ACQUIRE); }
+        void store_release (uint32_t *p, uint32_t v) { __atomic_store_n (p, v, __ATOMIC_RELEASE); }
+
+        int sys_setup (uint32_t entries, io_uring_params *p)
+        {
+            return static_cast<int> (syscall (__NR_io_uring_setup, entries, p));
+        }
+
+        int sys_enter (int fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags)
+        {
+            return static_cast<int> (syscall (__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+        }
+
+        int sys_register (int fd, uint32_t opcode, void const *arg, uint32_t nr_args)
+        {
+            return static_cast<int> (syscall (__NR_io_uring_register, fd, opcode, arg, nr_args));
+        }
+
+        template <typename T>
+        T *at (void *base, uint32_t offset)
+        {
+            return reinterpret_cast<T *> (static_cast<uint8_t *> (base) + offset);
+        }
+    }
+
+    bool try_setup (uint32_t depth, ring &r)
+    {
+        std::memset (&r.params, 0, sizeof (r.params));
+
+        handle_type result = sys_setup (depth, &r.params);
+        bool success = result != INVALID;
+
+        if (success)
+        {
+            auto const &p = r.params;
+            r.handle = result;
+
+            r.sq_map_size = p.sq_off.array + p.sq_entries * sizeof (uint32_t);
+            r.cq_map_size = p.cq_off.cqes + p.cq_entries * sizeof (result_type);
+            r.sqes_size = p.sq_entries * sizeof (entry_type);
+
+            // newer kernels expose both rings through one mapping
+            bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+            if (single)
+                r.sq_map_size = r.cq_map_size = std::max (r.sq_map_size, r.cq_map_size);
+
+            r.sq_map = mmap (nullptr, r.sq_map_size, PROT_READ | PROT_WRITE, 
+                    MAP_SHARED | MAP_POPULATE, r.handle, IORING_OFF_SQ_RING);
+            success = r.sq_map != MAP_FAILED;
+
+            if (success)
+            {
+                r.cq_map = single? r.sq_map : mmap (nullptr, r.cq_map_size, PROT_READ | PROT_WRITE, 
+                        MAP_SHARED | MAP_POPULATE, r.handle, IORING_OFF_CQ_RING);
+                success = r.cq_map != MAP_FAILED;
+            }
+
+            if (success)
+            {
+                void *sqes = mmap (nullptr, r.sqes_size, PROT_READ | PROT_WRITE, 
+                        MAP_SHARED | MAP_POPULATE, r.handle, IORING_OFF_SQES);
+                success = sqes != MAP_FAILED;
+                r.sqes = success? static_cast<entry_type *> (sqes) : nullptr;
+            }
+
+            if (success)
+            {
+                r.sq_head = at<uint32_t> (r.sq_map, p.sq_off.head);
+                r.sq_tail = at<uint32_t> (r.sq_map, p.sq_off.tail);
+                r.sq_array = at<uint32_t> (r.sq_map, p.sq_off.array);
+                r.sq_mask = *at<uint32_t> (r.sq_map, p.sq_off.ring_mask);
+                r.sq_entries = *at<uint32_t> (r.sq_map, p.sq_off.ring_entries);
+                r.sq_local_tail = r.sq_submitted = *r.sq_tail;
+
+                r.cq_head = at<uint32_t> (r.cq_map, p.cq_off.head);
+                r.cq_tail = at<uint32_t> (r.cq_map, p.cq_off.tail);
+                r.cq_mask = *at<uint32_t> (r.cq_map, p.cq_off.ring_mask);
+                r.cqes = at<result_type> (r.cq_map, p.cq_off.cqes);
+            }
+            else
+            {
+                int saved = errno;
+                try_teardown (r);
+                errno = saved;
+            }
+        }
+
+        return success;
+    }
+
+    bool try_teardown (ring &r)
+    {
+        if (r.sqes != nullptr)
+            munmap (r.sqes, r.sqes_size);
+
+        if (r.cq_map != nullptr && r.cq_map != MAP_FAILED && r.cq_map != r.sq_map)
+            munmap (r.cq_map, r.cq_map_size);
+
+        if (r.sq_map != nullptr && r.sq_map != MAP_FAILED)
+            munmap (r.sq_map, r.sq_map_size);
+
+        r.sqes = nullptr;
+        r.sq_map = r.cq_map = nullptr;
+
+        bool success = r.handle == INVALID || ::close (r.handle) == 0;
+
+        if (success)
+            r.handle = INVALID;
+
+        return success;
+    }
+
+    entry_type *try_get_entry (ring &r)
+    {
+        uint32_t head = load_acquire (r.sq_head);
+        bool success = r.sq_local_tail - head < r.sq_entries;
+
+        entry_type *entry = nullptr;
+
+        if (success)
+        {
+            uint32_t index = r.sq_local_tail & r.sq_mask;
+            entry = &r.sqes[index];
+            r.sq_array[index] = index;
+            ++r.sq_local_tail;
+
+            std::memset (entry, 0, sizeof (*entry));
+        }
+
+        return entry;
+    }
+
+    bool try_submit (ring &r, uint32_t wait_for, uint32_t &submitted)
+    {
+        uint32_t pending = r.sq_local_tail - r.sq_submitted;
+        store_release (r.sq_tail, r.sq_local_tail);
+
+        bool success = true;
+        submitted = 0;
+
+        // nothing to hand over or wait for, stay out of the kernel entirely
+        if (pending > 0 || wait_for > 0)
+        {
+            int result = sys_enter (r.handle, pending, wait_for, wait_for? IORING_ENTER_GETEVENTS : 0);
+            success = result >= 0;
+
+            submitted = success? static_cast<uint32_t> (result) : 0;
+            r.sq_submitted += submitted;
+        }
+
+        return success;
+    }
+
+    bool try_reap (ring &r, result_type &result)
+    {
+        uint32_t head = *r.cq_head;
+        bool success = head != load_acquire (r.cq_tail);
+
+        if (success)
+        {
+            result = r.cqes[head & r.cq_mask];
+            store_release (r.cq_head, head + 1);
+        }
+
+        return success;
+    }
+
+    bool try_register_buffers (ring &r, iovec const *vecs, unsigned count)
+    {
+        return sys_register (r.handle, IORING_REGISTER_BUFFERS, vecs, count) == 0;
+    }
+
+    bool try_unregister_buffers (ring &r)
+    {
+        return sys_register (r.handle, IORING_UNREGISTER_BUFFERS, nullptr, 0) == 0;
+    }
+
+} } } }
@@ -0,0 +1,68 @@
+#ifndef _PLATFORM_POSIX_URING_HPP_
+#define _PLATFORM_POSIX_URING_HPP_
+
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+// NOTE: linux-only (5.6+ for socket opcodes); talks to io_uring through the raw syscalls 
+// rather than liburing. The kernel shares the submission/completion rings with us over 
+// mmap, so queueing an operation is a store into shared memory and a single enter call 
+// can submit a whole batch and reap completions at the same time
+
+namespace ceres { namespace platform { namespace posix { namespace uring {
+
+    using handle_type = int;
+    using entry_type = io_uring_sqe;
+    using result_type = io_uring_cqe;
+
+    static const handle_type INVALID = -1;
+
+    struct ring
+    {
+        handle_type handle = INVALID;
+        io_uring_params params;
+
+        // submission queue, shared with kernel
+        uint32_t *sq_head = nullptr;
+        uint32_t *sq_tail = nullptr;
+        uint32_t *sq_array = nullptr;
+        uint32_t sq_mask = 0;
+        uint32_t sq_entries = 0;
+        entry_type *sqes = nullptr;
+
+        // entries handed out but not yet published to the kernel
+        uint32_t sq_local_tail = 0;
+        uint32_t sq_submitted = 0;
+
+        // completion queue, shared with kernel
+        uint32_t *cq_head = nullptr;
+        uint32_t *cq_tail = nullptr;
+        uint32_t cq_mask = 0;
+        result_type *cqes = nullptr;
+
+        // mappings to release on teardown
+        void *sq_map = nullptr;
+        void *cq_map = nullptr;
+        size_t sq_map_size = 0;
+        size_t cq_map_size = 0;
+        size_t sqes_size = 0;
+    };
+
+    bool try_setup (uint32_t depth, ring &r);
+    bool try_teardown (ring &r);
+
+    // returns a zeroed entry to fill in, or nullptr if the submission queue is full
+    entry_type *try_get_entry (ring &r);
+
+    // publishes pending entries and optionally waits until wait_for results are available
+    bool try_submit (ring &r, uint32_t wait_for, uint32_t &submitted);
+
+    // pops one result off the completion queue without entering the kernel
+    bool try_reap (ring &r, result_type &result);
+
+    bool try_register_buffers (ring &r, iovec const *vecs, unsigned count);
+    bool try_unregister_buffers (ring &r);
+
+} } } }
+
+#endif
@@ -247,6 +247,7 @@ namespace ceres
             private:
                 size_t  curr_active = nstates;
                 size_t  next_active = nstates;
+                alignas (core::max_type_align<States...>())
                 uint8_t buffer [core::max_type_size<States...>()];
         };
 
@@ -283,6 +284,207 @@ namespace ceres
                 Reactor     reactor_;
         };
 
+        //=====================================================================
+        
+        //---------------------------------------------------------------------
+        // Events a table machine reacts to; an event's position is its ID
+
+        template <typename ...Events>
+        struct event_list 
+        {
+            constexpr static size_t nevents = sizeof...(Events);
+        };
+
+        //---------------------------------------------------------------------
+        // Aligned storage for exactly one of the states at a time; an active 
+        // index of nstates means no state is alive
+
+        template <typename ...States>
+        class table_context
+        {
+            public:
+                constexpr static size_t nstates = sizeof...(States);
+
+                template <typename State>
+                using state_id = std::integral_constant <size_t, core::type_index <State, States...>::value>;
+
+                inline size_t active () const
+                {
+                    return active_;
+                }
+
+                template <typename State, typename ...Args>
+                inline void emplace (Args &&...args)
+                {
+                    static_assert (state_id <State>::value < nstates, "state is not part of the machine");
+
+                    new (reinterpret_cast <void *> (&storage_)) State (std::forward <Args> (args)...);
+                    active_ = state_id <State>::value;
+                }
+
+                template <typename State>
+                inline void destroy ()
+                {
+                    // marked inactive first so a throwing successor leaves no state to destroy
+                    active_ = nstates;
+                    reinterpret_cast <State *> (&storage_)-> ~State();
+                }
+
+                template <typename State>
+                inline State &get ()
+                {
+                    return *reinterpret_cast <State *> (&storage_);
+                }
+
+            private:
+                typedef typename std::aligned_storage <
+                    core::max_type_size <States...> (), 
+                    core::max_type_align <States...> ()>::type storage_type;
+
+                size_t          active_ = nstates;
+                storage_type    storage_;
+        };
+
+        //---------------------------------------------------------------------
+        // Single table entry: replaces From with To constructed from the event,
+        // or does nothing where no transition is specialized
+
+        template <typename Context, 
+                 typename From, 
+                 typename Event, 
+                 typename To = typename traits::state::transition <From, Event>::next>
+
+        struct table_transition
+        {
+            static void apply (Context &ctx, void const *event)
+            {
+                ctx.template destroy <From> ();
+                ctx.template emplace <To> (*static_cast <Event const *> (event));
+            }
+        };
+
+        template <typename Context, typename From, typename Event>
+        struct table_transition <Context, From, Event, traits::state::null>
+        {
+            static void apply (Context &, void const *) {}
+        };
+
+        template <typename Context, typename State>
+        struct table_destroyer
+        {
+            static void apply (Context &ctx)
+            {
+                ctx.template destroy <State> ();
+            }
+        };
+
+        template <typename Context>
+        struct table_destroyer <Context, traits::state::null>
+        {
+            static void apply (Context &) {}
+        };
+
+        //---------------------------------------------------------------------
+        // Flat (state ID, event ID) table of transitions generated at compile 
+        // time; the extra last row belongs to the inactive state and is no-op
+
+        template <typename Context, typename Events, typename ...States>
+        struct transition_table;
+
+        template <typename Context, typename ...Events, typename ...States>
+        struct transition_table <Context, event_list <Events...>, States...>
+        {
+            typedef void (*jump_type) (Context &, void const *);
+            typedef void (*destroy_type) (Context &);
+
+            constexpr static size_t nstates = sizeof...(States);
+            constexpr static size_t nevents = sizeof...(Events);
+
+            template <size_t Entry>
+            using from_state = core::type_at <Entry / nevents, States..., traits::state::null>;
+
+            template <size_t Entry>
+            using on_event = core::type_at <Entry % nevents, Events...>;
+
+            template <typename Indices>
+            struct generator;
+
+            template <size_t ...Entries>
+            struct generator <core::indices <Entries...>>
+            {
+                constexpr static jump_type jumps [sizeof...(Entries)] = 
+                {
+                    &table_transition <Context, 
+                        typename from_state <Entries>::type, 
+                        typename on_event <Entries>::type>::apply...
+                };
+            };
+
+            typedef generator <typename core::make_indices <(nstates + 1) * nevents>::type> table;
+
+            constexpr static destroy_type destroyers [nstates + 1] = 
+            {
+                &table_destroyer <Context, States>::apply..., 
+                &table_destroyer <Context, traits::state::null>::apply
+            };
+        };
+
+        template <typename Context, typename ...Events, typename ...States>
+        template <size_t ...Entries>
+        constexpr typename transition_table <Context, event_list <Events...>, States...>::jump_type
+        transition_table <Context, event_list <Events...>, States...>::generator <core::indices <Entries...>>::jumps [sizeof...(Entries)];
+
+        template <typename Context, typename ...Events, typename ...States>
+        constexpr typename transition_table <Context, event_list <Events...>, States...>::destroy_type
+        transition_table <Context, event_list <Events...>, States...>::destroyers [nstates + 1];
+
+        //---------------------------------------------------------------------
+        // Same semantics as singular_machine, but every reaction is a single 
+        // indexed jump rather than a walk over all states; events a machine 
+        // reacts to must be listed up front to be given IDs
+
+        template <typename Events, typename Default, typename ...States>
+        class table_machine;
+
+        template <typename ...Events, typename Default, typename ...States>
+        class table_machine <event_list <Events...>, Default, States...>
+        {
+            public:
+                typedef table_context <Default, States...>                              Context;
+                typedef transition_table <Context, event_list <Events...>, Default, States...> Table;
+
+                table_machine () 
+                { 
+                    context_.template emplace <Default> ();
+                }
+
+                ~table_machine () 
+                { 
+                    Table::destroyers [context_.active ()] (context_);
+                }
+
+                table_machine (table_machine const &) = delete;
+                table_machine &operator= (table_machine const &) = delete;
+
+                template <typename Event> 
+                void react (Event const &event) 
+                { 
+                    constexpr size_t event_id = core::type_index <Event, Events...>::value;
+                    static_assert (event_id < Table::nevents, "event is not part of the machine's event_list");
+
+                    Table::table::jumps [context_.active () * Table::nevents + event_id] (context_, &event);
+                }
+
+                template <typename State>
+                bool is_active () const
+                {
+                    return context_.active () == Context::template state_id <State>::value;
+                }
+
+            private:
+                Context     context_;
+        };
+
         //---------------------------------------------------------------------
         
         //template <typename ...States>
@@ -5,6 +5,11 @@
 #include <platform/posix/error.hpp>
 #include <platform/posix/socket.hpp>
 
+#ifdef __linux__
+#include <platform/posix/epoll.hpp>
+#include <platform/posix/uring.hpp>
+#endif
+
 namespace ceres { namespace system {
 
     using namespace platform::posix;
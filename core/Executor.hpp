@@ -5,11 +5,19 @@
 
 #include "core/Handle.hpp"
 
+// Work is a CORE_EXECUTOR_WORK, std::function<void()> unless it is defined
+// before this header to another nullary callable, e.g. a core::mofunction or
+// a core::inplace_function (mofunction.hpp) to schedule work without
+// allocating
+#ifndef CORE_EXECUTOR_WORK
+#define CORE_EXECUTOR_WORK std::function<void()>
+#endif
+
 namespace core {
 
 class Executor {
  public:
-  using Work = std::function<void()>;
+  using Work = CORE_EXECUTOR_WORK;
   using Duration = std::chrono::milliseconds;
   using Handle = core::Handle<uint64_t>;
 
@@ -10,10 +10,8 @@ class Handle {
   explicit Handle(Type value) : value_ {value} {}
 
  public:
-  Handle &operator=(const Handle &that) {
-    value_ = that.value_;
-    return *this;
-  }
+  Handle(const Handle &that) = default;
+  Handle &operator=(const Handle &that) = default;
 
  public:
   Type value() const { return value_; }
@@ -0,0 +1,46 @@
+#include "core/common.hpp"
+#include "core/SharedMemoryTransport.hpp"
+
+namespace core {
+
+SharedMemoryTransport::SharedMemoryTransport(shm::Segment segment, shm::Side side)
+    : segment_{std::move(segment)} {
+  std::tie(sending_, receiving_) = segment_.Rings(side);
+}
+
+void SharedMemoryTransport::Send(core::ByteBuffer message) {
+  if (!sending_.Send(message.base, message.size)) {
+    ErrorOccurred(std::make_error_code(std::errc::message_size));
+    return;
+  }
+  MessageSent(message);
+}
+
+void SharedMemoryTransport::Receive(core::ByteBuffer message) {
+  MessageReceived(message);
+}
+
+size_t SharedMemoryTransport::Poll(size_t limit) {
+  size_t delivered = 0;
+  const uint8_t *data;
+  size_t size;
+  while (delivered < limit && receiving_.TryPeek(&data, &size)) {
+    Deliver(data, size);
+    delivered++;
+  }
+  return delivered;
+}
+
+void SharedMemoryTransport::Wait() {
+  const uint8_t *data;
+  size_t size;
+  receiving_.Peek(&data, &size);
+  Deliver(data, size);
+}
+
+void SharedMemoryTransport::Deliver(const uint8_t *data, size_t size) {
+  this->Receive(core::ByteBuffer{const_cast<uint8_t *>(data), size});
+  receiving_.Release();
+}
+
+}  // namespace core
@@ -0,0 +1,36 @@
+#ifndef SRC_CORE_SHAREDMEMORYTRANSPORT_HPP_
+#define SRC_CORE_SHAREDMEMORYTRANSPORT_HPP_
+
+#include "core/Transport.hpp"
+#include "core/shm_ring.hpp"
+
+namespace core {
+
+// Transport between two processes over a shared memory segment, one end per
+// process. Send() copies a message into the next frame of the outgoing ring;
+// Poll() and Wait() hand incoming frames to Receive() in place, as aliases
+// valid until the handler returns.
+class SharedMemoryTransport : public Transport {
+ public:
+  SharedMemoryTransport(shm::Segment segment, shm::Side side);
+
+ public:
+  void Send(core::ByteBuffer message) override;
+  void Receive(core::ByteBuffer message) override;
+
+ public:
+  // Delivers up to `limit` waiting messages, returns how many.
+  size_t Poll(size_t limit = SIZE_MAX);
+  // Blocks until a message is waiting, then delivers it.
+  void Wait();
+
+ private:
+  void Deliver(const uint8_t *data, size_t size);
+
+  shm::Segment segment_;
+  shm::Ring sending_, receiving_;
+};
+
+}  // namespace core
+
+#endif
@@ -2,6 +2,16 @@
 #define SRC_CORE_SIGNAL_HPP_
 
 #include "core/common.hpp"
+#include "core/delegate.hpp"
+
+// Handlers are kept in CORE_SIGNAL_HANDLER<void(Args...)>, std::function
+// unless it is defined before this header to another copyable, nullable
+// callable template, e.g. a core::inplace_function alias (mofunction.hpp) to
+// connect handlers without allocating, or core::delegate to connect functions
+// and bound members as two words (core::bind<&Class::Method>(object))
+#ifndef CORE_SIGNAL_HANDLER
+#define CORE_SIGNAL_HANDLER std::function
+#endif
 
 namespace core {
 
@@ -11,6 +21,9 @@ template<typename ...Args> class Signal;
 
 using handle_type = uint8_t;
 
+template <typename Signature>
+using handler_type = CORE_SIGNAL_HANDLER<Signature>;
+
 template <typename ...Args>
 class Signal final {
  public:
@@ -59,7 +72,7 @@ class Signal final {
   void disconnect(Signal<Args...> *signal);
 
  private:
-  std::array<std::function<void(Args...)>, 4> handlers_;
+  std::array<handler_type<void(Args...)>, 4> handlers_;
 
  private:
   std::set<handle_type> whenhandles_;
@@ -114,8 +127,8 @@ class Slot final {
   void disconnect(Signal<Args...> *signal);
 
  private:
-  std::vector<std::function<void(Args...)>> whenhandlers_;
-  std::vector<std::function<void(Args...)>> oncehandlers_;
+  std::vector<handler_type<void(Args...)>> whenhandlers_;
+  std::vector<handler_type<void(Args...)>> oncehandlers_;
 
  private:
   std::map<Signal<Args...> *, std::vector<handle_type>> handlemap_;
@@ -186,7 +199,7 @@ handle_type install(Handlers &handlers, Functional &&functional) {  // NOLINT
   assert(handler != end(handlers) && "Exceeded maximum active handlers");
   *handler = functional;
 
-  auto index = distance(begin(handlers), handler);
+  auto index = std::distance(begin(handlers), handler);
   assert(index <= static_cast<handle_type>(-1) && "Exceeded indexable handle range");
 
   return static_cast<handle_type>(index);
@@ -197,7 +210,7 @@ void erase(Handlers &handlers, handle_type index) {  // NOLINT
   assert(index < handlers.size() && "Exceeded handler bounds");
 
   auto handler = begin(handlers);
-  advance(handler, index);
+  std::advance(handler, index);
 
   *handler = nullptr;
 }
@@ -228,7 +241,7 @@ size_t Signal<Args...>::once_handler_count() const {
 template <typename ...Args>
 template <typename ...DeducedArgs>
 void Signal<Args...>::operator()(DeducedArgs &&...args) {
-  for (const auto &handler : handlers_) {
+  for (auto &handler : handlers_) {
     if (handler) {
       handler(args...);
     }
@@ -2,10 +2,93 @@
 #define SRC_CORE_STATE_HPP_
 
 #include "core/common.hpp"
+#include "core/Executor.hpp"
 #include "core/Signal.hpp"
 
 namespace core {
 
+// When Changed is emitted after an assignment
+enum class Delivery {
+  Immediate,  // on every assignment that changes the value
+  Coalesced,  // once per batch flush, only with the net change since the last
+};
+
+// Coalesced states changed on this thread since the last flush. Flush() is
+// called at the end of a tick, and runs on its own after `limit` changes if
+// one is set. Coalesced states are assigned and destroyed on one thread.
+class StateBatch {
+ public:
+  StateBatch() = default;
+
+  StateBatch(const StateBatch &) = delete;
+  StateBatch &operator=(const StateBatch &) = delete;
+
+  // flushed rather than lost when the thread exits
+  ~StateBatch() { Flush(); }
+
+ public:
+  static StateBatch &Local() {
+    thread_local StateBatch batch;
+    return batch;
+  }
+
+ public:
+  size_t size() const { return dirty_.size(); }
+  size_t changes() const { return changes_; }
+  size_t limit() const { return limit_; }
+  void limit(size_t limit) { limit_ = limit; }
+
+ public:
+  void Flush() {
+    if (flushing_) {
+      return;
+    }
+
+    // listeners may dirty or destroy states while this runs: the former are
+    // appended and flushed in the same pass, the latter forgotten in place
+    flushing_ = true;
+    for (size_t i = 0; i < dirty_.size(); ++i) {
+      auto entry = dirty_[i];
+      if (entry.state) {
+        dirty_[i].state = nullptr;
+        entry.flush(entry.state);
+      }
+    }
+    dirty_.clear();
+    changes_ = 0;
+    flushing_ = false;
+  }
+
+ private:
+  template <typename Class, typename Value> friend class State;
+
+  using Flusher = void (*)(void *state);
+
+  size_t Mark(void *state, Flusher flush) {
+    dirty_.push_back({state, flush});
+    return dirty_.size() - 1;
+  }
+
+  void Forget(size_t slot) {
+    dirty_[slot].state = nullptr;
+  }
+
+  bool Record() {
+    return ++changes_ >= limit_ && limit_ && !flushing_;
+  }
+
+ private:
+  struct Entry {
+    void *state;
+    Flusher flush;
+  };
+
+  std::vector<Entry> dirty_;
+  size_t changes_ = 0;
+  size_t limit_ = 0;
+  bool flushing_ = false;
+};
+
 template <typename Class, typename Value = typename Class::State>
 class State {
  public:
@@ -13,6 +96,45 @@ class State {
   explicit State(Value initial) :
     state_ {initial} {}
 
+  // With an executor, Changed is emitted by the executor rather than by the
+  // assigning thread, with at most one notification in flight: changes made
+  // before it runs fold into it. Listeners are then connected before any
+  // change is made. Destroying the state cancels a notification still queued
+  // and waits for one being delivered on another thread.
+  State(Value initial, Delivery delivery, core::Executor *executor = nullptr) :
+    state_ {initial} {
+    if (delivery != Delivery::Immediate || executor) {
+      extras_ = std::make_unique<Extras>(initial, delivery);
+    }
+    if (executor) {
+      extras_->relay = std::make_shared<Relay>(this, executor, initial);
+    }
+  }
+
+  ~State() {
+    if (!extras_) {
+      return;
+    }
+    if (extras_->batch) {
+      extras_->batch->Forget(extras_->slot);
+    }
+    if (auto &relay = extras_->relay) {
+      std::unique_lock<std::mutex> lock {relay->mutex};
+      relay->owner = nullptr;
+      if (relay->delivering != std::this_thread::get_id()) {
+        relay->delivered.wait(lock, [&] { return relay->delivering == std::thread::id {}; });
+      }
+      auto scheduled = relay->scheduled;
+      auto handle = relay->handle;
+      lock.unlock();
+
+      // a queued notification finds no owner if it runs anyway
+      if (scheduled) {
+        relay->executor->Remove(handle);
+      }
+    }
+  }
+
  public:
   Value operator()() const { return state_; }
 
@@ -23,17 +145,122 @@ class State {
   friend Class;
   State &operator=(Value state) {
     if (state_ != state) {
-      auto previous = state_;
-      auto current = state;
+      if (!extras_ || extras_->delivery == Delivery::Immediate) {
+        auto previous = state_;
+        auto current = state;
+
+        state_ = state;
+        Notify(previous, current);
+        return *this;
+      }
+
+      auto &batch = StateBatch::Local();
+      if (!extras_->batch) {
+        extras_->batch = &batch;
+        extras_->slot = batch.Mark(this, &State::Flush);
+        extras_->flushed = state_;
+      }
 
       state_ = state;
-      Changed(previous, current);
+      if (batch.Record()) {
+        batch.Flush();
+      }
     }
     return *this;
   }
 
+ private:
+  // shared with the notification in flight, which may outlive the state
+  struct Relay {
+    Relay(State *owner, core::Executor *executor, const Value &initial) :
+      owner {owner}, executor {executor}, from {initial}, to {initial} {}
+
+    std::mutex mutex;
+    std::condition_variable delivered;
+    State *owner;
+    core::Executor *executor;
+    core::Executor::Handle handle;
+    Value from, to;
+    bool scheduled = false;
+    std::thread::id delivering;  // while emitting Changed
+  };
+
+  // only for states that are not delivered immediately on their own thread
+  struct Extras {
+    Extras(const Value &initial, Delivery delivery) :
+      delivery {delivery}, flushed {initial} {}
+
+    Delivery delivery;
+
+    // while coalescing: the value when last flushed, and the batch holding it
+    Value flushed;
+    StateBatch *batch = nullptr;
+    size_t slot = 0;
+
+    std::shared_ptr<Relay> relay;
+  };
+
+  static void Flush(void *self) {
+    auto &state = *static_cast<State *>(self);
+    auto &extras = *state.extras_;
+    extras.batch = nullptr;
+
+    // toggled back and forth since the last flush: nothing to tell
+    if (extras.flushed != state.state_) {
+      state.Notify(extras.flushed, state.state_);
+    }
+  }
+
+  void Notify(const Value &previous, const Value &current) {
+    if (!extras_ || !extras_->relay) {
+      Changed(previous, current);
+      return;
+    }
+
+    auto &relay = extras_->relay;
+    {
+      std::lock_guard<std::mutex> lock {relay->mutex};
+      relay->to = current;
+      if (relay->scheduled) {
+        return;
+      }
+      relay->from = previous;
+      relay->scheduled = true;
+    }
+
+    auto handle = relay->executor->Schedule([relay] { Deliver(relay); });
+
+    // still in flight unless the executor ran it inline
+    std::lock_guard<std::mutex> lock {relay->mutex};
+    relay->handle = handle;
+  }
+
+  static void Deliver(const std::shared_ptr<Relay> &relay) {
+    std::unique_lock<std::mutex> lock {relay->mutex};
+    relay->scheduled = false;
+
+    auto owner = relay->owner;
+    auto previous = relay->from;
+    auto current = relay->to;
+    if (!owner || !(previous != current)) {
+      return;
+    }
+
+    // the owner waits for this in its destructor, unless a listener is
+    // destroying it from here
+    relay->delivering = std::this_thread::get_id();
+    lock.unlock();
+
+    owner->Changed(previous, current);
+
+    lock.lock();
+    relay->delivering = std::thread::id {};
+    relay->delivered.notify_all();
+  }
+
  private:
   Value state_;
+  std::unique_ptr<Extras> extras_;
 };
 
 }  // namespace core
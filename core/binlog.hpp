@@ -0,0 +1,429 @@
+#ifndef SRC_CORE_BINLOG_HPP_
+#define SRC_CORE_BINLOG_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Asynchronous binary log backend
+//
+// A call site is described once by a static Site (level, location, message and
+// argument names), a record is just the Site address, a decoder function and the
+// raw bytes of the arguments, pushed onto a ring owned by the logging thread.
+// A single writer thread drains every ring and only then formats the text.
+//
+// Arguments are captured as follows:
+//   - arithmetic, enum and (non char) pointer values are copied bitwise
+//   - C strings and std::string are copied with their length
+//   - anything else is formatted on the calling thread with operator<< (slow path)
+//
+// A full ring drops the record rather than blocking, see Backend::dropped().
+
+namespace core {
+namespace binlog {
+
+enum class Level : uint8_t { TRACE, DEBUG, INFO, WARN, ERROR, FATAL };
+
+inline const char *to_string(Level level) {
+  static const char *names[] = {"TRACE", "DEBUG", "INFO", "WARN", "ERROR", "FATAL"};
+  return names[static_cast<size_t>(level)];
+}
+
+struct Site {
+  Level level;
+  const char *file;
+  int line;
+  const char *function;
+  const char *message;
+  const char *separator;  // between message and arguments
+  bool located;           // prefix with function[line]
+  const char *const *names;
+  size_t count;
+};
+
+using Clock = std::chrono::system_clock;
+using Sink = std::function<void(const Site &, Clock::time_point, const std::string &)>;
+using Decoder = void (*)(std::ostream &, const Site &, const char *);
+
+namespace detail {
+
+// byte-string view of an argument, owning only when formatted on the slow path
+struct Text {
+  const char *data;
+  size_t size;
+  std::string owned;
+
+  const char *begin() const { return owned.empty()? data : owned.data(); }
+  size_t length() const { return owned.empty()? size : owned.size(); }
+};
+
+template <typename Type>
+using is_text = std::integral_constant<bool,
+    std::is_convertible<const Type &, const char *>::value ||
+    std::is_same<Type, std::string>::value>;
+
+template <typename Type>
+using is_direct = std::integral_constant<bool, !is_text<Type>::value && (
+    std::is_arithmetic<Type>::value ||
+    std::is_enum<Type>::value ||
+    std::is_pointer<Type>::value)>;
+
+template <typename Type, std::enable_if_t<is_direct<Type>::value, int> = 0>
+const Type &prepare(const Type &value) {
+  return value;
+}
+
+template <typename Type, std::enable_if_t<
+    std::is_convertible<const Type &, const char *>::value, int> = 0>
+Text prepare(const Type &value) {
+  const char *text = value;
+  return Text{text, text? std::strlen(text) : 0, {}};
+}
+
+inline Text prepare(const std::string &value) {
+  return Text{value.data(), value.size(), {}};
+}
+
+template <typename Type, std::enable_if_t<
+    !is_direct<Type>::value && !is_text<Type>::value, int> = 0>
+Text prepare(const Type &value) {
+  std::ostringstream out;
+  out << value;
+  return Text{"", 0, out.str()};
+}
+
+template <typename Type>
+struct Codec {
+  static size_t size(const Type &) { return sizeof(Type); }
+
+  static size_t encode(char *destination, const Type &value) {
+    std::memcpy(destination, &value, sizeof(Type));
+    return sizeof(Type);
+  }
+
+  static size_t decode(std::ostream &out, const char *source) {
+    Type value;
+    std::memcpy(&value, source, sizeof(Type));
+    print(out, value);
+    return sizeof(Type);
+  }
+
+ private:
+  template <typename Value, std::enable_if_t<std::is_enum<Value>::value, int> = 0>
+  static void print(std::ostream &out, Value value) {
+    out << static_cast<std::underlying_type_t<Value>>(value);
+  }
+
+  template <typename Value, std::enable_if_t<std::is_pointer<Value>::value, int> = 0>
+  static void print(std::ostream &out, Value value) {
+    out << reinterpret_cast<const void *>(value);
+  }
+
+  template <typename Value, std::enable_if_t<std::is_arithmetic<Value>::value, int> = 0>
+  static void print(std::ostream &out, Value value) {
+    out << value;
+  }
+};
+
+template <>
+struct Codec<Text> {
+  static size_t size(const Text &text) { return sizeof(uint32_t) + text.length(); }
+
+  static size_t encode(char *destination, const Text &text) {
+    auto length = static_cast<uint32_t>(text.length());
+    std::memcpy(destination, &length, sizeof length);
+    std::memcpy(destination + sizeof length, text.begin(), length);
+    return sizeof length + length;
+  }
+
+  static size_t decode(std::ostream &out, const char *source) {
+    uint32_t length = 0;
+    std::memcpy(&length, source, sizeof length);
+    out.write(source + sizeof length, length);
+    return sizeof length + length;
+  }
+};
+
+// same layout as the LOG4CXX path: function[line]: message, name: value, ...
+template <typename ...Args>
+void decode(std::ostream &out, const Site &site, const char *source) {
+  if (site.located) {
+    out << site.function << '[' << site.line << ']';
+    if (*site.message || site.count) {
+      out << ": ";
+    }
+  }
+  out << site.message;
+
+  size_t index = 0;
+  auto field = [&](auto codec) {
+    out << (index == 0? (*site.message? site.separator : "") : ", ");
+    out << site.names[index++] << ": ";
+    source += decltype(codec)::type::decode(out, source);
+  };
+  using expand = int[];
+  (void) expand{0, (field(std::common_type<Codec<Args>>{}), 0)...};
+  (void) field;
+}
+
+}  // namespace detail
+
+// Single producer (the owning thread), single consumer (the writer) byte ring,
+// records never straddle the end, a short tail is skipped with a padding record
+class Ring {
+ public:
+  struct Record {
+    uint32_t size;   // whole record including header, multiple of 8
+    uint32_t padding;
+    const Site *site;
+    Decoder decoder;
+    Clock::rep time;
+  };
+
+ public:
+  explicit Ring(size_t capacity) : buffer_ {new char[capacity]}, capacity_ {capacity} {
+    assert((capacity & (capacity - 1)) == 0 && "Ring capacity must be a power of two");
+  }
+
+ public:
+  // producer: space for a record of bytes (rounded up), nullptr when full
+  char *reserve(size_t bytes) {
+    bytes = (bytes + 7) & ~size_t {7};
+    auto head = head_.load(std::memory_order_relaxed);
+    auto offset = head & (capacity_ - 1);
+    auto contiguous = capacity_ - offset;
+    auto needed = bytes <= contiguous? bytes : contiguous + bytes;
+
+    if (bytes > capacity_ / 2) {
+      return nullptr;
+    }
+    if (head + needed - tail_cache_ > capacity_) {
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+      if (head + needed - tail_cache_ > capacity_) {
+        return nullptr;
+      }
+    }
+
+    if (needed != bytes) {
+      auto *skip = reinterpret_cast<Record *>(buffer_.get() + offset);
+      skip->size = static_cast<uint32_t>(contiguous);
+      skip->padding = 1;
+      offset = 0;
+    }
+    pending_ = needed;
+    return buffer_.get() + offset;
+  }
+
+  void commit() {
+    head_.store(head_.load(std::memory_order_relaxed) + pending_, std::memory_order_release);
+  }
+
+  // consumer: visits each committed record in order, returns how many
+  template <typename Visitor>
+  size_t drain(Visitor &&visitor) {
+    auto tail = tail_.load(std::memory_order_relaxed);
+    auto head = head_.load(std::memory_order_acquire);
+
+    size_t count = 0;
+    while (tail != head) {
+      auto *record = reinterpret_cast<const Record *>(buffer_.get() + (tail & (capacity_ - 1)));
+      if (!record->padding) {
+        visitor(*record, reinterpret_cast<const char *>(record + 1));
+        ++count;
+      }
+      tail += record->size;
+    }
+    tail_.store(tail, std::memory_order_release);
+    return count;
+  }
+
+ public:
+  void retire() { retired_.store(true, std::memory_order_release); }
+  bool retired() const { return retired_.load(std::memory_order_acquire); }
+
+ private:
+  std::unique_ptr<char[]> buffer_;
+  size_t capacity_;
+
+  alignas(64) std::atomic<size_t> head_ {0};
+  size_t tail_cache_ = 0;
+  size_t pending_ = 0;
+
+  alignas(64) std::atomic<size_t> tail_ {0};
+  std::atomic<bool> retired_ {false};
+};
+
+class Backend {
+ public:
+  static constexpr size_t kRingCapacity = 1 << 16;
+
+ public:
+  static Backend &instance() {
+    static Backend backend;
+    return backend;
+  }
+
+  ~Backend() { stop(); }
+
+ public:
+  Level level() const { return level_.load(std::memory_order_relaxed); }
+  void set_level(Level level) { level_.store(level, std::memory_order_relaxed); }
+
+  // sinks run on the writer thread, swap before logging starts
+  void set_sink(Sink sink) {
+    std::lock_guard<std::mutex> lock {drain_lock_};
+    sink_ = std::move(sink);
+  }
+
+  uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+  uint64_t written() const { return written_.load(std::memory_order_relaxed); }
+
+ public:
+  // the calling thread's ring, created and registered on first use
+  Ring &ring() {
+    thread_local Local local {*this};
+    return *local.ring;
+  }
+
+  void drop() { dropped_.fetch_add(1, std::memory_order_relaxed); }
+
+  // formats everything logged so far on the calling thread
+  void flush() { drain(); }
+
+  void stop() {
+    if (running_.exchange(false)) {
+      writer_.join();
+    }
+    drain();
+  }
+
+ private:
+  struct Local {
+    explicit Local(Backend &backend) : ring {std::make_shared<Ring>(size_t {kRingCapacity})} {
+      backend.enroll(ring);
+    }
+    ~Local() { ring->retire(); }
+
+    std::shared_ptr<Ring> ring;
+  };
+
+ private:
+  Backend() : sink_ {[](const Site &site, Clock::time_point, const std::string &text) {
+      std::clog << to_string(site.level) << ' ' << text << '\n';
+    }} {}
+
+  void enroll(std::shared_ptr<Ring> ring) {
+    {
+      std::lock_guard<std::mutex> lock {rings_lock_};
+      rings_.push_back(std::move(ring));
+    }
+    if (!running_.exchange(true)) {
+      writer_ = std::thread {[this] { run(); }};
+    }
+  }
+
+  void run() {
+    while (running_.load(std::memory_order_acquire)) {
+      if (drain() == 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds {500});
+      }
+    }
+  }
+
+  size_t drain() {
+    std::lock_guard<std::mutex> lock {drain_lock_};
+
+    std::vector<std::shared_ptr<Ring>> rings;
+    {
+      std::lock_guard<std::mutex> lock {rings_lock_};
+      rings = rings_;
+    }
+
+    size_t count = 0;
+    for (auto &ring : rings) {
+      auto retired = ring->retired();  // read before draining, the last records are ours
+      count += ring->drain([this](const Ring::Record &record, const char *arguments) {
+        text_.str({});
+        record.decoder(text_, *record.site, arguments);
+        sink_(*record.site, Clock::time_point {Clock::duration {record.time}}, text_.str());
+      });
+      if (retired) {
+        std::lock_guard<std::mutex> lock {rings_lock_};
+        rings_.erase(std::remove(rings_.begin(), rings_.end(), ring), rings_.end());
+      }
+    }
+    written_.fetch_add(count, std::memory_order_relaxed);
+    return count;
+  }
+
+ private:
+  std::atomic<Level> level_ {Level::TRACE};
+  std::atomic<uint64_t> dropped_ {0};
+  std::atomic<uint64_t> written_ {0};
+
+  std::mutex rings_lock_;
+  std::vector<std::shared_ptr<Ring>> rings_;
+
+  std::mutex drain_lock_;  // one consumer at a time, guards sink_ and text_
+  Sink sink_;
+  std::ostringstream text_;
+
+  std::atomic<bool> running_ {false};
+  std::thread writer_;
+};
+
+namespace detail {
+
+template <typename ...Args>
+void push(Backend &backend, const Site &site, const Args &...args) {
+  size_t bytes = sizeof(Ring::Record);
+  using expand = size_t[];
+  (void) expand{0, (bytes += Codec<Args>::size(args))...};
+
+  auto &ring = backend.ring();
+  auto *slot = ring.reserve(bytes);
+  if (!slot) {
+    backend.drop();
+    return;
+  }
+
+  auto *record = reinterpret_cast<Ring::Record *>(slot);
+  record->size = static_cast<uint32_t>((bytes + 7) & ~size_t {7});
+  record->padding = 0;
+  record->site = &site;
+  record->decoder = &decode<Args...>;
+  record->time = Clock::now().time_since_epoch().count();
+
+  auto *cursor = slot + sizeof(Ring::Record);
+  (void) expand{0, (cursor += Codec<Args>::encode(cursor, args), size_t {0})...};
+  (void) cursor;
+  ring.commit();
+}
+
+}  // namespace detail
+
+template <typename ...Args>
+void write(const Site &site, const Args &...args) {
+  auto &backend = Backend::instance();
+  if (site.level < backend.level()) {
+    return;
+  }
+  detail::push(backend, site, detail::prepare(args)...);
+}
+
+}  // namespace binlog
+}  // namespace core
+
+
+#endif  // SRC_CORE_BINLOG_HPP_
@@ -0,0 +1,171 @@
+#ifndef SRC_CORE_DELEGATE_HPP_
+#define SRC_CORE_DELEGATE_HPP_
+
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+// Non-owning callbacks: a delegate is an object pointer and a trampoline
+// instantiated for the function it calls, two words that are copied, compared
+// and called without allocating or a virtual call.
+//
+//   core::delegate<void(int)> a {&free_function};
+//   core::delegate<void(int)> b {[](int value) { ... }};  // captureless
+//   auto c = core::bind<&Listener::OnValue>(listener);
+//   auto d = core::delegate<void(int)>::bind(callable);    // by reference
+//
+// Bound objects and callables are not kept alive by the delegate. Delegates
+// compare equal when they call the same function on the same object, so a
+// handler can be found again in a list to remove it; a linker folding
+// identical code (--icf) may make different trampolines compare equal.
+
+namespace core {
+
+template <typename Signature>
+class delegate;
+
+template <typename R, typename ...Args>
+class delegate<R(Args...)> {
+ public:
+  using function_type = R (*)(Args...);
+
+ public:
+  constexpr delegate() noexcept = default;
+  constexpr delegate(std::nullptr_t) noexcept {}  // NOLINT
+
+  constexpr delegate(function_type function) noexcept  // NOLINT
+    : target_ {function ? Target {function} : Target {}},
+      stub_ {function ? &function_stub : nullptr} {}
+
+  // captureless lambdas, through their conversion to a function pointer
+  template <typename Functor, typename = std::enable_if_t<
+      !std::is_same_v<std::decay_t<Functor>, delegate> &&
+      !std::is_same_v<std::decay_t<Functor>, function_type> &&
+      std::is_convertible_v<Functor, function_type>>>
+  constexpr delegate(Functor &&functor) noexcept  // NOLINT
+    : delegate {static_cast<function_type>(functor)} {}
+
+ public:
+  // a member function, or any function taking the object first
+  template <auto Method, typename Class>
+  static constexpr delegate bind(Class &object) noexcept {
+    static_assert(std::is_invocable_r_v<R, decltype(Method), Class &, Args...>,
+                  "bound method cannot be called with the delegate's arguments");
+    return delegate {Target {erase(&object)}, &method_stub<Method, Class>};
+  }
+
+  // a free function known at compile time, called directly by its trampoline
+  template <auto Function>
+  static constexpr delegate bind() noexcept {
+    static_assert(std::is_invocable_r_v<R, decltype(Function), Args...>,
+                  "bound function cannot be called with the delegate's arguments");
+    return delegate {Target {}, &constant_stub<Function>};
+  }
+
+  // a callable object that outlives the delegate, such as a capturing lambda
+  template <typename Functor>
+  static constexpr delegate bind(Functor &functor) noexcept {
+    static_assert(std::is_invocable_r_v<R, Functor &, Args...>,
+                  "bound callable cannot be called with the delegate's arguments");
+    return delegate {Target {erase(&functor)}, &functor_stub<Functor>};
+  }
+
+ public:
+  constexpr explicit operator bool() const noexcept { return stub_ != nullptr; }
+
+  constexpr bool operator==(const delegate &that) const noexcept {
+    if (stub_ != that.stub_) {
+      return false;
+    }
+    return stub_ == &function_stub ? target_.function == that.target_.function
+                                   : target_.object == that.target_.object;
+  }
+
+  constexpr bool operator!=(const delegate &that) const noexcept {
+    return !(*this == that);
+  }
+
+  R operator()(Args ...args) const {
+    assert(stub_ && "Called an empty delegate");
+    return stub_(target_, std::forward<Args>(args)...);
+  }
+
+ private:
+  union Target {
+    constexpr Target() noexcept : object {nullptr} {}
+    constexpr Target(void *object) noexcept : object {object} {}  // NOLINT
+    constexpr Target(function_type function) noexcept : function {function} {}  // NOLINT
+
+    void *object;
+    function_type function;
+  };
+
+  using stub_type = R (*)(Target target, Args ...args);
+
+  constexpr delegate(Target target, stub_type stub) noexcept
+    : target_ {target}, stub_ {stub} {}
+
+  static constexpr void *erase(const void *object) noexcept {
+    return const_cast<void *>(object);
+  }
+
+  static R function_stub(Target target, Args ...args) {
+    return target.function(std::forward<Args>(args)...);
+  }
+
+  template <auto Method, typename Class>
+  static R method_stub(Target target, Args ...args) {
+    auto &object = *static_cast<Class *>(target.object);
+    if constexpr (std::is_member_function_pointer_v<decltype(Method)>) {
+      return (object.*Method)(std::forward<Args>(args)...);
+    } else {
+      return Method(object, std::forward<Args>(args)...);
+    }
+  }
+
+  template <auto Function>
+  static R constant_stub(Target, Args ...args) {
+    return Function(std::forward<Args>(args)...);
+  }
+
+  template <typename Functor>
+  static R functor_stub(Target target, Args ...args) {
+    return (*static_cast<Functor *>(target.object))(std::forward<Args>(args)...);
+  }
+
+ private:
+  Target target_;
+  stub_type stub_ = nullptr;
+};
+
+namespace detail {
+
+template <typename Method>
+struct method_signature;
+
+template <typename R, typename Class, typename ...Args>
+struct method_signature<R (Class::*)(Args...)> { using type = R(Args...); };
+
+template <typename R, typename Class, typename ...Args>
+struct method_signature<R (Class::*)(Args...) const> { using type = R(Args...); };
+
+template <typename R, typename Class, typename ...Args>
+struct method_signature<R (Class::*)(Args...) noexcept> { using type = R(Args...); };
+
+template <typename R, typename Class, typename ...Args>
+struct method_signature<R (Class::*)(Args...) const noexcept> { using type = R(Args...); };
+
+}  // namespace detail
+
+// delegate to a member function, its signature taken from the member:
+// core::bind<&Listener::OnValue>(listener)
+template <auto Method, typename Class>
+constexpr auto bind(Class &object) noexcept {
+  using signature = typename detail::method_signature<decltype(Method)>::type;
+  return delegate<signature>::template bind<Method>(object);
+}
+
+}  // namespace core
+
+#endif  // SRC_CORE_DELEGATE_HPP_
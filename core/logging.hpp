@@ -1,18 +1,22 @@
 #ifndef SRC_CORE_LOGGING_HPP_
 #define SRC_CORE_LOGGING_HPP_
 
+#include <cassert>
+#include <string>
+#include <typeinfo>
+
 #ifdef __GNUC__  // clang supports this header
 #include <cxxabi.h>
+#include <cstdlib>
+#include <memory>
 
 inline std::string demangle(const std::string &name) {
-  size_t size = 1024;  // we *don't* want realloc() to be called
-  char buffer[size];  // NOLINT
-
   int status = 0;
-  abi::__cxa_demangle(name.c_str(), buffer, &size, &status);
+  std::unique_ptr<char, void (*)(void *)> buffer {
+      abi::__cxa_demangle(name.c_str(), nullptr, nullptr, &status), std::free};
   assert(status == 0 && "Demanging failed");
 
-  return buffer;
+  return buffer? buffer.get() : name;
 }
 #else
 inline std::string demangle(const std::string &name) {
@@ -20,6 +24,13 @@ inline std::string demangle(const std::string &name) {
 }
 #endif  // __GNUC__
 
+// demangled once per type, safe to log by reference
+template <typename Type>
+const std::string &type_name() {
+  static const std::string name = demangle(typeid(Type).name());
+  return name;
+}
+
 
 // Only supports maximum 8 arguments
 // Zero arguments are also *not* supported
@@ -46,8 +57,26 @@ inline std::string demangle(const std::string &name) {
 // print all args with name label and output stream operator
 #define PRINT_ARGS(...) CONCAT(PRINT_ARG_, COUNT_ARGS(__VA_ARGS__))(__VA_ARGS__)
 
+// argument names only, each followed by a comma
+#define NAME_ARG_1(argument) #argument,
+#define NAME_ARG_2(argument, ...) #argument, NAME_ARG_1(__VA_ARGS__)
+#define NAME_ARG_3(argument, ...) #argument, NAME_ARG_2(__VA_ARGS__)
+#define NAME_ARG_4(argument, ...) #argument, NAME_ARG_3(__VA_ARGS__)
+#define NAME_ARG_5(argument, ...) #argument, NAME_ARG_4(__VA_ARGS__)
+#define NAME_ARG_6(argument, ...) #argument, NAME_ARG_5(__VA_ARGS__)
+#define NAME_ARG_7(argument, ...) #argument, NAME_ARG_6(__VA_ARGS__)
+#define NAME_ARG_8(argument, ...) #argument, NAME_ARG_7(__VA_ARGS__)
+
+#define NAME_ARGS(...) CONCAT(NAME_ARG_, COUNT_ARGS(__VA_ARGS__))(__VA_ARGS__)
+
 
 // Uniform logging macros (assumes the loging object is called "logger")
+//
+// Define LOG_BACKEND_BINARY to route the same macros to core/binlog.hpp instead:
+// no logger object is needed, message must be a string literal and arguments
+// are captured as raw bytes to be formatted later on the log writer thread
+
+#ifndef LOG_BACKEND_BINARY
 
 #define LOG_METHOD_CALL()\
   LOG4CXX_DEBUG(logger, \
@@ -160,4 +189,52 @@ inline std::string demangle(const std::string &name) {
       message << ": " << PRINT_ARGS(__VA_ARGS__) \
       )
 
+#else  // LOG_BACKEND_BINARY
+
+#include "core/binlog.hpp"
+
+// static site description, names is a comma terminated list (possibly empty)
+#define BINLOG_SITE_(LEVEL, LOCATED, SEPARATOR, message, NAMES) \
+  static constexpr const char *binlog_names_[] = {NAMES nullptr}; \
+  static constexpr ::core::binlog::Site binlog_site_ { \
+      ::core::binlog::Level::LEVEL, __FILE__, __LINE__, __FUNCTION__, \
+      message, SEPARATOR, LOCATED, binlog_names_, \
+      sizeof(binlog_names_) / sizeof(*binlog_names_) - 1}
+
+#define BINLOG_(LEVEL, LOCATED, SEPARATOR, message) \
+  do { \
+    BINLOG_SITE_(LEVEL, LOCATED, SEPARATOR, message, ); \
+    ::core::binlog::write(binlog_site_); \
+  } while (0)
+
+#define BINLOG_ARGS_(LEVEL, LOCATED, SEPARATOR, message, ...) \
+  do { \
+    BINLOG_SITE_(LEVEL, LOCATED, SEPARATOR, message, NAME_ARGS(__VA_ARGS__)); \
+    ::core::binlog::write(binlog_site_, __VA_ARGS__); \
+  } while (0)
+
+#define LOG_METHOD_CALL() BINLOG_ARGS_(DEBUG, true, ", ", "", this)
+#define LOG_METHOD_CALL_(LEVEL) BINLOG_ARGS_(LEVEL, true, ", ", "", this)
+#define LOG_METHOD_ARGS(...) BINLOG_ARGS_(DEBUG, true, ", ", "", this, __VA_ARGS__)
+#define LOG_METHOD_ARGS_(LEVEL, ...) BINLOG_ARGS_(LEVEL, true, ", ", "", this, __VA_ARGS__)
+#define LOG_METHOD_MESG(message) BINLOG_ARGS_(DEBUG, true, ", ", message, this)
+#define LOG_METHOD_MESG_(LEVEL, message) BINLOG_ARGS_(LEVEL, true, ", ", message, this)
+#define LOG_METHOD_FULL(message, ...) BINLOG_ARGS_(DEBUG, true, ", ", message, this, __VA_ARGS__)
+#define LOG_METHOD_FULL_(LEVEL, message, ...) \
+  BINLOG_ARGS_(LEVEL, true, ", ", message, this, __VA_ARGS__)
+
+#define LOG_CALL() BINLOG_(DEBUG, true, ", ", "")
+#define LOG_CALL_(LEVEL) BINLOG_(LEVEL, true, ", ", "")
+#define LOG_ARGS(...) BINLOG_ARGS_(DEBUG, true, ", ", "", __VA_ARGS__)
+#define LOG_ARGS_(LEVEL, ...) BINLOG_ARGS_(LEVEL, true, ", ", "", __VA_ARGS__)
+#define LOG_MESG(message) BINLOG_(DEBUG, true, ", ", message)
+#define LOG_MESG_(LEVEL, message) BINLOG_(LEVEL, true, ", ", message)
+#define LOG_FULL(message, ...) BINLOG_ARGS_(DEBUG, true, ", ", message, __VA_ARGS__)
+#define LOG_FULL_(LEVEL, message, ...) BINLOG_ARGS_(LEVEL, true, ", ", message, __VA_ARGS__)
+
+#define LOG(message, ...) BINLOG_ARGS_(DEBUG, false, ": ", message, __VA_ARGS__)
+#define LOG_(LEVEL, message, ...) BINLOG_ARGS_(LEVEL, false, ": ", message, __VA_ARGS__)
+
+#endif  // LOG_BACKEND_BINARY
+
 #endif
@@ -0,0 +1,416 @@
+#ifndef SRC_CORE_SHM_RING_HPP_
+#define SRC_CORE_SHM_RING_HPP_
+
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Shared memory frame rings
+//
+// A Segment is a shared mapping, from memfd_create (passed on by fork or over
+// a unix socket) or shm_open (opened by name), holding two rings, one for each
+// direction between two processes. Each Ring has one producer and one consumer
+// and carries variable length frames: an 8 byte header holding the length,
+// then the payload padded to 8 bytes. A frame that doesn't fit before the end
+// of the data area is preceded by a wrap marker and written at the start.
+//
+// Frames are reserved and committed in place, so a sender can serialize
+// straight into the ring, and a receiver reads a frame where it lies and then
+// releases it: the payload is never copied through an intermediate buffer.
+//
+// Waiting is on futexes in the mapping ("doorbells"). A side that finds the
+// ring empty (or full) spins briefly, then announces itself as a waiter,
+// re-checks and sleeps; the other side only makes the wake syscall when a
+// waiter was announced, so while both sides keep up no syscalls are made.
+
+namespace core {
+namespace shm {
+
+class Doorbell {
+ public:
+  // Blocks until ready() holds; ready() must become true only after a ring().
+  template <typename Ready>
+  void Wait(Ready &&ready, int spins = 128) {
+    for (int i = 0; i < spins; ++i) {
+      if (ready()) {
+        return;
+      }
+    }
+    for (;;) {
+      uint32_t sequence = sequence_.load(std::memory_order_acquire);
+      waiters_.fetch_add(1, std::memory_order_seq_cst);
+      if (ready()) {
+        Withdraw();
+        return;
+      }
+      // a Ring() clears the announcement before waking, so it isn't undone
+      Futex(FUTEX_WAIT, sequence);
+      if (ready()) {
+        return;
+      }
+    }
+  }
+
+  // After publishing whatever ready() looks at. Only the first Ring() after a
+  // waiter announced itself wakes it: until the waiter runs again and finds
+  // nothing, the others see no waiters and make no syscall.
+  void Ring() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters_.load(std::memory_order_relaxed) != 0 &&
+        waiters_.exchange(0, std::memory_order_acq_rel) != 0) {
+      sequence_.fetch_add(1, std::memory_order_release);
+      Futex(FUTEX_WAKE, INT_MAX);
+    }
+  }
+
+ private:
+  static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+                "futex words are plain 32-bit integers");
+
+  // not FUTEX_PRIVATE_FLAG: the word is shared between processes
+  // takes back an announcement, unless a Ring() already cleared it
+  void Withdraw() {
+    uint32_t waiters = waiters_.load(std::memory_order_relaxed);
+    while (waiters != 0 &&
+           !waiters_.compare_exchange_weak(waiters, waiters - 1, std::memory_order_relaxed)) {
+    }
+  }
+
+  void Futex(int op, uint32_t value) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&sequence_), op, value,
+            nullptr, nullptr, 0);
+  }
+
+  std::atomic<uint32_t> sequence_{0};
+  std::atomic<uint32_t> waiters_{0};
+};
+
+// Shared state of one ring, placed in the mapping by Segment.
+struct RingHeader {
+  // producer side
+  alignas(64) std::atomic<uint64_t> head{0};
+  std::atomic<uint64_t> committed{0};
+  Doorbell readable;
+
+  // consumer side
+  alignas(64) std::atomic<uint64_t> tail{0};
+  std::atomic<uint64_t> released{0};
+  Doorbell writable;
+
+  alignas(64) uint64_t capacity = 0;
+};
+
+// The other process sees these atomics through the mapping only, so they
+// cannot be emulated with a lock that lives in this one.
+#if __cplusplus >= 201703L
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+              "ring positions and doorbells are lock free");
+#else
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_LONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+              "ring positions and doorbells are lock free");
+#endif
+
+// One process' view of a ring, as either its producer or its consumer.
+class Ring {
+ public:
+  static constexpr size_t kFrameHeader = 8;
+
+  Ring() = default;
+  Ring(RingHeader *header, uint8_t *data)
+      : header_{header}, data_{data}, mask_{header->capacity - 1} {}
+
+  // Largest payload a frame can carry.
+  size_t max_frame() const { return header_->capacity / 2 - kFrameHeader; }
+
+  // Frames committed and not yet released.
+  size_t size() const {
+    return header_->committed.load(std::memory_order_acquire) -
+           header_->released.load(std::memory_order_acquire);
+  }
+
+  bool empty() const {
+    return header_->tail.load(std::memory_order_acquire) ==
+           header_->head.load(std::memory_order_acquire);
+  }
+
+  // producer: room for `size` bytes, or nullptr while the ring is full
+  uint8_t *TryReserve(size_t size) {
+    if (size > max_frame()) {
+      return nullptr;
+    }
+    const uint64_t need = kFrameHeader + Align(size);
+    const uint64_t offset = head_ & mask_;
+    const uint64_t contiguous = header_->capacity - offset;
+    const uint64_t skip = need > contiguous ? contiguous : 0;
+
+    if (!HasRoom(skip + need)) {
+      return nullptr;
+    }
+    if (skip) {
+      StoreLength(offset, kWrapMarker);
+    }
+    reserved_ = head_ + skip;
+    return data_ + (reserved_ & mask_) + kFrameHeader;
+  }
+
+  // producer: blocks while the ring is full, nullptr if size > max_frame()
+  uint8_t *Reserve(size_t size) {
+    if (size > max_frame()) {
+      return nullptr;
+    }
+    uint8_t *frame = nullptr;
+    header_->writable.Wait([&] { return (frame = TryReserve(size)) != nullptr; });
+    return frame;
+  }
+
+  // producer: publishes the frame last reserved, `size` may be less than asked
+  void Commit(size_t size) {
+    StoreLength(reserved_ & mask_, static_cast<uint32_t>(size));
+    head_ = reserved_ + kFrameHeader + Align(size);
+    header_->committed.store(header_->committed.load(std::memory_order_relaxed) + 1,
+                             std::memory_order_relaxed);
+    header_->head.store(head_, std::memory_order_release);
+    header_->readable.Ring();
+  }
+
+  bool TrySend(const void *data, size_t size) {
+    uint8_t *frame = TryReserve(size);
+    if (!frame) {
+      return false;
+    }
+    std::memcpy(frame, data, size);
+    Commit(size);
+    return true;
+  }
+
+  bool Send(const void *data, size_t size) {
+    uint8_t *frame = Reserve(size);
+    if (!frame) {
+      return false;
+    }
+    std::memcpy(frame, data, size);
+    Commit(size);
+    return true;
+  }
+
+  // consumer: the oldest frame, left in place until Release()
+  bool TryPeek(const uint8_t **data, size_t *size) {
+    if (tail_ == cached_head_) {
+      cached_head_ = header_->head.load(std::memory_order_acquire);
+      if (tail_ == cached_head_) {
+        return false;
+      }
+    }
+    uint32_t length = LoadLength(tail_ & mask_);
+    if (length == kWrapMarker) {
+      tail_ += header_->capacity - (tail_ & mask_);
+      length = LoadLength(tail_ & mask_);
+    }
+    *data = data_ + (tail_ & mask_) + kFrameHeader;
+    *size = length;
+    peeked_ = length;
+    return true;
+  }
+
+  // consumer: blocks until a frame arrives
+  void Peek(const uint8_t **data, size_t *size) {
+    header_->readable.Wait([&] { return TryPeek(data, size); });
+  }
+
+  // consumer: gives the frame last peeked back to the producer
+  void Release() {
+    tail_ += kFrameHeader + Align(peeked_);
+    header_->released.store(header_->released.load(std::memory_order_relaxed) + 1,
+                            std::memory_order_relaxed);
+    header_->tail.store(tail_, std::memory_order_release);
+    header_->writable.Ring();
+  }
+
+ private:
+  static constexpr uint32_t kWrapMarker = ~uint32_t{0};
+
+  static uint64_t Align(uint64_t size) { return (size + 7) & ~uint64_t{7}; }
+
+  bool HasRoom(uint64_t bytes) {
+    if (header_->capacity - (head_ - cached_tail_) >= bytes) {
+      return true;
+    }
+    cached_tail_ = header_->tail.load(std::memory_order_acquire);
+    return header_->capacity - (head_ - cached_tail_) >= bytes;
+  }
+
+  void StoreLength(uint64_t offset, uint32_t length) {
+    std::memcpy(data_ + offset, &length, sizeof(length));
+  }
+
+  uint32_t LoadLength(uint64_t offset) const {
+    uint32_t length;
+    std::memcpy(&length, data_ + offset, sizeof(length));
+    return length;
+  }
+
+  RingHeader *header_ = nullptr;
+  uint8_t *data_ = nullptr;
+  uint64_t mask_ = 0;
+
+  // producer
+  uint64_t head_ = 0;
+  uint64_t reserved_ = 0;
+  uint64_t cached_tail_ = 0;
+
+  // consumer
+  uint64_t tail_ = 0;
+  uint64_t cached_head_ = 0;
+  size_t peeked_ = 0;
+};
+
+// Which end of a segment a process is: kFirst sends on ring 0 and receives
+// on ring 1, kSecond the other way around.
+enum class Side { kFirst, kSecond };
+
+class Segment {
+ public:
+  // `ring_bytes` is rounded up to a power of two. Unnamed segments use a
+  // memfd, which a child inherits across fork() (see Adopt).
+  static Segment Create(size_t ring_bytes, const std::string &name = "") {
+    size_t capacity = 64;
+    while (capacity < ring_bytes) {
+      capacity <<= 1;
+    }
+
+    int fd = name.empty() ? memfd_create("core-shm", MFD_CLOEXEC)
+                          : shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    Check(fd, "shm create");
+
+    Segment segment{fd};
+    try {
+      Check(ftruncate(fd, static_cast<off_t>(Bytes(capacity))), "ftruncate");
+      segment.Map(Bytes(capacity));
+    } catch (...) {
+      // a name this call created is not left behind half made
+      if (!name.empty()) {
+        Unlink(name);
+      }
+      throw;
+    }
+
+    auto layout = new (segment.base_) Layout{};
+    layout->capacity = capacity;
+    for (int index = 0; index < 2; ++index) {
+      auto ring = new (segment.base_ + RingOffset(capacity, index)) RingHeader{};
+      ring->capacity = capacity;
+    }
+    layout->magic.store(kMagic, std::memory_order_release);
+    return segment;
+  }
+
+  static Segment Open(const std::string &name) {
+    return Adopt(Check(shm_open(name.c_str(), O_RDWR, 0), "shm_open"));
+  }
+
+  // Takes ownership of a segment's file descriptor.
+  static Segment Adopt(int fd) {
+    Segment segment{fd};
+    struct stat info;
+    Check(fstat(fd, &info), "fstat");
+    segment.Map(static_cast<size_t>(info.st_size));
+    if (segment.size_ < sizeof(Layout) || segment.layout().magic.load(std::memory_order_acquire) != kMagic ||
+        Bytes(segment.layout().capacity) != segment.size_) {
+      throw std::system_error(std::make_error_code(std::errc::invalid_argument), "not a core::shm segment");
+    }
+    return segment;
+  }
+
+  static void Unlink(const std::string &name) { shm_unlink(name.c_str()); }
+
+  Segment(Segment &&that) noexcept
+      : fd_{std::exchange(that.fd_, -1)}, base_{std::exchange(that.base_, nullptr)}, size_{that.size_} {}
+
+  Segment &operator=(Segment &&that) noexcept {
+    std::swap(fd_, that.fd_);
+    std::swap(base_, that.base_);
+    std::swap(size_, that.size_);
+    return *this;
+  }
+
+  ~Segment() {
+    if (base_) {
+      munmap(base_, size_);
+    }
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  int fd() const { return fd_; }
+
+  // This process' rings for `side`: {sending, receiving}.
+  std::pair<Ring, Ring> Rings(Side side) {
+    Ring first = RingAt(0), second = RingAt(1);
+    return side == Side::kFirst ? std::make_pair(first, second) : std::make_pair(second, first);
+  }
+
+ private:
+  static constexpr uint64_t kMagic = 0x676e6972'6d687343;  // "Cshmring"
+
+  struct Layout {
+    std::atomic<uint64_t> magic{0};
+    uint64_t capacity = 0;
+  };
+
+  static constexpr size_t kLayoutBytes = 64;
+  static_assert(sizeof(Layout) <= kLayoutBytes, "layout fits its slot");
+
+  static size_t RingOffset(size_t capacity, int index) {
+    return kLayoutBytes + index * (sizeof(RingHeader) + capacity);
+  }
+
+  static size_t Bytes(size_t capacity) { return RingOffset(capacity, 2); }
+
+  static int Check(int result, const char *what) {
+    if (result < 0) {
+      throw std::system_error(errno, std::generic_category(), what);
+    }
+    return result;
+  }
+
+  explicit Segment(int fd) : fd_{fd} {}
+
+  void Map(size_t size) {
+    void *base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (base == MAP_FAILED) {
+      throw std::system_error(errno, std::generic_category(), "mmap");
+    }
+    base_ = static_cast<uint8_t *>(base);
+    size_ = size;
+  }
+
+  Layout &layout() { return *reinterpret_cast<Layout *>(base_); }
+
+  Ring RingAt(int index) {
+    auto offset = RingOffset(layout().capacity, index);
+    return Ring{reinterpret_cast<RingHeader *>(base_ + offset), base_ + offset + sizeof(RingHeader)};
+  }
+
+  int fd_ = -1;
+  uint8_t *base_ = nullptr;
+  size_t size_ = 0;
+};
+
+}  // namespace shm
+}  // namespace core
+
+#endif  // SRC_CORE_SHM_RING_HPP_
@@ -0,0 +1,56 @@
+// Concurrent raise throughput
+//
+// g++ -std=c++20 -O2 benchmark.cpp error.cpp -pthread
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "error.hpp"
+
+ctl::posix_domain posix;
+
+int main(int argc, char *argv[]) {
+  size_t raises = argc > 1 ? std::stoul(argv[1]) : 1'000'000;
+
+  std::cout << "threads  raises/s     ns/raise  expired\n";
+
+  for (size_t threads = 1; threads <= 8; threads *= 2) {
+    std::vector<std::thread> workers;
+    std::vector<size_t> expired(threads);
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < threads; ++t) {
+      workers.emplace_back([&, t] {
+        for (size_t i = 0; i < raises; ++i) {
+          auto error = posix.raise(ctl::posix_condition::AGAIN,  //
+                                   std::source_location::current(),
+                                   "resource temporarily unavailable");
+          // only a handle overwritten before we look at it may be expired
+          expired[t] += posix.expired(error);
+        }
+      });
+    }
+    for (auto &worker : workers) {
+      worker.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    size_t total = 0;
+    for (auto count : expired) {
+      total += count;
+    }
+    std::cout << threads << "        " << threads * raises / elapsed.count() << "  "
+              << elapsed.count() * 1e9 / (threads * raises) << "      " << total << '\n';
+  }
+
+  // a handle is reported expired once the ring wraps past it
+  auto first = posix.raise(ctl::posix_condition::PERM, std::source_location::current(), "first");
+  for (size_t i = 0; i < 128; ++i) {
+    posix.raise(ctl::posix_condition::PERM, std::source_location::current());
+  }
+  std::cout << "\nstale handle expired: " << std::boolalpha << posix.expired(first)
+            << ", message \"" << first.message() << "\"\n";
+}
@@ -1,7 +1,9 @@
 #include "error.hpp"
 
+#include <utility>
+
 namespace ctl {
-const std::array<detail::condition_entry, 125> posix_domain::categories_ = {
+constexpr std::array<detail::condition_entry, 125> posix_domain::categories_ = {
   detail::condition_entry{},
   detail::condition_entry{"Operation not permitted"},
   detail::condition_entry{"No such file or directory"},
@@ -129,7 +131,7 @@ const std::array<detail::condition_entry, 125> posix_domain::categories_ = {
   detail::condition_entry{"Wrong medium type "},
 };
 
-const std::array<detail::condition_entry, 200> win32_domain::categories_ = {
+constexpr std::array<detail::condition_entry, 200> win32_domain::categories_ = {
   detail::condition_entry{"ERROR_SUCCESS"},
   detail::condition_entry{"ERROR_INVALID_FUNCTION"},
   detail::condition_entry{"ERROR_FILE_NOT_FOUND"},
@@ -332,7 +334,10 @@ const std::array<detail::condition_entry, 200> win32_domain::categories_ = {
   detail::condition_entry{"ERROR_SWAPERROR"},
 };
 
-std::map<uint64_t, uint64_t> const win32_domain::condition_table_ = {
+namespace {
+// native win32 code -> index into categories_, both ascending; index 0 is
+// ERROR_SUCCESS which has no condition, so win32_condition is the index - 1
+constexpr std::pair<uint16_t, uint8_t> native_codes_[] = {
   {0u, 0u},     {1u, 1u},     {2u, 2u},     {3u, 3u},     {4u, 4u},     {5u, 5u},     {6u, 6u},
   {7u, 7u},     {8u, 8u},     {9u, 9u},     {10u, 10u},   {11u, 11u},   {12u, 12u},   {13u, 13u},
   {14u, 14u},   {15u, 15u},   {16u, 16u},   {17u, 17u},   {18u, 18u},   {19u, 19u},   {20u, 20u},
@@ -364,39 +369,75 @@ std::map<uint64_t, uint64_t> const win32_domain::condition_table_ = {
   {996u, 196u}, {997u, 197u}, {998u, 198u}, {999u, 199u},
 };
 
-std::size_t stable_hash(std::string_view str) {
-  static const auto shuffle_ = [](std::uint64_t block) {
-    return  // clang-format off
-      ((block & 0xFFFF'0000'0000'0000) >> 16) |
-      ((block & 0x0000'FFFF'0000'0000) >> 32) |
-      ((block & 0x0000'0000'FFFF'0000) << 32) |
-      ((block & 0x0000'0000'0000'FFFF) << 16);
-    // clang-format on
-  };
+constexpr size_t native_limit_ = 1000;
+constexpr uint8_t native_unknown_ = 0xFF;
+
+// dense table indexed by native code, built at compile time
+constexpr std::array<uint8_t, native_limit_> make_native_table_() {
+  std::array<uint8_t, native_limit_> table{};
+  table.fill(native_unknown_);
+  for (auto [native, condition] : native_codes_) {
+    table[native] = condition;
+  }
+  return table;
+}
+
+constexpr auto native_table_ = make_native_table_();
+static_assert(native_table_[36] == 35 && native_table_[999] == 199 && native_table_[35] == native_unknown_);
+static_assert(std::size(native_codes_) == 200);
+}  // namespace
 
-  static const auto diffuse_ = [](std::uint64_t block, std::uint64_t a, std::uint64_t b) {
-    return (block * a) ^ (~block * b);
+std::optional<win32_condition> win32_domain::from_native(uint64_t code) noexcept {
+  if (code == 0 || code >= native_limit_ || native_table_[code] == native_unknown_) {
+    return std::nullopt;
+  }
+  return static_cast<win32_condition>(native_table_[code] - 1);
+}
+
+std::optional<int> posix_domain::from_message(std::string_view message) noexcept {
+  // aliases (EWOULDBLOCK, EDEADLOCK) repeat an earlier message, the first wins
+  static constexpr auto is_first = [](size_t i) {
+    for (size_t j = 1; j < i; ++j) {
+      if (categories_[j].message == categories_[i].message) {
+        return false;
+      }
+    }
+    return true;
   };
 
-  constexpr std::uint64_t m1 = 0xC2B2AE35C2B2AE35;
-  constexpr std::uint64_t m2 = 0x42F0E1EBA9EA3693;
-  constexpr std::uint64_t m3 = 0xC96C5795D7870F42;
-  constexpr std::uint64_t block_size = 8;
+  static constexpr auto messages = [] {
+    constexpr auto count = [] {
+      size_t count = 0;
+      for (size_t i = 1; i < categories_.size(); ++i) {
+        count += is_first(i);
+      }
+      return count;
+    }();
 
-  std::size_t i = 0;
-  std::uint64_t block;
-  std::uint64_t result = diffuse_(str.size(), m1, m2);
+    std::array<std::pair<std::string_view, int>, count> entries{};
+    for (size_t i = 1, e = 0; i < categories_.size(); ++i) {
+      if (is_first(i)) {
+        entries[e++] = {categories_[i].message, static_cast<int>(i)};
+      }
+    }
+    return make_perfect_map(entries);
+  }();
 
-  for (; i < str.size() && block_size <= str.size(); i += block_size) {
-    std::memcpy(&block, str.data() + i, block_size);
-    result = shuffle_(result) ^ diffuse_(block, ~m2, m3);
-  }
+  auto found = messages.find(message);
+  return found ? std::optional<int>{*found} : std::nullopt;
+}
 
-  for (; i < str.size(); i++) {
-    result = shuffle_(result) ^ diffuse_(str[i], m3, ~m1);
-  }
+std::optional<win32_condition> win32_domain::from_name(std::string_view name) noexcept {
+  static constexpr auto names = [] {
+    std::array<std::pair<std::string_view, win32_condition>, categories_.size() - 1> entries{};
+    for (size_t i = 1; i < categories_.size(); ++i) {
+      entries[i - 1] = {categories_[i].message, static_cast<win32_condition>(i - 1)};
+    }
+    return make_perfect_map(entries);
+  }();
 
-  return diffuse_(result, m2, ~m3);
+  auto found = names.find(name);
+  return found ? std::optional<win32_condition>{*found} : std::nullopt;
 }
 
 }  // namespace ctl
@@ -1,11 +1,17 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <cstring>
 #include <iostream>
-#include <map>
+#include <optional>
 #include <source_location>
 #include <string_view>
 
+#include "hash.hpp"
+
 namespace ctl {
 constexpr size_t posix_domain_code = 0x1;
 enum class posix_condition : size_t {
@@ -494,12 +500,85 @@ inline size_t domain::domain_code(condition condition) const noexcept {
 
 namespace detail {
 struct condition_entry {
-  std::string message;  // ~64 characters?
+  std::string_view message;
 };
 
+// One raised error, written in place so raising never allocates. The stamp is
+// a seqlock: odd while a writer fills the entry, 2 * (ticket + 1) once done.
 struct incident_entry {
+  static constexpr size_t capacity = 104;
+
+  std::atomic<uint64_t> stamp{0};
   std::source_location location;
-  std::string message;
+  uint16_t length = 0;
+  char message[capacity];
+};
+
+// Fixed ring of the most recent incidents shared by all raising threads. The
+// 16 incident bits of a code hold the slot and a generation tag taken from the
+// same ticket, so a handle that outlived its slot is detected as expired
+// (until the generation wraps after 2^16 raises).
+class incident_ring {
+ public:
+  constexpr static uint64_t slot_bits = 7;
+  constexpr static uint64_t slots = uint64_t{1} << slot_bits;
+  constexpr static uint64_t slot_mask = slots - 1;
+  constexpr static uint64_t generation_mask = code::incident_mask >> slot_bits;
+
+  uint64_t record(std::source_location location, std::string_view message) noexcept {
+    auto ticket = next_.fetch_add(1, std::memory_order_relaxed);
+    auto &entry = entries_[ticket & slot_mask];
+
+    // a slow writer still holding the slot, or one lapped by a newer ticket,
+    // keeps it; the new handle then simply reports itself as expired
+    auto stamp = entry.stamp.load(std::memory_order_relaxed);
+    if ((stamp & 1) || stamp > 2 * ticket ||
+        !entry.stamp.compare_exchange_strong(stamp, 2 * ticket + 1, std::memory_order_acquire)) {
+      return incident_bits(ticket);
+    }
+
+    entry.location = location;
+    entry.length = static_cast<uint16_t>(std::min(message.size(), incident_entry::capacity));
+    std::memcpy(entry.message, message.data(), entry.length);
+
+    entry.stamp.store(2 * ticket + 2, std::memory_order_release);
+    return incident_bits(ticket);
+  }
+
+  // the entry if it still belongs to the given incident, nullptr once reused;
+  // a returned message stays valid until slots more errors are raised
+  const incident_entry *find(uint64_t bits) const noexcept {
+    const auto &entry = entries_[bits & slot_mask];
+    auto stamp = entry.stamp.load(std::memory_order_acquire);
+    if ((stamp & 1) || stamp == 0 || incident_bits(stamp / 2 - 1) != bits) {
+      return nullptr;
+    }
+    return &entry;
+  }
+
+  std::string_view message(uint64_t bits) const noexcept {
+    auto entry = find(bits);
+    return entry ? std::string_view{entry->message, entry->length} : std::string_view{};
+  }
+
+  std::source_location location(uint64_t bits) const noexcept {
+    auto entry = find(bits);
+    if (!entry) {
+      return {};
+    }
+    auto stamp = entry->stamp.load(std::memory_order_relaxed);
+    auto location = entry->location;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return entry->stamp.load(std::memory_order_relaxed) == stamp ? location : std::source_location{};
+  }
+
+ private:
+  static uint64_t incident_bits(uint64_t ticket) noexcept {
+    return (ticket & slot_mask) | (((ticket >> slot_bits) & generation_mask) << slot_bits);
+  }
+
+  std::array<incident_entry, slots> entries_;
+  std::atomic<uint64_t> next_{0};
 };
 }  // namespace detail
 
@@ -509,24 +588,28 @@ class posix_domain final : public domain {
   std::string_view name() const noexcept override { return name_; }
 
   std::string_view message(error error) const noexcept override {
-    return incidents_[incident_code(error)].message;
+    return incidents_.message(incident_code(error));
   }
 
   std::source_location location(error error) const noexcept override {
-    return incidents_[incident_code(error)].location;
+    return incidents_.location(incident_code(error));
   }
 
+  bool expired(error error) const noexcept { return !incidents_.find(incident_code(error)); }
+
   bool equivalent(error error, condition condition) const noexcept override {
     return false;  // TODO: use detail::is_equivalent
   }
 
-  error raise(posix_condition condition, std::source_location location, std::string message = {}) {
-    auto current = next_incident_++;
-    next_incident_ %= incidents_.size();
-    incidents_[current] = detail::incident_entry{std::move(location), std::move(message)};
+  // errno value with the given strerror style message
+  static std::optional<int> from_message(std::string_view message) noexcept;
+
+  error raise(posix_condition condition,
+              std::source_location location,
+              std::string_view message = {}) noexcept {
     return make_error(detail::code{static_cast<uint64_t>(domain_code()),
                                    static_cast<uint64_t>(condition),
-                                   static_cast<uint64_t>(current)});
+                                   incidents_.record(location, message)});
   }
 
   condition expect(posix_condition condition) {
@@ -537,53 +620,55 @@ class posix_domain final : public domain {
 
  private:
   static const std::array<detail::condition_entry, 125> categories_;
-  std::array<detail::incident_entry, 128> incidents_;
-  std::size_t next_incident_ = 0;
+  detail::incident_ring incidents_;
   std::string name_;
 };
 
-// In win32 case there is an indirect mapping between the value of the condition
-// and the value of condition, as represented by `condition_table_`.
+// In win32 case there is an indirect mapping between the value of the native
+// error code and the value of condition, as represented by `from_native`.
 //
 class win32_domain final : public domain {
  public:
-  ;
-
   explicit win32_domain() : domain{win32_domain_code}, name_{"win32"} {}
   std::string_view name() const noexcept override { return name_; }
 
   std::string_view message(error error) const noexcept override {
-    return incidents_[incident_code(error)].message;
+    return incidents_.message(incident_code(error));
   }
 
   std::source_location location(error error) const noexcept override {
-    return incidents_[incident_code(error)].location;
+    return incidents_.location(incident_code(error));
   }
 
+  bool expired(error error) const noexcept { return !incidents_.find(incident_code(error)); }
+
   bool equivalent(error error, condition condition) const noexcept override {
     return false;  // TODO: use detail::is_equivalent
   }
 
-  error raise(win32_condition condition, std::source_location location, std::string message = {}) {
-    auto current = next_incident_++;
-    next_incident_ %= incidents_.size();
-    incidents_[current] = detail::incident_entry{std::move(location), std::move(message)};
+  // condition for a native (GetLastError) code, if it is one we know
+  static std::optional<win32_condition> from_native(uint64_t code) noexcept;
+
+  // condition for a symbolic name such as "ERROR_ACCESS_DENIED"
+  static std::optional<win32_condition> from_name(std::string_view name) noexcept;
+
+  error raise(win32_condition condition,
+              std::source_location location,
+              std::string_view message = {}) noexcept {
     return make_error(detail::code{static_cast<uint64_t>(domain_code()),
-                                   condition_table_.at(static_cast<uint64_t>(condition)),
-                                   static_cast<uint64_t>(current)});
+                                   static_cast<uint64_t>(condition),
+                                   incidents_.record(location, message)});
   }
 
   condition expect(win32_condition condition) {
     return make_condition(detail::code{static_cast<uint64_t>(domain_code()),
-                                       condition_table_.at(static_cast<uint64_t>(condition)),
+                                       static_cast<uint64_t>(condition),
                                        static_cast<uint64_t>(0)});
   }
 
  private:
   static const std::array<detail::condition_entry, 200> categories_;
-  static const std::map<uint64_t, uint64_t> condition_table_;
-  std::array<detail::incident_entry, 128> incidents_;
-  std::size_t next_incident_ = 0;
+  detail::incident_ring incidents_;
   std::string name_;
 };
 }  // namespace ctl
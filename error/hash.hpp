@@ -0,0 +1,248 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace ctl {
+namespace detail {
+constexpr std::uint64_t hash_m1 = 0xC2B2AE35C2B2AE35;
+constexpr std::uint64_t hash_m2 = 0x42F0E1EBA9EA3693;
+constexpr std::uint64_t hash_m3 = 0xC96C5795D7870F42;
+constexpr std::size_t hash_block_size = 8;
+
+// inputs at least this long take the wide path at runtime
+constexpr std::size_t hash_wide_threshold = 128;
+
+// rotates the four 16-bit lanes (3 -> 2 -> 0 -> 1 -> 3), so shuffle^4 is identity
+constexpr std::uint64_t shuffle(std::uint64_t block) noexcept {
+  return  // clang-format off
+    ((block & 0xFFFF'0000'0000'0000) >> 16) |
+    ((block & 0x0000'FFFF'0000'0000) >> 32) |
+    ((block & 0x0000'0000'FFFF'0000) << 32) |
+    ((block & 0x0000'0000'0000'FFFF) << 16);
+  // clang-format on
+}
+
+constexpr std::uint64_t shuffle(std::uint64_t block, std::size_t times) noexcept {
+  for (times &= 3; times; --times) {
+    block = shuffle(block);
+  }
+  return block;
+}
+
+constexpr std::uint64_t diffuse(std::uint64_t block, std::uint64_t a, std::uint64_t b) noexcept {
+  return (block * a) ^ (~block * b);
+}
+
+// blocks are read little endian whatever the platform, so hashes can be stored
+constexpr std::uint64_t load_block(const char *data) noexcept {
+  if (std::is_constant_evaluated() || std::endian::native != std::endian::little) {
+    std::uint64_t block = 0;
+    for (std::size_t i = 0; i < hash_block_size; ++i) {
+      block |= std::uint64_t{static_cast<unsigned char>(data[i])} << (8 * i);
+    }
+    return block;
+  }
+  std::uint64_t block;
+  std::memcpy(&block, data, hash_block_size);
+  return block;
+}
+
+constexpr std::uint64_t hash_tail(std::uint64_t result, std::string_view str, std::size_t i) noexcept {
+  for (; i < str.size(); i++) {
+    result = shuffle(result) ^ diffuse(static_cast<unsigned char>(str[i]), hash_m3, ~hash_m1);
+  }
+  return diffuse(result, hash_m2, ~hash_m3);
+}
+
+// one block at a time, the reference definition
+constexpr std::uint64_t stable_hash_serial(std::string_view str) noexcept {
+  std::size_t i = 0;
+  std::uint64_t result = diffuse(str.size(), hash_m1, hash_m2);
+
+  for (; i + hash_block_size <= str.size(); i += hash_block_size) {
+    result = shuffle(result) ^ diffuse(load_block(str.data() + i), ~hash_m2, hash_m3);
+  }
+
+  return hash_tail(result, str, i);
+}
+
+// Same value as the serial loop: shuffle is linear over xor with period 4, so
+// after n blocks the result is shuffle^n(seed) ^ sum of shuffle^(n-1-k)(d_k).
+// Blocks are diffused independently into four accumulators by k % 4 (four
+// lanes of a vector with AVX2) and the shuffles are applied once at the end.
+inline std::uint64_t stable_hash_wide(std::string_view str) noexcept {
+  std::size_t blocks = str.size() / hash_block_size;
+  std::size_t k = 0;
+  std::uint64_t acc[4] = {};
+
+#if defined(__AVX2__)
+  // 64-bit lane multiply by a constant from three 32x32->64 multiplies
+  const auto multiply = [](__m256i x, std::uint64_t m) {
+    const __m256i lo = _mm256_set1_epi64x(m & 0xFFFF'FFFF);
+    const __m256i hi = _mm256_set1_epi64x(m >> 32);
+    __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), lo),
+                                     _mm256_mul_epu32(x, hi));
+    return _mm256_add_epi64(_mm256_mul_epu32(x, lo), _mm256_slli_epi64(cross, 32));
+  };
+  const __m256i ones = _mm256_set1_epi64x(-1);
+
+  __m256i vacc = _mm256_setzero_si256();
+  for (; k + 4 <= blocks; k += 4) {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(str.data() + k * hash_block_size));
+    vacc = _mm256_xor_si256(vacc, _mm256_xor_si256(multiply(x, ~hash_m2),
+                                                   multiply(_mm256_xor_si256(x, ones), hash_m3)));
+  }
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(acc), vacc);
+#else
+  for (; k + 4 <= blocks; k += 4) {
+    for (std::size_t lane = 0; lane < 4; ++lane) {
+      acc[lane] ^= diffuse(load_block(str.data() + (k + lane) * hash_block_size), ~hash_m2, hash_m3);
+    }
+  }
+#endif
+
+  for (; k < blocks; ++k) {
+    acc[k & 3] ^= diffuse(load_block(str.data() + k * hash_block_size), ~hash_m2, hash_m3);
+  }
+
+  std::uint64_t result = shuffle(diffuse(str.size(), hash_m1, hash_m2), blocks);
+  for (std::size_t lane = 0; lane < 4; ++lane) {
+    result ^= shuffle(acc[lane], blocks + 3 - lane);  // (blocks - 1 - lane) mod 4
+  }
+
+  return hash_tail(result, str, blocks * hash_block_size);
+}
+}  // namespace detail
+
+// Stable across runs and platforms, the same value at compile time and runtime.
+constexpr std::size_t stable_hash(std::string_view str) noexcept {
+  if (!std::is_constant_evaluated() && str.size() >= detail::hash_wide_threshold) {
+    return detail::stable_hash_wide(str);
+  }
+  return detail::stable_hash_serial(str);
+}
+
+// Read-only string keyed table built at compile time with hash and displace:
+// keys are spread over buckets by the low hash bits, each bucket gets the
+// first seed that places all its keys in free slots. A lookup is one hash,
+// one probe and one key compare; construction fails to compile if the keys
+// are not unique.
+template <typename Value, std::size_t N>
+class perfect_map {
+ public:
+  using entry = std::pair<std::string_view, Value>;
+
+  constexpr explicit perfect_map(const std::array<entry, N> &entries) : entries_{entries} {
+    std::array<std::uint64_t, N> hashes{};
+    std::array<std::size_t, bucket_count> sizes{};
+    for (std::size_t i = 0; i < N; ++i) {
+      hashes[i] = stable_hash(entries_[i].first);
+      sizes[hashes[i] & (bucket_count - 1)]++;
+      for (std::size_t j = 0; j < i; ++j) {
+        if (hashes[j] == hashes[i]) {
+          throw std::logic_error("perfect_map: duplicate key or hash");
+        }
+      }
+    }
+
+    // largest buckets first, while the table is still mostly empty
+    std::array<std::size_t, bucket_count> order{};
+    for (std::size_t b = 0; b < bucket_count; ++b) {
+      order[b] = b;
+    }
+    std::sort(order.begin(), order.end(),
+              [&](std::size_t a, std::size_t b) { return sizes[a] > sizes[b]; });
+
+    slots_.fill(empty);
+    std::array<std::uint16_t, N> members{};
+    for (auto bucket : order) {
+      if (!sizes[bucket]) {
+        break;
+      }
+
+      std::size_t count = 0;
+      for (std::size_t i = 0; i < N; ++i) {
+        if ((hashes[i] & (bucket_count - 1)) == bucket) {
+          members[count++] = static_cast<std::uint16_t>(i);
+        }
+      }
+
+      std::uint32_t seed = 0;
+      for (; seed < max_seed; ++seed) {
+        if (place(hashes, members, count, seed)) {
+          break;
+        }
+      }
+      if (seed == max_seed) {
+        throw std::logic_error("perfect_map: no displacement found");
+      }
+      seeds_[bucket] = seed;
+    }
+  }
+
+  constexpr const Value *find(std::string_view key) const noexcept {
+    auto hash = stable_hash(key);
+    auto index = slots_[slot_of(hash, seeds_[hash & (bucket_count - 1)])];
+    if (index == empty || entries_[index].first != key) {
+      return nullptr;
+    }
+    return &entries_[index].second;
+  }
+
+  constexpr std::size_t size() const noexcept { return N; }
+
+ private:
+  static_assert(N < 0xFFFF, "perfect_map: slot indices are 16 bits");
+
+  static constexpr std::size_t table_size = std::bit_ceil(N + N / 2 + 1);
+  static constexpr std::size_t bucket_count = std::bit_ceil(N / 2 + 1);
+  static constexpr std::uint16_t empty = 0xFFFF;
+  static constexpr std::uint32_t max_seed = 1 << 16;
+
+  static constexpr std::size_t slot_of(std::uint64_t hash, std::uint32_t seed) noexcept {
+    std::uint64_t x = std::rotr(hash, 32) ^ (seed * 0x9E37'79B9'7F4A'7C15);
+    x ^= x >> 31;
+    x *= 0xBF58'476D'1CE4'E5B9;
+    x ^= x >> 29;
+    return x & (table_size - 1);
+  }
+
+  // claims a slot per member, releasing them all again on the first clash
+  constexpr bool place(const std::array<std::uint64_t, N> &hashes,
+                       const std::array<std::uint16_t, N> &members,
+                       std::size_t count,
+                       std::uint32_t seed) {
+    for (std::size_t m = 0; m < count; ++m) {
+      auto slot = slot_of(hashes[members[m]], seed);
+      if (slots_[slot] != empty) {
+        while (m--) {
+          slots_[slot_of(hashes[members[m]], seed)] = empty;
+        }
+        return false;
+      }
+      slots_[slot] = members[m];
+    }
+    return true;
+  }
+
+  std::array<entry, N> entries_;
+  std::array<std::uint32_t, bucket_count> seeds_{};
+  std::array<std::uint16_t, table_size> slots_{};
+};
+
+template <typename Value, std::size_t N>
+constexpr perfect_map<Value, N> make_perfect_map(const std::array<std::pair<std::string_view, Value>, N> &entries) {
+  return perfect_map<Value, N>{entries};
+}
+}  // namespace ctl
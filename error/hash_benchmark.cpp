@@ -0,0 +1,101 @@
+// stable_hash serial vs wide path, perfect_map vs std::map lookup
+//
+// g++ -std=c++20 -O2 [-mavx2] hash_benchmark.cpp error.cpp
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "error.hpp"
+
+// compile time and runtime evaluation agree
+constexpr auto compile_time = ctl::stable_hash("ERROR_ACCESS_DENIED");
+static_assert(ctl::stable_hash("") == ctl::detail::stable_hash_serial(""));
+
+// bytes past 0x7F hash as unsigned whatever the signedness of char: "café"
+constexpr auto non_ascii = ctl::stable_hash("caf\xC3\xA9");
+static_assert(non_ascii == 0x33FEBEF652066543);
+
+template <typename Body>
+double ns_per_call(size_t calls, Body body) {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < calls; ++i) {
+    body(i);
+  }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / calls;
+}
+
+int main() {
+  std::mt19937_64 random{42};
+  std::string bytes(8192, '\0');
+  for (auto &byte : bytes) {
+    byte = static_cast<char>(random());
+  }
+
+  std::string key = "ERROR_ACCESS_DENIED";
+  if (ctl::stable_hash(key) != compile_time) {
+    std::cout << "compile time and runtime hashes differ\n";
+    return 1;
+  }
+  if (ctl::stable_hash(std::string{"caf\xC3\xA9"}) != non_ascii) {
+    std::cout << "runtime hash of a non-ASCII key differs\n";
+    return 1;
+  }
+  for (size_t length = 0; length <= 1024; ++length) {
+    std::string_view view{bytes.data() + length % 7, length};
+    if (ctl::detail::stable_hash_wide(view) != ctl::detail::stable_hash_serial(view)) {
+      std::cout << "wide and serial hashes differ at length " << length << '\n';
+      return 1;
+    }
+  }
+
+  std::cout << "length  serial ns  wide ns\n";
+  for (size_t length : {16, 64, 256, 1024, 8192}) {
+    std::string_view view{bytes.data(), length};
+    size_t sink = 0;
+    auto serial = ns_per_call(1'000'000'000 / (length + 64), [&](size_t i) {
+      sink += ctl::detail::stable_hash_serial(view.substr(i & 1));
+    });
+    auto wide = ns_per_call(1'000'000'000 / (length + 64), [&](size_t i) {
+      sink += ctl::detail::stable_hash_wide(view.substr(i & 1));
+    });
+    std::cout << length << "\t" << serial << "\t   " << wide << (sink ? "" : " ") << '\n';
+  }
+
+  // string keyed lookups: compile time perfect_map vs the runtime containers
+  constexpr std::array<std::pair<std::string_view, int>, 16> settings{{
+    {"log.level", 0},        {"log.path", 1},        {"net.address", 2},    {"net.port", 3},
+    {"net.backlog", 4},      {"net.timeout", 5},     {"pool.threads", 6},   {"pool.queue", 7},
+    {"cache.size", 8},       {"cache.ttl", 9},       {"auth.secret", 10},   {"auth.expiry", 11},
+    {"sync.interval", 12},   {"sync.retries", 13},   {"metrics.port", 14},  {"metrics.every", 15},
+  }};
+  constexpr auto perfect = ctl::make_perfect_map(settings);
+  static_assert(*perfect.find("net.port") == 3 && !perfect.find("net.ports"));
+
+  std::map<std::string, int, std::less<>> tree;
+  std::unordered_map<std::string, int> table;
+  std::vector<std::string> keys;
+  for (auto [key, value] : settings) {
+    tree.emplace(key, value);
+    table.emplace(key, value);
+    keys.emplace_back(key);
+  }
+
+  size_t found = 0;
+  auto probe = ns_per_call(10'000'000, [&](size_t i) { found += *perfect.find(keys[i & 15]); });
+  auto ordered = ns_per_call(10'000'000, [&](size_t i) { found += tree.find(keys[i & 15])->second; });
+  auto hashed = ns_per_call(10'000'000, [&](size_t i) { found += table.find(keys[i & 15])->second; });
+
+  std::cout << "\nlookup ns  perfect_map " << probe << "  std::map " << ordered
+            << "  std::unordered_map " << hashed << (found ? "" : " ") << '\n';
+
+  std::cout << "from_name(\"ERROR_ACCESS_DENIED\") = "
+            << static_cast<int>(ctl::win32_domain::from_name("ERROR_ACCESS_DENIED").value()) << '\n';
+  std::cout << "from_message(\"Broken pipe\") = " << ctl::posix_domain::from_message("Broken pipe").value_or(-1)
+            << '\n';
+}
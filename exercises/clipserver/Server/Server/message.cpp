@@ -1,5 +1,6 @@
 
 #include "message.hpp"
+#include "metrics.hpp"
 
 #include <json/json.h>
 
@@ -66,7 +67,7 @@ namespace msg {
 
         size_t written;
         if (!try_write_message (root, buf, written))
-            std::cout << "write error: generate authenticate request" << std::endl;
+            metrics::log (metrics::level::FAILURE, "write error: generate authenticate request");
         
         return {buf.pointer, written};
     }
@@ -80,7 +81,7 @@ namespace msg {
         
         size_t written;
         if (!try_write_message (root, buf, written))
-            std::cout << "write error: generate authenticate response" << std::endl;
+            metrics::log (metrics::level::FAILURE, "write error: generate authenticate response");
         
         return {buf.pointer, written};
     }
@@ -126,7 +127,7 @@ namespace msg {
         
         size_t written;
         if (!try_write_message (root, buf, written))
-            std::cout << "write error: generate refresh index request" << std::endl;
+            metrics::log (metrics::level::FAILURE, "write error: generate refresh index request");
 
         return {buf.pointer, written};
     }
@@ -151,7 +152,7 @@ namespace msg {
 
         size_t written;
         if (!try_write_message (root, buf, written))
-            std::cout << "write error: generate refresh index response" << std::endl;
+            metrics::log (metrics::level::FAILURE, "write error: generate refresh index response");
 
         return {buf.pointer, written};
     }
@@ -218,7 +219,7 @@ namespace msg {
         
         size_t written;
         if (!try_write_message (root, buf, written))
-            std::cout << "write error: generate notify available request" << std::endl;
+            metrics::log (metrics::level::FAILURE, "write error: generate notify available request");
 
         return {buf.pointer, written};
     }
@@ -261,7 +262,7 @@ namespace msg {
         
         size_t written;
         if (!try_write_message (root, buf, written))
-            std::cout << "write error: generate sync request" << std::endl;
+            metrics::log (metrics::level::FAILURE, "write error: generate sync request");
 
         return {buf.pointer, written};
     }
@@ -278,7 +279,7 @@ namespace msg {
         
         size_t written;
         if (!try_write_message (root, buf, written))
-            std::cout << "write error: generate sync response" << std::endl;
+            metrics::log (metrics::level::FAILURE, "write error: generate sync response");
 
         return {buf.pointer, written};
     }
@@ -291,7 +292,7 @@ namespace msg {
         
         size_t written;
         if (!try_write_message (root, buf, written))
-            std::cout << "write error: generate ping" << std::endl;
+            metrics::log (metrics::level::FAILURE, "write error: generate ping");
 
         return {buf.pointer, written};
     }
@@ -346,21 +347,26 @@ namespace msg {
     template <typename MessageType, typename MessageGenerator>
     std::error_code generic_send (net::socket &socket, MessageType const &request, MessageGenerator generator)
     {
-        size_t const HDR_BUFFER_SIZE = 128, MSG_BUFFER_SIZE = 4096;
-        uint8_t hdrmem [HDR_BUFFER_SIZE], msgmem [MSG_BUFFER_SIZE];
+        // header and message are laid out back to back and written once, a separate header 
+        // write leaves a tiny segment for nagle to hold back behind pipelined requests
+        size_t const HDR_BUFFER_SIZE = sizeof (header::payload_size), MSG_BUFFER_SIZE = 4096;
+        uint8_t framemem [HDR_BUFFER_SIZE + MSG_BUFFER_SIZE];
 
-        auto message = generator ({msgmem, MSG_BUFFER_SIZE}, request);
-        auto header = generate_header ({hdrmem, HDR_BUFFER_SIZE}, {size (message)});
+        auto message = generator ({framemem + HDR_BUFFER_SIZE, MSG_BUFFER_SIZE}, request);
+        auto header = generate_header ({framemem, HDR_BUFFER_SIZE}, {size (message)});
+        mem::buffer<uint8_t const> frame {framemem, size (header) + size (message)};
         
         std::error_code error;
         net::socket::size_type sent;
         bool proceed = socket.is_open();
             
-        proceed = proceed && !(error = socket.send (header, sent)) && sent == size (header);
-        proceed = proceed && !(error = socket.send_all (message, sent)) && sent == size (message);
+        proceed = proceed && !(error = socket.send_all (frame, sent)) && sent == size (frame);
 
         if (!proceed) 
-            std::cout << "send error: " << error.value() << std::endl;
+        {
+            metrics::global ().send_errors.add ();
+            metrics::log (metrics::level::FAILURE, "send error: %d", error.value());
+        }
 
         return error;
     }
@@ -410,6 +416,8 @@ namespace msg {
 
     void receiver::accept (net::socket &socket) 
     {
+        metrics::global ().accepted.add ();
+        metrics::global ().connections.add ();
         on_accept (socket);
     }
 
@@ -418,6 +426,9 @@ namespace msg {
         on_close (socket);
         std::error_code error = socket.close();
         closed_ = true; 
+
+        metrics::global ().closed.add ();
+        metrics::global ().connections.sub ();
     }
 
     // NOTE: based on known fixed header size and reading exactly required amount
@@ -427,10 +438,6 @@ namespace msg {
 
     void receiver::dispatch (net::socket &socket)
     {
-        using std::chrono::system_clock;
-        auto now = system_clock::to_time_t (system_clock::now());
-        std::cout << "\n " << std::ctime (&now) << "----------------------------------------" << std::endl;
-
         size_t const MSG_BUFFER_SIZE = 2048;
         uint8_t stackmem [MSG_BUFFER_SIZE];
 
@@ -439,6 +446,7 @@ namespace msg {
 
         std::error_code error;
         bool proceed = socket.is_open();
+        char const *failure = nullptr;     // first step that failed, logged once below
 
         size_t const HEADER_SIZE = sizeof (header.payload_size);
         mem::buffer<uint8_t> headerbuf {stackmem, HEADER_SIZE};
@@ -446,12 +454,15 @@ namespace msg {
         // receive header to discover upcoming payload message size
         proceed = proceed && !(error = socket.receive_all (headerbuf, received));
         proceed = proceed && received == HEADER_SIZE;
-        if (!proceed) std::cout << "failed to receive header" << std::endl;
+        if (!proceed) failure = "receive header";
+
+        // latency is taken from header arrival, time spent idle waiting for it doesn't count
+        auto arrived = metrics::clock::now ();
 
         // parse header to discover upcoming payload message size
         size_t headersize;
         proceed = proceed && try_parse_header (headerbuf, header, headersize);
-        if (!proceed) std::cout << "failed to parse header" << std::endl;
+        if (!proceed && !failure) failure = "parse header";
 
         Json::Value deserialized;
         {
@@ -470,19 +481,23 @@ namespace msg {
             // receive json payload to discover message type
             proceed = proceed && !(error = socket.receive_all (payloadbuf, received));
             proceed = proceed && received == header.payload_size;
-            if (!proceed) std::cout << "failed to receive payload" << std::endl;
+            if (!proceed && !failure) failure = "receive payload";
 
             // parse json payload to discover message type
             proceed = proceed && try_read_message (payloadbuf, deserialized);
             proceed = proceed && deserialized.isMember ("message_id");
-            if (!proceed) std::cout << "failed to parse payload" << std::endl;
+            if (!proceed && !failure) failure = "parse payload";
         }
 
         if (proceed)
         {
             // dispatch json payload to discover message contents
             int msgid = deserialized["message_id"].asInt();
-            std::cout << "received message: " << msgid << std::endl;
+            metrics::log (metrics::level::TRACE, "received message: %d", msgid);
+
+            auto index = static_cast<size_t> (msgid - HEADER);
+            auto stats = index < metrics::MAX_MESSAGE_TYPES? &metrics::global ().messages[index] : nullptr;
+            metrics::global ().busy_handlers.add ();
             switch (msgid)
             {
                 case AUTHENTICATE_REQUEST:
@@ -550,15 +565,30 @@ namespace msg {
                     break;
 
                 default:
-                    std::cerr << "can't find handler for message" << std::endl;
+                    metrics::log (metrics::level::FAILURE, "can't find handler for message %d", msgid);
                     break;
             }
 
+            metrics::global ().busy_handlers.sub ();
+
+            if (stats && proceed)
+            {
+                stats->received.add ();
+                stats->handled.record (metrics::clock::now () - arrived);
+            }
+            else if (stats)
+                stats->malformed.add ();
+
             if (!proceed)
-                std::cout << "failed to parse message (malformed message)" << std::endl;
+                metrics::log (metrics::level::FAILURE, "failed to parse message %d (malformed message)", msgid);
+        }
+        else if (!socket.receive_interrupted())
+        {
+            // an interrupted receive is a timeout or the peer closing, neither is worth a log
+            metrics::global ().receive_errors.add ();
+            metrics::log (metrics::level::FAILURE, "failed to deliver received message: %s (%d)", 
+                    failure, error.value());
         }
-        else
-            std::cout << "failed to deliver received message" << std::endl;
 
         if (socket.receive_interrupted())
             on_interrupt (socket);
@@ -623,4 +653,66 @@ namespace msg {
 
         return error;
     }
+
+    // ----- Streamed Block
+
+    std::error_code relay (net::socket &source, std::vector<net::socket *> const &sinks, 
+            size_t size, mem::buffer<uint8_t> store, size_t block)
+    {
+        std::error_code error;
+        net::socket::size_type received = 0, sent = 0;
+        bool retain = mem::size (store) >= size;
+        bool proceed = source.is_open() && (size == 0 || mem::size (store) > 0);
+
+        block = std::min (block, mem::size (store));
+
+        metrics::global ().relays.add ();
+
+        std::vector<net::socket *> live;
+        for (auto sink : sinks)
+            if (sink->is_open()) live.push_back (sink);
+
+        size_t relayed = 0;
+
+        // a single sink with nothing to retain can skip user-space entirely
+        if (proceed && !retain && live.size() == 1)
+        {
+            error = source.splice_to (*live.front(), size, block, relayed);
+
+            if (error == std::errc::operation_not_supported)
+                error = {};
+            else if (live.front()->error())
+                live.clear(); // sink dropped out, keep draining the source below
+
+            proceed = !source.error();
+        }
+
+        while (proceed && relayed < size)
+        {
+            auto blocksize = std::min (block, size - relayed);
+            mem::buffer<uint8_t> chunk {begin (store) + (retain? relayed : 0), blocksize};
+
+            proceed = !(error = source.receive_all (chunk, received)) && (size_t) received == blocksize;
+
+            for (auto sink = begin (live); proceed && sink != end (live);)
+            {
+                if ((*sink)->send_all ({begin (chunk), blocksize}, sent) || (size_t) sent != blocksize)
+                    sink = live.erase (sink);
+                else 
+                    ++sink;
+            }
+
+            relayed += proceed? blocksize : 0;
+        }
+
+        if (!proceed) 
+        {
+            metrics::log (metrics::level::FAILURE, "relay error: %zu of %zu", relayed, size);
+            if (!(error = source.error())) error = std::make_error_code (std::errc::connection_aborted);
+        }
+
+        metrics::global ().relays.sub ();
+
+        return proceed? std::error_code {} : error;
+    }
 }
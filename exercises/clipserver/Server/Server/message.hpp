@@ -24,6 +24,9 @@ namespace msg {
 
     // ----- Header
 
+    // NOTE: payload_size only frames the json message; bulk content (e.g. the bytes following 
+    // a sync_response) travels outside the frame as a raw block of content_size bytes
+
     struct header 
     {
         uint16_t payload_size = 0;
@@ -194,6 +197,18 @@ namespace msg {
     std::error_code send (net::socket &socket, mem::buffer<uint8_t const> buf);
     std::error_code recv (net::socket &socket, mem::buffer<uint8_t> buf);
     std::error_code recv_size (net::socket &socket, size_t &size);
+
+    // ----- Streamed Block
+
+    // block size used when relaying content, bounds per-transfer memory at one block
+    size_t const RELAY_BLOCK_SIZE = 64 * 1024;
+
+    // forwards exactly size bytes from source to every sink as they arrive; a sink that fails is 
+    // dropped but the source is always drained so its stream stays framed, and sends block on slow 
+    // sinks so tcp flow control pushes back on the source. if store can hold size bytes the whole 
+    // content is retained in it, otherwise store is reused per block
+    std::error_code relay (net::socket &source, std::vector<net::socket *> const &sinks, 
+            size_t size, mem::buffer<uint8_t> store, size_t block = RELAY_BLOCK_SIZE);
 }
 
 #endif
@@ -0,0 +1,454 @@
+
+#include "metrics.hpp"
+#include "message.hpp"
+#include "socket.hpp"
+
+#include <cstdio>
+#include <cstdarg>
+#include <iomanip>
+#include <condition_variable>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace metrics {
+
+    // ----- Counter
+
+    size_t thread_shard ()
+    {
+        static std::atomic<size_t> next {0};
+        thread_local size_t shard = next.fetch_add (1, std::memory_order_relaxed) % COUNTER_SHARDS;
+        return shard;
+    }
+
+    uint64_t counter::value () const
+    {
+        uint64_t total = 0;
+        for (auto const &shard : shards_)
+            total += shard.value.load (std::memory_order_relaxed);
+        return total;
+    }
+
+    // ----- Histogram
+
+    namespace {
+
+        unsigned highest_bit (uint64_t value)
+        {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanReverse64 (&index, value);
+            return static_cast<unsigned> (index);
+#else
+            return 63 - static_cast<unsigned> (__builtin_clzll (value));
+#endif
+        }
+    }
+
+    size_t histogram::bucket_of (uint64_t value)
+    {
+        if (value < SUB_COUNT)
+            return static_cast<size_t> (value);
+
+        // the top bit picks the group, the SUB_BITS below it pick the bucket within it
+        unsigned group = highest_bit (value) - SUB_BITS + 1;
+        size_t sub = static_cast<size_t> (value >> (group - 1)) & (SUB_COUNT - 1);
+        return group * SUB_COUNT + sub;
+    }
+
+    uint64_t histogram::lowest_of (size_t bucket)
+    {
+        size_t group = bucket / SUB_COUNT, sub = bucket % SUB_COUNT;
+        return group == 0? sub : (uint64_t {SUB_COUNT} + sub) << (group - 1);
+    }
+
+    uint64_t histogram::highest_of (size_t bucket)
+    {
+        size_t group = bucket / SUB_COUNT;
+        return group == 0? lowest_of (bucket) : lowest_of (bucket) + ((uint64_t {1} << (group - 1)) - 1);
+    }
+
+    void histogram::record (uint64_t value)
+    {
+        buckets_[bucket_of (value)].fetch_add (1, std::memory_order_relaxed);
+        sum_.fetch_add (value, std::memory_order_relaxed);
+
+        uint64_t seen = max_.load (std::memory_order_relaxed);
+        while (value > seen && !max_.compare_exchange_weak (seen, value, std::memory_order_relaxed));
+    }
+
+    void histogram::record (clock::duration elapsed)
+    {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds> (elapsed).count ();
+        record (static_cast<uint64_t> (ns > 0? ns : 0));
+    }
+
+    uint64_t histogram::count () const
+    {
+        uint64_t total = 0;
+        for (auto const &bucket : buckets_)
+            total += bucket.load (std::memory_order_relaxed);
+        return total;
+    }
+
+    uint64_t histogram::percentile (double fraction) const
+    {
+        // buckets are read one at a time while writers keep going, close enough for reporting
+        std::array<uint64_t, BUCKETS> counts;
+        uint64_t total = 0;
+
+        for (size_t i = 0; i < BUCKETS; ++i)
+            total += (counts[i] = buckets_[i].load (std::memory_order_relaxed));
+
+        auto rank = static_cast<uint64_t> (fraction * total + 0.5);
+        uint64_t seen = 0;
+
+        for (size_t i = 0; i < BUCKETS && total > 0; ++i)
+            if ((seen += counts[i]) >= std::max<uint64_t> (rank, 1))
+                return std::min (highest_of (i), max ());
+
+        return 0;
+    }
+
+    // ----- Registry
+
+    registry &global ()
+    {
+        static registry stats;
+        return stats;
+    }
+
+    namespace {
+
+        char const *message_name (size_t index)
+        {
+            switch (index + msg::HEADER)
+            {
+                case msg::AUTHENTICATE_REQUEST: return "authenticate_request";
+                case msg::AUTHENTICATE_RESPONSE: return "authenticate_response";
+                case msg::REFRESH_INDEX_REQUEST: return "refresh_index_request";
+                case msg::REFRESH_INDEX_RESPONSE: return "refresh_index_response";
+                case msg::NOTIFY_AVAILABLE_REQUEST: return "notify_available_request";
+                case msg::SYNC_REQUEST: return "sync_request";
+                case msg::SYNC_RESPONSE: return "sync_response";
+                case msg::PING: return "ping";
+                default: return "unknown";
+            }
+        }
+    }
+
+    std::string format (registry const &stats)
+    {
+        using std::chrono::duration_cast;
+        auto uptime = duration_cast<std::chrono::seconds> (clock::now () - stats.started).count ();
+
+        std::ostringstream out;
+        out << std::fixed << std::setprecision (1);
+
+        out << "clip_uptime_seconds " << uptime << "\n";
+        out << "clip_bytes_in_total " << stats.bytes_in.value () << "\n";
+        out << "clip_bytes_out_total " << stats.bytes_out.value () << "\n";
+        out << "clip_send_errors_total " << stats.send_errors.value () << "\n";
+        out << "clip_receive_errors_total " << stats.receive_errors.value () << "\n";
+        out << "clip_accepted_total " << stats.accepted.value () << "\n";
+        out << "clip_closed_total " << stats.closed.value () << "\n";
+        out << "clip_log_dropped_total " << stats.log_dropped.value () << "\n";
+        out << "clip_connections " << stats.connections.value () << "\n";
+        out << "clip_busy_handlers " << stats.busy_handlers.value () << "\n";
+        out << "clip_pending_syncs " << stats.pending_syncs.value () << "\n";
+        out << "clip_relays " << stats.relays.value () << "\n";
+
+        for (size_t i = 0; i < MAX_MESSAGE_TYPES; ++i)
+        {
+            auto const &message = stats.messages[i];
+            auto received = message.received.value ();
+            auto malformed = message.malformed.value ();
+            if (received == 0 && malformed == 0) continue;
+
+            std::string type = std::string {"{type=\""} + message_name (i) + "\"";
+            auto const &handled = message.handled;
+
+            out << "clip_messages_total" << type << "} " << received << "\n";
+            out << "clip_messages_malformed_total" << type << "} " << malformed << "\n";
+
+            std::pair<double, char const *> const quantiles [] = {{0.5, "0.5"}, {0.99, "0.99"}, {0.999, "0.999"}};
+            for (auto const &quantile : quantiles)
+                out << "clip_message_latency_us" << type << ",quantile=\"" << quantile.second << "\"} "
+                    << handled.percentile (quantile.first) / 1000.0 << "\n";
+
+            out << "clip_message_latency_us_max" << type << "} " << handled.max () / 1000.0 << "\n";
+            out << "clip_message_latency_us_sum" << type << "} " << handled.sum () / 1000.0 << "\n";
+            out << "clip_message_latency_us_count" << type << "} " << handled.count () << "\n";
+        }
+
+        return out.str ();
+    }
+
+    // ----- Log
+
+    namespace {
+
+        size_t const LOG_SLOTS = 1024;      // power of two
+        size_t const LOG_TEXT = 160;
+
+        // bounded multi-producer queue (after Vyukov), a slot's sequence says whose turn it is:
+        // equal to the enqueue position when free, one past it once written
+
+        struct journal
+        {
+            struct slot
+            {
+                std::atomic<size_t> sequence;
+                std::chrono::system_clock::time_point time;
+                level severity;
+                char text [LOG_TEXT];
+            };
+
+            std::array<slot, LOG_SLOTS> slots;
+            std::atomic<size_t> head {0};
+            size_t tail = 0;                // only the writer thread dequeues
+
+            std::atomic<uint32_t> trace_every {1024};
+            std::atomic<uint64_t> traces {0};
+
+            journal ()
+            {
+                for (size_t i = 0; i < LOG_SLOTS; ++i)
+                    slots[i].sequence.store (i, std::memory_order_relaxed);
+            }
+
+            slot *claim ()
+            {
+                size_t position = head.load (std::memory_order_relaxed);
+
+                for (;;)
+                {
+                    slot &candidate = slots[position & (LOG_SLOTS - 1)];
+                    size_t sequence = candidate.sequence.load (std::memory_order_acquire);
+                    auto lag = static_cast<std::ptrdiff_t> (sequence - position);
+
+                    if (lag == 0 && head.compare_exchange_weak (position, position + 1, std::memory_order_relaxed))
+                        return &candidate;
+                    else if (lag < 0)
+                        return nullptr;     // full
+                    else if (lag > 0)
+                        position = head.load (std::memory_order_relaxed);
+                }
+            }
+
+            void publish (slot &written)
+            {
+                auto position = written.sequence.load (std::memory_order_relaxed);
+                written.sequence.store (position + 1, std::memory_order_release);
+            }
+
+            template <typename Consumer>
+            size_t drain (Consumer consume)
+            {
+                size_t drained = 0;
+
+                for (;; ++drained, ++tail)
+                {
+                    slot &next = slots[tail & (LOG_SLOTS - 1)];
+                    if (next.sequence.load (std::memory_order_acquire) != tail + 1)
+                        break;
+
+                    consume (next);
+                    next.sequence.store (tail + LOG_SLOTS, std::memory_order_release);
+                }
+
+                return drained;
+            }
+        };
+
+        journal &global_journal ()
+        {
+            static journal records;
+            return records;
+        }
+
+        char const *level_name (level severity)
+        {
+            switch (severity)
+            {
+                case level::TRACE: return "trace";
+                case level::INFO: return "info";
+                case level::FAILURE: return "failure";
+            }
+
+            return "";
+        }
+    }
+
+    void log (level severity, char const *format, ...)
+    {
+        auto &records = global_journal ();
+
+        if (severity == level::TRACE)
+        {
+            auto every = records.trace_every.load (std::memory_order_relaxed);
+            if (every == 0 || records.traces.fetch_add (1, std::memory_order_relaxed) % every != 0)
+                return;
+        }
+
+        auto slot = records.claim ();
+        if (!slot)
+        {
+            global ().log_dropped.add ();
+            return;
+        }
+
+        slot->time = std::chrono::system_clock::now ();
+        slot->severity = severity;
+
+        va_list args;
+        va_start (args, format);
+        std::vsnprintf (slot->text, LOG_TEXT, format, args);
+        va_end (args);
+
+        records.publish (*slot);
+    }
+
+    // ----- Service
+
+    namespace {
+
+        struct service
+        {
+            options opts;
+            std::mutex lock;
+            std::condition_variable wake;
+            bool running = false;
+
+            std::thread writer;
+            std::thread scraper;
+            net::socket listener;
+        };
+
+        service &global_service ()
+        {
+            static service state;
+            return state;
+        }
+
+        void write_records (journal &records)
+        {
+            char stamp [32];
+
+            records.drain ([&] (journal::slot const &record)
+            {
+                auto time = std::chrono::system_clock::to_time_t (record.time);
+                std::strftime (stamp, sizeof (stamp), "%Y-%m-%d %H:%M:%S", std::localtime (&time));
+                std::clog << stamp << " [" << level_name (record.severity) << "] " << record.text << "\n";
+            });
+
+            std::clog.flush ();
+        }
+
+        void run_writer (service &state)
+        {
+            auto &records = global_journal ();
+            auto next_dump = clock::now () + state.opts.dump_interval;
+            std::unique_lock<std::mutex> lck {state.lock};
+
+            while (state.running)
+            {
+                state.wake.wait_for (lck, std::chrono::milliseconds {50});
+                lck.unlock ();
+
+                write_records (records);
+
+                if (state.opts.dump_interval.count () > 0 && clock::now () >= next_dump)
+                {
+                    std::clog << format (global ()) << std::flush;
+                    next_dump += state.opts.dump_interval;
+                }
+
+                lck.lock ();
+            }
+
+            lck.unlock ();
+            write_records (records);
+        }
+
+        // answers every connection with a plain http response holding the current metrics,
+        // bound to loopback so only local tooling can reach it
+
+        void run_scraper (service &state)
+        {
+            char const *HEADER = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n\r\n";
+            uint8_t requestmem [1024];
+
+            for (;;)
+            {
+                net::socket accepted;
+                if (state.listener.accept (accepted))
+                    break;
+
+                // consume the request first, closing on unread data would reset the reply
+                net::socket::size_type received = 0, sent = 0;
+                accepted.set_receive_timeout (std::chrono::milliseconds {200});
+                accepted.receive ({requestmem, sizeof (requestmem)}, received);
+
+                std::string response = HEADER + format (global ());
+                auto bytes = reinterpret_cast<uint8_t const *> (response.data ());
+                accepted.send_all ({bytes, response.size ()}, sent);
+                accepted.close ();
+            }
+        }
+    }
+
+    void start (options const &opts)
+    {
+        auto &state = global_service ();
+        std::lock_guard<std::mutex> lck {state.lock};
+
+        if (state.running)
+            return;
+
+        state.opts = opts;
+        state.running = true;
+        global_journal ().trace_every = opts.trace_every;
+        state.writer = std::thread {run_writer, std::ref (state)};
+
+        if (opts.scrape_port != 0)
+        {
+            std::error_code error;
+            std::string local = "127.0.0.1:" + std::to_string (opts.scrape_port);
+
+            bool proceed = !(error = state.listener.open (net::socket::type::TCP));
+            proceed = proceed && !(error = state.listener.bind ({local}));
+            proceed = proceed && !(error = state.listener.listen ());
+
+            if (proceed)
+                state.scraper = std::thread {run_scraper, std::ref (state)};
+            else
+                log (level::FAILURE, "metrics: scrape listener on %s failed: %s", local.c_str (), error.message ().c_str ());
+        }
+    }
+
+    void stop ()
+    {
+        auto &state = global_service ();
+        {
+            std::lock_guard<std::mutex> lck {state.lock};
+            if (!state.running) return;
+            state.running = false;
+        }
+
+        state.wake.notify_all ();
+
+        if (state.scraper.joinable ())
+        {
+            state.listener.shutdown ();
+            state.scraper.join ();
+        }
+
+        state.listener.close ();
+
+        if (state.writer.joinable ())
+            state.writer.join ();
+    }
+}
@@ -0,0 +1,170 @@
+#ifndef _METRICS_HPP_
+#define _METRICS_HPP_
+
+#include "standard.hpp"
+
+#include <chrono>
+
+namespace metrics {
+
+    using clock = std::chrono::steady_clock;
+
+    // ----- Counter
+
+    // monotonic count split over cache line sized shards, each thread bumps the shard it was
+    // assigned on first use so handler threads never contend on the same line
+
+    size_t const COUNTER_SHARDS = 16;
+
+    size_t thread_shard ();
+
+    class counter
+    {
+        public:
+            void add (uint64_t amount = 1)
+            {
+                shards_[thread_shard ()].value.fetch_add (amount, std::memory_order_relaxed);
+            }
+
+            uint64_t value () const;
+
+        private:
+            struct alignas (64) shard
+            {
+                std::atomic<uint64_t> value {0};
+            };
+
+            std::array<shard, COUNTER_SHARDS> shards_;
+    };
+
+    // ----- Gauge
+
+    // current level of something that comes and goes (open sockets, waiting requests)
+
+    class gauge
+    {
+        public:
+            void add (int64_t amount = 1) { value_.fetch_add (amount, std::memory_order_relaxed); }
+            void sub (int64_t amount = 1) { value_.fetch_sub (amount, std::memory_order_relaxed); }
+            void set (int64_t amount) { value_.store (amount, std::memory_order_relaxed); }
+            int64_t value () const { return value_.load (std::memory_order_relaxed); }
+
+        private:
+            std::atomic<int64_t> value_ {0};
+    };
+
+    // ----- Histogram
+
+    // log-linear buckets in the manner of HdrHistogram: values below 2^SUB_BITS are exact,
+    // above that every power of two is split into 2^SUB_BITS buckets, so a recorded value is
+    // off by at most 1/16th and the whole 64-bit range fits in under a thousand counters
+
+    class histogram
+    {
+        public:
+            static const unsigned SUB_BITS = 4;
+            static const size_t SUB_COUNT = size_t {1} << SUB_BITS;
+            static const size_t BUCKETS = (64 - SUB_BITS + 1) * SUB_COUNT;
+
+        public:
+            void record (uint64_t value);
+            void record (clock::duration elapsed);
+
+        public:
+            uint64_t count () const;
+            uint64_t sum () const { return sum_.load (std::memory_order_relaxed); }
+            uint64_t max () const { return max_.load (std::memory_order_relaxed); }
+            uint64_t percentile (double fraction) const; // upper bound of the containing bucket
+
+        public:
+            static size_t bucket_of (uint64_t value);
+            static uint64_t lowest_of (size_t bucket);
+            static uint64_t highest_of (size_t bucket);
+
+        private:
+            std::array<std::atomic<uint64_t>, BUCKETS> buckets_ {};
+            std::atomic<uint64_t> sum_ {0};
+            std::atomic<uint64_t> max_ {0};
+    };
+
+    // scoped timer, records the time since construction into a histogram in nanoseconds
+
+    class timer
+    {
+        public:
+            explicit timer (histogram &target) : target_ (target), start_ {clock::now ()} {}
+            ~timer () { target_.record (clock::now () - start_); }
+
+            timer (timer const &) = delete;
+            timer &operator= (timer const &) = delete;
+
+        private:
+            histogram &target_;
+            clock::time_point start_;
+    };
+
+    // ----- Registry
+
+    size_t const MAX_MESSAGE_TYPES = 16;
+
+    struct message_stats
+    {
+        counter received;
+        counter malformed;
+        histogram handled;                  // header arrival to handler return (ns)
+    };
+
+    struct registry
+    {
+        std::array<message_stats, MAX_MESSAGE_TYPES> messages; // indexed by msg::type - msg::HEADER
+
+        counter bytes_in;
+        counter bytes_out;
+        counter send_errors;
+        counter receive_errors;
+        counter accepted;
+        counter closed;
+        counter log_dropped;
+
+        gauge connections;                  // sockets currently being served
+        gauge busy_handlers;                // threads inside a message handler
+        gauge pending_syncs;                // sync requests waiting on a device to answer
+        gauge relays;                       // content transfers in flight
+
+        clock::time_point started = clock::now ();
+    };
+
+    registry &global ();
+
+    // prometheus style text exposition of every metric in the registry
+    std::string format (registry const &stats);
+
+    // ----- Log
+
+    // records are formatted into fixed slots of a lock-free ring and written out by a
+    // background thread, a full ring drops the record (counted) instead of blocking;
+    // trace records are additionally sampled so per-message logging stays cheap
+
+    enum class level { TRACE, INFO, FAILURE };
+
+    void log (level severity, char const *format, ...)
+#if defined (__GNUC__)
+        __attribute__ ((format (printf, 2, 3)))
+#endif
+        ;
+
+    // ----- Service
+
+    struct options
+    {
+        uint32_t trace_every = 1024;        // one in N trace records is kept, 0 drops them all
+        std::chrono::seconds dump_interval {0};  // periodic dump to the log, zero disables
+        uint16_t scrape_port = 0;           // loopback-only scrape listener, zero disables
+    };
+
+    // starts the log writer and optional dump/scrape threads, stop flushes the log
+    void start (options const &opts);
+    void stop ();
+}
+
+#endif
@@ -5,6 +5,7 @@
 #include "message.hpp"
 #include "content.hpp"
 #include "util.hpp"
+#include "metrics.hpp"
 
 #include <json/json.h>
 
@@ -39,6 +40,8 @@ namespace app
             id {id}, secret {secret} {}
     };
 
+    size_t const CACHE_LIMIT = 1024 * 1024;                                 // largest content kept on server
+
     std::recursive_mutex glb_lock;
     std::map<uint64_t, app::account> glb_accounts;                          // user_id -> account
     std::map<uint64_t, uint64_t> glb_token_to_device_id;                    // token -> device_id
@@ -46,18 +49,105 @@ namespace app
     std::map<uint64_t, app::connection> glb_connections;                    // device_id -> connection
     std::multimap<uint64_t, app::connection> glb_content_id_to_connection;  // content_id -> connection
 
+    // messages and relayed content sent on one socket must not interleave, so each socket has 
+    // an outlet serializing its sends. a thread never waits on an outlet while holding glb_lock: 
+    // handlers post messages and send them once glb_lock is released. a relay marks the outlets 
+    // it streams to rather than holding them, messages for them are deferred until it is done, 
+    // and a socket is only closed once no relay streams to it
+    struct outlet
+    {
+        std::mutex lock;
+        std::condition_variable idle;                                       // streaming ended
+        bool open = true;
+        bool streaming = false;
+        std::vector<std::function<std::error_code (net::socket &)>> deferred;
+    };
+
+    std::map<net::socket const *, std::shared_ptr<app::outlet>> glb_outlets;       // socket -> outlet
+
+    // with glb_lock held
+    std::shared_ptr<outlet> outlet_of (net::socket const &socket)
+    {
+        auto &outlet = glb_outlets[&socket];
+        if (!outlet) outlet = std::make_shared<app::outlet> ();
+        return outlet;
+    }
+
     struct receiver : public msg::receiver
     {
+        struct delivery
+        {
+            std::shared_ptr<app::outlet> outlet;
+            net::socket *remote;
+            std::function<std::error_code (net::socket &)> send;
+        };
+
+        std::vector<delivery> outbox;                                       // posted under glb_lock
+
+        // glb_lock for the rest of a handler, what it posted is delivered once released
+        class handling
+        {
+            public:
+                handling (receiver &r, net::socket &socket) : 
+                    receiver_ (r), socket_ (socket), lock_ (glb_lock) {}
+
+                ~handling ()
+                {
+                    lock_.unlock ();
+                    receiver_.deliver (socket_);
+                }
+
+            private:
+                receiver &receiver_;
+                net::socket &socket_;
+                std::unique_lock<std::recursive_mutex> lock_;
+        };
+
+        // with glb_lock held
+        template <typename Message>
+        void post (net::socket &remote, Message const &message)
+        {
+            outbox.push_back ({outlet_of (remote), &remote, 
+                    [message] (net::socket &remote) { return msg::send (remote, message); }});
+        }
+
+        // without glb_lock. a socket that failed is closed only if it is our own, a remote's 
+        // handler meets the error itself
+        void deliver (net::socket &socket)
+        {
+            std::vector<delivery> posted;
+            posted.swap (outbox);
+
+            bool failed = false;
+            for (auto &delivery : posted)
+            {
+                std::error_code error;
+                {
+                    std::lock_guard<std::mutex> sending {delivery.outlet->lock};
+                    if (!delivery.outlet->open)
+                        continue;
+
+                    if (delivery.outlet->streaming)
+                        delivery.outlet->deferred.push_back (std::move (delivery.send));
+                    else
+                        error = delivery.send (*delivery.remote);
+                }
+                failed = failed || (error && delivery.remote == &socket);
+            }
+
+            if (failed) on_error (socket);
+        }
+
         void on_accept (net::socket &socket) override
         {
-            std::cout << "on_accept: " << socket.get_handle() << std::endl;
+            metrics::log (metrics::level::INFO, "accepted socket %d", socket.get_handle());
             socket.set_receive_timeout (std::chrono::minutes {5});
+            socket.set_no_delay (true); // small frames, relayed blocks must not wait on acks
         }
 
         void on_close (net::socket &socket) override
         {
-            std::lock_guard<std::recursive_mutex> lck {glb_lock};
-            std::cout << "on_close " << std::endl;
+            std::unique_lock<std::recursive_mutex> lck {glb_lock};
 
             // find map pair using socket handle value
             auto conn = std::begin (glb_connections);
@@ -87,10 +177,29 @@ namespace app
                 }
 
                 glb_connections.erase (conn);
+                metrics::global ().pending_syncs.set (glb_content_id_to_connection.size ());
+            }
+
+            std::shared_ptr<app::outlet> outlet;
+            auto found = glb_outlets.find (&socket);
+            if (found != std::end (glb_outlets))
+            {
+                outlet = found->second;
+                glb_outlets.erase (found);
+            }
+            lck.unlock ();
+
+            // a relay streaming to this socket finishes before it goes away
+            if (outlet)
+            {
+                std::unique_lock<std::mutex> relayed {outlet->lock};
+                outlet->idle.wait (relayed, [&] { return !outlet->streaming; });
+                outlet->open = false;
+                outlet->deferred.clear ();
             }
 
             if (!success) 
-                std::cout << "warning: unable to remove connection!" << std::endl;
+                metrics::log (metrics::level::FAILURE, "unable to remove connection");
         }
 
         void on_receive (net::socket &socket, msg::authenticate_response const &msg) override {} // client-only
@@ -98,9 +207,9 @@ namespace app
 
         void on_receive (net::socket &socket, msg::authenticate_request const &msg) override
         {
-            std::lock_guard<std::recursive_mutex> lck {glb_lock};
-            std::cout << "received auth request: " << msg.user_id << std::endl;
-            std::cout << "from device: " << msg.device_id << std::endl;
+            handling lck {*this, socket};
+            metrics::log (metrics::level::INFO, "auth request from user %llu device %llu", 
+                    (unsigned long long) msg.user_id, (unsigned long long) msg.device_id);
 
             auto user_id = msg.user_id;
             auto device_id = msg.device_id;
@@ -108,14 +217,13 @@ namespace app
 
             if (glb_accounts.count (user_id) == 0)
             {
-                std::cout << "creating new account" << std::endl;
+                metrics::log (metrics::level::INFO, "creating new account %llu", (unsigned long long) user_id);
                 glb_accounts[user_id] = {user_id, secret}; 
             }
 
             // all connections are authenticated and given tokens
             auto &account = glb_accounts[user_id];
             uint64_t token = util::generate_rand63();
-            std::cout << "using token: " << token << std::endl;
 
             // track current connections
             app::connection connection { &socket, device_id, user_id, token };
@@ -128,14 +236,13 @@ namespace app
 
             // respond successfully
             msg::authenticate_response response {token, 1}; 
-            std::error_code error = msg::send (socket, response);
-            if (error) on_error (socket);
+            post (socket, response);
         }
 
         void on_receive (net::socket &socket, msg::refresh_index_request const &msg) override
         {
-            std::lock_guard<std::recursive_mutex> lck {glb_lock};
-            std::cout << "refresh index request: " << msg.token << std::endl;
+            handling lck {*this, socket};
+            metrics::log (metrics::level::TRACE, "refresh index request");
 
             auto token = msg.token;
             auto dataset_id = (size_t) msg.dataset_id;
@@ -156,14 +263,13 @@ namespace app
             else
                 response.message = 0;
 
-            std::error_code error = msg::send (socket, response);
-            if (error) on_error (socket);
+            post (socket, response);
         }
 
         void on_receive (net::socket &socket, msg::notify_available_request const &msg) override
         {
-            std::lock_guard<std::recursive_mutex> lck {glb_lock};
-            std::cout << "notify available request: " << msg.token << std::endl;
+            handling lck {*this, socket};
+            metrics::log (metrics::level::TRACE, "notify available request: %llu", (unsigned long long) msg.content.id);
 
             auto token = msg.token;
             auto dataset_id = msg.dataset_id;
@@ -185,25 +291,16 @@ namespace app
 
                 for (auto connection : account.connections)
                 {
-                    std::cout << "this device_id: " << device_id << std::endl;
-                    std::cout << "checking device_id: " << connection.device_id << std::endl;
                     if (device_id != connection.device_id)
-                    {
-                        std::cout << "socket: " << connection.remote->get_handle() << std::endl;
-                        auto &remote = *connection.remote;
-                        std::error_code error = msg::send (remote, msg);
-                        if (error) on_error (remote);
-                    }
+                        post (*connection.remote, msg);
                 }
             }
-
-            std::cout << "content: " << content_id << " : " << std::endl;
         }
 
         void on_receive (net::socket &socket, msg::sync_request const &msg) override
         {
-            std::lock_guard<std::recursive_mutex> lck {glb_lock};
-            std::cout << "sync request: " << msg.token << std::endl;
+            handling lck {*this, socket};
+            metrics::log (metrics::level::TRACE, "sync request: %llu", (unsigned long long) msg.content_id);
 
             auto token = msg.token;
             auto content_id = msg.content_id;
@@ -223,10 +320,9 @@ namespace app
 
                     if (bytes != nullptr && size > 0)
                     {
-                        std::cout << "content is cached on server: " << content_id << std::endl;
+                        metrics::log (metrics::level::TRACE, "content is cached on server: %llu", (unsigned long long) content_id);
 
                         bool proceed = true;
-                        std::error_code error;
                         msg::sync_response response;
 
                         response.token = 0; // TODO: who authenticates this
@@ -234,29 +330,27 @@ namespace app
                         response.content = node.buffer;
                         response.message = proceed;
 
-                        proceed = proceed && !(error = msg::send (socket, response));
-                        proceed = proceed && !(error = msg::send (socket, {bytes, size}));
-                        if (error) on_error (socket);
+                        // cached bytes are never freed, so they can be sent after glb_lock
+                        outbox.push_back ({outlet_of (socket), &socket, [response, bytes, size] (net::socket &remote)
+                        {
+                            std::error_code error = msg::send (remote, response);
+                            return error? error : msg::send (remote, {bytes, size});
+                        }});
                     }
                     else
                     {
-                        std::cout << "forwarding request: " << content_id << std::endl;
+                        metrics::log (metrics::level::TRACE, "forwarding request: %llu", (unsigned long long) content_id);
                         // we have to forward the request
                         // remember who initiated the request
                         std::pair<uint64_t, connection> entry = {content_id, {&socket, device_id, user_id, token}};
                         glb_content_id_to_connection.insert (entry);
+                        metrics::global ().pending_syncs.set (glb_content_id_to_connection.size ());
 
                         // ask the device(s) that notified of this content
                         for (auto id : node.devices)
                         {
                             if (id != device_id)
-                            {
-                                std::cout << "to device: " << id << std::endl;
-                                auto &connection = glb_connections[id];
-                                auto &remote = *connection.remote;
-                                std::error_code error = msg::send (remote, msg);
-                                if (error) on_error (remote);
-                            }
+                                post (*glb_connections[id].remote, msg);
                         }
                     }
                 }
@@ -265,8 +359,7 @@ namespace app
 
         void on_receive (net::socket &socket, msg::sync_response const &msg) override
         {
-            std::lock_guard<std::recursive_mutex> lck {glb_lock};
-            std::cout << "sync response: " << msg.token << std::endl;
+            metrics::log (metrics::level::TRACE, "sync response: %llu", (unsigned long long) msg.content.id);
 
             auto token = msg.token;
             auto dataset_id = msg.dataset_id;
@@ -274,37 +367,116 @@ namespace app
             auto content_size = msg.content.size;
             auto message = msg.message;
 
-            if (glb_token_to_user_id.count (token))
+            // take the pending requestors under glb_lock, the content is streamed to them without it
+            std::vector<std::pair<std::shared_ptr<app::outlet>, net::socket *>> pending_requestors;
             {
+                std::lock_guard<std::recursive_mutex> lck {glb_lock};
+                if (!glb_token_to_user_id.count (token))
+                    return;
+
                 auto &account = glb_accounts[glb_token_to_user_id[token]];
                 auto &dataset = account.datasets[dataset_id];
-                if (dataset.contents.count (content_id))
+                if (!dataset.contents.count (content_id))
+                    return;
+
+                auto range = glb_content_id_to_connection.equal_range (content_id);
+                for (auto pending = range.first; pending != range.second; ++pending)
+                {
+                    auto requestor = std::make_pair (outlet_of (*pending->second.remote), pending->second.remote);
+                    if (requestor.second != &socket && 
+                            std::find (begin (pending_requestors), end (pending_requestors), requestor) == end (pending_requestors))
+                        pending_requestors.push_back (requestor);
+                }
+
+                // requests arriving from now on are forwarded again
+                glb_content_id_to_connection.erase (content_id);
+                metrics::global ().pending_syncs.set (glb_content_id_to_connection.size ());
+            }
+
+            // outlets are claimed in address order, so relays sharing requestors cannot deadlock
+            std::sort (begin (pending_requestors), end (pending_requestors));
+
+            std::error_code error;
+            std::vector<net::socket *> requestors;
+            std::vector<std::shared_ptr<app::outlet>> streaming;
+
+            // announce to original requestors still connected, content is then streamed to them
+            for (auto const &requestor : pending_requestors)
+            {
+                auto &outlet = requestor.first;
+                std::unique_lock<std::mutex> lock {outlet->lock};
+                outlet->idle.wait (lock, [&] { return !outlet->streaming || !outlet->open; });
+                if (outlet->open && !(error = msg::send (*requestor.second, msg)))
+                {
+                    outlet->streaming = true;
+                    requestors.push_back (requestor.second);
+                    streaming.push_back (outlet);
+                }
+            }
+
+            // only small content is cached, anything larger is relayed through one block
+            bool cache = content_size <= CACHE_LIMIT;
+            std::unique_ptr<uint8_t[]> scratch {cache? nullptr : new uint8_t [msg::RELAY_BLOCK_SIZE]};
+            auto bytes = cache? new uint8_t [content_size] : nullptr;
+
+            mem::buffer<uint8_t> store = cache? 
+                mem::buffer<uint8_t> {bytes, content_size} : 
+                mem::buffer<uint8_t> {scratch.get(), msg::RELAY_BLOCK_SIZE};
+
+            // forward each block to requestors as it arrives
+            bool proceed = !(error = msg::relay (socket, requestors, content_size, store));
+
+            // then what was deferred meanwhile, still marked streaming so it stays in order
+            for (size_t i = 0; i < streaming.size (); ++i)
+            {
+                auto &outlet = streaming[i];
+                std::unique_lock<std::mutex> lock {outlet->lock};
+                while (!outlet->deferred.empty ())
                 {
-                    auto &node = dataset.contents[content_id];
+                    std::vector<std::function<std::error_code (net::socket &)>> deferred;
+                    deferred.swap (outlet->deferred);
+                    lock.unlock ();
 
-                    std::error_code error;
-                    bool proceed = socket.is_open();
+                    for (auto &send : deferred)
+                        if (send (*requestors[i])) break;
 
-                    // allocate heap storage based on expected content size
-                    auto bytes = proceed? new uint8_t [content_size] : nullptr;
-                    size_t size = proceed? content_size : 0;
+                    lock.lock ();
+                }
+                outlet->streaming = false;
+                outlet->idle.notify_all ();
+            }
 
-                    // receive the full expected content
-                    proceed = proceed && !(error = msg::recv (socket, {bytes, size}));
-                    node.buffer.bytes = bytes;
-                    node.buffer.size = size;
+            {
+                std::lock_guard<std::recursive_mutex> lck {glb_lock};
+                auto cached = false;
+                if (cache && proceed && glb_token_to_user_id.count (token))
+                {
+                    auto &account = glb_accounts[glb_token_to_user_id[token]];
+                    auto &node = account.datasets[dataset_id].contents[content_id];
 
-                    // forward to original requestor
-                    auto range = glb_content_id_to_connection.equal_range (content_id);
-                    for (auto pending = range.first; proceed && pending != range.second; ++pending)
+                    // cached bytes are never freed, another response may have cached them meanwhile
+                    if (node.buffer.bytes == nullptr)
                     {
-                        std::cout << "sending to requestor device: " << pending->second.device_id << std::endl;
-                        proceed = !(error = msg::send (*pending->second.remote, msg));
-                        proceed = !(error = msg::send (*pending->second.remote, {bytes, size}));
+                        node.buffer.id = content_id;
+                        node.buffer.bytes = bytes;
+                        node.buffer.size = content_size;
+                        cached = true;
                     }
-
-                    glb_content_id_to_connection.erase (content_id);
                 }
+                if (!cached)
+                    delete [] bytes;
+            }
+
+            if (error) on_error (socket);
+        }
+
+        void on_receive (net::socket &socket, msg::ping const &msg) override
+        {
+            // echo client pings so they can measure the link, our own keepalives carry 0
+            if (msg.token != 0)
+            {
+                handling lck {*this, socket};
+                post (socket, msg);
             }
         }
 
@@ -324,7 +496,8 @@ namespace app
             else if (error == timed_out)
             {
                 socket.clear_error();
-                error = msg::send (socket, msg::ping {0}); // TODO: who authenticates this
+                handling lck {*this, socket};
+                post (socket, msg::ping {0}); // TODO: who authenticates this
             }
         }
 
@@ -335,7 +508,7 @@ namespace app
 
             if (error)
             {
-                std::cout << "on_error: " << error.message() << " (" << error.value() << ")" << std::endl;
+                metrics::log (metrics::level::FAILURE, "on_error: %s (%d)", error.message().c_str(), error.value());
                 close (socket);
             }
         }
@@ -350,8 +523,6 @@ namespace app
             std::error_code error = listener.accept (accepted);
             proceed = proceed && !error;
 
-            std::cout << "=======================================" << std::endl;
-
             app::receiver receiver;
             receiver.accept (accepted);
             while (proceed && !receiver.is_closed ())
@@ -384,6 +555,12 @@ int main (int argc, char **argv)
     bool interactive = argc == 2 && std::string {argv[1]} == "interactive";
 
     sys::socket::system sockets; // initializes socket system
+
+    // metrics are scraped from 127.0.0.1:4243, unattended servers also dump them to the log
+    metrics::options reporting;
+    reporting.scrape_port = 4243;
+    reporting.dump_interval = std::chrono::seconds {interactive? 0 : 60};
+    metrics::start (reporting);
     net::socket listener {net::socket::type::TCP}; 
     std::vector<std::thread> threads;
     
@@ -414,6 +591,8 @@ int main (int argc, char **argv)
                 std::cout << "command: " << command << std::endl;
                 if (command == "quit")
                     proceed = false;
+                else if (command == "stats")
+                    std::cout << metrics::format (metrics::global ());
             }
         }
         else
@@ -423,6 +602,7 @@ int main (int argc, char **argv)
     else
         std::cout << "has error: " << error.message() << std::endl;
     
+    metrics::stop ();
     return 0;
 }
 
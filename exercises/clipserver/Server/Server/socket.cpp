@@ -2,11 +2,14 @@
 #ifdef _WIN32
 #include <WS2tcpip.h>
 #else
+#include <fcntl.h>
 #include <unistd.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
 #endif
 
 #include "socket.hpp"
+#include "metrics.hpp"
 
 namespace sys { 
 
@@ -147,6 +150,12 @@ namespace sys {
             return try_set_socket_options (handle, SOL_SOCKET, SO_RCVTIMEO, &duration, sizeof(duration));
         }
 
+        bool try_set_no_delay (handle_type handle, bool enable)
+        {
+            int value = enable? 1 : 0;
+            return try_set_socket_options (handle, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+        }
+
         bool try_open (int family, int type, int protocol, int &handle)
         {
             using ::socket;
@@ -162,8 +171,6 @@ namespace sys {
 
         bool try_close (handle_type &handle)
         {
-            if (handle != INVALID)
-                std::cout << "closing socket " << handle << std::endl;
 #ifdef _WIN32
             handle_type result = closesocket (handle);
 #else
@@ -177,6 +184,16 @@ namespace sys {
             return success;
         }
 
+        bool try_shutdown (handle_type handle)
+        {
+#ifdef _WIN32
+            int result = shutdown (handle, SD_BOTH);
+#else
+            int result = shutdown (handle, SHUT_RDWR);
+#endif
+            return result == 0;
+        }
+
         bool try_bind (handle_type handle, sockaddr const *addr, size_type size)
         {
             handle_type result = bind (handle, addr, size);
@@ -238,7 +255,7 @@ namespace sys {
             bool success = result >= 0;
 
             sent = success? static_cast<size_type> (result) : 0;
-            std::cout << "sending bytes: " << sent << " to " << (int) handle << std::endl;
+            metrics::global ().bytes_out.add (sent);
             return success;
         }
 
@@ -253,6 +270,7 @@ namespace sys {
             bool success = result >= 0;
 
             sent = success? static_cast<size_type> (result) : 0;
+            metrics::global ().bytes_out.add (sent);
             return success;
         }
         
@@ -266,7 +284,7 @@ namespace sys {
             bool success = result > 0;
 
             received = success? static_cast<size_type> (result) : 0;
-            std::cout << "received bytes: " << received << " out of " << bytes << " from " << (int) handle << std::endl;
+            metrics::global ().bytes_in.add (received);
             return success;
         }
 
@@ -281,8 +299,74 @@ namespace sys {
             bool success = result > 0;
 
             received = success? static_cast<size_type> (result) : 0;
+            metrics::global ().bytes_in.add (received);
             return success;
         }
+
+        bool try_open_pipe (handle_type (&pipefd) [2], size_t capacity)
+        {
+#ifdef __linux__
+            bool success = pipe2 (pipefd, O_CLOEXEC) == 0;
+
+            if (success)
+                fcntl (pipefd[1], F_SETPIPE_SZ, static_cast<int> (capacity));
+
+            return success;
+#else
+            return false;
+#endif
+        }
+
+        bool try_close_pipe (handle_type (&pipefd) [2])
+        {
+#ifdef __linux__
+            bool success = ::close (pipefd[0]) == 0;
+            success = ::close (pipefd[1]) == 0 && success;
+
+            if (success)
+                pipefd[0] = pipefd[1] = INVALID;
+
+            return success;
+#else
+            return false;
+#endif
+        }
+
+        // NOTE: moves bytes socket -> pipe -> socket inside the kernel, so relayed content 
+        // never gets copied through user-space; the pipe holds at most one block in flight
+
+        bool try_splice (handle_type from, handle_type to, handle_type (&pipefd) [2], 
+                size_t bytes, size_t block, size_t &moved, bool &sink_failed)
+        {
+            moved = 0;
+            sink_failed = false;
+
+#ifdef __linux__
+            bool success = true;
+
+            while (success && moved < bytes)
+            {
+                auto request = std::min (block, bytes - moved);
+                ssize_type in = splice (from, nullptr, pipefd[1], nullptr, request, SPLICE_F_MOVE | SPLICE_F_MORE);
+                success = in > 0;
+
+                // source bytes are consumed from here on, even if the sink drops them
+                if (success) moved += static_cast<size_t> (in);
+                if (success) metrics::global ().bytes_in.add (in);
+
+                for (ssize_type out = 0, pushed = 0; success && out < in; out += pushed)
+                {
+                    pushed = splice (pipefd[0], nullptr, to, nullptr, in - out, SPLICE_F_MOVE | SPLICE_F_MORE);
+                    success = !(sink_failed = pushed <= 0);
+                    if (success) metrics::global ().bytes_out.add (pushed);
+                }
+            }
+
+            return success;
+#else
+            return false;
+#endif
+        }
 } }
 
 namespace net {
@@ -457,6 +541,12 @@ namespace net {
             sys::socket::load_last_error_code (error_);
     }
 
+    void socket::set_no_delay (bool enable)
+    {
+        if (!sys::socket::try_set_no_delay (handle_, enable))
+            sys::socket::load_last_error_code (error_);
+    }
+
     std::error_code socket::open (type kind)
     {
         int sockfam, socktype, sockproto;
@@ -479,6 +569,14 @@ namespace net {
         return error_;
     }
 
+    std::error_code socket::shutdown ()
+    {
+        if (!sys::socket::try_shutdown (handle_))
+            sys::socket::load_last_error_code (error_);
+
+        return error_;
+    }
+
     std::error_code socket::bind (address const &local)
     {
         auto addr = (sockaddr const *) local;
@@ -633,6 +731,25 @@ namespace net {
         return error_;
     }
 
+    std::error_code socket::splice_to (socket &sink, size_t bytes, size_t block, size_t &moved)
+    {
+        handle_type pipe [2] = {INVALID, INVALID};
+        bool sink_failed = false;
+        moved = 0;
+
+        // caller falls back to copying through user-space if the kernel can't splice
+        if (!sys::socket::try_open_pipe (pipe, block))
+            return std::make_error_code (std::errc::operation_not_supported);
+
+        if (!sys::socket::try_splice (handle_, sink.handle_, pipe, bytes, block, moved, sink_failed))
+            sys::socket::load_last_error_code (sink_failed? sink.error_ : error_);
+
+        sys::socket::try_close_pipe (pipe);
+        recv_interrupt_ = !sink_failed && moved < bytes;
+
+        return sink_failed? sink.error_ : error_;
+    }
+
     void socket::map_socket_type (type kind, int &sockfam, int &socktype, int &sockprot)
     {
         switch (kind)
@@ -38,6 +38,7 @@ namespace sys {
 
         bool try_open (int family, int type, int protocol, int &handle);
         bool try_close (handle_type &handle);
+        bool try_shutdown (handle_type handle);
         
         bool try_bind (handle_type handle, sockaddr const *addr, size_type size);
         bool try_connect (handle_type handle, sockaddr const *addr, size_type size);
@@ -56,6 +57,11 @@ namespace sys {
         bool try_recvfrom (handle_type handle, sockaddr *addr, size_type size,
                 void *buf, size_type bytes, int flags, size_type &received);
 
+        bool try_open_pipe (handle_type (&pipefd) [2], size_t capacity);
+        bool try_close_pipe (handle_type (&pipefd) [2]);
+        bool try_splice (handle_type from, handle_type to, handle_type (&pipefd) [2], 
+                size_t bytes, size_t block, size_t &moved, bool &sink_failed);
+
         struct system
         {
             system () { try_initialize_sockets (); }
@@ -153,10 +159,12 @@ namespace net {
         public:
             void set_send_timeout (std::chrono::milliseconds timeout);
             void set_receive_timeout (std::chrono::milliseconds timeout);
+            void set_no_delay (bool enable);
 
         public:
             std::error_code open (type kind);
             std::error_code close ();
+            std::error_code shutdown ();
             std::error_code bind (address const &local);
             std::error_code connect (address const &remote);
 
@@ -178,6 +186,9 @@ namespace net {
             std::error_code receive_all (mem::buffer<uint8_t> buf, size_type &received);
             std::error_code receive_from (address &remote, mem::buffer<uint8_t> buf, size_type &received);
 
+        public:
+            std::error_code splice_to (socket &sink, size_t bytes, size_t block, size_t &moved);
+
         private:
             void map_socket_type (type kind, int &sockfam, int &socktype, int &sockprot);
 
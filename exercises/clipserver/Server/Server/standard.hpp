@@ -15,8 +15,10 @@
 #include <algorithm>
 
 #include <mutex>
+#include <condition_variable>
 #include <atomic>
 #include <thread>
+#include <functional>
 
 #include <sstream>
 #include <iostream>
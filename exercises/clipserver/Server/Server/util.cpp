@@ -1,17 +1,19 @@
 
 #include "util.hpp"
 
+#include <random>
+
 namespace util
 {
     uint64_t generate_rand64 ()
     {
-        std::srand (static_cast<unsigned> (std::time (0)));
-        // std::rand portably guarantees only 15 bits of randomness (see RAND_MAX)
-        uint64_t A = 0xFFFF & std::rand ();
-        uint64_t B = 0xFFFF & std::rand ();
-        uint64_t C = 0xFFFF & std::rand ();
-        uint64_t D = 0xFFFF & std::rand ();
-        return (A << (3 * 16)) | (B << (2 * 16)) | (C << (1 * 16)) | (D << (0 * 16));
+        // seeded once, reseeding std::rand from std::time per call handed every caller
+        // within the same second the same value (and so the same session token)
+        static std::mutex lock;
+        static std::mt19937_64 engine {std::random_device {} ()};
+
+        std::lock_guard<std::mutex> lck {lock};
+        return engine ();
     }
 
     uint64_t generate_guid64 (std::string const &bytes)
@@ -0,0 +1,542 @@
+#include "client.hpp"
+#include "util.hpp"
+
+namespace client {
+
+    namespace {
+
+        std::chrono::seconds const AUTHENTICATE_TIMEOUT {5};
+        std::chrono::seconds const KEEPALIVE_TIMEOUT {60};
+        size_t const HEALTH_MISSED_PINGS = 3;
+
+        // pairs a handler with the future it completes, errors surface as std::system_error
+        template <typename Response>
+        std::pair<handler<Response>, std::future<Response>> make_completion ()
+        {
+            auto promise = std::make_shared<std::promise<Response>> ();
+            auto future = promise->get_future ();
+
+            handler<Response> done = [promise] (std::error_code const &error, Response const &response)
+            {
+                if (error)
+                    promise->set_exception (std::make_exception_ptr (std::system_error {error}));
+                else
+                    promise->set_value (response);
+            };
+
+            return {done, std::move (future)};
+        }
+
+        template <typename Response>
+        void reject (handler<Response> const &done, std::errc reason)
+        {
+            if (done) done (std::make_error_code (reason), Response {});
+        }
+    }
+
+    // ----- Connection
+
+    connection::connection (std::string const &address, credentials const &login,
+            std::shared_ptr<catalog> published) :
+        socket_ {net::socket::type::TCP}, login_ {login}, published_ {published}
+    {
+        last_heard_ = clock::now ().time_since_epoch ().count ();
+
+        std::error_code error;
+        bool proceed = socket_ && !(error = socket_.connect ({address}));
+
+        if (proceed)
+        {
+            socket_.set_receive_timeout (KEEPALIVE_TIMEOUT);
+            socket_.set_no_delay (true);
+            reader_ = std::thread {&connection::run, this};
+        }
+        else
+            failed_ = error? error : std::make_error_code (std::errc::not_connected);
+    }
+
+    connection::~connection ()
+    {
+        shutdown ();
+
+        if (reader_.joinable ())
+            reader_.join ();
+    }
+
+    bool connection::is_ready () const
+    {
+        return token_ != 0 && !is_closed ();
+    }
+
+    connection::clock::time_point connection::last_heard () const
+    {
+        return clock::time_point {clock::duration {last_heard_}};
+    }
+
+    void connection::shutdown ()
+    {
+        std::lock_guard<std::mutex> lck {link_lock_};
+        if (!is_closed () && reader_.joinable ())
+            socket_.shutdown ();
+    }
+
+    // enlists the handler and writes the request under one lock so per-type queues stay in
+    // wire order; a failed write shuts the link, the reader then fails everything pending
+
+    template <typename Message, typename Response, typename Enlist>
+    void connection::submit (Message const &message, handler<Response> const &done, Enlist enlist)
+    {
+        std::error_code error;
+        {
+            std::lock_guard<std::mutex> sending {send_lock_};
+            {
+                std::lock_guard<std::mutex> lck {pending_lock_};
+                if (!(error = failed_))
+                {
+                    enlist ();
+                    ++outstanding_;
+                }
+            }
+
+            if (!error && msg::send (socket_, message))
+                socket_.shutdown ();
+        }
+
+        if (error && done) done (error, Response {});
+    }
+
+    void connection::authenticate (handler<msg::authenticate_response> done)
+    {
+        msg::authenticate_request request {login_.user_id, login_.device_id, login_.secret};
+        submit (request, done, [&] { authenticates_.push_back (done); });
+    }
+
+    void connection::refresh_index (uint16_t dataset_id, handler<msg::refresh_index_response> done)
+    {
+        msg::refresh_index_request request {token_, dataset_id};
+        submit (request, done, [&] { refreshes_.push_back (done); });
+    }
+
+    void connection::sync (uint64_t content_id, uint16_t dataset_id, handler<sync_result> done)
+    {
+        msg::sync_request request {token_, content_id};
+        request.dataset_id = dataset_id;
+        submit (request, done, [&] { syncs_.insert ({content_id, done}); });
+    }
+
+    void connection::ping (handler<msg::ping> done)
+    {
+        uint64_t sequence = ++sequence_;
+        submit (msg::ping {sequence}, done, [&] { pings_[sequence] = done; });
+    }
+
+    std::error_code connection::notify (uint16_t dataset_id, content::node const &node)
+    {
+        std::lock_guard<std::mutex> sending {send_lock_};
+        return msg::send (socket_, msg::notify_available_request {token_, dataset_id, node});
+    }
+
+    std::future<msg::authenticate_response> connection::authenticate ()
+    {
+        auto completion = make_completion<msg::authenticate_response> ();
+        authenticate (completion.first);
+        return std::move (completion.second);
+    }
+
+    std::future<msg::refresh_index_response> connection::refresh_index (uint16_t dataset_id)
+    {
+        auto completion = make_completion<msg::refresh_index_response> ();
+        refresh_index (dataset_id, completion.first);
+        return std::move (completion.second);
+    }
+
+    std::future<sync_result> connection::sync (uint64_t content_id, uint16_t dataset_id)
+    {
+        auto completion = make_completion<sync_result> ();
+        sync (content_id, dataset_id, completion.first);
+        return std::move (completion.second);
+    }
+
+    std::future<msg::ping> connection::ping ()
+    {
+        auto completion = make_completion<msg::ping> ();
+        ping (completion.first);
+        return std::move (completion.second);
+    }
+
+    void connection::run ()
+    {
+        accept (socket_);
+
+        while (!is_closed ())
+        {
+            dispatch (socket_);
+            last_heard_ = clock::now ().time_since_epoch ().count ();
+        }
+    }
+
+    // shutdown first so a writer blocked in send lets go of the send lock, the handle is
+    // only released once no writer can still be using it
+
+    void connection::close_link ()
+    {
+        std::lock_guard<std::mutex> lck {link_lock_};
+
+        if (!is_closed ())
+        {
+            socket_.shutdown ();
+            std::lock_guard<std::mutex> sending {send_lock_};
+            close (socket_);
+        }
+    }
+
+    void connection::fail_pending (std::error_code const &error)
+    {
+        std::deque<handler<msg::authenticate_response>> authenticates;
+        std::deque<handler<msg::refresh_index_response>> refreshes;
+        std::multimap<uint64_t, handler<sync_result>> syncs;
+        std::map<uint64_t, handler<msg::ping>> pings;
+        {
+            std::lock_guard<std::mutex> lck {pending_lock_};
+            failed_ = error;
+            outstanding_ = 0;
+
+            authenticates.swap (authenticates_);
+            refreshes.swap (refreshes_);
+            syncs.swap (syncs_);
+            pings.swap (pings_);
+        }
+
+        for (auto &done : authenticates) if (done) done (error, {});
+        for (auto &done : refreshes) if (done) done (error, {});
+        for (auto &pending : syncs) if (pending.second) pending.second (error, {});
+        for (auto &pending : pings) if (pending.second) pending.second (error, {});
+    }
+
+    void connection::on_receive (net::socket &socket, msg::authenticate_response const &msg)
+    {
+        if (msg.message) token_ = msg.token;
+
+        handler<msg::authenticate_response> done;
+        {
+            std::lock_guard<std::mutex> lck {pending_lock_};
+            if (!authenticates_.empty ())
+            {
+                done = std::move (authenticates_.front ());
+                authenticates_.pop_front ();
+                --outstanding_;
+            }
+        }
+
+        if (done) done ({}, msg);
+    }
+
+    void connection::on_receive (net::socket &socket, msg::refresh_index_response const &msg)
+    {
+        handler<msg::refresh_index_response> done;
+        {
+            std::lock_guard<std::mutex> lck {pending_lock_};
+            if (!refreshes_.empty ())
+            {
+                done = std::move (refreshes_.front ());
+                refreshes_.pop_front ();
+                --outstanding_;
+            }
+        }
+
+        if (done) done ({}, msg);
+    }
+
+    // NOTE: serving runs on the reader thread and takes the send lock, a writer stuck behind
+    // a full socket stalls it; fine for clipboard sized content
+
+    void connection::on_receive (net::socket &socket, msg::sync_request const &msg)
+    {
+        std::string bytes;
+        bool found = false;
+
+        if (published_)
+        {
+            std::lock_guard<std::mutex> lck {published_->lock};
+            auto item = published_->items.find (msg.content_id);
+            if ((found = item != std::end (published_->items)))
+                bytes = item->second;
+        }
+
+        auto size = found? static_cast<uint32_t> (bytes.size ()) : 0;
+        msg::sync_response response {token_, msg.dataset_id, {msg.content_id, size}, found};
+
+        std::error_code error;
+        {
+            std::lock_guard<std::mutex> sending {send_lock_};
+            bool proceed = !(error = msg::send (socket, response));
+            proceed = proceed && size > 0 &&
+                !(error = msg::send (socket, {reinterpret_cast<uint8_t const *> (bytes.data ()), size}));
+        }
+
+        if (error) on_error (socket);
+    }
+
+    void connection::on_receive (net::socket &socket, msg::sync_response const &msg)
+    {
+        sync_result result;
+        result.response = msg;
+        result.content.resize (msg.content.size);
+
+        // content follows the response as a raw block, always drained to keep the stream framed
+        std::error_code error = msg::relay (socket, {}, msg.content.size,
+                {result.content.data (), result.content.size ()});
+
+        handler<sync_result> done;
+        {
+            std::lock_guard<std::mutex> lck {pending_lock_};
+            auto waiting = syncs_.find (msg.content.id);
+            if (waiting != std::end (syncs_))
+            {
+                done = std::move (waiting->second);
+                syncs_.erase (waiting);
+                --outstanding_;
+            }
+        }
+
+        if (done) done (error, result);
+        if (error) on_error (socket);
+    }
+
+    void connection::on_receive (net::socket &socket, msg::ping const &msg)
+    {
+        handler<msg::ping> done;
+        {
+            std::lock_guard<std::mutex> lck {pending_lock_};
+            auto waiting = pings_.find (msg.token);
+            if (waiting != std::end (pings_))
+            {
+                done = std::move (waiting->second);
+                pings_.erase (waiting);
+                --outstanding_;
+            }
+        }
+
+        if (done) done ({}, msg);
+    }
+
+    void connection::on_interrupt (net::socket &socket)
+    {
+        std::error_code error = socket.error();
+
+#ifdef _WIN32 // uhh, thanks windows... :/
+        auto timed_out = std::error_condition {WSAETIMEDOUT, std::system_category()};
+#else
+        auto timed_out = std::make_error_condition (std::errc::timed_out);
+#endif
+        bool idle = error == timed_out;
+
+        if (idle)
+        {
+            // keepalive pings carry no sequence and get no echo
+            socket.clear_error();
+            std::lock_guard<std::mutex> sending {send_lock_};
+            idle = !msg::send (socket, msg::ping {0});
+        }
+
+        if (!idle)
+            close_link ();
+    }
+
+    void connection::on_error (net::socket &socket)
+    {
+        msg::receiver::on_error (socket);
+
+        if (socket.error())
+            close_link ();
+    }
+
+    void connection::on_close (net::socket &socket)
+    {
+        std::error_code error = socket.error();
+        fail_pending (error? error : std::make_error_code (std::errc::connection_reset));
+    }
+
+    // ----- Pool
+
+    pool::pool (options const &opts) :
+        opts_ {opts}, published_ {std::make_shared<catalog> ()}
+    {
+        for (size_t i = 0; i < opts_.connections; ++i)
+            connections_.push_back (connect (i));
+
+        if (ready () < opts_.connections)
+            error_ = std::make_error_code (std::errc::not_connected);
+
+        if (opts_.ping_interval.count () > 0)
+            health_ = std::thread {&pool::check_health, this};
+    }
+
+    pool::~pool ()
+    {
+        {
+            std::lock_guard<std::mutex> lck {health_lock_};
+            stopping_ = true;
+        }
+
+        health_wake_.notify_all ();
+
+        if (health_.joinable ())
+            health_.join ();
+    }
+
+    size_t pool::ready () const
+    {
+        std::lock_guard<std::mutex> lck {lock_};
+        return std::count_if (std::begin (connections_), std::end (connections_),
+                [] (std::shared_ptr<connection> const &link) { return link->is_ready (); });
+    }
+
+    std::error_code pool::error () const
+    {
+        std::lock_guard<std::mutex> lck {lock_};
+        return error_;
+    }
+
+    std::shared_ptr<connection> pool::connect (size_t index)
+    {
+        credentials login = opts_.login;
+        login.device_id += index;
+
+        auto link = std::make_shared<connection> (opts_.address, login, published_);
+        auto authenticated = link->authenticate ();
+
+        if (authenticated.wait_for (AUTHENTICATE_TIMEOUT) != std::future_status::ready)
+            link->shutdown ();
+
+        return link;
+    }
+
+    // least outstanding requests wins, which keeps pipelines short on every connection
+
+    std::shared_ptr<connection> pool::pick (uint64_t avoid_device)
+    {
+        std::lock_guard<std::mutex> lck {lock_};
+        std::shared_ptr<connection> best;
+
+        for (auto const &link : connections_)
+        {
+            bool usable = link->is_ready () && link->device_id () != avoid_device;
+            if (usable && (!best || link->outstanding () < best->outstanding ()))
+                best = link;
+        }
+
+        return best;
+    }
+
+    void pool::refresh_index (uint16_t dataset_id, handler<msg::refresh_index_response> done)
+    {
+        auto link = pick ();
+        if (link) link->refresh_index (dataset_id, done);
+        else reject (done, std::errc::not_connected);
+    }
+
+    void pool::sync (uint64_t content_id, uint16_t dataset_id, handler<sync_result> done)
+    {
+        uint64_t owner = 0;
+        {
+            std::lock_guard<std::mutex> lck {lock_};
+            auto found = owners_.find (content_id);
+            if (found != std::end (owners_)) owner = found->second;
+        }
+
+        // the server never forwards a sync back to the device that owns the content
+        auto link = pick (owner);
+        if (link) link->sync (content_id, dataset_id, done);
+        else reject (done, std::errc::not_connected);
+    }
+
+    void pool::ping (handler<msg::ping> done)
+    {
+        auto link = pick ();
+        if (link) link->ping (done);
+        else reject (done, std::errc::not_connected);
+    }
+
+    std::future<msg::refresh_index_response> pool::refresh_index (uint16_t dataset_id)
+    {
+        auto completion = make_completion<msg::refresh_index_response> ();
+        refresh_index (dataset_id, completion.first);
+        return std::move (completion.second);
+    }
+
+    std::future<sync_result> pool::sync (uint64_t content_id, uint16_t dataset_id)
+    {
+        auto completion = make_completion<sync_result> ();
+        sync (content_id, dataset_id, completion.first);
+        return std::move (completion.second);
+    }
+
+    std::future<msg::ping> pool::ping ()
+    {
+        auto completion = make_completion<msg::ping> ();
+        ping (completion.first);
+        return std::move (completion.second);
+    }
+
+    std::error_code pool::publish (uint16_t dataset_id, std::string const &description,
+            std::string const &bytes, uint64_t &content_id)
+    {
+        content_id = util::generate_guid63 (bytes);
+        {
+            std::lock_guard<std::mutex> lck {published_->lock};
+            published_->items[content_id] = bytes;
+        }
+
+        std::shared_ptr<connection> link;
+        {
+            std::lock_guard<std::mutex> lck {lock_};
+            link = connections_.front ();
+            owners_[content_id] = link->device_id ();
+        }
+
+        if (!link->is_ready ())
+            return std::make_error_code (std::errc::not_connected);
+
+        content::node node {content_id, {"text/plain"}, description};
+        return link->notify (dataset_id, node);
+    }
+
+    // a connection is replaced once it closed or stayed silent through several pings, the
+    // replacement keeps the same device_id so content published through it stays reachable
+
+    void pool::check_health ()
+    {
+        auto deadline = opts_.ping_interval * HEALTH_MISSED_PINGS;
+        std::unique_lock<std::mutex> lck {health_lock_};
+
+        while (!health_wake_.wait_for (lck, opts_.ping_interval, [this] { return stopping_; }))
+        {
+            lck.unlock ();
+
+            for (size_t i = 0; i < opts_.connections; ++i)
+            {
+                std::shared_ptr<connection> link;
+                {
+                    std::lock_guard<std::mutex> guard {lock_};
+                    link = connections_[i];
+                }
+
+                bool silent = connection::clock::now () - link->last_heard () > deadline;
+
+                if (link->is_ready () && !silent)
+                    link->ping ([] (std::error_code const &, msg::ping const &) {});
+                else
+                {
+                    link->shutdown ();
+                    auto replacement = connect (i);
+
+                    std::lock_guard<std::mutex> guard {lock_};
+                    connections_[i] = replacement;
+                }
+            }
+
+            lck.lock ();
+        }
+    }
+}
@@ -0,0 +1,205 @@
+#ifndef _CLIENT_HPP_
+#define _CLIENT_HPP_
+
+#include "standard.hpp"
+
+#include "content.hpp"
+#include "buffer.hpp"
+#include "socket.hpp"
+#include "message.hpp"
+
+#include <deque>
+#include <future>
+#include <functional>
+#include <condition_variable>
+
+namespace client {
+
+    struct credentials
+    {
+        uint64_t user_id = 0;
+        uint64_t device_id = 0;
+        uint64_t secret = 0;
+
+        credentials () = default;
+        credentials (uint64_t user_id, uint64_t device_id, uint64_t secret) :
+            user_id {user_id}, device_id {device_id}, secret {secret} {}
+    };
+
+    struct sync_result
+    {
+        msg::sync_response response;
+        std::vector<uint8_t> content;
+    };
+
+    // content this client serves when the server forwards another device's sync request
+    struct catalog
+    {
+        std::mutex lock;
+        std::map<uint64_t, std::string> items;  // content_id -> bytes
+    };
+
+    // completion handlers run on the connection's reader thread, keep them short
+    template <typename Response>
+    using handler = std::function<void (std::error_code const &, Response const &)>;
+
+    // ----- Connection
+
+    // one persistent, authenticated socket with its own reader thread; requests are written
+    // back to back without waiting on earlier responses and matched up as responses arrive:
+    //  - pings carry a sequence number in their token which the server echoes back
+    //  - sync responses are matched on content_id, they arrive whenever the owner replies
+    //  - everything else is answered in order per connection, so each type is a fifo
+
+    class connection : public msg::receiver
+    {
+        public:
+            using clock = std::chrono::steady_clock;
+
+        public:
+            connection (std::string const &address, credentials const &login,
+                    std::shared_ptr<catalog> published = nullptr);
+            ~connection ();
+
+            connection (connection const &) = delete;
+            connection &operator= (connection const &) = delete;
+
+        public:
+            bool is_ready () const;
+            uint64_t token () const { return token_; }
+            uint64_t device_id () const { return login_.device_id; }
+            size_t outstanding () const { return outstanding_; }
+            clock::time_point last_heard () const;
+
+        public:
+            void authenticate (handler<msg::authenticate_response> done);
+            void refresh_index (uint16_t dataset_id, handler<msg::refresh_index_response> done);
+            void sync (uint64_t content_id, uint16_t dataset_id, handler<sync_result> done);
+            void ping (handler<msg::ping> done);
+            std::error_code notify (uint16_t dataset_id, content::node const &node);
+
+        public:
+            std::future<msg::authenticate_response> authenticate ();
+            std::future<msg::refresh_index_response> refresh_index (uint16_t dataset_id);
+            std::future<sync_result> sync (uint64_t content_id, uint16_t dataset_id);
+            std::future<msg::ping> ping ();
+
+        public:
+            void shutdown ();
+
+        protected:
+            void on_receive (net::socket &socket, msg::authenticate_request const &msg) override {} // server-side
+            void on_receive (net::socket &socket, msg::refresh_index_request const &msg) override {} // server-side
+            void on_receive (net::socket &socket, msg::notify_available_request const &msg) override {}
+
+            void on_receive (net::socket &socket, msg::authenticate_response const &msg) override;
+            void on_receive (net::socket &socket, msg::refresh_index_response const &msg) override;
+            void on_receive (net::socket &socket, msg::sync_request const &msg) override;
+            void on_receive (net::socket &socket, msg::sync_response const &msg) override;
+            void on_receive (net::socket &socket, msg::ping const &msg) override;
+
+        protected:
+            void on_interrupt (net::socket &socket) override;
+            void on_error (net::socket &socket) override;
+
+        protected:
+            void on_accept (net::socket &socket) override {}
+            void on_close (net::socket &socket) override;
+
+        private:
+            template <typename Message, typename Response, typename Enlist>
+            void submit (Message const &message, handler<Response> const &done, Enlist enlist);
+
+            void run ();
+            void close_link ();
+            void fail_pending (std::error_code const &error);
+
+        private:
+            net::socket socket_;
+            credentials login_;
+            std::shared_ptr<catalog> published_;
+
+            std::atomic<uint64_t> token_ {0};
+            std::atomic<size_t> outstanding_ {0};
+            std::atomic<uint64_t> sequence_ {0};
+            std::atomic<clock::rep> last_heard_ {0};
+            std::error_code failed_;                // set once the link is gone, rejects new requests
+
+            std::mutex link_lock_;                  // orders shutdown against close, handles get reused
+            std::mutex send_lock_;                  // serializes frames onto the socket
+            std::mutex pending_lock_;               // guards failed_ and the pending tables below
+
+            std::deque<handler<msg::authenticate_response>> authenticates_;
+            std::deque<handler<msg::refresh_index_response>> refreshes_;
+            std::multimap<uint64_t, handler<sync_result>> syncs_;           // content_id -> waiting
+            std::map<uint64_t, handler<msg::ping>> pings_;                  // sequence -> waiting
+
+            std::thread reader_;
+    };
+
+    // ----- Pool
+
+    struct options
+    {
+        std::string address;
+        credentials login;                      // connection i authenticates as device_id + i
+        size_t connections = 4;
+        std::chrono::milliseconds ping_interval {1000}; // zero disables health checks
+    };
+
+    // fixed set of persistent connections, requests go to the ready connection with the
+    // fewest outstanding requests; a health thread pings every connection each interval
+    // and replaces any that closed or did not answer the previous ping in time
+
+    class pool
+    {
+        public:
+            explicit pool (options const &opts);
+            ~pool ();
+
+            pool (pool const &) = delete;
+            pool &operator= (pool const &) = delete;
+
+        public:
+            size_t size () const { return opts_.connections; }
+            size_t ready () const;
+            std::error_code error () const;
+
+        public:
+            void refresh_index (uint16_t dataset_id, handler<msg::refresh_index_response> done);
+            void sync (uint64_t content_id, uint16_t dataset_id, handler<sync_result> done);
+            void ping (handler<msg::ping> done);
+
+        public:
+            std::future<msg::refresh_index_response> refresh_index (uint16_t dataset_id);
+            std::future<sync_result> sync (uint64_t content_id, uint16_t dataset_id);
+            std::future<msg::ping> ping ();
+
+        public:
+            // make content available through the first connection, the pool serves sync
+            // requests for it and routes its own syncs of it through the other connections
+            std::error_code publish (uint16_t dataset_id, std::string const &description,
+                    std::string const &bytes, uint64_t &content_id);
+
+        private:
+            std::shared_ptr<connection> pick (uint64_t avoid_device = 0);
+            std::shared_ptr<connection> connect (size_t index);
+            void check_health ();
+
+        private:
+            options opts_;
+            std::shared_ptr<catalog> published_;
+
+            mutable std::mutex lock_;
+            std::vector<std::shared_ptr<connection>> connections_;
+            std::map<uint64_t, uint64_t> owners_;   // content_id -> device_id
+            std::error_code error_;
+
+            std::mutex health_lock_;
+            std::condition_variable health_wake_;
+            bool stopping_ = false;
+            std::thread health_;
+    };
+}
+
+#endif
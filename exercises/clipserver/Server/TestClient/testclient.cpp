@@ -5,9 +5,14 @@
 #include "message.hpp"
 #include "content.hpp"
 #include "util.hpp"
+#include "client.hpp"
+#include "metrics.hpp"
 
 #include <json/json.h>
 
+#include <cmath>
+#include <cstdlib>
+
 using std::cout;
 using std::endl;
 
@@ -86,6 +91,11 @@ namespace app
             auto size = msg.content.size;
 
             std::cout << "expecting " << content_id << " of size " << size << std::endl;
+
+            // content follows the response as a raw block, drain it in bounded pieces
+            uint8_t blockmem [4096];
+            std::error_code error = msg::relay (socket, {}, size, {blockmem, sizeof (blockmem)});
+            if (error) on_error (socket);
         }
 
         void on_interrupt (net::socket &socket) override
@@ -182,15 +192,175 @@ namespace ui
     }
 }
 
+namespace bench
+{
+    using clock = std::chrono::steady_clock;
+
+    struct mix 
+    {
+        unsigned refresh = 100;
+        unsigned ping = 0;
+        unsigned sync = 0;
+
+        mix () = default;
+        mix (unsigned refresh, unsigned ping, unsigned sync) :
+            refresh {refresh}, ping {ping}, sync {sync} {}
+
+        unsigned total () const { return refresh + ping + sync; }
+    };
+
+    // parses weights like "refresh=90,ping=9,sync=1", unnamed kinds get no share
+    bool try_parse_mix (std::string const &text, mix &weights)
+    {
+        std::string entry;
+        std::stringstream stream (text);
+        weights = {0, 0, 0};
+        bool proceed = true;
+
+        while (proceed && std::getline (stream, entry, ','))
+        {
+            auto split = entry.find ('=');
+            proceed = split != std::string::npos;
+
+            auto name = proceed? entry.substr (0, split) : "";
+            auto weight = proceed? (unsigned) std::strtoul (entry.c_str() + split + 1, nullptr, 10) : 0;
+
+            if (name == "refresh") weights.refresh = weight;
+            else if (name == "ping") weights.ping = weight;
+            else if (name == "sync") weights.sync = weight;
+            else proceed = false;
+        }
+
+        return proceed && weights.total () > 0;
+    }
+
+    double percentile (std::vector<int64_t> const &sorted, double fraction)
+    {
+        if (sorted.empty ()) return 0.0;
+        auto rank = (size_t) std::ceil (fraction * sorted.size ());
+        return sorted [std::max<size_t> (rank, 1) - 1] / 1000.0;
+    }
+
+    // open loop: request i is due at start + i / rate whether or not earlier ones finished,
+    // and latency counts from when it was due so a stalled server can't hide its own backlog
+
+    int run (std::string const &address, size_t connections, size_t rate, size_t seconds, mix const &weights)
+    {
+        size_t const total = rate * seconds;
+        auto const interval = std::chrono::nanoseconds {1000000000 / std::max<size_t> (rate, 1)};
+        auto const drain = std::chrono::seconds {5};
+        int64_t const LOST = -1;
+
+        std::unique_ptr<std::atomic<int64_t>[]> latencies {new std::atomic<int64_t> [total]};
+        std::atomic<size_t> completed {0}, failed {0};
+        for (size_t i = 0; i < total; ++i) latencies[i] = LOST;
+
+        client::options opts;
+        opts.address = address;
+        opts.login = {1, 1000, 3};
+        opts.connections = connections;
+
+        client::pool pool {opts};
+        uint64_t content_id = 0;
+        std::error_code error = pool.error ();
+
+        if (!error && weights.sync > 0)
+        {
+            error = pool.publish (content::dataset::CLIPBOARD, "bench", std::string (1024, 'x'), content_id);
+            if (connections < 2) error = std::make_error_code (std::errc::invalid_argument);
+        }
+
+        auto start = clock::now () + std::chrono::milliseconds {100};
+
+        for (size_t i = 0; !error && i < total; ++i)
+        {
+            auto due = start + interval * i;
+            std::this_thread::sleep_until (due);
+
+            auto record = [&latencies, &completed, &failed, i, due] (std::error_code const &error)
+            {
+                if (error) ++failed;
+                else latencies[i] = std::chrono::duration_cast<std::chrono::nanoseconds> (clock::now () - due).count ();
+                ++completed;
+            };
+
+            // interleave kinds evenly by weight rather than at random, keeps runs repeatable
+            auto slot = i % weights.total ();
+
+            if (slot < weights.refresh)
+                pool.refresh_index (content::dataset::CLIPBOARD, 
+                        [record] (std::error_code const &error, msg::refresh_index_response const &) { record (error); });
+            else if (slot < weights.refresh + weights.ping)
+                pool.ping ([record] (std::error_code const &error, msg::ping const &) { record (error); });
+            else
+                pool.sync (content_id, content::dataset::CLIPBOARD, 
+                        [record] (std::error_code const &error, client::sync_result const &) { record (error); });
+        }
+
+        auto elapsed = clock::now () - start;
+        auto deadline = clock::now () + drain;
+        while (!error && completed < total && clock::now () < deadline)
+            std::this_thread::sleep_for (std::chrono::milliseconds {10});
+
+        if (error)
+        {
+            std::cout << "bench: " << error.message () << std::endl;
+            return 1;
+        }
+
+        std::vector<int64_t> sorted;
+        for (size_t i = 0; i < total; ++i)
+            if (latencies[i] != LOST) sorted.push_back (latencies[i]);
+
+        std::sort (std::begin (sorted), std::end (sorted));
+
+        auto achieved = total / std::chrono::duration<double> (elapsed).count ();
+        auto lost = total - sorted.size () - failed;
+
+        std::cout << "connections: " << connections << ", target: " << rate << "/s, achieved: " 
+            << (size_t) achieved << "/s" << std::endl;
+        std::cout << "requests: " << total << ", completed: " << sorted.size () 
+            << ", failed: " << failed << ", lost: " << lost << std::endl;
+        std::cout << "latency (us) p50: " << percentile (sorted, 0.50) 
+            << " p99: " << percentile (sorted, 0.99) 
+            << " p999: " << percentile (sorted, 0.999) 
+            << " max: " << percentile (sorted, 1.0) << std::endl;
+
+        return 0;
+    }
+}
+
 int main (int argc, char **argv)
 {
-    if (argc != 2)
+    if (argc != 2 && !(argc >= 6 && argc <= 7 && std::string {argv[2]} == "bench"))
     {
         std::cout << "usage: <" << argv[0] << "> <ADDRESS>:<PORT>" << std::endl;
+        std::cout << "       <" << argv[0] << "> <ADDRESS>:<PORT> bench <CONNECTIONS> <RATE> <SECONDS> [refresh=N,ping=N,sync=N]" << std::endl;
         return 0;
     }
 
     sys::socket::system sockets; // initializes socket system
+
+    metrics::options reporting;
+    reporting.trace_every = 0;
+    metrics::start (reporting);
+
+    if (argc > 2)
+    {
+        bench::mix weights;
+        if (argc == 7 && !bench::try_parse_mix (argv[6], weights))
+        {
+            std::cout << "bench: bad request mix " << argv[6] << std::endl;
+            return 1;
+        }
+
+        int result = bench::run (argv[1], std::strtoul (argv[3], nullptr, 10), 
+                std::strtoul (argv[4], nullptr, 10), std::strtoul (argv[5], nullptr, 10), weights);
+
+        metrics::stop ();
+        return result;
+    }
+
     net::socket connector {net::socket::type::TCP};
     app::receiver receiver;
     std::thread thread;
@@ -227,5 +397,6 @@ int main (int argc, char **argv)
             std::cout << command << ": bad arguments" << std::endl;
     }
     
+    metrics::stop ();
 	return 0;
 }
@@ -1,9 +1,31 @@
+// Delegates: core::delegate (core/delegate.hpp) against std::function and
+// virtual calls, and a signal of delegates that are removed by value
+//
+// g++ -std=c++17 -O2 -I.. delegates.cpp [-DDELEGATE_HANDLERS]
+//
+// delegates           signal demo
+// delegates bench     call and bind costs, then core::Signal handlers, which
+//                     are std::function, or core::delegate when built with
+//                     DELEGATE_HANDLERS: run both builds to compare
+
 #include <iostream>
 #include <functional>
 #include <vector>
+#include <array>
+#include <map>
+#include <set>
+#include <string>
+#include <chrono>
 #include <cstring>
 #include <cassert>
 
+#ifdef DELEGATE_HANDLERS
+#define CORE_SIGNAL_HANDLER core::delegate
+#endif
+
+#include "core/delegate.hpp"
+#include "core/Signal.hpp"
+
 using namespace std;
 
 struct Test
@@ -16,174 +38,22 @@ struct Test
     int count = 0;
 };
 
-namespace core
+namespace util
 {
-    template <typename ...Args>
-    class delegate
-    {
-        private:
-            class dispatch
-            {
-                public:
-                    operator bool () const
-                    {
-                        return 
-                            call_ != nullptr && 
-                            copy_ != nullptr && 
-                            destroy_ != nullptr;
-                    }
-
-                    bool operator== (dispatch const &other) const
-                    {
-                        return 
-                            call_ != other.call_ && 
-                            copy_ != other.copy_ && 
-                            destroy_ != other.destroy_;
-                    }
-
-                    inline void call (void *storage, Args... args)
-                    {
-                        (*call_) (storage, args...);
-                    }
-
-                    inline void copy (void const *storage, void *destination)
-                    {
-                        (*copy_) (storage, destination);
-                    }
-
-                    inline void destroy (void *storage)
-                    {
-                        (*destroy_) (storage);
-                    }
-
-                    void clear ()
-                    {
-                        call_ = nullptr; 
-                        copy_ = nullptr; 
-                        destroy_ = nullptr;
-                    }
-
-                    template <typename Functor>
-                    void initialize ()
-                    {
-                        call_ = &dispatch::functor_call<Functor>;
-                        copy_ = &dispatch::functor_copy<Functor>;
-                        destroy_ = &dispatch::functor_destroy<Functor>;
-                    }
-
-                private:
-                    template <typename Functor>
-                    static void functor_call (void *storage, Args... args)
-                    {
-                        auto typed_storage = reinterpret_cast<Functor *> (storage);
-                        (*typed_storage) (args...);
-                    }
-
-                    template <typename Functor>
-                    static void functor_copy (void const *storage, void *destination)
-                    {
-                        auto typed_storage = reinterpret_cast<Functor const *> (storage);
-                        new (destination) Functor (*typed_storage);
-                    }
-
-                    template <typename Functor>
-                    static void functor_destroy (void *storage)
-                    {
-                        auto typed_storage = reinterpret_cast<Functor *> (storage);
-                        typed_storage->~Functor();
-                    }
-
-                private:
-                    void (*call_) (void *storage, Args... args) = nullptr;
-                    void (*copy_) (void const *storage, void *dst) = nullptr;
-                    void (*destroy_) (void *storage) = nullptr;
-            };
-
-            // Tune memory requirements for your application or platform
-            using storage = std::aligned_storage<24, 8>::type; 
-
-        public:
-
-            delegate () = default;
-
-            delegate (delegate const &other) :
-                dispatch_ {other.dispatch_}
-            {
-                dispatch_.copy (&other.storage_, &storage_);
-            }
-
-            template <typename Functor>
-            delegate (Functor functor)
-            {
-                static_assert (sizeof (functor) <= sizeof (storage_), 
-                        "functor too large for fixed storage");
-
-                dispatch_.template initialize<Functor> ();
-                dispatch_.copy (&functor, &storage_);
-            }
-
-            ~delegate ()
-            {
-                dispatch_.destroy (&storage_);
-            }
-
-        public:
-            delegate &operator= (std::nullptr_t)
-            {
-                dispatch_.clear ();
-                return *this;
-            }
-
-            delegate &operator= (delegate const &other)
-            {
-                dispatch_.copy (&other.storage_, &storage_);
-                return *this;
-            }
-
-            template <typename Functor>
-            delegate &operator= (Functor functor)
-            {
-                static_assert (sizeof (functor) <= sizeof (storage_), 
-                        "functor too large for fixed storage");
-
-                dispatch_.template initialize<Functor> ();
-                dispatch_.copy (&functor, &storage_);
-                return *this;
-            }
-
-        public:
-            operator bool () const 
-            { 
-                return dispatch_;
-            }
-
-            bool operator== (delegate const &other) const
-            {
-                return dispatch_ == other.dispatch_;
-            }
-
-            void operator() (Args... args)
-            {
-                dispatch_.call (&storage_, args...);
-            }
-
-        private:
-            dispatch dispatch_;
-            storage  storage_;
-    };
-
     template <typename ...Args>
     class signal
     {
         public:
+            using delegate = core::delegate<void (Args...)>;
+
             class slot
             {
                 friend class signal;
 
                 public:
-                    operator bool () const 
-                    { 
-                        return signal_ != nullptr && index_ != -1; 
+                    operator bool () const
+                    {
+                        return signal_ != nullptr && index_ != -1;
                     }
 
                 private:
@@ -215,29 +85,28 @@ namespace core
             };
 
         public:
-            template <typename Functor>
-            slot operator+= (Functor functor)
+            slot operator+= (delegate incoming)
             {
-                slot incoming;
+                slot attached;
 
                 int size = delegates.size();
                 for (int index = 0; index < size; ++index)
                 {
                     if (!delegates[index])
                     {
-                        delegates[index] = functor;
-                        incoming.attach (this, index);
+                        delegates[index] = incoming;
+                        attached.attach (this, index);
                         break;
                     }
                 }
 
-                if (!incoming)
+                if (!attached)
                 {
-                    delegates.emplace_back (functor);
-                    incoming.attach (this, size);
+                    delegates.push_back (incoming);
+                    attached.attach (this, size);
                 }
 
-                return incoming;
+                return attached;
             }
 
             void operator-= (slot &outgoing)
@@ -250,6 +119,20 @@ namespace core
                 }
             }
 
+            // without a slot: the first delegate calling the same function
+            // on the same object
+            void operator-= (delegate const &outgoing)
+            {
+                for (auto &next : delegates)
+                {
+                    if (next == outgoing)
+                    {
+                        next = nullptr;
+                        break;
+                    }
+                }
+            }
+
             void operator() (Args... args)
             {
                 for (auto &next : delegates)
@@ -257,7 +140,7 @@ namespace core
             }
 
         private:
-            std::vector<delegate<Args...>> delegates;
+            std::vector<delegate> delegates;
     };
 }
 
@@ -266,22 +149,179 @@ void dummy (int value)
     cout << "dummy (" << value << ")" << endl;
 }
 
-int main()
+// bound at compile time
+Test global;
+constexpr auto to_global = core::bind<&Test::foo> (global);
+constexpr core::delegate<void (int)> to_dummy {dummy};
+
+static_assert (to_global && to_dummy && !(to_global == core::delegate<void (int)> {}),
+        "delegates are constexpr");
+
+// ==== Benchmarks
+
+using clock_type = std::chrono::steady_clock;
+
+// keeps the optimizer from seeing through `object`
+template <typename Type>
+void escape (Type &object)
+{
+    asm volatile ("" : : "g" (&object) : "memory");
+}
+
+template <typename Body>
+void measure (char const *name, size_t calls, Body body)
+{
+    auto start = clock_type::now ();
+    for (size_t i = 0; i < calls; ++i)
+        body (i);
+    std::chrono::duration<double, std::nano> elapsed = clock_type::now () - start;
+
+    cout << name << elapsed.count () / calls << " ns" << endl;
+}
+
+struct Base
+{
+    virtual ~Base () = default;
+    virtual void on (int value) = 0;
+};
+
+// with one override GCC calls it directly after comparing the vtable, which
+// the indirect calls of the other callables do not get
+struct Listener : Base
+{
+    __attribute__((noinline)) void on (int value) override
+    {
+        total += value;
+    }
+
+    int total = 0;
+};
+
+int free_total = 0;
+
+void on_free (int value)
+{
+    free_total += value;
+}
+
+size_t const CALLS = 100000000;
+size_t const TARGETS = 16;
+
+void calls ()
 {
+    cout << "call through one of " << TARGETS << " callables" << endl;
+
+    std::array<Listener, TARGETS> listeners;
+    std::array<Base *, TARGETS> bases;
+    std::array<std::function<void (int)>, TARGETS> functions;
+    std::array<core::delegate<void (int)>, TARGETS> members, pointers, constants;
+
+    for (size_t i = 0; i < TARGETS; ++i)
+    {
+        auto &listener = listeners[i];
+        bases[i] = &listener;
+        functions[i] = [&listener] (int value) { listener.on (value); };
+        members[i] = core::bind<&Listener::on> (listener);
+        pointers[i] = &on_free;
+        constants[i] = core::delegate<void (int)>::bind<&on_free> ();
+    }
+    escape (bases);
+    escape (functions);
+    escape (members);
+    escape (pointers);
+    escape (constants);
+
+    measure ("  virtual                      ", CALLS, [&] (size_t i) { bases[i % TARGETS]->on (int (i)); });
+    measure ("  std::function, lambda        ", CALLS, [&] (size_t i) { functions[i % TARGETS] (int (i)); });
+    measure ("  delegate, bound member       ", CALLS, [&] (size_t i) { members[i % TARGETS] (int (i)); });
+    measure ("  delegate, function pointer   ", CALLS, [&] (size_t i) { pointers[i % TARGETS] (int (i)); });
+    measure ("  delegate, constant function  ", CALLS, [&] (size_t i) { constants[i % TARGETS] (int (i)); });
+
+    escape (listeners);
+    escape (free_total);
+}
+
+void binds ()
+{
+    cout << "bind, call and destroy a member callback with context" << endl;
+
+    Listener listener;
+    int scale = 3, offset = 1;
+
+    // three captures: past what libstdc++ keeps without allocating
+    measure ("  std::function                ", CALLS / 10, [&] (size_t i) {
+        std::function<void (int)> function {[&listener, &scale, &offset] (int value) {
+            listener.on (value * scale + offset);
+        }};
+        escape (function);
+        function (int (i));
+    });
+
+    // the context is the object: the delegate points at it
+    measure ("  delegate                     ", CALLS / 10, [&] (size_t i) {
+        auto delegate = core::bind<&Listener::on> (listener);
+        escape (delegate);
+        delegate (int (i));
+    });
+
+    escape (listener);
+}
+
+void signals ()
+{
+#ifdef DELEGATE_HANDLERS
+    cout << "core::Signal handlers: core::delegate" << endl;
+#else
+    cout << "core::Signal handlers: std::function" << endl;
+#endif
+
+    std::array<Listener, 4> listeners;
+    core::Signal<int> signal;
+
+    measure ("  when + remove                ", CALLS / 10, [&] (size_t i) {
+        auto handle = signal.when (core::bind<&Listener::on> (listeners[i & 3]));
+        signal.remove (handle);
+    });
+
+    for (auto &listener : listeners)
+        signal.when (core::bind<&Listener::on> (listener));
+
+    measure ("  emit to 4 handlers           ", CALLS / 10, [&] (size_t i) { signal (int (i)); });
+
+    escape (listeners);
+}
+
+int main (int argc, char **argv)
+{
+    if (argc > 1 && std::strcmp (argv[1], "bench") == 0)
+    {
+        calls ();
+        binds ();
+        signals ();
+        return 0;
+    }
+
     Test test;
 
-    core::signal<int> signal;
-    core::signal<int>::slot last;
+    util::signal<int> signal;
+    util::signal<int>::slot last;
 
     for (int i=0; i < 3; ++i)
     {
-        last = (signal += [&test] (int value) { test.foo (value); });
+        last = (signal += core::bind<&Test::foo> (test));
     }
 
     signal += dummy;
+    signal += to_global;
 
     signal (5);
+
+    signal -= last;
+    signal -= to_dummy;
     signal (6);
+
+    signal -= core::bind<&Test::foo> (test);
+    signal -= core::bind<&Test::foo> (test);
     signal (7);
 
     return 0;
@@ -0,0 +1,214 @@
+// Callback storage: std::function against core::mofunction, core::inplace_function
+// and core::function_ref (mofunction.hpp), then as core::Signal handlers,
+// core::Executor::Work items and Publisher subscribers
+//
+// g++ -std=c++20 -O2 -I.. function-benchmark.cpp [-DINPLACE_HANDLERS]
+//
+// core::Signal and core::Executor take their handler types from macros, so
+// the second half measures std::function, or core::inplace_function when built
+// with INPLACE_HANDLERS: run both builds to compare.
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <new>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "mofunction.hpp"
+
+#ifdef INPLACE_HANDLERS
+template <typename Signature>
+using inplace_handler = core::inplace_function<Signature, 4 * sizeof(void*)>;
+#define CORE_SIGNAL_HANDLER inplace_handler
+#define CORE_EXECUTOR_WORK inplace_handler<void()>
+#endif
+
+#include "core/Executor.hpp"
+#include "core/Signal.hpp"
+
+// every allocation in the process
+static size_t allocations = 0;
+
+// noinline, or GCC sees malloc() paired with operator delete and warns
+__attribute__((noinline)) void* operator new(size_t size) {
+  allocations++;
+  if (void* p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc{};
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept {
+  std::free(p);
+}
+
+// keeps the optimizer from eliding `object` altogether
+template <typename Type>
+void escape(Type& object) {
+  asm volatile("" : : "g"(&object) : "memory");
+}
+
+template <typename Body>
+void measure(const char* name, size_t calls, Body body) {
+  size_t before = allocations;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < calls; ++i) {
+    body(i);
+  }
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::cout << name << elapsed.count() / calls << " ns, "
+            << double(allocations - before) / calls << " allocations\n";
+}
+
+// ==== Function types
+
+// construct + invoke + destroy of a lambda capturing three pointers
+template <typename Function>
+void construct_and_call(const char* name) {
+  int a = 1, b = 2, c = 3;
+  unsigned sink = 0;
+  measure(name, 10'000'000, [&](size_t i) {
+    auto lambda = [&a, &b, &c](int x) { return x + a + b + c; };
+    Function f(lambda);  // a function_ref must not outlive it
+    escape(f);
+    sink += f(int(i));
+  });
+  escape(sink);
+}
+
+// a synchronous callback parameter, the case function_ref is for
+template <typename Callback>
+__attribute__((noinline)) int for_each_value(const std::vector<int>& values,
+                                             Callback callback) {
+  int sum = 0;
+  for (int value : values) {
+    sum += callback(value);
+  }
+  return sum;
+}
+
+template <typename Callback>
+void pass_callback(const char* name) {
+  std::vector<int> values(16, 1);
+  int a = 1, b = 2, c = 3;
+  unsigned sink = 0;
+  measure(name, 10'000'000, [&](size_t) {
+    auto lambda = [&a, &b, &c](int x) { return x + a + b + c; };
+    sink += for_each_value<Callback>(values, lambda);
+  });
+  escape(sink);
+}
+
+// ==== Drop-in handlers
+
+template <typename M, typename Subscriber>
+struct Publisher {
+  void publish(M m) {
+    for (auto&& s : subscribers) {
+      s(m);
+    }
+  }
+
+  std::vector<Subscriber> subscribers;
+};
+
+// Handlers below capture three words, as a member callback with some context
+// would: libstdc++'s std::function only keeps up to two inline.
+
+void signals() {
+  // connected and removed over and over, as a short-lived observer would
+  core::Signal<int> signal;
+  int received = 0;
+  int* counter = &received;
+  measure("  Signal when + remove            ", 10'000'000, [&](size_t i) {
+    auto handle = signal.when([counter, &signal, i](int x) { *counter ^= x + int(i); });
+    signal.remove(handle);
+  });
+
+  for (size_t i = 0; i < 4; ++i) {
+    signal.when([counter, &signal, i](int x) { *counter ^= x + int(i); });
+  }
+  measure("  Signal emit to 4 handlers       ", 10'000'000,
+          [&](size_t i) { signal(int(i & 0xff)); });
+  escape(received);
+}
+
+void executor_work() {
+  // the queue of a simple executor: scheduled, then run and released
+  std::vector<core::Executor::Work> queue;
+  queue.reserve(1024);
+  int done = 0;
+  int* counter = &done;
+  measure("  Executor::Work schedule + run   ", 10'000'000 / 1024 * 1024,
+          [&](size_t i) {
+            queue.emplace_back([counter, &queue, i] { *counter += int(i & 1); });
+            if (queue.size() == 1024) {
+              for (auto& work : queue) {
+                work();
+              }
+              queue.clear();
+            }
+          });
+  escape(done);
+}
+
+template <typename Subscriber>
+void publisher(const char* name) {
+  int received = 0;
+  int* counter = &received;
+  measure(name, 1'000'000, [&](size_t) {
+    Publisher<int, Subscriber> publisher;
+    publisher.subscribers.reserve(4);
+    for (size_t i = 0; i < 4; ++i) {
+      publisher.subscribers.emplace_back(
+          [counter, &publisher, i](int x) { *counter ^= x + int(i); });
+    }
+    for (int i = 0; i < 16; ++i) {
+      publisher.publish(i);
+    }
+  });
+  escape(received);
+}
+
+int main() {
+  std::cout << "sizeof std::function " << sizeof(std::function<int(int)>)
+            << ", mofunction " << sizeof(core::mofunction<int(int)>)
+            << ", inplace_function " << sizeof(core::inplace_function<int(int)>)
+            << ", function_ref " << sizeof(core::function_ref<int(int)>) << "\n";
+
+  std::cout << "\nconstruct + call + destroy, three captures\n";
+  construct_and_call<std::function<int(int)>>("  std::function                   ");
+  construct_and_call<core::mofunction<int(int)>>("  core::mofunction                ");
+  construct_and_call<core::inplace_function<int(int)>>("  core::inplace_function          ");
+  construct_and_call<core::function_ref<int(int)>>("  core::function_ref              ");
+
+  std::cout << "\nsynchronous callback parameter, 16 calls\n";
+  pass_callback<const std::function<int(int)>&>("  const std::function&            ");
+  pass_callback<core::function_ref<int(int)>>("  core::function_ref              ");
+
+  std::cout << "\nPublisher of 4 subscribers, 16 messages\n";
+  publisher<std::function<void(int)>>("  std::function                   ");
+  publisher<core::inplace_function<void(int)>>("  core::inplace_function          ");
+
+#ifdef INPLACE_HANDLERS
+  std::cout << "\ncore handlers: inplace_function\n";
+#else
+  std::cout << "\ncore handlers: std::function\n";
+#endif
+  signals();
+  executor_work();
+}
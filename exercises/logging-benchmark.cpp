@@ -0,0 +1,132 @@
+// ns per log call: core/binlog.hpp backend vs the LOG4CXX formatting path
+//
+// g++ -std=c++20 -O2 -I.. logging-benchmark.cpp -pthread [-llog4cxx]
+//
+// Without log4cxx installed the second column is a stand-in doing the same work
+// on the calling thread as LOG4CXX_DEBUG: format into a stream, then hand the
+// string to a locked appender (which here discards it)
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define LOG_BACKEND_BINARY
+#include "core/logging.hpp"
+
+#if __has_include(<log4cxx/logger.h>)
+#define HAVE_LOG4CXX
+#include <log4cxx/logger.h>
+#include <log4cxx/appenderskeleton.h>
+#include <log4cxx/helpers/pool.h>
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+#ifdef HAVE_LOG4CXX
+class NullAppender : public log4cxx::AppenderSkeleton {
+ public:
+  void append(const log4cxx::spi::LoggingEventPtr &, log4cxx::helpers::Pool &) override {}
+  void close() override {}
+  bool requiresLayout() const override { return false; }
+};
+
+log4cxx::LoggerPtr logger = [] {
+  auto logger = log4cxx::Logger::getLogger("bench");
+  logger->addAppender(log4cxx::AppenderPtr {new NullAppender});
+  logger->setLevel(log4cxx::Level::getDebug());
+  return logger;
+}();
+
+#define STREAM_LOG(...) \
+  LOG4CXX_DEBUG(logger, __FUNCTION__ << '[' << __LINE__ << ']' << ": " << PRINT_ARGS(__VA_ARGS__))
+#else
+std::mutex appender;
+size_t appended = 0;
+
+#define STREAM_LOG(...) \
+  do { \
+    std::ostringstream stream; \
+    stream << __FUNCTION__ << '[' << __LINE__ << ']' << ": " << PRINT_ARGS(__VA_ARGS__); \
+    std::lock_guard<std::mutex> lock {appender}; \
+    appended += stream.str().size(); \
+  } while (0)
+#endif
+
+struct Widget {
+  int id;
+  double weight;
+  std::string name;
+};
+
+// calls go in bursts the writer can keep up with (a full ring would make drops look
+// fast), only time spent inside the bursts is counted
+template <typename Body>
+double measure(size_t threads, size_t calls, Body body) {
+  const size_t burst = 256;
+  std::vector<Clock::duration> spent(threads);
+  std::vector<std::thread> workers;
+  for (size_t thread = 0; thread < threads; ++thread) {
+    workers.emplace_back([&, thread] {
+      Widget widget {7, 1.5, "sprocket"};
+      for (size_t call = 0; call < calls;) {
+        auto start = Clock::now();
+        for (auto end = std::min(calls, call + burst); call < end; ++call) {
+          body(widget, call);
+        }
+        spent[thread] += Clock::now() - start;
+        std::this_thread::sleep_for(std::chrono::milliseconds {1});
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  std::chrono::duration<double, std::nano> total {};
+  for (auto &elapsed : spent) {
+    total += elapsed;
+  }
+  return total.count() / (threads * calls);
+}
+
+int main(int argc, char *argv[]) {
+  size_t calls = argc > 1? std::stoul(argv[1]) : 200000;
+
+  auto &backend = core::binlog::Backend::instance();
+  backend.set_sink([](const core::binlog::Site &, core::binlog::Clock::time_point,
+                      const std::string &) {});
+
+  std::cout << "type_name<Widget>: " << type_name<Widget>() << "\n\n";
+  std::cout << "threads  binlog ns/call  "
+#ifdef HAVE_LOG4CXX
+            << "log4cxx ns/call  "
+#else
+            << "ostream ns/call  "
+#endif
+            << "dropped\n";
+
+  for (size_t threads : {1, 2, 4}) {
+    auto before = backend.dropped();
+    auto binary = measure(threads, calls, [](const Widget &widget, size_t call) {
+      LOG_ARGS(widget.id, widget.weight, widget.name, call);
+    });
+    backend.flush();
+
+    auto stream = measure(threads, calls, [](const Widget &widget, size_t call) {
+      STREAM_LOG(widget.id, widget.weight, widget.name, call);
+    });
+
+    std::cout << threads << "        "
+              << binary << "            "
+              << stream << "            "
+              << backend.dropped() - before << '\n';
+  }
+
+  backend.stop();
+  std::cout << "\nformatted " << backend.written() << " records\n";
+}
@@ -0,0 +1,95 @@
+/* benchmark.cpp -- deep logger hierarchies under multithreaded logging
+ *
+ *	g++ -std=c++14 -O2 benchmark.cpp logstream.cpp -pthread
+ */
+
+#include "logstream.hpp"
+#include "logmacro.hpp"
+#include "logiomanip.hpp"
+
+#include <chrono>
+#include <thread>
+
+//=============================================================================
+// streambuf that only counts what it is given
+
+class null_streambuf : public std::streambuf
+{
+    public:
+	null_streambuf () : count_ (0) {}
+	size_t count () const { return count_; }
+
+    protected:
+	std::streamsize xsputn (const char*, std::streamsize n) { count_ += n; return n; }
+	int_type overflow (int_type c) { ++count_; return c; }
+
+    private:
+	size_t count_;
+};
+
+typedef std::chrono::steady_clock clock_type;
+
+template <typename Body>
+double ns_per_call (size_t threads, size_t calls, Body body)
+{
+    std::vector <std::thread> workers;
+    clock_type::time_point start = clock_type::now();
+
+    for (size_t t = 0; t < threads; ++t)
+	workers.push_back (std::thread ([&] {
+	    for (size_t i = 0; i < calls; ++i)
+		body (i);
+	}));
+
+    for (size_t t = 0; t < threads; ++t)
+	workers[t].join();
+
+    std::chrono::duration <double, std::nano> elapsed = clock_type::now() - start;
+    return elapsed.count() / calls;
+}
+
+//=============================================================================
+int main (int argc, char* argv[])
+{
+    const size_t depth = 16;
+    const size_t calls = (argc > 1)? std::stoul (argv[1]) : 1000000;
+
+    null_streambuf sink;
+    logstream_factory factory (&sink, INFO);
+
+    // a logger at every level: root.l0.l1...l15
+    std::string path = "l0";
+    std::vector <logstream*> chain;
+    for (size_t i = 0; i < depth; ++i)
+    {
+	chain.push_back (&factory.get_logstream (path));
+	path += ".l" + std::to_string (i + 1);
+    }
+
+    logstream& leaf = *chain.back();
+    std::string leaf_path = leaf.name();
+
+    std::cout << "depth " << depth << ", " << calls << " calls per thread\n\n";
+    std::cout << "threads\tlookup\tdisabled\tenabled (ns/call)\n";
+
+    for (size_t threads = 1; threads <= 8; threads *= 2)
+    {
+	double lookup = ns_per_call (threads, calls / 10, [&] (size_t) {
+	    factory.get_logstream (leaf_path);
+	});
+
+	double disabled = ns_per_call (threads, calls, [&] (size_t i) {
+	    log_debug (leaf, "value " << i);
+	});
+
+	double enabled = ns_per_call (threads, calls / 10, [&] (size_t i) {
+	    log_info (leaf, "value " << i);
+	});
+
+	std::cout << threads << '\t' << lookup << '\t' << disabled
+	    << "\t\t" << enabled << '\n';
+    }
+
+    // a shared buffer is only written once however many ancestors accept the level
+    std::cout << "\nbytes written " << sink.count() << '\n';
+}
@@ -18,11 +18,6 @@ basic_logstream <C,T>& operator <<
 (basic_logstream <C,T>& out, 
  basic_logstream <C,T>& (*manip) (basic_logstream <C,T>&)) 
 { 
-    typedef std::basic_ostream <C,T> basic_ostream_type;
-
-    basic_logstream <C,T> *p = out.parent();
-    if (p) *p << manip;
-
     return manip (out);
 }
 
@@ -48,31 +48,37 @@ typedef basic_log_entry<wchar_t> wlog_entry;
 
 
 //-----------------------------------------------------------------------------
-// Forward all input to ostream if loggin at the given level
-// and forward to parent
+// Format the entry once and hand it to every sink accepting the level
 
 template <typename C, typename T>
-basic_logstream <C,T>& operator << 
-(basic_logstream <C,T>& out, const basic_log_entry <C,T>& entry)
+void log_write 
+(basic_logstream <C,T>& out, log_level_t level, const basic_log_entry <C,T>& entry)
 {
-    typedef std::basic_ostream <C,T> basic_ostream_type;
-    typedef typename basic_ostream_type::sentry sentry;
+    if (!out.enabled (level))
+	return;
 
-    basic_logstream <C,T> *p = out.parent();
-    if (p) *p << entry;
+    std::basic_ostringstream <C,T> text;
+    text << '[' << out.name() << ' ' << level << ']' 
+	<< '(' << entry.filename() << ' ' << entry.function() 
+	<< ':' << entry.linenum() << ')' << entry.str();
 
-    if ((out.context() >= out.level()) && sentry (out))
-	reinterpret_cast <basic_ostream_type&> 
-	    (out) << '[' << out.name() << ' ' << out.context() << ']' 
-	    << '(' << entry.filename() << ' ' << entry.function() 
-	    << ':' << entry.linenum() << ')' << entry.str();
+    out.dispatch (level, text.str());
+}
 
+template <typename C, typename T>
+basic_logstream <C,T>& operator << 
+(basic_logstream <C,T>& out, const basic_log_entry <C,T>& entry)
+{
+    log_write (out, out.context(), entry);
     return out;
 }
 
 //-----------------------------------------------------------------------------
 // Helpful macros
 
+// the message is only formatted when some sink accepts the level,
+// and each logstream is safe to use from several threads at once
+
 #ifdef DISABLE_LOGGING_
 #define log_debug(logger,msg) 
 #define log_info(logger,msg) 
@@ -80,21 +86,20 @@ basic_logstream <C,T>& operator <<
 #define log_error(logger,msg) 
 #define log_fatal(logger,msg) 
 #else
-#define log_debug(logger,msg) \
-    logger.push_context (DEBUG) << log_entry (__FILE__,__FUNCTION__,__LINE__) << msg << "\n" \
-	&& logger.pop_context()
-#define log_info(logger,msg) \
-    logger.push_context (INFO) << log_entry (__FILE__,__FUNCTION__,__LINE__) << msg << "\n" \
-	&& logger.pop_context()
-#define log_warn(logger,msg) \
-    logger.push_context (WARN) << log_entry (__FILE__,__FUNCTION__,__LINE__) << msg << "\n" \
-	&& logger.pop_context()
-#define log_error(logger,msg) \
-    logger.push_context (ERROR) << log_entry (__FILE__,__FUNCTION__,__LINE__) << msg << "\n" \
-	&& logger.pop_context()
-#define log_fatal(logger,msg) \
-    logger.push_context (FATAL) << log_entry (__FILE__,__FUNCTION__,__LINE__) << msg << "\n" \
-	&& logger.pop_context()
+#define log_at_(logger,level,msg) \
+    do { \
+	if ((logger).enabled (level)) { \
+	    log_entry entry_ (__FILE__,__FUNCTION__,__LINE__); \
+	    entry_ << msg << "\n"; \
+	    log_write ((logger), (level), entry_); \
+	} \
+    } while (0)
+
+#define log_debug(logger,msg) log_at_ (logger, DEBUG, msg)
+#define log_info(logger,msg) log_at_ (logger, INFO, msg)
+#define log_warn(logger,msg) log_at_ (logger, WARN, msg)
+#define log_error(logger,msg) log_at_ (logger, ERROR, msg)
+#define log_fatal(logger,msg) log_at_ (logger, FATAL, msg)
 #endif
 
 #endif //_LOGMACRO_HPP_
@@ -10,8 +10,15 @@
 //
 #include <iostream>
 #include <ostream>
+#include <sstream>
+#include <string>
 #include <vector>
 #include <stack>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
 #include <algorithm>
 #include <functional>
 #include <cassert>
@@ -67,6 +74,13 @@ struct extended_char_traits <wchar_t>
 // Extend std::ostream to not log certain levels
 // Declare operator<< externally to avoid hiding inherited methods
 
+// A logstream prints a message when the message level passes its own level,
+// and every ancestor logstream does the same with its own level and buffer.
+// Rather than forwarding each message up the chain, the factory caches the
+// flattened list of (buffer, level) sinks on each logstream, one entry per
+// distinct buffer, plus the lowest level any of them accepts: a disabled
+// message costs one relaxed load, an enabled one is formatted once.
+
 template <typename CharType, typename TraitType=std::char_traits<CharType> >
 class basic_logstream : 
     public std::basic_ostream <CharType,TraitType>
@@ -77,6 +91,16 @@ class basic_logstream :
 	typedef std::basic_streambuf <CharType,TraitType>	basic_streambuf_type;
 	typedef std::basic_ios <CharType,TraitType>		basic_ios_type;
 
+	// destination of formatted messages, shared by every logstream using buf
+	struct sink_type
+	{
+	    basic_streambuf_type    *buf;
+	    log_level_t             level;
+	    std::mutex              *lock;
+	};
+
+	typedef std::vector <sink_type>                         sink_list_type;
+
 	// constructor for writing to an existing rdbuf 
 	// taken from an existing std::ostream
 	explicit basic_logstream 
@@ -87,7 +111,7 @@ class basic_logstream :
 		name_ (name),
 		level_ (level), 
 		parent_ (p),
-		bufhandl_ (NULL) 
+		threshold_ (level)
 	{ msgcontext_.push (NONE); }
 
 	// constructor for writing to a shared external streambuf
@@ -99,20 +123,21 @@ class basic_logstream :
 		name_ (name),
 		level_ (level), 
 		parent_ (p),
-		bufhandl_ (NULL)
+		threshold_ (level)
 	{ msgcontext_.push (NONE); }
 
 	// constructor for writing to an external streambuf
-	// that we assume ownership of (via auto_ptr)
+	// that we assume ownership of
 	explicit basic_logstream 
 	    (const basic_string_type& name, log_level_t level, 
-	     std::auto_ptr<basic_streambuf_type> o, 
+	     std::unique_ptr<basic_streambuf_type> o,
 	     basic_logstream* p = NULL) : 
 		basic_ostream_type (o.get()), 
 		name_ (name),
 		level_ (level), 
 		parent_ (p),
-		bufhandl_ (o)
+		threshold_ (level),
+		bufhandl_ (std::move (o))
 	{ msgcontext_.push (NONE); }
 
 	~basic_logstream () {} 
@@ -120,7 +145,11 @@ class basic_logstream :
 	// accessor and mutator methods
 	
 	// current logging level
-	log_level_t level () const { return level_; }
+	log_level_t level () const { return level_.load (std::memory_order_relaxed); }
+
+	// true if some sink would print a message of this level
+	bool enabled (log_level_t level) const
+	{ return level >= threshold_.load (std::memory_order_relaxed); }
 	
 	// the context for messages coming into the stream
 	log_level_t context () const 
@@ -133,8 +162,6 @@ class basic_logstream :
 	basic_logstream& push_context (log_level_t level) 
 	{ 
 	    msgcontext_.push (level); 
-	    if (parent_) parent_->push_context (level);
-
 	    return *this; 
 	}
 
@@ -143,11 +170,34 @@ class basic_logstream :
 	{
 	    assert (msgcontext_.size());
 	    msgcontext_.pop();
-	    if (parent_) parent_->pop_context();
-
 	    return *this;
 	}
 
+	// write an already formatted message to each sink accepting level,
+	// and flush those sinks when the message ended with endl or flush
+	void dispatch (log_level_t level, const basic_string_type& text, bool flush = false)
+	{
+	    if (!enabled (level))
+		return;
+
+	    std::shared_ptr <const sink_list_type> sinks = std::atomic_load (&sinks_);
+	    if (!sinks)
+		return;
+
+	    typename sink_list_type::const_iterator i = sinks->begin();
+	    typename sink_list_type::const_iterator end = sinks->end();
+	    for (; i != end; ++i)
+	    {
+		if (level < i->level)
+		    continue;
+
+		std::lock_guard <std::mutex> guard (*i->lock);
+		i->buf->sputn (text.data(), text.size());
+		if (flush)
+		    i->buf->pubsync();
+	    }
+	}
+
 	basic_string_type name () const { return name_; }
 	basic_logstream* parent () { return parent_; }
 
@@ -155,16 +205,21 @@ class basic_logstream :
 
     private:
 	basic_string_type	name_;		// name of the stream
-	log_level_t 		level_;		// level the stream is logging
+	std::atomic <log_level_t> level_;	// level the stream is logging
 	basic_logstream*	parent_;	// pointer to parent stream
 	
+	// lowest level accepted by any sink, and the sinks themselves
+	// (both are rebuilt by the factory whenever the hierarchy changes)
+	std::atomic <log_level_t>               threshold_;
+	std::shared_ptr <const sink_list_type>  sinks_;
+
 	// stack of message context levels 
 	// (since messages don't hold their own state, we track
 	// input logging levels with a context stack)
 	std::stack <log_level_t> 		msgcontext_;
 
 	// handler for aquiring ownership of a rdbuf
-	std::auto_ptr <basic_streambuf_type>	bufhandl_;
+	std::unique_ptr <basic_streambuf_type>  bufhandl_;
 
     private:
 	basic_logstream();
@@ -187,6 +242,8 @@ class basic_logstream_factory
 	typedef std::basic_string <CharType,TraitType> 		basic_string_type;
 	typedef std::basic_streambuf <CharType,TraitType>	basic_streambuf_type;
 	typedef basic_logstream <CharType,TraitType> 		basic_logstream_type;
+	typedef typename basic_logstream_type::sink_type        sink_type;
+	typedef typename basic_logstream_type::sink_list_type   sink_list_type;
 
 	// internal tree Node for maintaining a namespace tree of loggers
 	class Node
@@ -195,16 +252,18 @@ class basic_logstream_factory
 		typedef std::vector <Node*> child_list_type;
 
 		// all nodes require a name, but a logstream can be added later
-		Node (const basic_string_type& n, const basic_logstream_type *l = NULL) :
+		Node (const basic_string_type& n, Node *p = NULL) :
 		    name (n), 
-		    logger (l), 
+		    parent (p),
+		    logger (NULL),
 		    buf (NULL), 
 		    level (NONE) {}
 
 		~Node () { delete logger; }
 
 		const basic_string_type 	name;
-		const basic_logstream_type	*logger;
+		Node                            *parent;
+		basic_logstream_type            *logger;
 		basic_streambuf_type		*buf;
 		log_level_t			level;
 
@@ -225,13 +284,8 @@ class basic_logstream_factory
 		}
 	};
 
-	// Comparator object for comparing a Node's name given a pointer and string
-	struct NodeCompare : 
-	    public std::binary_function <const Node*, const basic_string_type, bool> {
-		bool operator () (const Node *lhs, const basic_string_type& rhs) const { 
-		    return (lhs->name == rhs); 
-		}
-	    };
+	// full path name -> node, every prefix of a path has its own entry
+	typedef std::unordered_map <basic_string_type, Node*>   node_map_type;
 
 
     public:
@@ -253,13 +307,16 @@ class basic_logstream_factory
 	// Factory method -- change the output buffer for the logger
 	// mush be called before get_logstream, buffers cannot be live swapped
 	// returns true on success
-	// TODO: we can create an new logstream for the new buf, 
-	// return the previous buf and expect the user to clean it up?
 	
-	void set_default_buffer (basic_streambuf_type* buf) { default_rdbuf_ = buf; }
+	void set_default_buffer (basic_streambuf_type* buf)
+	{
+	    std::lock_guard <std::mutex> guard (lock_);
+	    default_rdbuf_ = buf;
+	}
 
 	bool set_buffer (const basic_string_type& path, basic_streambuf_type* buf)
 	{
+	    std::lock_guard <std::mutex> guard (lock_);
 	    Node *parent = NULL, *node = NULL;
 
 	    find_node_ (path, parent, node);
@@ -271,7 +328,7 @@ class basic_logstream_factory
 	// Factory method -- change the log level for the logger
 	basic_logstream_type* set_log_level (const basic_string_type& path, log_level_t level)
 	{
-	    basic_logstream_type *logger = NULL;
+	    std::lock_guard <std::mutex> guard (lock_);
 	    Node *parent = NULL, *node = NULL;
 
 	    // lookup the correct node by path name
@@ -280,18 +337,21 @@ class basic_logstream_factory
 	    // set the level on the path node (for future loggers)
 	    node->level = level;
 
-	    // set the level on the logger if it exists
-	    logger = const_cast <basic_logstream_type*> (node->logger);
-	    if (logger)
-		logger->level_ = level;
+	    // set the level on the logger if it exists, the change is
+	    // visible to every logger below it through their sinks
+	    if (node->logger)
+	    {
+		node->logger->level_.store (level, std::memory_order_relaxed);
+		update_sinks_ (node);
+	    }
 
-	    return logger;
+	    return node->logger;
 	}
 
 	// Factory method -- return a logger ptr for a unqiue path name
 	basic_logstream_type& get_logstream (const basic_string_type& path)
 	{
-	    basic_logstream_type *logger = NULL;
+	    std::lock_guard <std::mutex> guard (lock_);
 	    Node *parent = NULL, *node = NULL;
 
 	    find_node_ (path, parent, node);
@@ -305,94 +365,120 @@ class basic_logstream_factory
 		basic_streambuf_type *buf = (node->buf)? 
 		    node->buf : default_rdbuf_;
 
-		basic_logstream_type *p = (parent)? 
-		    const_cast <basic_logstream_type*> (parent->logger) : NULL;
+		basic_logstream_type *p = (parent)? parent->logger : NULL;
 
 		node->logger = new basic_logstream_type (path, level, buf, p);
-	    }
 
-	    logger = const_cast <basic_logstream_type*> (node->logger);
+		// make sure all parent-child relationships are maintained
+		typename Node::child_list_type::iterator i = node->children.begin();
+		typename Node::child_list_type::iterator end = node->children.end();
+		while (i != end)
+		    add_logger_to_children_ (*i++, node->logger);
 
-	    // make sure all parent-child relationships are maintained
-	    typename Node::child_list_type::iterator i = node->children.begin();
-	    typename Node::child_list_type::iterator end = node->children.end();
-	    while (i != end)
-		add_logger_to_children_ (*i++, logger);
+		update_sinks_ (node);
+	    }
 
-	    return *logger;
+	    return *node->logger;
 	}
 
     private:
-	
-	// split a path into a list of names
-	void split_ (const basic_string_type& s, CharType c, std::vector<basic_string_type>& v)
-	{
-	    typename basic_string_type::size_type begin = 0;
-	    typename basic_string_type::size_type curr = s.find (c);
-	    typename basic_string_type::size_type end = basic_string_type::npos;
 
-	    while (curr != end)
+	void add_logger_to_children_ (Node *n, basic_logstream_type *l)
+	{
+	    if (n->logger)
 	    {
-		v.push_back (s.substr (begin, curr-begin));
-		begin = ++curr;
-		curr = s.find (c, curr);
+		n->logger->parent_ = l;
+		return;
 	    }
 
-	    v.push_back (s.substr (begin));
+	    typename Node::child_list_type::iterator i = n->children.begin();
+	    typename Node::child_list_type::iterator end = n->children.end();
+	    while (i != end)
+		add_logger_to_children_ (*i++, l);
 	}
 
-	void add_logger_to_children_ (Node *n, basic_logstream_type *l)
+	// rebuild the cached sinks of every logger at or below n
+	void update_sinks_ (Node *n)
 	{
 	    if (n->logger)
 	    {
-		basic_logstream_type *child = 
-		    const_cast <basic_logstream_type*> (n->logger);
+		std::shared_ptr <sink_list_type> sinks (new sink_list_type);
+		log_level_t threshold = static_cast <log_level_t> (FATAL + 1);
 
-		child->parent_ = l;
-		return;
+		for (basic_logstream_type *l = n->logger; l; l = l->parent_)
+		{
+		    basic_streambuf_type *buf = l->rdbuf();
+		    log_level_t level = l->level_.load (std::memory_order_relaxed);
+
+		    typename sink_list_type::iterator i = sinks->begin();
+		    while (i != sinks->end() && i->buf != buf)
+			++i;
+
+		    if (i == sinks->end())
+		    {
+			sink_type sink = { buf, level, &buffer_lock_ (buf) };
+			sinks->push_back (sink);
+		    }
+		    else
+			i->level = std::min (i->level, level);
+
+		    threshold = std::min (threshold, level);
+		}
+
+		std::atomic_store (&n->logger->sinks_,
+			std::shared_ptr <const sink_list_type> (sinks));
+		n->logger->threshold_.store (threshold, std::memory_order_relaxed);
 	    }
 
 	    typename Node::child_list_type::iterator i = n->children.begin();
 	    typename Node::child_list_type::iterator end = n->children.end();
 	    while (i != end)
-		add_logger_to_children_ (*i++, l);
+		update_sinks_ (*i++);
 	}
 
-	void find_node_ (const basic_string_type& path, Node*& parent, Node*& node)
+	// one lock per distinct buffer, shared by all loggers writing to it
+	std::mutex& buffer_lock_ (basic_streambuf_type *buf)
 	{
-	    // split the path into an array by delimiter
-	    std::vector <basic_string_type> pathlist;
-	    split_ (path, path_delim, pathlist);
+	    std::unique_ptr <std::mutex>& lock = buffer_locks_[buf];
+	    if (!lock)
+		lock.reset (new std::mutex);
 
-	    size_t size = pathlist.size();
+	    return *lock;
+	}
 
-	    node = root_;
-	    Node *next = NULL;
-	    typename Node::child_list_type::iterator iter;
+	// hashed lookup of the whole path, only a miss walks the prefixes
+	void find_node_ (const basic_string_type& path, Node*& parent, Node*& node)
+	{
+	    typename node_map_type::iterator found = nodes_.find (path);
+	    if (found == nodes_.end())
+		node = create_node_ (path);
+	    else
+		node = found->second;
+
+	    // nearest ancestor with a logger is the possible parent
+	    for (Node *n = node->parent; n && !parent; n = n->parent)
+		if (n->logger)
+		    parent = n;
+	}
 
-	    // for each step in the path
-	    for (size_t i=0; i < size; ++i)
-	    {
-		// look for existing node in the path
-		iter = find_if (node->children.begin(), node->children.end(), 
-				bind2nd (NodeCompare(), pathlist[i]));
+	Node* create_node_ (const basic_string_type& path)
+	{
+	    typename basic_string_type::size_type delim = path.rfind (path_delim);
 
-		// if not found, create a new path
-		if (iter == node->children.end())
-		{
-		    next = new Node (pathlist[i], NULL);
-		    node->children.push_back (next);
-		}
-		else
-		    next = *iter;
+	    Node *up = (delim == basic_string_type::npos)?
+		root_ : find_or_create_ (path.substr (0, delim));
 
-		// walk to the next branch in path
-		node = next;
+	    Node *node = new Node (path.substr (delim + 1), up);
+	    up->children.push_back (node);
+	    nodes_[path] = node;
 
-		// if node has a logger, consider it a possible parent
-		if (node->logger)
-		    parent = node;
-	    }
+	    return node;
+	}
+
+	Node* find_or_create_ (const basic_string_type& path)
+	{
+	    typename node_map_type::iterator found = nodes_.find (path);
+	    return (found == nodes_.end())? create_node_ (path) : found->second;
 	}
 
 	void delete_tree_ (Node *n)
@@ -410,10 +496,14 @@ class basic_logstream_factory
 
     private:
 	Node			*root_;	// default root log node
+	node_map_type           nodes_; // every node below root by full path
 
 	basic_streambuf_type	*default_rdbuf_;
 	log_level_t 		default_level_;
 
+	std::mutex              lock_;  // guards the tree, taken only by factory methods
+	std::map <basic_streambuf_type*, std::unique_ptr <std::mutex> > buffer_locks_;
+
 	// TODO: support more delimiters ('/', '::')
 	static const CharType 	path_delim = '.';
 
@@ -440,39 +530,53 @@ wlogstream& get_logstream (const std::wstring& path);
 
 
 //-----------------------------------------------------------------------------
-// Forward all input to ostream if logging is set at the given level
-// and forward the message to the parent
+// Format input once if logging is set at the current context level
+// and hand the text to every sink of the stream
 
 // These forwarding funcitons implements the core logstream functionality: 
-// pass the message on to the parent, and print only if the level matches
+// format with the stream's own flags, print only where the level matches
 
 template <typename C, typename T, typename OutputType>
 static inline void logstream_forward_output_ 
 (basic_logstream <C,T>& out, const OutputType& msg)
 {
-    typedef std::basic_ostream <C,T> basic_ostream_type;
-    typedef typename basic_ostream_type::sentry sentry;
-
-    basic_logstream <C,T> *p = out.parent();
-    if (p) *p << msg;
+    if (!out.enabled (out.context()))
+	return;
 
-    if ((out.context() >= out.level()) && sentry (out))
-	reinterpret_cast <basic_ostream_type&> 
-	    (out) << msg;
+    std::basic_ostringstream <C,T> text;
+    text.copyfmt (out);
+    text << msg;
+    out.dispatch (out.context(), text.str());
 }
 
+// text buffer that remembers being flushed, so endl and flush reach the sinks
+template <typename C, typename T>
+class logstream_manip_buffer_ : public std::basic_stringbuf <C,T>
+{
+    public:
+	logstream_manip_buffer_ () : synced_ (false) {}
+	bool synced () const { return synced_; }
+
+    protected:
+	int sync () { synced_ = true; return 0; }
+
+    private:
+	bool synced_;
+};
+
 template <typename C, typename T, typename OutputType>
 static inline void logstream_forward_manip_ 
 (basic_logstream <C,T>& out, const OutputType& msg)
 {
-    typedef std::basic_ostream <C,T> basic_ostream_type;
-
-    basic_logstream <C,T> *p = out.parent();
-    if (p) *p << msg;
-
-    if (out.context() >= out.level())
-	reinterpret_cast <basic_ostream_type&> 
-	    (out) << msg;
+    // format changing manipulators must stick even if nothing is printed
+    logstream_manip_buffer_ <C,T> buffer;
+    std::basic_ostream <C,T> text (&buffer);
+    text.copyfmt (out);
+    text << msg;
+    out.copyfmt (text);
+
+    if (!buffer.str().empty() || buffer.synced())
+	out.dispatch (out.context(), buffer.str(), buffer.synced());
 }
 
 // Interface for printing all primitive types
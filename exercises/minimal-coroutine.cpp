@@ -54,6 +54,11 @@
 //    such as 'schedule when an I/O operation completes' or 'schedule when a time
 //    elapses'.
 //
+//    `static_thread_pool` is the same idea grown into a multi-threaded runtime
+//    with per-worker queues and work-stealing, see the comment on that class.
+//    `io_context` adds the 'when an I/O operation completes' and 'when a time
+//    elapses' kinds on top of a `manual_event_loop`, using epoll.
+//
 // These 4 components are essential to being able to write asynchronous coroutine code.
 //
 // Different coroutine library implementations may structure these facilities in
@@ -80,6 +85,7 @@
 
 // And some other helpers:
 // - `lazy_task` - useful for improving coroutine allocation-elision
+// - `frame_pool` / `frame_arena` - recycling coroutine frames when elision doesn't happen
 // - `scope_guard`
 //
 //
@@ -92,18 +98,36 @@
 
 #include <atomic>
 #include <cassert>
+#include <cerrno>
+#include <chrono>
 #include <concepts>
 #include <condition_variable>
 #include <coroutine>
+#include <cstddef>
 #include <cstdio>
+#include <cstdlib>
+#include <cstdint>
 #include <exception>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <semaphore>
 #include <stop_token>
+#include <string_view>
+#include <system_error>
 #include <thread>
+#include <unordered_map>
 #include <utility>
 #include <variant>
+#include <vector>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 ///////////////////////////////////////////////////
 // general helpers
@@ -192,7 +216,7 @@ get_awaiter(T&& x) noexcept(noexcept(static_cast<T&&>(x).operator co_await())) {
 
 template <typename T>
   requires _free_co_await<T> decltype(auto)
-get_awaiter(T&& x) noexcept(operator co_await(static_cast<T&&>(x))) {
+get_awaiter(T&& x) noexcept(noexcept(operator co_await(std::declval<T>()))) {
   return operator co_await(static_cast<T&&>(x));
 }
 
@@ -210,6 +234,192 @@ template <typename T>
   requires awaitable<T>
 using await_result_t = decltype(std::declval<awaiter_type_t<T>&>().await_resume());
 
+///////////////////////////////////////////////////
+// frame_pool - recycling allocator for coroutine frames
+//
+// The compiler can only elide a coroutine frame allocation when it can prove
+// the frame's lifetime is nested within the caller's (see `lazy_task` below),
+// which in practice rarely holds once tasks are spawned or handed between
+// threads. Every other `task<T>` call is a trip through malloc and free.
+//
+// Promise types that derive from `pooled_frame` get their frames from a
+// thread-local free list per size class instead. A frame freed on another
+// thread goes onto that thread's list, so in a steady state where frames
+// are created and destroyed on the same threads no heap calls are made.
+// Each list keeps at most `max_cached` frames, the rest go back to the heap.
+//
+// A coroutine can instead take its frame from a caller-supplied `frame_arena`
+// by declaring `(std::allocator_arg_t, frame_arena&, ...)` as its first
+// parameters. Arena frames are never individually freed, the arena's memory
+// is reused as a whole once all frames allocated from it are destroyed.
+// When the arena is exhausted the frame comes from the pool as usual.
+//
+// `frame_pool::heap_allocations()` counts every frame that did have to come
+// from the global heap, so a test can assert it stays flat after a warm-up.
+
+struct frame_arena {
+  frame_arena(void* buffer, std::size_t size) noexcept
+    : begin(static_cast<std::byte*>(buffer)), next(begin), end(begin + size) {}
+
+  frame_arena(const frame_arena&) = delete;
+  frame_arena& operator=(const frame_arena&) = delete;
+
+  // only once every frame allocated from the arena has been destroyed
+  void reset() noexcept { next = begin; }
+
+  std::size_t used() const noexcept { return static_cast<std::size_t>(next - begin); }
+
+ private:
+  friend struct frame_pool;
+
+  void* try_allocate(std::size_t size) noexcept {
+    if (static_cast<std::size_t>(end - next) < size) {
+      return nullptr;
+    }
+    return std::exchange(next, next + size);
+  }
+
+  std::byte* begin;
+  std::byte* next;
+  std::byte* end;
+};
+
+struct frame_pool {
+ private:
+  // every frame is prefixed by a header recording where it came from; the
+  // header keeps the frame aligned for __STDCPP_DEFAULT_NEW_ALIGNMENT__
+  struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) header {
+    std::uint32_t size_class;
+    bool from_arena;
+  };
+
+  struct free_frame {
+    free_frame* next;
+  };
+
+  static constexpr std::size_t granularity = 64;
+  static constexpr std::size_t size_classes = 16;  // frames up to 1KiB are pooled
+  static constexpr std::size_t unpooled = size_classes;
+  static constexpr std::size_t max_cached = 1024;
+
+  // Trivially destructible so that the hot path is a plain TLS access
+  // without an initialisation guard; the lists are drained at thread exit
+  // by a `drain_at_exit` that is only touched off the hot path.
+  struct free_lists {
+    free_frame* head[size_classes];
+    std::size_t count[size_classes];
+    bool disabled;
+  };
+
+  struct drain_at_exit {
+    ~drain_at_exit() {
+      for (std::size_t c = 0; c < size_classes; ++c) {
+        while (free_frame* frame = lists.head[c]) {
+          lists.head[c] = frame->next;
+          ::operator delete(frame);
+        }
+        lists.count[c] = 0;
+      }
+      lists.disabled = true;  // frames still freed on this thread go to the heap
+    }
+  };
+
+  static constinit thread_local free_lists lists;
+  static inline std::atomic<std::size_t> heap_count{0};
+
+  static std::size_t size_class_of(std::size_t bytes) noexcept {
+    std::size_t c = (bytes - 1) / granularity;
+    return c < size_classes ? c : unpooled;
+  }
+
+  static void drain_this_thread_at_exit() noexcept {
+    static thread_local drain_at_exit drain;
+    (void)drain;
+  }
+
+  static void* from_heap(std::size_t bytes) {
+    drain_this_thread_at_exit();
+    heap_count.fetch_add(1, std::memory_order_relaxed);
+    return ::operator new(bytes);
+  }
+
+  static void* with_header(void* block, std::size_t size_class, bool from_arena) noexcept {
+    auto* h = ::new (block) header{static_cast<std::uint32_t>(size_class), from_arena};
+    return h + 1;
+  }
+
+ public:
+  static void* allocate(std::size_t size) {
+    const std::size_t bytes = size + sizeof(header);
+    const std::size_t c = size_class_of(bytes);
+    if (c == unpooled || lists.disabled) {
+      return with_header(from_heap(bytes), unpooled, false);
+    }
+
+    if (free_frame* frame = lists.head[c]) {
+      lists.head[c] = frame->next;
+      --lists.count[c];
+      return with_header(frame, c, false);
+    }
+    return with_header(from_heap((c + 1) * granularity), c, false);
+  }
+
+  static void* allocate(std::size_t size, frame_arena& arena) {
+    constexpr std::size_t align = alignof(header);
+    const std::size_t bytes = (size + sizeof(header) + align - 1) & ~(align - 1);
+    if (void* block = arena.try_allocate(bytes)) {
+      return with_header(block, unpooled, true);
+    }
+    return allocate(size);
+  }
+
+  static void deallocate(void* frame) noexcept {
+    header* h = static_cast<header*>(frame) - 1;
+    if (h->from_arena) {
+      return;
+    }
+
+    const std::size_t c = h->size_class;
+    if (c == unpooled || lists.disabled || lists.count[c] == max_cached) {
+      ::operator delete(h);
+      return;
+    }
+    if (lists.count[c] == 0) {
+      // frames freed here may have been allocated on another thread
+      drain_this_thread_at_exit();
+    }
+    auto* free = ::new (static_cast<void*>(h)) free_frame{lists.head[c]};
+    lists.head[c] = free;
+    ++lists.count[c];
+  }
+
+  // Frames that had to be allocated from the global heap, on any thread.
+  static std::size_t heap_allocations() noexcept { return heap_count.load(std::memory_order_relaxed); }
+
+  // Turns recycling on or off for the calling thread, for comparison.
+  static void set_enabled(bool enabled) noexcept { lists.disabled = !enabled; }
+};
+
+constinit inline thread_local frame_pool::free_lists frame_pool::lists{};
+
+// Base class for promise types whose frames should come from frame_pool.
+struct pooled_frame {
+  static void* operator new(std::size_t size) { return frame_pool::allocate(size); }
+
+  template <typename... Args>
+  static void* operator new(std::size_t size, std::allocator_arg_t, frame_arena& arena, Args&...) {
+    return frame_pool::allocate(size, arena);
+  }
+
+  // the same for member function coroutines, where the object comes first
+  template <typename Self, typename... Args>
+  static void* operator new(std::size_t size, Self&, std::allocator_arg_t, frame_arena& arena, Args&...) {
+    return frame_pool::allocate(size, arena);
+  }
+
+  static void operator delete(void* frame) noexcept { frame_pool::deallocate(frame); }
+};
+
 ///////////////////////////////////////////////////
 // task<T> - basic async task type
 
@@ -217,7 +427,7 @@ template <typename T>
 struct task;
 
 template <typename T>
-struct task_promise {
+struct task_promise : pooled_frame {
   task<T> get_return_object() noexcept;
 
   std::suspend_always initial_suspend() noexcept { return {}; }
@@ -245,7 +455,7 @@ struct task_promise {
 };
 
 template <>
-struct task_promise<void> {
+struct task_promise<void> : pooled_frame {
   task<void> get_return_object() noexcept;
 
   std::suspend_always initial_suspend() noexcept { return {}; }
@@ -331,7 +541,7 @@ task<void> task_promise<void>::get_return_object() noexcept {
 struct async_scope {
  private:
   struct detached_task {
-    struct promise_type {
+    struct promise_type : pooled_frame {
       async_scope& scope;
 
       promise_type(async_scope& scope, auto&) noexcept : scope(scope) {}
@@ -372,7 +582,10 @@ struct async_scope {
     std::size_t oldValue = ref_count.load(std::memory_order_acquire);
     assert(oldValue >= ref_increment);
 
-    if (oldValue > (joiner_flag + ref_increment)) {
+    // Only the last ref with a joiner already waiting may skip the decrement:
+    // nobody else can touch the count then. Without a joiner the count must
+    // still drop to zero, or a later join_async() would wait forever.
+    if (oldValue != (joiner_flag + ref_increment)) {
       oldValue = ref_count.fetch_sub(ref_increment, std::memory_order_acq_rel);
     }
 
@@ -519,6 +732,8 @@ await_result_t<Task> sync_wait(Task&& t) {
 
 struct manual_event_loop {
  private:
+  friend struct io_context;
+
   struct queue_item {
     queue_item* next;
     std::coroutine_handle<> coro;
@@ -591,6 +806,747 @@ struct manual_event_loop {
   }
 };
 
+/////////////////////////////////////////////////
+// static_thread_pool
+//
+// A work-stealing scheduler with a fixed set of worker threads.
+//
+// Each worker owns:
+// - a LIFO slot holding the item it scheduled most recently, which it runs
+//   next so that a coroutine handing off to another stays hot in cache.
+//   The slot is not stealable; after `max_lifo_runs` consecutive runs from
+//   it the item is sent to the back of the injection queue so a pair of
+//   coroutines ping-ponging through the slot can't starve everything else.
+// - a bounded Chase-Lev deque: the owner pushes/pops at the bottom without
+//   locks, idle workers steal from the top.
+//
+// Items scheduled from threads outside the pool (or when a deque is full) go
+// to a mutex protected injection queue, which workers also poll every
+// `injection_interval` items for fairness. That is the only lock taken on
+// the schedule path, and a worker scheduling onto its own pool never takes it.
+//
+// Idle workers spin briefly stealing, then sleep. A schedule only touches the
+// sleep mutex when some worker is actually asleep.
+//
+// Like task<T>, completion of a coroutine transfers straight to its awaiting
+// coroutine (symmetric transfer), so a deep chain of co_awaits completes in
+// constant stack space no matter which worker resumes it.
+
+struct static_thread_pool {
+ private:
+  struct queue_item {
+    queue_item* next;
+    std::coroutine_handle<> coro;
+  };
+
+  // Chase-Lev deque of fixed capacity (Le, Pop, Cohen, Zappa Nardelli 2013)
+  struct work_deque {
+    static constexpr std::int64_t capacity = 1024;
+
+    std::atomic<std::int64_t> top{0};
+    std::atomic<std::int64_t> bottom{0};
+    std::atomic<queue_item*> items[capacity];
+
+    // owner only
+    bool push(queue_item* item) noexcept {
+      std::int64_t b = bottom.load(std::memory_order_relaxed);
+      std::int64_t t = top.load(std::memory_order_acquire);
+      if (b - t >= capacity) {
+        return false;
+      }
+      items[b & (capacity - 1)].store(item, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      bottom.store(b + 1, std::memory_order_relaxed);
+      return true;
+    }
+
+    // owner only
+    queue_item* pop() noexcept {
+      std::int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+      bottom.store(b, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      std::int64_t t = top.load(std::memory_order_relaxed);
+
+      if (t > b) {
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+      }
+
+      queue_item* item = items[b & (capacity - 1)].load(std::memory_order_relaxed);
+      if (t == b) {
+        // last item, race thieves for it
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                         std::memory_order_relaxed)) {
+          item = nullptr;
+        }
+        bottom.store(b + 1, std::memory_order_relaxed);
+      }
+      return item;
+    }
+
+    // any thread, nullptr if empty or it lost a race
+    queue_item* steal() noexcept {
+      std::int64_t t = top.load(std::memory_order_acquire);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      std::int64_t b = bottom.load(std::memory_order_acquire);
+      if (t >= b) {
+        return nullptr;
+      }
+
+      queue_item* item = items[t & (capacity - 1)].load(std::memory_order_relaxed);
+      if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                       std::memory_order_relaxed)) {
+        return nullptr;
+      }
+      return item;
+    }
+
+    bool empty() const noexcept {
+      return top.load(std::memory_order_acquire) >= bottom.load(std::memory_order_acquire);
+    }
+  };
+
+  struct alignas(64) worker {
+    static_thread_pool* pool;
+    std::size_t index;
+    queue_item* lifo{nullptr};
+    std::size_t lifo_runs{0};
+    std::size_t ticks{0};
+    work_deque deque;
+  };
+
+  static constexpr std::size_t max_lifo_runs = 16;
+  static constexpr std::size_t injection_interval = 61;
+  static constexpr int spin_rounds = 64;
+
+  static inline thread_local worker* current_worker = nullptr;
+
+  std::unique_ptr<worker[]> workers;
+  std::size_t worker_count;
+  std::vector<std::thread> threads;
+
+  std::mutex injection_mut;
+  queue_item* injection_head{nullptr};
+  queue_item* injection_tail{nullptr};
+  std::atomic<std::size_t> injection_size{0};
+
+  std::mutex sleep_mut;
+  std::condition_variable sleep_cv;
+  std::atomic<std::size_t> sleepers{0};
+  std::atomic<bool> stopping{false};
+
+  void inject(queue_item* item) noexcept {
+    std::lock_guard lock{injection_mut};
+    item->next = nullptr;
+    if (injection_head == nullptr) {
+      injection_head = item;
+    } else {
+      injection_tail->next = item;
+    }
+    injection_tail = item;
+    injection_size.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  queue_item* pop_injected() noexcept {
+    if (injection_size.load(std::memory_order_relaxed) == 0) {
+      return nullptr;
+    }
+    std::lock_guard lock{injection_mut};
+    queue_item* front = injection_head;
+    if (front != nullptr) {
+      injection_head = front->next;
+      if (injection_head == nullptr) {
+        injection_tail = nullptr;
+      }
+      injection_size.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return front;
+  }
+
+  void enqueue(queue_item* item) noexcept {
+    worker* self = current_worker;
+    if (self != nullptr && self->pool == this) {
+      // newest item takes the LIFO slot, the one it displaces goes to the deque
+      if (queue_item* displaced = std::exchange(self->lifo, item)) {
+        if (!self->deque.push(displaced)) {
+          inject(displaced);
+        }
+      }
+    } else {
+      inject(item);
+    }
+    wake_one();
+  }
+
+  void wake_one() noexcept {
+    // pairs with the fence in sleep(): either the sleeper sees our item when
+    // it re-checks, or we see it counted and notify under the lock
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers.load(std::memory_order_relaxed) != 0) {
+      { std::lock_guard lock{sleep_mut}; }
+      sleep_cv.notify_one();
+    }
+  }
+
+  bool has_visible_work() const noexcept {
+    if (injection_size.load(std::memory_order_relaxed) != 0) {
+      return true;
+    }
+    for (std::size_t i = 0; i < worker_count; ++i) {
+      if (!workers[i].deque.empty()) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  queue_item* steal(worker& self) noexcept {
+    for (std::size_t n = 1; n < worker_count; ++n) {
+      worker& victim = workers[(self.index + n) % worker_count];
+      if (queue_item* item = victim.deque.steal()) {
+        return item;
+      }
+    }
+    return nullptr;
+  }
+
+  queue_item* next_item(worker& self) noexcept {
+    if (++self.ticks % injection_interval == 0) {
+      if (queue_item* item = pop_injected()) {
+        return item;
+      }
+    }
+
+    if (self.lifo != nullptr) {
+      queue_item* item = std::exchange(self.lifo, nullptr);
+      if (++self.lifo_runs <= max_lifo_runs) {
+        return item;
+      }
+      inject(item);
+    }
+    self.lifo_runs = 0;
+
+    if (queue_item* item = self.deque.pop()) {
+      return item;
+    }
+    if (queue_item* item = pop_injected()) {
+      return item;
+    }
+    return steal(self);
+  }
+
+  void sleep() noexcept {
+    std::unique_lock lock{sleep_mut};
+    sleepers.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!has_visible_work() && !stopping.load(std::memory_order_relaxed)) {
+      sleep_cv.wait(lock);
+    }
+    sleepers.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  void run(std::size_t index) noexcept {
+    worker& self = workers[index];
+    current_worker = &self;
+
+    int idle = 0;
+    while (!stopping.load(std::memory_order_relaxed)) {
+      if (queue_item* item = next_item(self)) {
+        idle = 0;
+        item->coro.resume();
+      } else if (++idle < spin_rounds) {
+        std::this_thread::yield();
+      } else {
+        idle = 0;
+        sleep();
+      }
+    }
+
+    current_worker = nullptr;
+  }
+
+  struct schedule_awaitable {
+    static_thread_pool* pool;
+    queue_item item;
+
+    explicit schedule_awaitable(static_thread_pool& pool) noexcept : pool(&pool) {}
+
+    bool await_ready() noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> coro) noexcept {
+      item.coro = coro;
+      pool->enqueue(&item);
+    }
+    void await_resume() noexcept {}
+  };
+
+ public:
+  explicit static_thread_pool(std::size_t thread_count = std::thread::hardware_concurrency())
+    : workers(new worker[std::max<std::size_t>(thread_count, 1)]),
+      worker_count(std::max<std::size_t>(thread_count, 1)) {
+    for (std::size_t i = 0; i < worker_count; ++i) {
+      workers[i].pool = this;
+      workers[i].index = i;
+    }
+    threads.reserve(worker_count);
+    for (std::size_t i = 0; i < worker_count; ++i) {
+      threads.emplace_back([this, i] { run(i); });
+    }
+  }
+
+  static_thread_pool(const static_thread_pool&) = delete;
+  static_thread_pool& operator=(const static_thread_pool&) = delete;
+
+  // Work still queued is abandoned, join scopes before destroying the pool.
+  ~static_thread_pool() {
+    {
+      std::lock_guard lock{sleep_mut};
+      stopping.store(true, std::memory_order_relaxed);
+    }
+    sleep_cv.notify_all();
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+
+  std::size_t thread_count() const noexcept { return worker_count; }
+
+  schedule_awaitable schedule() noexcept { return schedule_awaitable{*this}; }
+};
+
+/////////////////////////////////////////////////
+// io_context
+//
+// An epoll reactor that lets coroutines wait for a file descriptor to become
+// readable or writable, or for a deadline to pass, and resumes them on a
+// manual_event_loop when it does.
+//
+// One thread drives the reactor with `io.run(st)`. The coroutines it wakes
+// are enqueued to the loop and resumed by the loop's threads, never on the
+// reactor thread, so a slow handler doesn't hold up other connections.
+//
+// Every wait takes an optional std::stop_token and completes early, reporting
+// cancellation, once stop is requested. An operation is handed to the loop
+// only after both its completion (readiness, expiry or cancellation) and the
+// end of await_suspend(), so the stop_callback inside the awaiter can't be
+// destroyed by a resumed coroutine while it is still being constructed.
+//
+// The async_* coroutines below build socket operations from a non-blocking
+// syscall plus a wait, retried until the syscall stops saying EAGAIN. A
+// connection handler is then straight-line code and needs no thread of its
+// own. Regular files are always "ready" as far as epoll is concerned, so
+// async_read_file() instead issues the read from one of the loop's threads.
+
+struct io_context {
+ private:
+  using clock = std::chrono::steady_clock;
+
+  struct operation {
+    io_context* io;
+    manual_event_loop::queue_item item;
+    std::atomic<int> pending{2};  // completion + end of await_suspend()
+    bool cancelled{false};
+
+    explicit operation(io_context& io) noexcept : io(&io) {}
+
+    void release() noexcept {
+      if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        io->loop->enqueue(&item);
+      }
+    }
+  };
+
+  struct wait_op : operation {
+    int fd;
+    bool write;
+
+    wait_op(io_context& io, int fd, bool write) noexcept : operation(io), fd(fd), write(write) {}
+  };
+
+  struct timer_op : operation {
+    clock::time_point deadline;
+    std::multimap<clock::time_point, timer_op*>::iterator where;
+    bool queued{false};
+
+    timer_op(io_context& io, clock::time_point deadline) noexcept : operation(io), deadline(deadline) {}
+  };
+
+  struct fd_waiters {
+    wait_op* reader{nullptr};
+    wait_op* writer{nullptr};
+  };
+
+  manual_event_loop* loop;
+  int epoll_fd;
+  int wake_fd;
+
+  std::mutex mut;
+  std::unordered_map<int, fd_waiters> fds;
+  std::multimap<clock::time_point, timer_op*> timers;
+
+  static void check(int result, const char* what) {
+    if (result < 0) {
+      throw std::system_error(errno, std::generic_category(), what);
+    }
+  }
+
+  void wake() noexcept {
+    std::uint64_t one = 1;
+    [[maybe_unused]] auto n = ::write(wake_fd, &one, sizeof(one));
+  }
+
+  // with `mut` held; false if the fd can't be polled (e.g. a regular file)
+  bool arm(int fd, const fd_waiters& waiters) noexcept {
+    epoll_event ev{};
+    ev.events = EPOLLONESHOT | (waiters.reader ? EPOLLIN : 0u) | (waiters.writer ? EPOLLOUT : 0u);
+    ev.data.fd = fd;
+    if (::epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev) == 0) {
+      return true;
+    }
+    return errno == ENOENT && ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == 0;
+  }
+
+  void add_wait(wait_op& op) noexcept {
+    {
+      std::lock_guard lock{mut};
+      fd_waiters& waiters = fds[op.fd];
+      wait_op*& slot = op.write ? waiters.writer : waiters.reader;
+      assert(slot == nullptr && "one reader and one writer per fd at a time");
+      slot = &op;
+      if (arm(op.fd, waiters)) {
+        return;
+      }
+      slot = nullptr;
+      if (!waiters.reader && !waiters.writer) {
+        fds.erase(op.fd);
+      }
+    }
+    op.release();  // not pollable: report it ready and let the syscall decide
+  }
+
+  void cancel(wait_op& op) noexcept {
+    {
+      std::lock_guard lock{mut};
+      auto it = fds.find(op.fd);
+      if (it == fds.end()) {
+        return;
+      }
+      wait_op*& slot = op.write ? it->second.writer : it->second.reader;
+      if (slot != &op) {
+        return;  // already completed
+      }
+      slot = nullptr;
+      op.cancelled = true;
+      if (!it->second.reader && !it->second.writer) {
+        fds.erase(it);  // the fd stays armed, a late event finds no waiters
+      } else {
+        arm(op.fd, it->second);
+      }
+    }
+    op.release();
+  }
+
+  void add_timer(timer_op& op) noexcept {
+    bool earliest;
+    {
+      std::lock_guard lock{mut};
+      op.where = timers.emplace(op.deadline, &op);
+      op.queued = true;
+      earliest = op.where == timers.begin();
+    }
+    if (earliest) {
+      wake();  // the reactor may be sleeping towards a later deadline
+    }
+  }
+
+  void cancel(timer_op& op) noexcept {
+    {
+      std::lock_guard lock{mut};
+      if (!op.queued) {
+        return;
+      }
+      timers.erase(op.where);
+      op.queued = false;
+      op.cancelled = true;
+    }
+    op.release();
+  }
+
+  template <typename Op>
+  struct cancel_on_stop {
+    Op* op;
+    void operator()() noexcept { op->io->cancel(*op); }
+  };
+
+  template <typename Op>
+  struct awaitable_base : Op {
+    std::stop_token st;
+    std::optional<std::stop_callback<cancel_on_stop<Op>>> on_stop;
+
+    bool stopped() noexcept {
+      this->cancelled = st.stop_requested();
+      return this->cancelled;
+    }
+
+    bool suspend_if_not_stopped(std::coroutine_handle<> coro) noexcept {
+      this->item.coro = coro;
+      return !stopped();
+    }
+
+    void finish_suspend() noexcept {
+      if (st.stop_possible()) {
+        on_stop.emplace(st, cancel_on_stop<Op>{this});
+      }
+      this->release();
+    }
+
+    // true if the wait completed, false if it was cancelled
+    bool await_resume() noexcept {
+      on_stop.reset();
+      return !this->cancelled;
+    }
+  };
+
+  struct wait_awaitable : awaitable_base<wait_op> {
+    wait_awaitable(io_context& io, int fd, bool write, std::stop_token st) noexcept
+      : awaitable_base<wait_op>{{io, fd, write}, std::move(st), std::nullopt} {}
+
+    bool await_ready() noexcept { return stopped(); }
+    bool await_suspend(std::coroutine_handle<> coro) noexcept {
+      if (!suspend_if_not_stopped(coro)) {
+        return false;
+      }
+      io->add_wait(*this);
+      finish_suspend();
+      return true;
+    }
+  };
+
+  struct timer_awaitable : awaitable_base<timer_op> {
+    timer_awaitable(io_context& io, clock::time_point deadline, std::stop_token st) noexcept
+      : awaitable_base<timer_op>{{io, deadline}, std::move(st), std::nullopt} {}
+
+    bool await_ready() noexcept { return stopped() || deadline <= clock::now(); }
+    bool await_suspend(std::coroutine_handle<> coro) noexcept {
+      if (!suspend_if_not_stopped(coro)) {
+        return false;
+      }
+      io->add_timer(*this);
+      finish_suspend();
+      return true;
+    }
+  };
+
+  int timeout_ms() noexcept {
+    std::lock_guard lock{mut};
+    if (timers.empty()) {
+      return -1;
+    }
+    auto remaining = timers.begin()->first - clock::now();
+    if (remaining <= clock::duration::zero()) {
+      return 0;
+    }
+    // rounded up so we never wake just before a deadline and spin
+    return static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(remaining).count());
+  }
+
+ public:
+  explicit io_context(manual_event_loop& loop)
+    : loop(&loop), epoll_fd(::epoll_create1(EPOLL_CLOEXEC)), wake_fd(::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {
+    check(epoll_fd, "epoll_create1");
+    check(wake_fd, "eventfd");
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = wake_fd;
+    check(::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev), "epoll_ctl");
+  }
+
+  io_context(const io_context&) = delete;
+  io_context& operator=(const io_context&) = delete;
+
+  // Outstanding waits are abandoned, cancel them before destroying the context.
+  ~io_context() {
+    ::close(wake_fd);
+    ::close(epoll_fd);
+  }
+
+  // Drives the reactor on the calling thread until stop is requested.
+  void run(std::stop_token st) {
+    std::stop_callback cb{st, [this]() noexcept { wake(); }};
+
+    std::vector<operation*> completed;
+    epoll_event events[64];
+    while (!st.stop_requested()) {
+      int n = ::epoll_wait(epoll_fd, events, 64, timeout_ms());
+      if (n < 0 && errno != EINTR) {
+        check(n, "epoll_wait");
+      }
+
+      {
+        std::lock_guard lock{mut};
+        for (int i = 0; i < n; ++i) {
+          int fd = events[i].data.fd;
+          if (fd == wake_fd) {
+            std::uint64_t count;
+            [[maybe_unused]] auto r = ::read(wake_fd, &count, sizeof(count));
+            continue;
+          }
+
+          auto it = fds.find(fd);
+          if (it == fds.end()) {
+            continue;
+          }
+          fd_waiters& waiters = it->second;
+          const std::uint32_t ready = events[i].events;
+          if (waiters.reader && (ready & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+            completed.push_back(std::exchange(waiters.reader, nullptr));
+          }
+          if (waiters.writer && (ready & (EPOLLOUT | EPOLLHUP | EPOLLERR))) {
+            completed.push_back(std::exchange(waiters.writer, nullptr));
+          }
+          if (!waiters.reader && !waiters.writer) {
+            fds.erase(it);
+          } else {
+            arm(fd, waiters);
+          }
+        }
+
+        const auto now = clock::now();
+        while (!timers.empty() && timers.begin()->first <= now) {
+          timer_op* op = timers.begin()->second;
+          timers.erase(timers.begin());
+          op->queued = false;
+          completed.push_back(op);
+        }
+      }
+
+      // outside the lock: a released operation may be resumed and gone at once
+      for (operation* op : completed) {
+        op->release();
+      }
+      completed.clear();
+    }
+  }
+
+  // co_await io.readable(fd) -> bool, false if cancelled through `st`
+  [[nodiscard]] wait_awaitable readable(int fd, std::stop_token st = {}) noexcept {
+    return wait_awaitable{*this, fd, false, std::move(st)};
+  }
+
+  [[nodiscard]] wait_awaitable writable(int fd, std::stop_token st = {}) noexcept {
+    return wait_awaitable{*this, fd, true, std::move(st)};
+  }
+
+  // co_await io.sleep_until(deadline) -> bool, false if cancelled through `st`
+  [[nodiscard]] timer_awaitable sleep_until(clock::time_point deadline, std::stop_token st = {}) noexcept {
+    return timer_awaitable{*this, deadline, std::move(st)};
+  }
+
+  template <typename Rep, typename Period>
+  [[nodiscard]] timer_awaitable sleep_for(std::chrono::duration<Rep, Period> delay,
+                                          std::stop_token st = {}) noexcept {
+    return sleep_until(clock::now() + std::chrono::ceil<clock::duration>(delay), std::move(st));
+  }
+
+  manual_event_loop& get_loop() noexcept { return *loop; }
+};
+
+// Socket operations as coroutines. The fds must be non-blocking. Errors,
+// and cancellation as std::errc::operation_canceled, are thrown as
+// std::system_error.
+
+[[noreturn]] inline void throw_io_error(const char* what) {
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+[[noreturn]] inline void throw_io_cancelled() {
+  throw std::system_error(std::make_error_code(std::errc::operation_canceled));
+}
+
+inline bool would_block(int error) noexcept {
+  return error == EAGAIN || error == EWOULDBLOCK || error == EINTR;
+}
+
+inline task<int> async_accept(io_context& io, int listen_fd, std::stop_token st = {}) {
+  while (true) {
+    int fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd >= 0) {
+      co_return fd;
+    }
+    if (!would_block(errno)) {
+      throw_io_error("accept");
+    }
+    if (!co_await io.readable(listen_fd, st)) {
+      throw_io_cancelled();
+    }
+  }
+}
+
+inline task<void> async_connect(io_context& io, int fd, const sockaddr* addr, socklen_t len,
+                                std::stop_token st = {}) {
+  if (::connect(fd, addr, len) == 0) {
+    co_return;
+  }
+  if (errno != EINPROGRESS) {
+    throw_io_error("connect");
+  }
+  if (!co_await io.writable(fd, st)) {
+    throw_io_cancelled();
+  }
+  int error = 0;
+  socklen_t size = sizeof(error);
+  if (::getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &size) < 0 || error != 0) {
+    errno = error ? error : errno;
+    throw_io_error("connect");
+  }
+}
+
+// Returns as soon as some bytes are received, 0 at end of stream.
+inline task<std::size_t> async_recv(io_context& io, int fd, void* buffer, std::size_t size,
+                                    std::stop_token st = {}) {
+  while (true) {
+    ssize_t n = ::recv(fd, buffer, size, 0);
+    if (n >= 0) {
+      co_return static_cast<std::size_t>(n);
+    }
+    if (!would_block(errno)) {
+      throw_io_error("recv");
+    }
+    if (!co_await io.readable(fd, st)) {
+      throw_io_cancelled();
+    }
+  }
+}
+
+// Returns once all `size` bytes are sent.
+inline task<std::size_t> async_send(io_context& io, int fd, const void* buffer, std::size_t size,
+                                    std::stop_token st = {}) {
+  std::size_t sent = 0;
+  while (sent < size) {
+    ssize_t n = ::send(fd, static_cast<const char*>(buffer) + sent, size - sent, MSG_NOSIGNAL);
+    if (n >= 0) {
+      sent += static_cast<std::size_t>(n);
+    } else if (!would_block(errno)) {
+      throw_io_error("send");
+    } else if (!co_await io.writable(fd, st)) {
+      throw_io_cancelled();
+    }
+  }
+  co_return sent;
+}
+
+// Reads from `offset` on a loop thread. An io_uring backend would make this
+// a real asynchronous read; with epoll the best we can do is keep it off the
+// reactor and off the awaiting coroutine's thread.
+inline task<std::size_t> async_read_file(io_context& io, int fd, void* buffer, std::size_t size,
+                                         off_t offset) {
+  co_await io.get_loop().schedule();
+  ssize_t n = ::pread(fd, buffer, size, offset);
+  if (n < 0) {
+    throw_io_error("pread");
+  }
+  co_return static_cast<std::size_t>(n);
+}
+
 ////////////////////////////////////////////////
 // Helper for improving allocation elision for composed operations.
 //
@@ -646,8 +1602,6 @@ lazy_task(F) -> lazy_task<F>;
 /////////////////////////////////////////////////
 // Example code
 
-#include <unistd.h>
-
 static task<int> f(int i) {
   using namespace std::chrono_literals;
   std::this_thread::sleep_for(1ms);
@@ -685,7 +1639,244 @@ static task<void> nested_scopes(int x, manual_event_loop& loop) {
   std::fflush(stdout);
 }
 
-int main() {
+static task<void> echo_session(io_context& io, int fd) {
+  scope_guard close_on_exit{[fd] { ::close(fd); }};
+  char buffer[1024];
+  while (std::size_t n = co_await async_recv(io, fd, buffer, sizeof(buffer))) {
+    co_await async_send(io, fd, buffer, n);
+  }
+}
+
+// Accepts connections until `st` is stopped, each served by its own coroutine.
+static task<void> echo_server(io_context& io, int listen_fd, std::stop_token st) {
+  async_scope scope;
+  try {
+    while (true) {
+      int fd = co_await async_accept(io, listen_fd, st);
+      scope.spawn_detached(echo_session(io, fd));
+    }
+  } catch (const std::system_error& e) {
+    std::printf("server stopped: %s\n", e.what());
+  }
+  co_await scope.join_async();
+}
+
+static task<void> echo_client(io_context& io, const sockaddr_in& addr, int i) {
+  int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  scope_guard close_on_exit{[fd] { ::close(fd); }};
+  co_await async_connect(io, fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+
+  char message[32];
+  int length = std::snprintf(message, sizeof(message), "hello %i", i);
+  co_await async_send(io, fd, message, length);
+
+  char reply[32];
+  std::size_t n = co_await async_recv(io, fd, reply, sizeof(reply));
+  std::printf("client %i got \"%.*s\"\n", i, (int)n, reply);
+}
+
+static task<void> io_examples(io_context& io) {
+  using namespace std::chrono_literals;
+
+  int listen_fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  scope_guard close_on_exit{[listen_fd] { ::close(listen_fd); }};
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t length = sizeof(addr);
+  if (::bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+      ::listen(listen_fd, 16) < 0 ||
+      ::getsockname(listen_fd, reinterpret_cast<sockaddr*>(&addr), &length) < 0) {
+    throw_io_error("listen");
+  }
+
+  std::stop_source stop_server;
+  async_scope scope;
+  scope.spawn_detached(echo_server(io, listen_fd, stop_server.get_token()));
+  {
+    async_scope clients;
+    for (int i = 0; i < 3; ++i) {
+      clients.spawn_detached(echo_client(io, addr, i));
+    }
+    co_await clients.join_async();
+  }
+  stop_server.request_stop();
+  co_await scope.join_async();
+
+  auto start = std::chrono::steady_clock::now();
+  co_await io.sleep_for(20ms);
+  std::chrono::duration<double, std::milli> slept = std::chrono::steady_clock::now() - start;
+  std::printf("slept %.1f ms\n", slept.count());
+
+  std::stop_source stop_sleep;
+  stop_sleep.request_stop();
+  bool elapsed = co_await io.sleep_for(10s, stop_sleep.get_token());
+  std::printf("cancelled sleep %s\n", elapsed ? "elapsed" : "returned early");
+
+  int exe = ::open("/proc/self/exe", O_RDONLY | O_CLOEXEC);
+  if (exe >= 0) {
+    scope_guard close_exe{[exe] { ::close(exe); }};
+    char magic[4];
+    std::size_t n = co_await async_read_file(io, exe, magic, sizeof(magic), 0);
+    std::printf("read %zu bytes of /proc/self/exe: %s\n", n,
+                std::string_view{magic, n} == "\x7f" "ELF" ? "ELF" : "not ELF");
+  }
+}
+
+/////////////////////////////////////////////////
+// Benchmarks (run with `bench [threads]`)
+
+using bench_clock = std::chrono::steady_clock;
+
+static double ns_since(bench_clock::time_point start, std::size_t count) {
+  std::chrono::duration<double, std::nano> elapsed = bench_clock::now() - start;
+  return elapsed.count() / static_cast<double>(count);
+}
+
+static task<void> leaf(std::size_t& sum, std::size_t i) {
+  sum += i & 1;
+  co_return;
+}
+
+static task<void> leaf_in(std::allocator_arg_t, frame_arena&, std::size_t& sum, std::size_t i) {
+  sum += i & 1;
+  co_return;
+}
+
+// Each spawn allocates two frames: the detached wrapper and the task itself.
+// Both complete synchronously, so the pool serves every frame after the first.
+static void bench_spawn(const char* label, std::size_t count, auto make_task) {
+  std::size_t sum = 0;
+  auto spawn_all = [&](std::size_t n) {
+    async_scope scope;
+    for (std::size_t i = 0; i < n; ++i) {
+      scope.spawn_detached(make_task(sum, i));
+    }
+    sync_wait(scope.join_async());
+  };
+
+  spawn_all(1000);  // warm up
+  std::size_t heap_before = frame_pool::heap_allocations();
+  auto start = bench_clock::now();
+  spawn_all(count);
+  std::printf("%-28s %6.1f ns/spawn, %zu frames from the heap%s\n", label, ns_since(start, count),
+              frame_pool::heap_allocations() - heap_before, sum ? "" : " ");
+}
+
+static task<void> hop(static_thread_pool& pool) {
+  co_await pool.schedule();
+}
+
+static task<void> yield_loop(static_thread_pool& pool, std::size_t count) {
+  for (std::size_t i = 0; i < count; ++i) {
+    co_await pool.schedule();
+  }
+}
+
+static task<std::size_t> chain(std::size_t depth) {
+  if (depth == 0) {
+    co_return 0;
+  }
+  co_return 1 + co_await chain(depth - 1);
+}
+
+static task<void> store(task<std::uint64_t> t, std::uint64_t& out) {
+  out = co_await std::move(t);
+}
+
+// binary fan-out to 2^depth leaves, each doing `work` iterations, then fan-in
+static task<std::uint64_t> tree(static_thread_pool& pool, int depth, std::uint64_t work) {
+  co_await pool.schedule();
+
+  if (depth == 0) {
+    std::uint64_t x = work;
+    for (std::uint64_t i = 0; i < work; ++i) {
+      x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    }
+    co_return (x & 1) + 1;
+  }
+
+  std::uint64_t left = 0, right = 0;
+  async_scope scope;
+  scope.spawn_detached(lazy_task{[&] { return store(tree(pool, depth - 1, work), left); }});
+  scope.spawn_detached(lazy_task{[&] { return store(tree(pool, depth - 1, work), right); }});
+  co_await scope.join_async();
+  co_return left + right;
+}
+
+static void run_benchmarks(std::size_t max_threads) {
+  {
+    const std::size_t count = 1'000'000;
+    frame_pool::set_enabled(false);
+    bench_spawn("spawn, global operator new:", count, [](std::size_t& sum, std::size_t i) {
+      return leaf(sum, i);
+    });
+    frame_pool::set_enabled(true);
+    bench_spawn("spawn, frame_pool:", count, [](std::size_t& sum, std::size_t i) {
+      return leaf(sum, i);
+    });
+
+    alignas(std::max_align_t) static std::byte buffer[4096];
+    frame_arena arena{buffer, sizeof(buffer)};
+    bench_spawn("spawn, frame_arena:", count, [&](std::size_t& sum, std::size_t i) {
+      // every previous task has completed by now
+      arena.reset();
+      return leaf_in(std::allocator_arg, arena, sum, i);
+    });
+    std::printf("\n");
+  }
+
+  {
+    static_thread_pool pool{1};
+    const std::size_t count = 1'000'000;
+
+    auto start = bench_clock::now();
+    {
+      async_scope scope;
+      scope_guard join_on_exit{[&] { sync_wait(scope.join_async()); }};
+      for (std::size_t i = 0; i < count; ++i) {
+        scope.spawn_detached(lazy_task{[&] { return hop(pool); }});
+      }
+    }
+    std::printf("spawn + remote schedule + complete: %6.1f ns/task\n", ns_since(start, count));
+
+    start = bench_clock::now();
+    sync_wait(yield_loop(pool, count));
+    std::printf("resume via worker LIFO slot:        %6.1f ns/resume\n", ns_since(start, count));
+
+    const std::size_t depth = 1'000'000;
+    start = bench_clock::now();
+    std::size_t reached = sync_wait(chain(depth));
+    std::printf("co_await chain of %zu frames:   %6.1f ns/level (%s)\n", depth,
+                ns_since(start, depth), reached == depth ? "ok" : "wrong");
+  }
+
+  const int depth = 16;
+  const std::uint64_t work = 2000;
+  std::printf("\nfan-out/fan-in tree of %d leaves x %llu iterations\n", 1 << depth,
+              (unsigned long long)work);
+  std::printf("threads  ms       speedup\n");
+
+  double base = 0;
+  for (std::size_t threads = 1; threads <= max_threads; threads *= 2) {
+    static_thread_pool pool{threads};
+    auto start = bench_clock::now();
+    std::uint64_t leaves = sync_wait(tree(pool, depth, work));
+    double ms = ns_since(start, 1) / 1e6;
+    if (threads == 1) {
+      base = ms;
+    }
+    std::printf("%-8zu %-8.1f %.2fx%s\n", threads, ms, base / ms, leaves ? "" : " ");
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc > 1 && std::string_view{argv[1]} == "bench") {
+    unsigned hardware = std::thread::hardware_concurrency();
+    run_benchmarks(argc > 2 ? std::strtoul(argv[2], nullptr, 10) : std::max(hardware, 1u));
+    return 0;
+  }
+
   manual_event_loop loop;
 
   std::jthread thd{[&](std::stop_token st) {
@@ -727,6 +1918,16 @@ int main() {
     }
   }
 
+  std::printf("starting io example\n");
+
+  {
+    io_context io{loop};
+    std::jthread reactor{[&](std::stop_token st) {
+      io.run(st);
+    }};
+    sync_wait(io_examples(io));
+  }
+
   return 0;
 }
 
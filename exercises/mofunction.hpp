@@ -0,0 +1,973 @@
+#pragma once
+
+#include <cxxabi.h>
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+
+// ==== Implementation ========================================================
+
+namespace core {
+namespace detail {
+template <typename Type>
+std::string to_type_string() {
+  int status = 0;
+  std::unique_ptr<char, decltype(&std::free)> buffer {
+      abi::__cxa_demangle(typeid(Type).name(), nullptr, nullptr, &status),
+      &std::free};
+  assert(status == 0 && "Demanging failed");
+
+  return buffer ? buffer.get() : typeid(Type).name();
+}
+
+class bad_erasure_trait : public std::logic_error {
+  using std::logic_error::logic_error;
+};
+
+struct basic_eraser {
+  using erased_allocate = void* (*)();
+  using erased_delete = void (*)(void*);
+  using erased_construct = void (*)(void*);
+  using erased_destroy = void (*)(void*);
+
+  template <typename Type>
+  static void* typed_allocate() {
+    return new std::aligned_storage_t<sizeof(Type), alignof(Type)>;
+  }
+
+  template <typename Type>
+  static void typed_delete(void* target) {
+    auto* recovered = reinterpret_cast<Type*>(target);
+
+    delete recovered;
+  }
+
+  template <typename Type>
+  static void typed_construct(void* target) {
+    if constexpr (std::is_default_constructible_v<Type>) {
+      auto* recovered = reinterpret_cast<Type*>(target);
+
+      new (recovered) Type();
+    } else {
+      throw bad_erasure_trait(to_type_string<Type>() +
+                              " is not default constructible");
+    }
+  }
+
+  template <typename Type>
+  static void typed_destroy(void* target) {
+    if constexpr (std::is_destructible_v<Type>) {
+      auto* recovered = reinterpret_cast<Type*>(target);
+
+      recovered->~Type();
+    } else {
+      throw bad_erasure_trait(to_type_string<Type>() + " is not destructible");
+    }
+  }
+};
+
+struct copy_eraser {
+  using erased_construct = void (*)(void*, void*);
+  using erased_assign = void (*)(void*, void*);
+
+  template <typename Type>
+  static void typed_construct(void* src, void* dst) {
+    if constexpr (std::is_copy_constructible_v<Type>) {
+      auto* recovered_src = reinterpret_cast<const Type*>(src);
+      auto* recovered_dst = reinterpret_cast<Type*>(dst);
+
+      new (recovered_dst) Type(*recovered_src);
+    } else {
+      throw bad_erasure_trait(to_type_string<Type>() +
+                              " is not copy constructible");
+    }
+  }
+
+  template <typename Type>
+  static void typed_assign(void* src, void* dst) {
+    if constexpr (std::is_copy_assignable_v<Type>) {
+      auto* recovered_src = reinterpret_cast<const Type*>(src);
+      auto* recovered_dst = reinterpret_cast<Type*>(dst);
+
+      *recovered_dst = *recovered_src;
+    } else {
+      throw bad_erasure_trait(to_type_string<Type>() +
+                              " is not copy assignable");
+    }
+  }
+};
+
+struct move_eraser {
+  using erased_construct = void (*)(void*, void*);
+  using erased_assign = void (*)(void*, void*);
+
+  template <typename Type>
+  static void typed_construct(void* src, void* dst) {
+    if constexpr (std::is_move_constructible_v<Type>) {
+      auto* recovered_src = reinterpret_cast<Type*>(src);
+      auto* recovered_dst = reinterpret_cast<Type*>(dst);
+
+      new (recovered_dst) Type(std::move(*recovered_src));
+    } else {
+      throw bad_erasure_trait(to_type_string<Type>() +
+                              " is not move constructible");
+    }
+  }
+
+  template <typename Type>
+  static void typed_assign(void* src, void* dst) {
+    if constexpr (std::is_move_assignable_v<Type>) {
+      auto* recovered_src = reinterpret_cast<Type*>(src);
+      auto* recovered_dst = reinterpret_cast<Type*>(dst);
+
+      *recovered_dst = std::move(*recovered_src);
+    } else {
+      throw bad_erasure_trait(to_type_string<Type>() +
+                              " is not move assignable");
+    }
+  }
+
+  // move constructs dst from src, then destroys src
+  template <typename Type>
+  static void typed_relocate(void* src, void* dst) {
+    typed_construct<Type>(src, dst);
+    reinterpret_cast<Type*>(src)->~Type();
+  }
+};
+
+// Whether a Type can be moved by copying its bytes and forgetting the source.
+// Conservatively the trivially movable and destructible types; specialize for
+// others known to be safe (e.g. holding a unique_ptr).
+template <typename Type>
+struct is_trivially_relocatable
+    : std::bool_constant<std::is_trivially_move_constructible_v<Type> &&
+                         std::is_trivially_destructible_v<Type>> {};
+
+template <typename Type>
+inline constexpr bool is_trivially_relocatable_v =
+    is_trivially_relocatable<Type>::value;
+
+template <typename Signature>
+struct call_traits {};
+
+template <typename Return, typename... Args>
+struct call_traits<Return(Args...)> {
+  using signature_type = Return(Args...);
+  using result_type = Return;
+
+  template <typename Target>
+  static inline constexpr bool is_invocable_with =
+      std::is_invocable_r<Return, Target&, Args...>::value;
+
+  template <typename Target>
+  static inline constexpr bool is_nothrow_invocable_with =
+      std::is_nothrow_invocable_r<Return, Target, Args...>::value;
+};
+
+template <typename Return, typename... Args>
+struct call_traits<Return(Args...) const> {
+  using signature_type = Return(Args...) const;
+  using result_type = Return;
+
+  template <typename Target>
+  static inline constexpr bool is_invocable_with =
+      std::is_invocable_r<Return, const Target&, Args...>::value;
+
+  template <typename Target>
+  static inline constexpr bool is_nothrow_invocable_with =
+      std::is_nothrow_invocable_r<Return, const Target&, Args...>::value;
+};
+
+template <typename Return, typename... Args>
+struct call_traits<Return(Args...) &&> {
+  using signature_type = Return(Args...) &&;
+  using result_type = Return;
+
+  template <typename Target>
+  static inline constexpr bool is_invocable_with =
+      std::is_invocable_r<Return, Target&&, Args...>::value;
+
+  template <typename Target>
+  static inline constexpr bool is_nothrow_invocable_with =
+      std::is_nothrow_invocable_r<Return, Target&&, Args...>::value;
+};
+
+template <typename Target, typename... Args>
+using call_result = decltype(std::declval<Target>()(std::declval<Args>()...));
+
+template <typename Signature>
+class call_eraser {};
+
+template <typename Return, typename... Args>
+struct call_eraser<Return(Args...)> {
+  using erased_call = Return (*)(void*, Args...);
+
+  template <typename Target>
+  static Return typed_call(void* target, Args... args) {
+    if constexpr (call_traits<Return(
+                      Args...)>::template is_invocable_with<Target>) {
+      auto* recovered = reinterpret_cast<Target*>(target);
+      return std::invoke(*recovered, std::forward<Args>(args)...);
+    } else {
+      static_assert("Not lvalue callable");
+    }
+  }
+};
+
+template <typename Return, typename... Args>
+struct call_eraser<Return(Args...) const> {
+  using erased_call = Return (*)(const void*, Args...);
+
+  template <typename Target>
+  static Return typed_call(const void* target, Args... args) {
+    if constexpr (call_traits<Return(Args...)
+                                  const>::template is_invocable_with<Target>) {
+      auto* recovered = reinterpret_cast<const Target*>(target);
+      return std::invoke(*recovered, std::forward<Args>(args)...);
+    } else {
+      static_assert("Not const callable");
+    }
+  }
+};
+
+template <typename Return, typename... Args>
+struct call_eraser<Return(Args...) &&> {
+  using erased_call = Return (*)(void*, Args&&...);
+
+  template <typename Target>
+  static Return typed_call(void* target, Args&&... args) {
+    if constexpr (call_traits<Return(Args...) &&>::template is_invocable_with<
+                      Target>) {
+      auto* recovered = reinterpret_cast<Target*>(target);
+      return std::invoke(std::move(*recovered), std::forward<Args>(args)...);
+    } else {
+      static_assert("Not rvalue callable");
+    }
+  }
+};
+
+struct op_allocate {};
+struct op_delete {};
+struct op_destroy {};
+struct op_default_construct {};
+struct op_copy_construct {};
+struct op_copy_assign {};
+struct op_move_construct {};
+struct op_move_assign {};
+struct op_relocate {};
+struct op_call {};
+
+template <typename Mixed>
+class heap_storage_mixin {
+ public:
+  template <typename Erased, typename... Args>
+  static auto make(Args&&... args) {
+    return heap_storage_mixin(new Erased(std::forward<Args>(args)...));
+  }
+
+  heap_storage_mixin() = default;
+
+  heap_storage_mixin(const heap_storage_mixin& that)
+      : address_(static_cast<Mixed*>(this)->operate(op_allocate{})) {
+    static_cast<Mixed*>(this)->operate(op_copy_construct{}, that.address_,
+                                       address_);
+  }
+
+  heap_storage_mixin& operator=(const heap_storage_mixin& that) {
+    if (address_ != that.address_) {
+      if (!address_) {
+        address_ = static_cast<Mixed*>(this)->operate(op_allocate{});
+      }
+      static_cast<Mixed*>(this)->operate(op_copy_assign{}, that.address_,
+                                         address_);
+    }
+    return *this;
+  }
+
+  heap_storage_mixin(heap_storage_mixin&& that) { swap(that); }
+
+  heap_storage_mixin& operator=(heap_storage_mixin&& that) {
+    if (address_ != that.address_) {
+      swap(that);
+    }
+    return *this;
+  }
+
+  ~heap_storage_mixin() noexcept { release(); }
+
+  void* address() const noexcept { return address_; }
+
+  void swap(heap_storage_mixin& that) noexcept {
+    std::swap(address_, that.address_);
+  }
+
+  void release() {
+    if (address_) {
+      static_cast<Mixed*>(this)->operate(op_delete{}, address_);
+    }
+  }
+
+ private:
+  explicit heap_storage_mixin(void* address) : address_(address) {}
+
+  void* address_ = nullptr;
+};
+
+// Keeps targets of up to Size bytes and Align alignment, that are nothrow move
+// constructible, in a buffer inside the object, and larger ones on the heap.
+// A heap target is held by pointer in the buffer, so it and trivially
+// relocatable inline targets are moved by copying the buffer; only other
+// inline targets are relocated through the dispatch. As with
+// heap_storage_mixin, the Mixed dispatch must be assigned before the storage.
+template <typename Mixed, size_t Size = 3 * sizeof(void*),
+          size_t Align = alignof(std::max_align_t)>
+class inline_storage_mixin {
+ public:
+  template <typename Erased>
+  static inline constexpr bool is_inline =
+      sizeof(Erased) <= Size && Align % alignof(Erased) == 0 &&
+      std::is_nothrow_move_constructible_v<Erased>;
+
+  inline_storage_mixin() = default;
+
+  template <typename Erased, typename... Args>
+  explicit inline_storage_mixin(std::in_place_type_t<Erased>, Args&&... args) {
+    if constexpr (is_inline<Erased>) {
+      new (buffer_) Erased(std::forward<Args>(args)...);
+      kind_ = is_trivially_relocatable_v<Erased> ? kind::trivial : kind::local;
+    } else {
+      heap() = new Erased(std::forward<Args>(args)...);
+      kind_ = kind::heap;
+    }
+  }
+
+  inline_storage_mixin(const inline_storage_mixin& that) { copy(that); }
+
+  inline_storage_mixin& operator=(const inline_storage_mixin& that) {
+    if (this != &that) {
+      release();
+      copy(that);
+    }
+    return *this;
+  }
+
+  inline_storage_mixin(inline_storage_mixin&& that) noexcept { take(that); }
+
+  inline_storage_mixin& operator=(inline_storage_mixin&& that) noexcept {
+    if (this != &that) {
+      release();
+      take(that);
+    }
+    return *this;
+  }
+
+  ~inline_storage_mixin() noexcept { release(); }
+
+  void* address() const noexcept {
+    switch (kind_) {
+      case kind::empty:
+        return nullptr;
+      case kind::heap:
+        return heap();
+      default:
+        return const_cast<unsigned char*>(buffer_);
+    }
+  }
+
+  void release() noexcept {
+    switch (kind_) {
+      case kind::empty:
+      case kind::trivial:
+        break;
+      case kind::local:
+        static_cast<Mixed*>(this)->operate(op_destroy{}, buffer_);
+        break;
+      case kind::heap:
+        static_cast<Mixed*>(this)->operate(op_delete{}, heap());
+        break;
+    }
+    kind_ = kind::empty;
+  }
+
+ private:
+  enum class kind : unsigned char { empty, trivial, local, heap };
+
+  void*& heap() const noexcept {
+    return *reinterpret_cast<void**>(const_cast<unsigned char*>(buffer_));
+  }
+
+  void take(inline_storage_mixin& that) noexcept {
+    if (that.kind_ == kind::local) {
+      static_cast<Mixed*>(this)->operate(op_relocate{}, that.buffer_, buffer_);
+    } else if (that.kind_ != kind::empty) {
+      std::memcpy(buffer_, that.buffer_, Size);
+    }
+    kind_ = std::exchange(that.kind_, kind::empty);
+  }
+
+  void copy(const inline_storage_mixin& that) {
+    void* source = that.address();
+    if (that.kind_ == kind::heap) {
+      heap() = static_cast<Mixed*>(this)->operate(op_allocate{});
+      static_cast<Mixed*>(this)->operate(op_copy_construct{}, source, heap());
+    } else if (source) {
+      static_cast<Mixed*>(this)->operate(op_copy_construct{}, source, buffer_);
+    }
+    kind_ = that.kind_;
+  }
+
+  static_assert(Size >= sizeof(void*), "the buffer also holds a heap pointer");
+
+  alignas(Align) unsigned char buffer_[Size] = {};
+  kind kind_ = kind::empty;
+};
+
+// Refers to a target owned elsewhere, which must outlive it.
+class reference_storage_mixin {
+ public:
+  reference_storage_mixin() = default;
+  explicit reference_storage_mixin(void* address) noexcept
+      : address_(address) {}
+
+  void* address() const noexcept { return address_; }
+
+ private:
+  void* address_ = nullptr;
+};
+
+class compact_dispatch_mixin {
+ public:
+  template <typename Erased>
+  static auto make() {
+    return compact_dispatch_mixin(typed_dispatch<Erased>);
+  }
+
+  compact_dispatch_mixin() = default;
+  ~compact_dispatch_mixin() = default;
+
+  compact_dispatch_mixin(const compact_dispatch_mixin&) = default;
+  compact_dispatch_mixin& operator=(const compact_dispatch_mixin&) = default;
+
+  compact_dispatch_mixin(compact_dispatch_mixin&&) = default;
+  compact_dispatch_mixin& operator=(compact_dispatch_mixin&&) = default;
+
+  void* operate(op_allocate) {
+    return erased_dispatch_(operation::do_allocate, nullptr, nullptr);
+  }
+
+  void operate(op_delete, void* object) {
+    erased_dispatch_(operation::do_delete, object, nullptr);
+  }
+
+  void operate(op_default_construct, void* object) {
+    erased_dispatch_(operation::do_default_construct, object, nullptr);
+  }
+
+  void operate(op_destroy, void* object) {
+    erased_dispatch_(operation::do_destroy, object, nullptr);
+  }
+
+  void operate(op_copy_construct, void* src, void* dst) {
+    erased_dispatch_(operation::do_copy_construct, src, dst);
+  }
+
+  void operate(op_copy_assign, void* src, void* dst) {
+    erased_dispatch_(operation::do_copy_assign, src, dst);
+  }
+
+  void operate(op_move_construct, void* src, void* dst) {
+    erased_dispatch_(operation::do_move_construct, src, dst);
+  }
+
+  void operate(op_move_assign, void* src, void* dst) {
+    erased_dispatch_(operation::do_move_assign, src, dst);
+  }
+
+  void operate(op_relocate, void* src, void* dst) {
+    erased_dispatch_(operation::do_relocate, src, dst);
+  }
+
+  void swap(compact_dispatch_mixin& that) noexcept {
+    std::swap(erased_dispatch_, that.erased_dispatch_);
+  }
+
+ private:
+  enum class operation {
+    do_allocate,
+    do_delete,
+    do_destroy,
+    do_default_construct,
+    do_copy_construct,
+    do_copy_assign,
+    do_move_construct,
+    do_move_assign,
+    do_relocate,
+  };
+
+  template <typename Type>
+  static void* typed_dispatch(operation op, void* lhs, void* rhs) {
+    switch (op) {
+      case operation::do_allocate:
+        return basic_eraser::typed_allocate<Type>();
+      case operation::do_delete:
+        basic_eraser::typed_delete<Type>(lhs);
+        break;
+      case operation::do_default_construct:
+        basic_eraser::typed_construct<Type>(lhs);
+        break;
+      case operation::do_destroy:
+        basic_eraser::typed_destroy<Type>(lhs);
+        break;
+      case operation::do_copy_construct:
+        copy_eraser::typed_construct<Type>(lhs, rhs);
+        break;
+      case operation::do_copy_assign:
+        copy_eraser::typed_assign<Type>(lhs, rhs);
+        break;
+      case operation::do_move_construct:
+        move_eraser::typed_construct<Type>(lhs, rhs);
+        break;
+      case operation::do_move_assign:
+        move_eraser::typed_assign<Type>(lhs, rhs);
+        break;
+      case operation::do_relocate:
+        move_eraser::typed_relocate<Type>(lhs, rhs);
+        break;
+    }
+    return nullptr;
+  }
+
+  explicit compact_dispatch_mixin(void* (*dispatch)(operation op, void*, void*))
+      : erased_dispatch_(dispatch) {}
+
+  void* (*erased_dispatch_)(operation op, void*, void*) = nullptr;
+};
+
+template <typename Signature>
+class callable_dispatch_mixin {
+ public:
+  template <typename Target>
+  static auto make() {
+    return callable_dispatch_mixin(
+        call_eraser<Signature>::template typed_call<Target>);
+  }
+
+  callable_dispatch_mixin() = default;
+  ~callable_dispatch_mixin() = default;
+
+  callable_dispatch_mixin(const callable_dispatch_mixin&) = default;
+  callable_dispatch_mixin& operator=(const callable_dispatch_mixin&) = default;
+
+  callable_dispatch_mixin(callable_dispatch_mixin&&) = default;
+  callable_dispatch_mixin& operator=(callable_dispatch_mixin&&) = default;
+
+  template <typename Return, typename... Args>
+  Return operate(op_call, void* target, Args&&... args) const {
+    if (!erased_call_) {
+      throw std::bad_function_call();
+    }
+    return erased_call_(target, std::forward<Args>(args)...);
+  }
+
+  void swap(callable_dispatch_mixin& that) noexcept {
+    std::swap(erased_call_, that.erased_call_);
+  }
+
+ private:
+  explicit callable_dispatch_mixin(
+      typename call_eraser<Signature>::erased_call call)
+      : erased_call_(call) {}
+
+  typename call_eraser<Signature>::erased_call erased_call_ = nullptr;
+};
+
+template <typename Signature>
+class callable_compact_dispatch_mixin
+    : public callable_dispatch_mixin<Signature>,
+      compact_dispatch_mixin {
+ public:
+  template <typename Target>
+  static auto make() {
+    return callable_compact_dispatch_mixin(
+        callable_dispatch_mixin<Signature>::template make<Target>(),
+        compact_dispatch_mixin::template make<Target>());
+  }
+
+  callable_compact_dispatch_mixin() = default;
+  ~callable_compact_dispatch_mixin() = default;
+
+  callable_compact_dispatch_mixin(const callable_compact_dispatch_mixin&) =
+      default;
+  callable_compact_dispatch_mixin& operator=(
+      const callable_compact_dispatch_mixin&) = default;
+
+  callable_compact_dispatch_mixin(callable_compact_dispatch_mixin&&) = default;
+  callable_compact_dispatch_mixin& operator=(
+      callable_compact_dispatch_mixin&&) = default;
+
+  void swap(callable_compact_dispatch_mixin& that) noexcept {
+    callable_dispatch_mixin<Signature>::swap(that);
+    compact_dispatch_mixin::swap(that);
+  }
+
+  using callable_dispatch_mixin<Signature>::operate;
+  using compact_dispatch_mixin::operate;
+
+ private:
+  explicit callable_compact_dispatch_mixin(
+      callable_dispatch_mixin<Signature> callable,
+      compact_dispatch_mixin compact)
+      : callable_dispatch_mixin<Signature>(std::move(callable)),
+        compact_dispatch_mixin(std::move(compact)) {}
+};
+
+template <typename Mixed, typename Signature>
+class callable_interface_mixin {};
+
+template <typename Mixed, typename Return, typename... Args>
+struct callable_interface_mixin<Mixed, Return(Args...) const> {
+  Return operator()(Args... args) const& {
+    return static_cast<const Mixed*>(this)->template operate<Return, Args...>(
+        op_call{}, static_cast<const Mixed*>(this)->address(),
+        std::forward<Args>(args)...);
+  }
+};
+
+template <typename Mixed, typename Return, typename... Args>
+struct callable_interface_mixin<Mixed, Return(Args...)> {
+  Return operator()(Args... args) {
+    return static_cast<Mixed*>(this)->template operate<Return, Args...>(
+        op_call{}, static_cast<Mixed*>(this)->address(),
+        std::forward<Args>(args)...);
+  }
+};
+
+template <typename Mixed, typename Return, typename... Args>
+struct callable_interface_mixin<Mixed, Return(Args...) &&> {
+  Return operator()(Args... args) && {
+    return static_cast<Mixed*>(this)->template operate<Return, Args...>(
+        op_call{}, static_cast<Mixed*>(this)->address(),
+        std::forward<Args>(args)...);
+  }
+};
+
+// A reference is a pointer: calling through it never changes the reference,
+// so a plain signature is called like a const one
+template <typename Signature>
+struct reference_call {
+  using type = Signature;
+};
+
+template <typename Return, typename... Args>
+struct reference_call<Return(Args...)> {
+  using type = Return(Args...) const;
+};
+
+template <typename Signature>
+using reference_call_t = typename reference_call<Signature>::type;
+
+}  // namespace detail
+
+template <typename Signature>
+class mofunction
+    : public detail::callable_interface_mixin<mofunction<Signature>, Signature>,
+      private detail::callable_compact_dispatch_mixin<Signature>,
+      detail::inline_storage_mixin<mofunction<Signature>> {
+ private:
+  using interface_mixin_type =
+      detail::callable_interface_mixin<mofunction<Signature>, Signature>;
+  using dispatch_mixin_type = detail::callable_compact_dispatch_mixin<Signature>;
+  using storage_mixin_type = detail::inline_storage_mixin<mofunction<Signature>>;
+
+  friend interface_mixin_type;
+  friend dispatch_mixin_type;
+  friend storage_mixin_type;
+
+  template <class Target>
+  using target_requirements = std::enable_if_t<
+      detail::call_traits<Signature>::template is_invocable_with<Target> &&
+          !std::is_same_v<std::decay_t<Target>, mofunction>,
+      int>;  // nothrow invocable?
+
+ public:
+  using result_type = typename detail::call_traits<Signature>::result_type;
+
+  mofunction() noexcept = default;
+  mofunction(std::nullptr_t) noexcept : mofunction() {}
+
+  mofunction& operator=(std::nullptr_t) noexcept {
+    storage_mixin_type::release();
+    dispatch_mixin_type::operator=(dispatch_mixin_type{});
+    return *this;
+  }
+
+  // the target is relocated by the dispatch it came with, and f left empty
+  mofunction(mofunction&& f) noexcept
+      : dispatch_mixin_type(static_cast<dispatch_mixin_type&&>(f)),
+        storage_mixin_type(static_cast<storage_mixin_type&&>(f)) {
+    f.dispatch_mixin_type::operator=(dispatch_mixin_type{});
+  }
+
+  // our target is released with our own dispatch before taking f's
+  mofunction& operator=(mofunction&& f) noexcept {
+    if (this != &f) {
+      storage_mixin_type::release();
+      dispatch_mixin_type::operator=(static_cast<dispatch_mixin_type&&>(f));
+      storage_mixin_type::operator=(static_cast<storage_mixin_type&&>(f));
+      f.dispatch_mixin_type::operator=(dispatch_mixin_type{});
+    }
+    return *this;
+  }
+
+  mofunction(const mofunction&) = delete;
+  mofunction& operator=(const mofunction&) = delete;
+
+  ~mofunction() = default;
+
+  template <class Target, target_requirements<Target> = 0>
+  mofunction(Target&& target)
+      : dispatch_mixin_type(
+            dispatch_mixin_type::template make<std::decay_t<Target>>()),
+        storage_mixin_type(std::in_place_type<std::decay_t<Target>>,
+                           std::forward<Target>(target)) {}
+
+  template <class Target, target_requirements<Target> = 0>
+  mofunction& operator=(Target&& target) {
+    return *this = mofunction(std::forward<Target>(target));
+  }
+
+  void swap(mofunction& f) noexcept {
+    mofunction g(std::move(f));
+    f = std::move(*this);
+    *this = std::move(g);
+  }
+
+  explicit operator bool() const noexcept {
+    return storage_mixin_type::address() != nullptr;
+  }
+};
+
+template <typename Signature>
+bool operator==(const mofunction<Signature>& f, std::nullptr_t) noexcept {
+  return !static_cast<bool>(f);
+}
+
+template <typename Signature>
+bool operator==(std::nullptr_t, const mofunction<Signature>& f) noexcept {
+  return !static_cast<bool>(f);
+}
+
+template <typename Signature>
+bool operator!=(const mofunction<Signature>& f, std::nullptr_t) noexcept {
+  return static_cast<bool>(f);
+}
+
+template <typename Signature>
+bool operator!=(std::nullptr_t, const mofunction<Signature>& f) noexcept {
+  return static_cast<bool>(f);
+}
+
+template <typename Signature>
+void swap(mofunction<Signature>& f, mofunction<Signature>& g) noexcept {
+  f.swap(g);
+}
+
+// Non-owning reference to a callable, for synchronous callbacks: a target
+// pointer and a call pointer, never allocating. A function pointer is held by
+// value; anything else must outlive the function_ref.
+template <typename Signature>
+class function_ref
+    : public detail::callable_interface_mixin<
+          function_ref<Signature>, detail::reference_call_t<Signature>>,
+      private detail::callable_dispatch_mixin<Signature>,
+      detail::reference_storage_mixin {
+ private:
+  using interface_mixin_type = detail::callable_interface_mixin<
+      function_ref<Signature>, detail::reference_call_t<Signature>>;
+  using dispatch_mixin_type = detail::callable_dispatch_mixin<Signature>;
+  using storage_mixin_type = detail::reference_storage_mixin;
+
+  friend interface_mixin_type;
+
+  // function lvalues and pointers are called through the function type
+  template <class Target>
+  using erased_type = std::conditional_t<
+      std::is_function_v<std::remove_pointer_t<std::decay_t<Target>>>,
+      std::remove_pointer_t<std::decay_t<Target>>,
+      std::remove_reference_t<Target>>;
+
+  template <class Target>
+  using target_requirements = std::enable_if_t<
+      detail::call_traits<Signature>::template is_invocable_with<
+          erased_type<Target>> &&
+          !std::is_same_v<std::remove_cvref_t<Target>, function_ref>,
+      int>;
+
+  template <class Target>
+  static void* erase(Target&& target) noexcept {
+    if constexpr (std::is_function_v<std::remove_reference_t<Target>>) {
+      return reinterpret_cast<void*>(&target);
+    } else if constexpr (std::is_function_v<
+                             std::remove_pointer_t<std::decay_t<Target>>>) {
+      return reinterpret_cast<void*>(target);
+    } else {
+      return const_cast<void*>(
+          static_cast<const void*>(std::addressof(target)));
+    }
+  }
+
+ public:
+  using result_type = typename detail::call_traits<Signature>::result_type;
+
+  template <class Target, target_requirements<Target> = 0>
+  function_ref(Target&& target) noexcept
+      : dispatch_mixin_type(
+            dispatch_mixin_type::template make<erased_type<Target>>()),
+        storage_mixin_type(erase(std::forward<Target>(target))) {}
+
+  function_ref(const function_ref&) noexcept = default;
+  function_ref& operator=(const function_ref&) noexcept = default;
+};
+
+// Owning, copyable callable that keeps its target inside the object and
+// never allocates. Targets must be copy constructible and nothrow move
+// constructible, and fit Capacity and Alignment, or the construction fails to
+// compile.
+template <typename Signature, size_t Capacity = 3 * sizeof(void*),
+          size_t Alignment = alignof(std::max_align_t)>
+class inplace_function
+    : public detail::callable_interface_mixin<
+          inplace_function<Signature, Capacity, Alignment>, Signature>,
+      private detail::callable_compact_dispatch_mixin<Signature>,
+      detail::inline_storage_mixin<
+          inplace_function<Signature, Capacity, Alignment>, Capacity,
+          Alignment> {
+ private:
+  using interface_mixin_type = detail::callable_interface_mixin<
+      inplace_function<Signature, Capacity, Alignment>, Signature>;
+  using dispatch_mixin_type = detail::callable_compact_dispatch_mixin<Signature>;
+  using storage_mixin_type =
+      detail::inline_storage_mixin<inplace_function, Capacity, Alignment>;
+
+  friend interface_mixin_type;
+  friend dispatch_mixin_type;
+  friend storage_mixin_type;
+
+  template <class Target>
+  using target_requirements = std::enable_if_t<
+      detail::call_traits<Signature>::template is_invocable_with<
+          std::decay_t<Target>> &&
+          std::is_copy_constructible_v<std::decay_t<Target>> &&
+          !std::is_same_v<std::decay_t<Target>, inplace_function>,
+      int>;
+
+ public:
+  using result_type = typename detail::call_traits<Signature>::result_type;
+
+  inplace_function() noexcept = default;
+  inplace_function(std::nullptr_t) noexcept : inplace_function() {}
+
+  inplace_function& operator=(std::nullptr_t) noexcept {
+    storage_mixin_type::release();
+    dispatch_mixin_type::operator=(dispatch_mixin_type{});
+    return *this;
+  }
+
+  template <class Target, target_requirements<Target> = 0>
+  inplace_function(Target&& target)
+      : dispatch_mixin_type(
+            dispatch_mixin_type::template make<std::decay_t<Target>>()),
+        storage_mixin_type(std::in_place_type<std::decay_t<Target>>,
+                           std::forward<Target>(target)) {
+    static_assert(
+        storage_mixin_type::template is_inline<std::decay_t<Target>>,
+        "inplace_function target is too large, overaligned or may throw on "
+        "move");
+  }
+
+  template <class Target, target_requirements<Target> = 0>
+  inplace_function& operator=(Target&& target) {
+    return *this = inplace_function(std::forward<Target>(target));
+  }
+
+  inplace_function(const inplace_function& f)
+      : dispatch_mixin_type(static_cast<const dispatch_mixin_type&>(f)),
+        storage_mixin_type(static_cast<const storage_mixin_type&>(f)) {}
+
+  inplace_function& operator=(const inplace_function& f) {
+    if (this != &f) {
+      storage_mixin_type::release();
+      dispatch_mixin_type::operator=(static_cast<const dispatch_mixin_type&>(f));
+      storage_mixin_type::operator=(static_cast<const storage_mixin_type&>(f));
+    }
+    return *this;
+  }
+
+  inplace_function(inplace_function&& f) noexcept
+      : dispatch_mixin_type(static_cast<dispatch_mixin_type&&>(f)),
+        storage_mixin_type(static_cast<storage_mixin_type&&>(f)) {
+    f.dispatch_mixin_type::operator=(dispatch_mixin_type{});
+  }
+
+  inplace_function& operator=(inplace_function&& f) noexcept {
+    if (this != &f) {
+      storage_mixin_type::release();
+      dispatch_mixin_type::operator=(static_cast<dispatch_mixin_type&&>(f));
+      storage_mixin_type::operator=(static_cast<storage_mixin_type&&>(f));
+      f.dispatch_mixin_type::operator=(dispatch_mixin_type{});
+    }
+    return *this;
+  }
+
+  ~inplace_function() = default;
+
+  void swap(inplace_function& f) noexcept {
+    inplace_function g(std::move(f));
+    f = std::move(*this);
+    *this = std::move(g);
+  }
+
+  explicit operator bool() const noexcept {
+    return storage_mixin_type::address() != nullptr;
+  }
+};
+
+template <typename Signature, size_t Capacity, size_t Alignment>
+bool operator==(const inplace_function<Signature, Capacity, Alignment>& f,
+                std::nullptr_t) noexcept {
+  return !static_cast<bool>(f);
+}
+
+template <typename Signature, size_t Capacity, size_t Alignment>
+bool operator!=(const inplace_function<Signature, Capacity, Alignment>& f,
+                std::nullptr_t) noexcept {
+  return static_cast<bool>(f);
+}
+
+template <typename Signature, size_t Capacity, size_t Alignment>
+void swap(inplace_function<Signature, Capacity, Alignment>& f,
+          inplace_function<Signature, Capacity, Alignment>& g) noexcept {
+  f.swap(g);
+}
+
+/*
+// template <class R, class... As>
+// mofunction(R (*)(As...))->mofunction<R(As...)>;
+
+// Remarks: This deduction guide participates in overload resolution only if
+// &Target::operator() is well-formed when treated as an unevaluated operand. In
+that
+// case, if decltype(&Target::operator()) is of the form R(G::*)(A...) cv &opt
+// noexceptopt for a class type G, then the deduced type is mofunction<R(A...)>.
+// template <class Target> mofunction(Target)->mofunction<>;
+
+*/
+}  // namespace core
@@ -1,5 +1,22 @@
+// Properties notifying on every set, and a reactive graph of sources and 
+// values computed from them on demand
+//
+// g++ -std=c++17 -O2 property.cpp
+//
+// property          properties demo
+// property bench    wide, deep and diamond bindings as chained properties
+//                   and as a graph
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <functional>
+#include <memory>
+#include <optional>
+#include <string>
 #include <type_traits>
 #include <vector>
 
@@ -45,6 +62,11 @@ class signal
         delegate(args...);
     }
 
+    bool empty() const
+    {
+      return delegates_.empty();
+    }
+
   private:
     std::vector<std::function<void(Args...)>> delegates_;
 };
@@ -240,6 +262,387 @@ std::istream &operator>>(std::istream &input, property<T> &p)
   return input >> p.value();
 }
 
+
+// Reactive property graph: a set only marks what depends on it dirty, and a
+// derived value is recomputed when read, after whatever it reads, and only if
+// one of its inputs has a new version since it was last computed. A derived
+// value that comes out equal keeps its version, which stops the recomputation
+// there. Nodes are destroyed before the nodes they read.
+
+class graph;
+
+class node
+{
+  public:
+    node (node const &) = delete;
+    node &operator= (node const &) = delete;
+
+    virtual ~node ();
+
+  protected:
+    explicit node (graph &g) : 
+      graph_ {g} {}
+
+    void depends_on (node &input)
+    {
+      inputs_.push_back ({&input, never});
+      input.dependents_.push_back (this);
+    }
+
+    // returns whether the value changed
+    virtual bool recompute () { return false; }
+    virtual void commit () {}
+    virtual void notify () {}
+    virtual bool observed () const { return false; }
+
+  protected:
+    constexpr static uint64_t never = uint64_t (-1);
+
+    graph &graph_;
+    uint64_t version_ = 0;
+    bool dirty_ = false;
+
+  private:
+    friend class graph;
+
+    struct input
+    {
+      node *from;
+      uint64_t seen;  // its version when last computed
+    };
+
+    std::vector<input> inputs_;
+    std::vector<node *> dependents_;
+    uint64_t notified_ = 0;
+    bool queued_ = false;   // dirty with listeners, waiting for a flush
+    bool pending_ = false;  // set in the open transaction
+};
+
+class graph
+{
+  public:
+    graph () = default;
+    graph (graph const &) = delete;
+    graph &operator= (graph const &) = delete;
+
+  public:
+    size_t const &recomputations () const { return recomputations_; }
+
+  private:
+    friend class node;
+    friend class transaction;
+    template <typename Type> friend class source;
+    template <typename Type> friend class computed;
+
+    // a source changed: everything downstream is dirty, though nothing is 
+    // recomputed; those with listeners are remembered for the next flush
+    void changed (node &n)
+    {
+      n.version_ = ++clock_;
+      enqueue (n);
+
+      marking_.push_back (&n);
+      while (!marking_.empty ())
+      {
+        auto current = marking_.back ();
+        marking_.pop_back ();
+
+        for (auto dependent : current->dependents_)
+        {
+          // dirty nodes only have dirty nodes downstream
+          if (dependent->dirty_)
+            continue;
+
+          dependent->dirty_ = true;
+          enqueue (*dependent);
+          marking_.push_back (dependent);
+        }
+      }
+    }
+
+    void update (node &n)
+    {
+      // computations read their inputs through here, clean by then
+      if (n.dirty_)
+        refresh (n);
+    }
+
+    // brings a dirty node up to date after its dirty inputs, depth first 
+    // without recursion so that long chains do not overflow the stack
+    void refresh (node &n)
+    {
+      // reentered when a computation reads a dirty node it did not declare
+      auto base = updating_.size ();
+      updating_.push_back ({&n, 0});
+
+      while (updating_.size () > base)
+      {
+        auto current = updating_.back ().first;
+        auto &next = updating_.back ().second;
+
+        if (next < current->inputs_.size ())
+        {
+          auto input = current->inputs_[next++].from;
+          if (input->dirty_)
+            updating_.push_back ({input, 0});
+          continue;
+        }
+
+        updating_.pop_back ();
+
+        // with no inputs, computed once
+        bool stale = current->inputs_.empty ();
+        for (auto &input : current->inputs_)
+        {
+          if (input.seen != input.from->version_)
+          {
+            input.seen = input.from->version_;
+            stale = true;
+          }
+        }
+
+        if (stale)
+        {
+          ++recomputations_;
+          if (current->recompute ())
+            current->version_ = ++clock_;
+        }
+
+        current->dirty_ = false;
+      }
+    }
+
+    void enqueue (node &n)
+    {
+      if (!n.queued_ && n.observed ())
+      {
+        n.queued_ = true;
+        observed_.push_back (&n);
+      }
+    }
+
+    // brings observed nodes up to date and tells their listeners of those 
+    // whose version moved, once however many sets it took
+    void flush ()
+    {
+      if (depth_ || flushing_)
+        return;
+
+      flushing_ = true;
+      for (size_t i = 0; i < observed_.size (); ++i)
+      {
+        auto n = observed_[i];
+        if (!n)
+          continue;
+
+        n->queued_ = false;
+        update (*n);
+
+        if (n->notified_ != n->version_)
+        {
+          n->notified_ = n->version_;
+          n->notify ();
+        }
+      }
+      observed_.clear ();
+      flushing_ = false;
+    }
+
+    void begin ()
+    {
+      ++depth_;
+    }
+
+    void end ()
+    {
+      if (--depth_)
+        return;
+
+      for (size_t i = 0; i < pending_.size (); ++i)
+      {
+        if (auto n = pending_[i])
+        {
+          n->pending_ = false;
+          n->commit ();
+        }
+      }
+      pending_.clear ();
+
+      flush ();
+    }
+
+    void defer (node &n)
+    {
+      n.pending_ = true;
+      pending_.push_back (&n);
+    }
+
+    void forget (node &n)
+    {
+      if (n.queued_)
+        std::replace (std::begin (observed_), std::end (observed_), &n, static_cast<node *> (nullptr));
+      if (n.pending_)
+        std::replace (std::begin (pending_), std::end (pending_), &n, static_cast<node *> (nullptr));
+    }
+
+  private:
+    uint64_t clock_ = 0;
+    size_t recomputations_ = 0;
+    size_t depth_ = 0;
+    bool flushing_ = false;
+
+    std::vector<node *> pending_;
+    std::vector<node *> observed_;
+
+    // scratch, kept for their capacity
+    std::vector<node *> marking_;
+    std::vector<std::pair<node *, size_t>> updating_;
+};
+
+inline node::~node ()
+{
+  graph_.forget (*this);
+  for (auto &input : inputs_)
+  {
+    auto &dependents = input.from->dependents_;
+    dependents.erase (std::find (std::begin (dependents), std::end (dependents), this));
+  }
+}
+
+// Sets made while one is open are applied together when the outermost one 
+// closes: a source set many times changes once, if it ends up different, and
+// listeners hear of each change once. Sources and derived values read 
+// meanwhile hold what was last committed.
+class transaction
+{
+  public:
+    explicit transaction (graph &g) : 
+      graph_ {g}
+    { 
+      graph_.begin (); 
+    }
+
+    ~transaction () 
+    { 
+      graph_.end (); 
+    }
+
+    transaction (transaction const &) = delete;
+    transaction &operator= (transaction const &) = delete;
+
+  private:
+    graph &graph_;
+};
+
+template <typename Type>
+class source : 
+  public node
+{
+  public:
+    source (graph &g, Type init) : 
+      node {g},
+      value_ {std::move (init)} {}
+
+  public:
+    Type const &operator() () const { return value_; }
+    operator Type const &() const { return value_; }
+
+    source &operator= (Type value)
+    {
+      if (graph_.depth_)
+      {
+        if (!pending_set ())
+          graph_.defer (*this);
+        next_ = std::move (value);
+        return *this;
+      }
+
+      if (value == value_)
+        return *this;
+
+      value_ = std::move (value);
+      graph_.changed (*this);
+      graph_.flush ();
+      return *this;
+    }
+
+  public:
+    signal<Type const &> changed;
+
+  private:
+    bool pending_set () const { return next_.has_value (); }
+
+    void commit () override
+    {
+      if (*next_ != value_)
+      {
+        value_ = std::move (*next_);
+        graph_.changed (*this);
+      }
+      next_.reset ();
+    }
+
+    void notify () override { changed (value_); }
+    bool observed () const override { return !changed.empty (); }
+
+  private:
+    Type value_;
+    std::optional<Type> next_;  // set in the open transaction
+};
+
+template <typename Type>
+class computed : 
+  public node
+{
+  public:
+    template <typename Compute, typename ...Inputs>
+    computed (graph &g, Compute &&compute, Inputs &...inputs) :
+      node {g},
+      compute_ {std::forward<Compute> (compute)}
+    {
+      (depends_on (inputs), ...);
+      dirty_ = true;
+    }
+
+  public:
+    Type const &operator() () const
+    {
+      graph_.update (const_cast<computed &> (*this));
+      return *value_;
+    }
+
+    operator Type const &() const { return (*this)(); }
+
+  public:
+    signal<Type const &> changed;
+
+  private:
+    bool recompute () override
+    {
+      auto value = compute_ ();
+
+      // the first value is not a change
+      if (!value_)
+      {
+        value_ = std::move (value);
+        return false;
+      }
+
+      if (*value_ == value)
+        return false;
+
+      value_ = std::move (value);
+      return true;
+    }
+
+    void notify () override { changed (*value_); }
+    bool observed () const override { return !changed.empty (); }
+
+  private:
+    std::function<Type ()> compute_;
+    std::optional<Type> value_;
+};
+
 } // util::
 
 
@@ -307,8 +710,221 @@ struct Foo
   }
 };
 
-int main()
+// ==== Benchmarks
+
+using clock_type = std::chrono::steady_clock;
+
+using eager = util::property<int>;
+
+std::unique_ptr<eager> make_eager (size_t &recomputations)
+{
+  return std::make_unique<eager> (
+      [](int const &) {}, 
+      [&recomputations](int &p, int v) { ++recomputations; p = v; });
+}
+
+template <typename Body>
+void measure (char const *name, size_t sets, size_t const &recomputations, Body body)
+{
+  auto before = recomputations;
+  auto start = clock_type::now ();
+  body ();
+  std::chrono::duration<double, std::nano> elapsed = clock_type::now () - start;
+
+  cout << name << elapsed.count () / sets << " ns/set, " 
+    << double (recomputations - before) / sets << " recomputations/set" << endl;
+}
+
+// a chain of `length` values each one more than the last, the end read 
+// every `reads` sets of the start
+void deep (size_t length, size_t sets, size_t reads)
+{
+  cout << "deep: chain of " << length << ", end read every " << reads << " sets" << endl;
+
+  size_t eager_recomputations = 0, sink = 0;
+  std::vector<std::unique_ptr<eager>> chain;
+  for (size_t i = 0; i < length; ++i)
+    chain.push_back (make_eager (eager_recomputations));
+  for (size_t i = 0; i + 1 < length; ++i)
+  {
+    auto next = chain[i + 1].get ();
+    chain[i]->changed += [next](int const &v) { *next = v + 1; };
+  }
+
+  measure ("  properties    ", sets, eager_recomputations, [&] {
+    for (size_t i = 0; i < sets; ++i)
+    {
+      *chain.front () = int (i);
+      if (i % reads == 0)
+        sink += (*chain.back ()) ();
+    }
+  });
+
+  util::graph g;
+  util::source<int> start {g, 0};
+  std::vector<std::unique_ptr<util::computed<int>>> values;
+  for (size_t i = 0; i + 1 < length; ++i)
+  {
+    util::node &input = values.empty ()? static_cast<util::node &> (start) : *values.back ();
+    auto previous = values.empty ()? nullptr : values.back ().get ();
+    values.push_back (std::make_unique<util::computed<int>> (g, 
+          [&start, previous] { return (previous? (*previous) () : start ()) + 1; }, input));
+  }
+  sink += (*values.back ()) ();
+
+  measure ("  graph         ", sets, g.recomputations (), [&] {
+    for (size_t i = 0; i < sets; ++i)
+    {
+      start = int (i);
+      if (i % reads == 0)
+        sink += (*values.back ()) ();
+    }
+  });
+
+  // destroyed dependents first
+  while (!values.empty ())
+    values.pop_back ();
+
+  if (sink == 42) cout << endl;
+}
+
+// `width` values each read from one source, one of them read every 
+// `reads` sets
+void wide (size_t width, size_t sets, size_t reads)
 {
+  cout << "wide: " << width << " values of one source, one read every " << reads << " sets" << endl;
+
+  size_t eager_recomputations = 0, sink = 0;
+  auto root = make_eager (eager_recomputations);
+  std::vector<std::unique_ptr<eager>> leaves;
+  for (size_t i = 0; i < width; ++i)
+  {
+    leaves.push_back (make_eager (eager_recomputations));
+    auto leaf = leaves.back ().get ();
+    root->changed += [leaf, i](int const &v) { *leaf = v * int (i); };
+  }
+
+  eager_recomputations = 0;
+  measure ("  properties    ", sets, eager_recomputations, [&] {
+    for (size_t i = 0; i < sets; ++i)
+    {
+      *root = int (i);
+      if (i % reads == 0)
+        sink += (*leaves[i % width]) ();
+    }
+  });
+
+  util::graph g;
+  util::source<int> source {g, 0};
+  std::vector<std::unique_ptr<util::computed<int>>> values;
+  for (size_t i = 0; i < width; ++i)
+    values.push_back (std::make_unique<util::computed<int>> (g, 
+          [&source, i] { return source () * int (i); }, source));
+
+  measure ("  graph         ", sets, g.recomputations (), [&] {
+    for (size_t i = 0; i < sets; ++i)
+    {
+      source = int (i);
+      if (i % reads == 0)
+        sink += (*values[i % width]) ();
+    }
+  });
+
+  values.clear ();
+  if (sink == 42) cout << endl;
+}
+
+// d = b + c with b and c both from a, d listened to; then the graph again
+// with `batch` sets a transaction
+void diamond (size_t sets, size_t batch)
+{
+  cout << "diamond: d listened to, a set" << endl;
+
+  size_t eager_recomputations = 0, eager_notified = 0;
+  auto a = make_eager (eager_recomputations);
+  auto b = make_eager (eager_recomputations);
+  auto c = make_eager (eager_recomputations);
+  auto d = make_eager (eager_recomputations);
+  a->changed += [&](int const &v) { *b = v + 1; };
+  a->changed += [&](int const &v) { *c = v * 2; };
+  b->changed += [&](int const &v) { *d = v + (*c) (); };
+  c->changed += [&](int const &v) { *d = (*b) () + v; };
+  d->changed += [&](int const &) { ++eager_notified; };
+
+  measure ("  properties    ", sets, eager_recomputations, [&] {
+    for (size_t i = 0; i < sets; ++i)
+      *a = int (i);
+  });
+  cout << "                  " << double (eager_notified) / sets << " notifications/set" << endl;
+
+  for (size_t each : {size_t (1), batch})
+  {
+    util::graph g;
+    util::source<int> ga {g, 0};
+    util::computed<int> gb {g, [&] { return ga () + 1; }, ga};
+    util::computed<int> gc {g, [&] { return ga () * 2; }, ga};
+    util::computed<int> gd {g, [&] { return gb () + gc (); }, gb, gc};
+
+    size_t notified = 0;
+    gd.changed += [&](int const &) { ++notified; };
+    gd ();
+
+    auto name = each == 1? "  graph         " : "  transactions  ";
+    measure (name, sets, g.recomputations (), [&] {
+      for (size_t i = 0; i < sets; i += each)
+      {
+        util::transaction tx {g};
+        for (size_t j = i; j < i + each; ++j)
+          ga = int (j);
+      }
+    });
+    cout << "                  " << double (notified) / sets << " notifications/set" << endl;
+  }
+}
+
+// values read in a transaction, which sets a source back before it closes
+void transactions ()
+{
+  util::graph g;
+  util::source<int> a {g, 1};
+  util::computed<int> b {g, [&] { return a () + 1; }, a};
+
+  {
+    util::transaction tx {g};
+    a = 2;
+    cout << "transactions: b = " << b () << " with a = 2 pending" << endl;
+    a = 1;
+  }
+  cout << "transactions: b = " << b () << " with a set back to 1" << endl;
+  assert (b () == 2);
+
+  {
+    util::transaction tx {g};
+    a = 5;
+    b ();
+    a = 0;
+  }
+  cout << "transactions: b = " << b () << " with a = 0" << endl;
+  assert (b () == 1);
+}
+
+void bench ()
+{
+  deep (1000, 100000, 1);
+  deep (1000, 100000, 100);
+  wide (1000, 100000, 1);
+  wide (1000, 100000, 100);
+  diamond (1000000, 100);
+}
+
+int main(int argc, char **argv)
+{
+  if (argc > 1 && std::strcmp (argv[1], "bench") == 0)
+  {
+    bench ();
+    return 0;
+  }
+
   Test1 t1;
   Test2 t2;
   Object v {6}, r;
@@ -323,6 +939,8 @@ int main()
   Foo f;
   f.method();
 
+  transactions ();
+
   return 0;
 }
 
@@ -1,28 +1,451 @@
+// Typed message bus: a publisher writes each message once into a refcounted
+// envelope and hands it to every subscriber's bounded SPSC inbox, and each
+// subscriber drains its inbox in batches on its own core::Executor, so a slow
+// component no longer stalls the tick of every component publishing to it
+//
+// g++ -std=c++20 -O2 -I.. pubsub.cpp -pthread
+//
+// pubsub                      components ticking in one loop
+// pubsub bench [messages]     fan-out to 1 to 64 subscribers on worker
+//                             threads, against calling every subscriber
+//                             on the publisher's thread
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
 #include <vector>
 
-bool quit = false;
+#include "mofunction.hpp"
 
-struct M1 {};
-struct M2 {};
-struct M3 {};
+// drain work captures only `this`, so it is scheduled without allocating
+#define CORE_EXECUTOR_WORK core::mofunction<void()>
+#include "core/Executor.hpp"
+
+// ==== Executors
+
+// Runs work on the thread calling run(), as a component's tick loop does
+class LoopExecutor : public core::Executor {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  Handle Schedule(Work item, Duration expiry = {}, Duration period = {}) override {
+    std::lock_guard lock{mutex_};
+    Handle handle{++last_handle_};
+    queue_.push_back({std::move(item), Clock::now() + expiry, period, handle});
+    pending_ = true;
+    ready_.notify_one();
+    return handle;
+  }
+
+  bool Remove(Handle handle) override {
+    std::lock_guard lock{mutex_};
+    auto found = std::find_if(queue_.begin(), queue_.end(),
+                              [&](const Item& item) { return item.handle == handle; });
+    if (found == queue_.end()) {
+      // maybe running: a periodic item is then not scheduled again
+      cancelled_.push_back(handle);
+      return false;
+    }
+    queue_.erase(found);
+    return true;
+  }
+
+  // runs the work that is due, returns when the next item will be
+  Clock::time_point run() {
+    {
+      std::lock_guard lock{mutex_};
+      running_.swap(queue_);
+      pending_ = false;
+    }
+
+    auto now = Clock::now();
+    auto next = Clock::time_point::max();
+    for (auto& item : running_) {
+      if (item.due <= now) {
+        item.work();
+        if (item.period == Duration::zero()) {
+          continue;
+        }
+        item.due = now + item.period;
+      }
+      next = std::min(next, item.due);
+      kept_.push_back(std::move(item));
+    }
+    running_.clear();
+
+    std::lock_guard lock{mutex_};
+    for (auto& item : kept_) {
+      auto cancelled = std::find(cancelled_.begin(), cancelled_.end(), item.handle);
+      if (cancelled == cancelled_.end()) {
+        queue_.push_back(std::move(item));
+      }
+    }
+    kept_.clear();
+    cancelled_.clear();
+    return pending_ ? now : next;
+  }
+
+ protected:
+  // until `next`, new work or stop()
+  void wait(Clock::time_point next) {
+    std::unique_lock lock{mutex_};
+    auto woken = [this] { return pending_ || stopped_; };
+    if (next == Clock::time_point::max()) {
+      ready_.wait(lock, woken);
+    } else {
+      ready_.wait_until(lock, next, woken);
+    }
+  }
+
+  void stop() {
+    std::lock_guard lock{mutex_};
+    stopped_ = true;
+    ready_.notify_all();
+  }
+
+  bool stopped() {
+    std::lock_guard lock{mutex_};
+    return stopped_;
+  }
+
+ private:
+  struct Item {
+    Work work;
+    Clock::time_point due;
+    Duration period;
+    Handle handle;
+  };
+
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  std::vector<Item> queue_;
+  std::vector<Handle> cancelled_;
+  uint64_t last_handle_ = 0;
+  bool pending_ = false;
+  bool stopped_ = false;
+
+  // only touched by run(), kept for their capacity
+  std::vector<Item> running_;
+  std::vector<Item> kept_;
+};
+
+// Runs work on a thread of its own; work still queued when it is destroyed
+// is dropped
+class ThreadExecutor : public LoopExecutor {
+ public:
+  ThreadExecutor() : thread_{[this] {
+    while (!stopped()) {
+      wait(run());
+    }
+  }} {}
+
+  ~ThreadExecutor() override {
+    stop();
+    thread_.join();
+  }
+
+ private:
+  std::thread thread_;
+};
+
+// ==== Bus
+
+// What a subscriber's full inbox does with one more message
+enum class Overflow {
+  drop,      // the new message is lost to this subscriber
+  block,     // the publisher waits: the subscriber must not run on its thread
+  coalesce,  // messages past capacity replace each other, the latest is kept
+};
+
+struct SubscriberOptions {
+  size_t capacity = 64;  // rounded up to a power of two
+  size_t batch = 16;     // messages per run before letting other work go
+  Overflow overflow = Overflow::drop;
+};
+
+namespace bus {
+
+template <typename M>
+struct Envelope {
+  std::atomic<uint32_t> references{0};
+  uint64_t sequence = 0;
+  std::optional<M> message;
+  Envelope* next = nullptr;  // while pooled
+};
 
+// Envelopes are taken by the publisher and given back by whichever
+// subscriber releases one last, onto a stack the publisher takes back whole
 template <typename M>
-struct Publisher {
+class EnvelopePool {
+ public:
+  Envelope<M>* take() {
+    if (!free_) {
+      free_ = returned_.exchange(nullptr, std::memory_order_acquire);
+    }
+    if (!free_) {
+      envelopes_.push_back(std::make_unique<Envelope<M>>());
+      return envelopes_.back().get();
+    }
+    auto envelope = free_;
+    free_ = envelope->next;
+    return envelope;
+  }
+
+  void release(Envelope<M>* envelope) {
+    if (envelope->references.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+      return;
+    }
+    envelope->message.reset();
+    envelope->next = returned_.load(std::memory_order_relaxed);
+    while (!returned_.compare_exchange_weak(envelope->next, envelope, std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+    }
+  }
+
+ private:
+  Envelope<M>* free_ = nullptr;
+  std::atomic<Envelope<M>*> returned_{nullptr};
+  std::vector<std::unique_ptr<Envelope<M>>> envelopes_;
+};
+
+// A ring of envelopes written by the publisher and read by one subscriber,
+// which is scheduled on its executor when the ring stops being empty. With
+// Overflow::coalesce a full ring overflows into `latest_`, and while that
+// holds a message the ring is not written, so sequence numbers tell which
+// ring messages come before it.
+template <typename M, typename Handler>
+class Inbox {
+ public:
+  Inbox(EnvelopePool<M>& pool, core::Executor& executor, Handler handler,
+        SubscriberOptions options)
+      : pool_{pool},
+        executor_{executor},
+        handler_{std::move(handler)},
+        options_{options},
+        ring_(std::bit_ceil(std::max<size_t>(options.capacity, 2))),
+        mask_{ring_.size() - 1} {}
+
+  ~Inbox() {
+    for (auto head = head_.load(); head != tail_.load(); ++head) {
+      pool_.release(ring_[head & mask_]);
+    }
+    if (auto latest = latest_.load()) {
+      pool_.release(latest);
+    }
+  }
+
+  // publisher: schedule() must follow, after a fence
+  void push(Envelope<M>* envelope) {
+    auto tail = tail_.load(std::memory_order_relaxed);
+    bool coalescing = options_.overflow == Overflow::coalesce &&
+                      latest_.load(std::memory_order_relaxed) != nullptr;
+
+    if (coalescing || full(tail)) {
+      switch (options_.overflow) {
+        case Overflow::drop:
+          dropped_++;
+          pool_.release(envelope);
+          return;
+        case Overflow::coalesce:
+          if (auto replaced = latest_.exchange(envelope, std::memory_order_acq_rel)) {
+            coalesced_++;
+            pool_.release(replaced);
+          }
+          return;
+        case Overflow::block:
+          wait_for_room(tail);
+          break;
+      }
+    }
+
+    ring_[tail & mask_] = envelope;
+    tail_.store(tail + 1, std::memory_order_release);
+  }
+
+  // publisher
+  void schedule() {
+    if (!scheduled_.load(std::memory_order_relaxed) &&
+        !scheduled_.exchange(true, std::memory_order_acq_rel)) {
+      executor_.Schedule([this] { drain(); });
+    }
+  }
+
+  // counted by the publisher
+  size_t dropped() const { return dropped_; }
+  size_t coalesced() const { return coalesced_; }
+
+ private:
+  bool full(size_t tail) {
+    if (tail - head_cache_ <= mask_) {
+      return false;
+    }
+    head_cache_ = head_.load(std::memory_order_acquire);
+    return tail - head_cache_ > mask_;
+  }
+
+  void wait_for_room(size_t tail) {
+    while (full(tail)) {
+      waiting_.store(true, std::memory_order_seq_cst);
+      auto head = head_.load(std::memory_order_seq_cst);
+      if (tail - head > mask_) {
+        head_.wait(head, std::memory_order_acquire);
+      }
+      waiting_.store(false, std::memory_order_relaxed);
+    }
+  }
+
+  void deliver(Envelope<M>* envelope) {
+    handler_(*envelope->message);
+    pool_.release(envelope);
+  }
+
+  // subscriber, never run twice at once as `scheduled_` is held meanwhile
+  void drain() {
+    auto head = head_.load(std::memory_order_relaxed);
+    auto tail = tail_.load(std::memory_order_acquire);
+    size_t count = 0;
+
+    for (; head != tail && count < options_.batch; ++head, ++count) {
+      deliver(ring_[head & mask_]);
+    }
+
+    if (head == tail && count < options_.batch) {
+      if (auto latest = latest_.exchange(nullptr, std::memory_order_acq_rel)) {
+        // older messages may have been written since the ring looked empty
+        for (tail = tail_.load(std::memory_order_acquire);
+             head != tail && ring_[head & mask_]->sequence < latest->sequence; ++head) {
+          deliver(ring_[head & mask_]);
+        }
+        deliver(latest);
+        count++;
+      }
+    }
+
+    head_.store(head, std::memory_order_release);
+    if (count < options_.batch) {
+      scheduled_.store(false, std::memory_order_relaxed);
+    }
+
+    // pairs with the publisher's fence between push() and schedule(); a
+    // blocked publisher is woken once half the ring is free, not per batch
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    tail = tail_.load(std::memory_order_relaxed);
+    if (waiting_.load(std::memory_order_relaxed) && (tail - head <= mask_ / 2 || count == 0)) {
+      head_.notify_one();
+    }
+
+    if (count == options_.batch) {
+      executor_.Schedule([this] { drain(); });
+    } else if ((tail != head ||
+                latest_.load(std::memory_order_relaxed)) &&
+               !scheduled_.exchange(true, std::memory_order_acq_rel)) {
+      executor_.Schedule([this] { drain(); });
+    }
+  }
+
+  EnvelopePool<M>& pool_;
+  core::Executor& executor_;
+  Handler handler_;
+  const SubscriberOptions options_;
+  std::vector<Envelope<M>*> ring_;
+  const size_t mask_;
+
+  alignas(64) std::atomic<size_t> head_{0};
+  std::atomic<bool> scheduled_{false};
+
+  alignas(64) std::atomic<size_t> tail_{0};
+  std::atomic<Envelope<M>*> latest_{nullptr};
+  std::atomic<bool> waiting_{false};
+  size_t head_cache_ = 0;
+  size_t dropped_ = 0;
+  size_t coalesced_ = 0;
+};
+
+}  // namespace bus
+
+// Subscribers capturing little more than `this` fit an inplace_function, so
+// subscribing allocates only the inbox; std::function or core::mofunction drop
+// in as well. publish() and subscribe() are called from one thread at a time,
+// and subscribers' executors must be stopped before the publisher is destroyed.
+template <typename M, typename Subscriber = core::inplace_function<void(const M&)>>
+class Publisher {
+ public:
+  template <typename Handler>
+  void subscribe(core::Executor& executor, Handler handler, SubscriberOptions options = {}) {
+    inboxes_.push_back(
+        std::make_unique<Inbox>(pool_, executor, Subscriber{std::move(handler)}, options));
+  }
+
   void publish(M m) {
-    for (auto&& s : subscribers) {
-      s(m);
+    if (inboxes_.empty()) {
+      return;
+    }
+
+    auto envelope = pool_.take();
+    envelope->message.emplace(std::move(m));
+    envelope->sequence = ++sequence_;
+    envelope->references.store(uint32_t(inboxes_.size()), std::memory_order_relaxed);
+
+    for (auto& inbox : inboxes_) {
+      inbox->push(envelope);
+    }
+    // one fence for all subscribers, so an idle one is never missed
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (auto& inbox : inboxes_) {
+      inbox->schedule();
     }
   }
 
-  std::vector<std::function<void(M)>> subscribers;
+  size_t dropped() const {
+    size_t total = 0;
+    for (auto& inbox : inboxes_) {
+      total += inbox->dropped();
+    }
+    return total;
+  }
+
+  size_t coalesced() const {
+    size_t total = 0;
+    for (auto& inbox : inboxes_) {
+      total += inbox->coalesced();
+    }
+    return total;
+  }
+
+ private:
+  using Inbox = bus::Inbox<M, Subscriber>;
+
+  bus::EnvelopePool<M> pool_;
+  std::vector<std::unique_ptr<Inbox>> inboxes_;
+  uint64_t sequence_ = 0;
 };
 
+// ==== Components
+
+bool quit = false;
+
+struct M1 {};
+struct M2 {};
+struct M3 {};
+
 struct Component {
   virtual void tick() = 0;
   std::string name;
   int state = 0;
+
+  // messages to this component are handled here, before its tick
+  LoopExecutor executor;
 };
 
 struct C1 final : public Component {
@@ -46,11 +469,11 @@ struct C1 final : public Component {
 
 struct C2 final : public Component {
   void connect(Publisher<M1>* p1, Publisher<M2>* p2) {
-    p1->subscribers.push_back([this](M1) {
+    p1->subscribe(executor, [this](const M1&) {
       std::cout << name << " received M1\n";
       state++;
     });
-    p2->subscribers.push_back([this](M2) {
+    p2->subscribe(executor, [this](const M2&) {
       std::cout << name << " received M2\n";
       state++;
     });
@@ -70,16 +493,172 @@ struct C2 final : public Component {
 
 struct C3 final : public Component {
   void connect(Publisher<M3>* p3) {
-    p3->subscribers.push_back([this](M3) {
-      std::cout << name << " received M3\n";
-      quit = true;
-    });
+    // only the latest M3 matters
+    p3->subscribe(executor,
+                  [this](const M3&) {
+                    std::cout << name << " received M3\n";
+                    quit = true;
+                  },
+                  {.capacity = 2, .overflow = Overflow::coalesce});
   }
 
   void tick() override {}
 };
 
-int main() {
+// ==== Benchmark
+
+using Clock = std::chrono::steady_clock;
+
+struct Sample {
+  uint64_t sequence;
+  double values[7];
+};
+
+// written by one subscriber's drain, read once the executors have stopped
+struct alignas(64) Received {
+  std::atomic<uint64_t> count{0};
+  uint64_t next = 0;  // messages arrive in order, whatever is lost
+  bool ordered = true;
+  double sum = 0;
+};
+
+static void spin_for(std::chrono::nanoseconds duration) {
+  for (auto until = Clock::now() + duration; Clock::now() < until;) {
+  }
+}
+
+static Sample sample(uint64_t i) {
+  Sample s{i, {}};
+  s.values[0] = double(i);
+  return s;
+}
+
+// every subscriber called in turn on the publisher's thread, as before
+static double synchronous(size_t subscribers, size_t messages, std::chrono::nanoseconds slow) {
+  std::vector<std::function<void(Sample)>> handlers;
+  std::vector<Received> received(subscribers);
+  for (size_t i = 0; i < subscribers; ++i) {
+    handlers.push_back([&, i](Sample s) {
+      if (i == 0 && slow.count()) {
+        spin_for(slow);
+      }
+      received[i].sum += s.values[0];
+      received[i].count.store(received[i].count.load(std::memory_order_relaxed) + 1,
+                              std::memory_order_relaxed);
+    });
+  }
+
+  auto start = Clock::now();
+  for (uint64_t m = 0; m < messages; ++m) {
+    for (auto& handler : handlers) {
+      handler(sample(m));
+    }
+  }
+  std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+  return elapsed.count() / messages;
+}
+
+struct BusResult {
+  double publish_ns;    // per message, on the publisher's thread
+  double delivered_ns;  // per message, until every subscriber had it
+  double lost;          // fraction of deliveries dropped or coalesced
+};
+
+static BusResult bus_fan_out(size_t subscribers, size_t messages, Overflow overflow,
+                             std::chrono::nanoseconds slow) {
+  size_t threads = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<std::unique_ptr<ThreadExecutor>> workers;
+  for (size_t i = 0; i < std::min(threads, subscribers); ++i) {
+    workers.push_back(std::make_unique<ThreadExecutor>());
+  }
+
+  std::vector<Received> received(subscribers);
+  Publisher<Sample> publisher;
+  for (size_t i = 0; i < subscribers; ++i) {
+    auto counter = &received[i];
+    // the slow subscriber gets a worker of its own when there are several
+    auto& worker = *workers[i == 0 ? 0 : (workers.size() > 1 ? 1 + i % (workers.size() - 1) : 0)];
+    bool is_slow = i == 0 && slow.count();
+    publisher.subscribe(worker,
+                        [counter, is_slow, slow](const Sample& s) {
+                          if (is_slow) {
+                            spin_for(slow);
+                          }
+                          counter->ordered &= s.sequence >= counter->next;
+                          counter->next = s.sequence + 1;
+                          counter->sum += s.values[0];
+                          counter->count.store(counter->count.load(std::memory_order_relaxed) + 1,
+                                               std::memory_order_relaxed);
+                        },
+                        {.capacity = 256, .batch = 32, .overflow = overflow});
+  }
+
+  auto start = Clock::now();
+  for (uint64_t m = 0; m < messages; ++m) {
+    publisher.publish(sample(m));
+  }
+  std::chrono::duration<double, std::nano> published = Clock::now() - start;
+
+  uint64_t expected = subscribers * messages - publisher.dropped() - publisher.coalesced();
+  for (;;) {
+    uint64_t total = 0;
+    for (auto& r : received) {
+      total += r.count.load(std::memory_order_relaxed);
+    }
+    if (total == expected) {
+      break;
+    }
+    std::this_thread::yield();
+  }
+  std::chrono::duration<double, std::nano> delivered = Clock::now() - start;
+
+  workers.clear();
+  for (auto& r : received) {
+    if (!r.ordered) {
+      throw std::logic_error{"messages out of order"};
+    }
+  }
+  return {published.count() / messages, delivered.count() / messages,
+          double(publisher.dropped() + publisher.coalesced()) / (subscribers * messages)};
+}
+
+static int bench(size_t messages) {
+  std::cout << "fan-out of " << messages << " 64 B messages, "
+            << std::max(1u, std::thread::hardware_concurrency()) << " worker threads\n"
+            << "subscribers  synchronous  | bus: overflow  publish  delivered  lost\n";
+
+  for (size_t subscribers : {1, 2, 4, 8, 16, 32, 64}) {
+    double sync = synchronous(subscribers, messages, {});
+    for (auto [overflow, name] : {std::pair{Overflow::block, "block   "},
+                                  std::pair{Overflow::drop, "drop    "},
+                                  std::pair{Overflow::coalesce, "coalesce"}}) {
+      auto result = bus_fan_out(subscribers, messages, overflow, {});
+      std::cout << "  " << subscribers << "\t\t" << sync << " ns\t| " << name << "  "
+                << result.publish_ns << " ns  " << result.delivered_ns << " ns  "
+                << result.lost * 100 << " %\n";
+    }
+  }
+
+  // one of 8 subscribers taking 2 us per message
+  auto slow = std::chrono::microseconds{2};
+  size_t slow_messages = messages / 20;
+  std::cout << "\none slow subscriber of 8, " << slow_messages << " messages\n"
+            << "  synchronous  " << synchronous(8, slow_messages, slow) << " ns/message\n";
+  for (auto [overflow, name] : {std::pair{Overflow::block, "block   "},
+                                std::pair{Overflow::drop, "drop    "},
+                                std::pair{Overflow::coalesce, "coalesce"}}) {
+    auto result = bus_fan_out(8, slow_messages, overflow, slow);
+    std::cout << "  bus " << name << " publish " << result.publish_ns << " ns/message, "
+              << result.lost * 100 << " % lost\n";
+  }
+  return 0;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc > 1 && std::string{argv[1]} == "bench") {
+    return bench(argc > 2 ? std::stoul(argv[2]) : 1'000'000);
+  }
+
   C1 c1;
   C2 c2;
   C3 c3;
@@ -95,6 +674,7 @@ int main() {
 
   while (!quit) {
     for (auto c : components) {
+      c->executor.run();
       c->tick();
     }
   }
@@ -1,12 +1,32 @@
+// g++ -std=c++14 -O2 -Wall -I.. rpc2.cpp -pthread
+//
+// rpc2 [bench [actors] [threads] | bench-rpc [requests] | shm [requests]]
+
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
 #include <chrono>
 #include <deque>
 #include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
 #include <thread>
+#include <type_traits>
 #include <vector>
 
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "core/shm_ring.hpp"
+
 using namespace std::literals::chrono_literals;
 
 // ==== Generated by protobufs
@@ -97,6 +117,107 @@ struct Packet {
   std::vector<Response> responses;
 };
 
+// ==== Wire format
+// What the protobufs would encode, for Channels that leave the process:
+// numbers as their bytes, strings and vectors prefixed by a 32 bit length.
+// Each message lists its fields once, for the sizer, writer and reader alike.
+
+struct WireSizer {
+  uint32_t length(size_t size) {
+    this->size += sizeof(uint32_t);
+    return static_cast<uint32_t>(size);
+  }
+  void bytes(void *, size_t size) { this->size += size; }
+
+  size_t size = 0;
+};
+
+struct WireWriter {
+  uint32_t length(size_t size) {
+    uint32_t length = static_cast<uint32_t>(size);
+    bytes(&length, sizeof(length));
+    return length;
+  }
+  void bytes(void *data, size_t size) {
+    std::memcpy(at, data, size);
+    at += size;
+  }
+
+  uint8_t *at;
+};
+
+struct WireReader {
+  uint32_t length(size_t) {
+    uint32_t length = 0;
+    bytes(&length, sizeof(length));
+    return length <= size_t(end - at) ? length : (failed = true, 0);
+  }
+  void bytes(void *data, size_t size) {
+    if (size > size_t(end - at)) {
+      failed = true;
+      return;
+    }
+    std::memcpy(data, at, size);
+    at += size;
+  }
+
+  const uint8_t *at;
+  const uint8_t *end;
+  bool failed = false;
+};
+
+template <typename Archive, typename Type>
+typename std::enable_if<std::is_arithmetic<Type>::value ||
+                        std::is_enum<Type>::value>::type
+wire(Archive &archive, Type &value) {
+  archive.bytes(&value, sizeof(value));
+}
+
+template <typename Archive>
+void wire(Archive &archive, std::string &value) {
+  value.resize(archive.length(value.size()));
+  archive.bytes(&value[0], value.size());
+}
+
+template <typename Archive, typename Type>
+void wire(Archive &archive, std::vector<Type> &values) {
+  values.resize(archive.length(values.size()));
+  for (auto &value : values) {
+    wire(archive, value);
+  }
+}
+
+template <typename Archive, typename... Fields>
+void wire_fields(Archive &archive, Fields &...fields) {
+  int _[] = {0, (wire(archive, fields), 0)...};
+  (void)_;
+}
+
+template <typename A> void wire(A &a, ID &m) { wire_fields(a, m.which, m.user, m.space); }
+template <typename A> void wire(A &a, Result &m) { wire_fields(a, m.error_code); }
+template <typename A> void wire(A &a, User &m) { wire_fields(a, m.name); }
+template <typename A> void wire(A &a, UserAuth &m) { wire_fields(a, m.password); }
+template <typename A> void wire(A &a, UserID &m) { wire_fields(a, m.username); }
+template <typename A> void wire(A &a, UserSession &m) { wire_fields(a, m.token); }
+template <typename A> void wire(A &a, UserRequest &m) {
+  wire_fields(a, m.which, m.auth, m.get, m.ping, m.target);
+}
+template <typename A> void wire(A &a, UserResponse &m) {
+  wire_fields(a, m.which, m.auth, m.get, m.ping);
+}
+template <typename A> void wire(A &a, Space &m) { wire_fields(a, m.name); }
+template <typename A> void wire(A &a, SpaceRequest &m) { wire_fields(a, m.which, m.join, m.target); }
+template <typename A> void wire(A &a, SpaceResponse &m) { wire_fields(a, m.which, m.join); }
+template <typename A> void wire(A &, RequestHeader &) {}
+template <typename A> void wire(A &, ResponseHeader &) {}
+template <typename A> void wire(A &a, Request &m) {
+  wire_fields(a, m.header, m.which, m.user, m.space);
+}
+template <typename A> void wire(A &a, Response &m) {
+  wire_fields(a, m.header, m.which, m.user, m.space, m.error);
+}
+template <typename A> void wire(A &a, Packet &m) { wire_fields(a, m.requests, m.responses); }
+
 // ==== Foundation
 
 struct Actor;
@@ -160,30 +281,154 @@ struct Fiber {
   std::shared_ptr<FiberState> state;
 };
 
-struct Actor : public std::enable_shared_from_this<Actor> {
-  Actor(std::string uuid) {
-    thread = std::thread{[this] {
-      for (;;) {
-        run_once();
+// ==== Scheduling
+//
+// Actors don't own threads. Each has an intrusive MPSC mailbox and is put on
+// a Scheduler's run queue only when its mailbox goes from empty to non-empty,
+// so an idle actor costs its memory and nothing else. Scheduler workers take
+// an actor off the queue and run up to `batch` of its messages; an actor that
+// still has work after that goes to the back of the queue, so one busy actor
+// can't keep a worker from the others.
+
+// Vyukov's intrusive MPSC queue: push is one exchange, pop is owner only.
+struct Mailbox {
+  struct Node {
+    virtual ~Node() = default;
+    // runs the message, after which the mailbox no longer refers to it
+    virtual void run() = 0;
+    // for a message that will never run
+    virtual void discard() = 0;
+
+    std::atomic<Node *> next{nullptr};
+  };
+
+  Mailbox() : back{&stub}, front{&stub} {}
+
+  // any thread
+  void push(Node *node) {
+    node->next.store(nullptr, std::memory_order_relaxed);
+    Node *prev = back.exchange(node, std::memory_order_seq_cst);
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  // owner only, nullptr when empty or while a push is only half done
+  Node *pop() {
+    Node *first = front;
+    Node *next = first->next.load(std::memory_order_acquire);
+    if (first == &stub) {
+      if (!next) {
+        return nullptr;
       }
-    }};
+      front = first = next;
+      next = next->next.load(std::memory_order_acquire);
+    }
+    if (next) {
+      front = next;
+      return first;
+    }
+    if (first != back.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    push(&stub);
+    next = first->next.load(std::memory_order_acquire);
+    if (next) {
+      front = next;
+      return first;
+    }
+    return nullptr;
+  }
+
+  // owner only, counts half done pushes as non-empty
+  bool empty() const {
+    return front == &stub && back.load(std::memory_order_seq_cst) == &stub;
   }
 
-  Actor() { thread.detach(); }
+  // any thread, once the owner has popped until nullptr: whether anything
+  // was pushed since. Only the stub is left at the back of a drained queue.
+  bool pushed_since_drained() const {
+    return back.load(std::memory_order_seq_cst) != &stub;
+  }
+
+private:
+  struct Stub : Node {
+    void run() override {}
+    void discard() override {}
+  };
+
+  std::atomic<Node *> back;
+  Node *front;
+  Stub stub;
+};
+
+struct Actor;
+
+struct Scheduler {
+  explicit Scheduler(size_t threads = std::thread::hardware_concurrency(),
+                     size_t batch = 64);
+  ~Scheduler();
+
+  // process wide scheduler that actors use unless given another
+  static Scheduler &global() {
+    static Scheduler scheduler;
+    return scheduler;
+  }
+
+  void schedule(Actor &actor);
+
+  const size_t batch;
+
+private:
+  void work();
+
+  std::mutex mutex;
+  std::condition_variable wakeup;
+  Actor *head = nullptr;
+  Actor *tail = nullptr;
+  size_t idle = 0;
+  bool stopping = false;
+  std::vector<std::thread> workers;
+};
+
+struct Actor : public std::enable_shared_from_this<Actor> {
+  explicit Actor(std::string uuid, Scheduler &scheduler = Scheduler::global())
+      : scheduler{&scheduler} {}
+
+  Actor() : Actor{std::string{}} {}
+
+  // messages still queued are dropped, the actor must not be scheduled,
+  // nor be posted to again
+  ~Actor() {
+    assert(!scheduled.load());
+    while (auto message = mailbox.pop()) {
+      message->discard();
+    }
+  }
 
   template <typename Functional> void post(Functional &&work) {
-    std::lock_guard<decltype(mutex)> _{mutex};
-    work_list.emplace_back(std::forward<Functional>(work));
+    post_message(*new Message<typename std::decay<Functional>::type>{
+        std::forward<Functional>(work)});
   }
 
-  void run_once() {
-    std::lock_guard<decltype(mutex)> _{mutex};
-    if (work_list.size()) {
-      work_list.front()();
-      work_list.pop_front();
+  // posts a message that owns its own storage, without allocating
+  void post_message(Mailbox::Node &message) {
+    mailbox.push(&message);
+    if (!scheduled.exchange(true, std::memory_order_seq_cst)) {
+      scheduler->schedule(*this);
     }
   }
 
+  // runs up to `limit` messages on the calling thread, true if there may be more
+  bool run_once(size_t limit = 1) {
+    for (size_t count = 0; count < limit; ++count) {
+      auto message = mailbox.pop();
+      if (!message) {
+        return !mailbox.empty();
+      }
+      message->run();
+    }
+    return true;
+  }
+
   Fiber create_fiber() {
     auto state = std::make_shared<FiberState>(shared_from_this());
     fibers.push_back(state);
@@ -191,11 +436,112 @@ struct Actor : public std::enable_shared_from_this<Actor> {
   }
 
   std::vector<std::shared_ptr<FiberState>> fibers;
-  std::deque<std::function<void()>> work_list;
-  std::thread thread;
-  std::mutex mutex;
+
+private:
+  friend struct Scheduler;
+
+  template <typename Functional> struct Message : Mailbox::Node {
+    explicit Message(Functional &&work) : work{std::move(work)} {}
+    explicit Message(const Functional &work) : work{work} {}
+
+    void run() override {
+      std::unique_ptr<Message> self{this};
+      work();
+    }
+
+    void discard() override { delete this; }
+
+    Functional work;
+  };
+
+  // on a scheduler worker, after being taken off the run queue
+  void activate() {
+    if (run_once(scheduler->batch)) {
+      scheduler->schedule(*this); // more to do, but after everyone else
+      return;
+    }
+    // a post racing with this either sees `scheduled` false and schedules
+    // us itself, or happened before it and is seen here. Once `scheduled` is
+    // false another worker may be popping, so only the producers' side of
+    // the mailbox is looked at.
+    scheduled.store(false, std::memory_order_seq_cst);
+    if (mailbox.pushed_since_drained() &&
+        !scheduled.exchange(true, std::memory_order_seq_cst)) {
+      scheduler->schedule(*this);
+    }
+  }
+
+  Mailbox mailbox;
+  std::atomic<bool> scheduled{false};
+  Actor *next_runnable = nullptr;
+  std::shared_ptr<Actor> pinned; // while on the run queue
+  Scheduler *scheduler;
 };
 
+Scheduler::Scheduler(size_t threads, size_t batch) : batch{batch} {
+  for (size_t i = 0; i < std::max<size_t>(threads, 1); ++i) {
+    workers.emplace_back([this] { work(); });
+  }
+}
+
+Scheduler::~Scheduler() {
+  {
+    std::lock_guard<decltype(mutex)> _{mutex};
+    stopping = true;
+  }
+  wakeup.notify_all();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+// actors must be owned by a shared_ptr, which keeps them while queued
+void Scheduler::schedule(Actor &actor) {
+  auto pinned = actor.shared_from_this();
+  bool wake;
+  {
+    std::lock_guard<decltype(mutex)> _{mutex};
+    actor.pinned = std::move(pinned);
+    actor.next_runnable = nullptr;
+    if (tail) {
+      tail->next_runnable = &actor;
+    } else {
+      head = &actor;
+    }
+    tail = &actor;
+    wake = idle > 0;
+  }
+  if (wake) {
+    wakeup.notify_one();
+  }
+}
+
+void Scheduler::work() {
+  std::unique_lock<decltype(mutex)> lock{mutex};
+  for (;;) {
+    if (!head) {
+      ++idle;
+      wakeup.wait(lock, [this] { return head || stopping; });
+      --idle;
+    }
+    if (!head) {
+      return; // stopping, and everything scheduled has run
+    }
+
+    Actor *actor = head;
+    head = actor->next_runnable;
+    if (!head) {
+      tail = nullptr;
+    }
+    auto pinned = std::move(actor->pinned);
+
+    lock.unlock();
+    actor->activate();
+    pinned.reset();
+    lock.lock();
+  }
+}
+
 void Continuation::run_once() {
   if (auto host = state->host.lock()) {
     host->post([continuation = *this]() mutable {
@@ -244,29 +590,105 @@ struct ActorGroup {};
 struct ActorPool {
   template <typename Type>
   std::shared_ptr<Actor> get_or_create_actor(ActorGroup &group,
-                                             std::string id) {
-    return std::static_pointer_cast<Actor>(
-        actors.emplace(id, std::make_shared<Type>(id)).first->second);
+                                             const std::string &id) {
+    auto it = actors.find(id);
+    if (it == actors.end()) {
+      it = actors.emplace(id, std::make_shared<Type>(id)).first;
+    }
+    return it->second;
   }
 
   std::map<std::string, std::shared_ptr<Actor>> actors;
 };
 
+// Recycles blocks for one type of object that is allocated on one thread and
+// freed on another, as handlers are: created by the dispatcher, released on
+// their service's worker. Freed blocks are chained through themselves and
+// kept for reuse, so the pool holds the peak number in flight.
+template <typename Type> class BlockPool {
+public:
+  static void *allocate() {
+    auto &pool = instance();
+    {
+      std::lock_guard<decltype(pool.mtx_)> _{pool.mtx_};
+      if (auto block = pool.free_) {
+        pool.free_ = block->next;
+        return block;
+      }
+    }
+    return ::operator new(sizeof(Type));
+  }
+
+  static void deallocate(void *pointer) {
+    auto &pool = instance();
+    std::lock_guard<decltype(pool.mtx_)> _{pool.mtx_};
+    pool.free_ = new (pointer) Block{pool.free_};
+  }
+
+private:
+  struct Block {
+    Block *next;
+  };
+  static_assert(sizeof(Type) >= sizeof(Block), "blocks hold a link when free");
+
+  static BlockPool &instance() {
+    static BlockPool pool;
+    return pool;
+  }
+
+  std::mutex mtx_;
+  Block *free_ = nullptr;
+};
+
 class RpcBase;
+class RpcHandlerBase;
+struct RpcRegistry;
 bool is_server_only_rpc(const RpcBase *rpc);
 
+// A completion callback bound at compile time: a function pointer stamped out
+// for one member function, plus the object to call it on. Unlike a
+// std::function it never allocates and the call is a plain indirect call.
+struct Completion {
+  template <typename Type, void (Type::*Method)(RpcHandlerBase &, ErrorCode)>
+  static Completion bind(Type *object) {
+    Completion completion;
+    completion.object = object;
+    completion.call = [](void *object, RpcHandlerBase &handler,
+                         ErrorCode error) {
+      (static_cast<Type *>(object)->*Method)(handler, error);
+    };
+    return completion;
+  }
+
+  explicit operator bool() const { return call != nullptr; }
+
+  void operator()(RpcHandlerBase &handler, ErrorCode error) const {
+    call(object, handler, error);
+  }
+
+  void *object = nullptr;
+  void (*call)(void *, RpcHandlerBase &, ErrorCode) = nullptr;
+};
+
 class RpcBase {
 public:
+  virtual ~RpcBase() = default;
+
   virtual void execute() = 0;
-  virtual void set_on_complete(std::function<void(ErrorCode)>) = 0;
+  virtual void set_on_complete(Completion) = 0;
 
   bool is_server_only() const {
     return is_server_only_rpc(this);
   };
+
+  // the handler owning this rpc, passed to its completion
+  RpcHandlerBase *owner = nullptr;
 };
 
 class RpcHandlerBase {
 public:
+  virtual ~RpcHandlerBase() = default;
+
   virtual Request &request() = 0;
   virtual Response &response() = 0;
   virtual RpcBase &rpc() = 0;
@@ -274,28 +696,77 @@ public:
   virtual const Request &request() const = 0;
   virtual const Response &response() const = 0;
   virtual const RpcBase &rpc() const = 0;
+
+  // where the handler was adopted, so its completion can release it
+  RpcRegistry *registry = nullptr;
+  uint64_t tag = 0;
 };
 
+// Handlers in flight, in a slot map: a tag is a slot index in the low half
+// and the slot's generation in the high half, so a tag kept after its handler
+// was released finds nothing rather than whatever reused the slot. Free slots
+// are chained through the slots themselves; once the slot vector has grown
+// to the peak number of rpcs in flight, adopt and release never allocate.
 struct RpcRegistry {
-  size_t adopt(std::unique_ptr<RpcHandlerBase> &&rpc) {
+  using Tag = uint64_t;
+
+  Tag adopt(std::unique_ptr<RpcHandlerBase> &&rpc) {
     std::lock_guard<decltype(mutex)> _{mutex};
-    rpcs[tag] = std::move(rpc);
-    return tag++;
+    uint32_t index = free_head;
+    if (index == none) {
+      index = static_cast<uint32_t>(slots.size());
+      slots.emplace_back();
+    } else {
+      free_head = slots[index].next_free;
+    }
+
+    Slot &slot = slots[index];
+    Tag tag = (Tag{slot.generation} << 32) | index;
+    rpc->registry = this;
+    rpc->tag = tag;
+    slot.handler = std::move(rpc);
+    return tag;
   }
 
-  std::unique_ptr<RpcHandlerBase> release(size_t tag) {
+  std::unique_ptr<RpcHandlerBase> release(Tag tag) {
     std::lock_guard<decltype(mutex)> _{mutex};
-    return std::move(rpcs[tag]);
+    Slot *slot = find(tag);
+    if (!slot) {
+      return {};
+    }
+    ++slot->generation;
+    slot->next_free = free_head;
+    free_head = static_cast<uint32_t>(tag);
+    return std::move(slot->handler);
   }
 
-  RpcHandlerBase *at(size_t tag) {
+  RpcHandlerBase *at(Tag tag) {
     std::lock_guard<decltype(mutex)> _{mutex};
-    return rpcs[tag].get();
+    Slot *slot = find(tag);
+    return slot ? slot->handler.get() : nullptr;
+  }
+
+private:
+  static constexpr uint32_t none = ~uint32_t{0};
+
+  struct Slot {
+    std::unique_ptr<RpcHandlerBase> handler;
+    uint32_t generation = 1; // so that no tag is 0
+    uint32_t next_free = none;
+  };
+
+  Slot *find(Tag tag) {
+    auto index = static_cast<uint32_t>(tag);
+    if (index >= slots.size() || slots[index].generation != tag >> 32 ||
+        !slots[index].handler) {
+      return nullptr;
+    }
+    return &slots[index];
   }
 
   std::mutex mutex;
-  std::map<size_t, std::unique_ptr<RpcHandlerBase>> rpcs;
-  size_t tag = 1;
+  std::vector<Slot> slots;
+  uint32_t free_head = none;
 };
 
 struct Service : public Actor {
@@ -325,7 +796,7 @@ struct Mesh {
     Remote remote;
   };
 
-  Domain should_forward(std::string id) {
+  Domain should_forward(const std::string &id) {
     static ActorGroup global;
     Domain result;
     result.type = Domain::Type::local;
@@ -334,62 +805,194 @@ struct Mesh {
   }
 };
 
-template <typename Type> class Channel {
+// Where a Channel's values are kept between push() and pop()
+template <typename Type> class ChannelBackend {
+public:
+  virtual ~ChannelBackend() = default;
+
+  virtual size_t size() const = 0;
+  virtual bool empty() const = 0;
+  virtual void push(Type value) = 0;
+  virtual bool pop(Type &value) = 0;
+};
+
+// in process: values are moved through a locked ring of slots, which grows
+// when full and is kept, so a steady flow stops allocating for it. A deque
+// would allocate and free a block every few values.
+template <typename Type> class LockedQueue : public ChannelBackend<Type> {
 public:
-  size_t size() const {
+  size_t size() const override {
     std::lock_guard<decltype(mtx_)> _{mtx_};
-    return queue_.size();
+    return count_;
   }
 
-  bool empty() const {
+  bool empty() const override {
     std::lock_guard<decltype(mtx_)> _{mtx_};
-    return queue_.empty();
+    return count_ == 0;
   }
 
-  void push(Type value) {
+  void push(Type value) override {
     std::lock_guard<decltype(mtx_)> _{mtx_};
-    queue_.push_back(value);
+    if (count_ == slots_.size()) {
+      grow();
+    }
+    slots_[(head_ + count_) % slots_.size()] = std::move(value);
+    ++count_;
   }
 
-  bool pop(Type &value) {
+  bool pop(Type &value) override {
     std::lock_guard<decltype(mtx_)> _{mtx_};
-    bool success = !queue_.empty();
+    bool success = count_ != 0;
     if (success) {
-      value = queue_.front();
-      queue_.pop_front();
+      value = std::move(slots_[head_]);
+      head_ = (head_ + 1) % slots_.size();
+      --count_;
     }
     return success;
   }
 
 private:
+  // twice the slots, the values moved to the front in order
+  void grow() {
+    std::vector<Type> slots(std::max<size_t>(16, 2 * slots_.size()));
+    for (size_t i = 0; i < count_; ++i) {
+      slots[i] = std::move(slots_[(head_ + i) % slots_.size()]);
+    }
+    slots_.swap(slots);
+    head_ = 0;
+  }
+
   mutable std::mutex mtx_;
-  std::deque<Type> queue_;
+  std::vector<Type> slots_;
+  size_t head_ = 0;
+  size_t count_ = 0;
+};
+
+// across processes: values are serialized into frames of a shared memory
+// ring, this process being either its producer or its consumer. push() blocks
+// while the ring is full. The ring has a single producer and consumer, and
+// Channels are pushed to from several workers, so each end takes a lock.
+template <typename Type> class SharedMemoryQueue : public ChannelBackend<Type> {
+public:
+  using Recycle = std::function<void(Type &&)>;
+
+  // `recycle` gets pushed values back once serialized, e.g. for a PacketPool
+  explicit SharedMemoryQueue(core::shm::Ring ring, Recycle recycle = {})
+      : ring_{ring}, recycle_{std::move(recycle)} {}
+
+  size_t size() const override { return ring_.size(); }
+
+  bool empty() const override { return ring_.empty(); }
+
+  void push(Type value) override {
+    WireSizer sizer;
+    wire(sizer, value);
+    {
+      std::lock_guard<decltype(push_mtx_)> _{push_mtx_};
+      uint8_t *frame = ring_.Reserve(sizer.size);
+      if (!frame) {
+        throw std::length_error{"SharedMemoryQueue: value larger than a frame"};
+      }
+      WireWriter writer{frame};
+      wire(writer, value);
+      ring_.Commit(sizer.size);
+    }
+    if (recycle_) {
+      recycle_(std::move(value));
+    }
+  }
+
+  bool pop(Type &value) override {
+    std::lock_guard<decltype(pop_mtx_)> _{pop_mtx_};
+    const uint8_t *frame;
+    size_t size;
+    if (!ring_.TryPeek(&frame, &size)) {
+      return false;
+    }
+    WireReader reader{frame, frame + size};
+    wire(reader, value);
+    ring_.Release();
+    if (reader.failed) {
+      throw std::runtime_error{"SharedMemoryQueue: malformed frame"};
+    }
+    return true;
+  }
+
+private:
+  core::shm::Ring ring_;
+  Recycle recycle_;
+  std::mutex push_mtx_, pop_mtx_;
+};
+
+template <typename Type> class Channel {
+public:
+  Channel() : backend_{new LockedQueue<Type>} {}
+  explicit Channel(std::unique_ptr<ChannelBackend<Type>> backend)
+      : backend_{std::move(backend)} {}
+
+  size_t size() const { return backend_->size(); }
+  bool empty() const { return backend_->empty(); }
+  void push(Type value) { backend_->push(std::move(value)); }
+  bool pop(Type &value) { return backend_->pop(value); }
+
+private:
+  std::unique_ptr<ChannelBackend<Type>> backend_;
+};
+
+// Packets whose vectors keep their capacity between uses. Packets move
+// through Channels, so buffers acquired on one side are recycled on the other
+// and a steady request/response flow stops allocating for them.
+class PacketPool {
+public:
+  Packet acquire() {
+    std::lock_guard<decltype(mtx_)> _{mtx_};
+    if (free_.empty()) {
+      return {};
+    }
+    Packet packet = std::move(free_.back());
+    free_.pop_back();
+    return packet;
+  }
+
+  void recycle(Packet &&packet) {
+    packet.requests.clear();
+    packet.responses.clear();
+    std::lock_guard<decltype(mtx_)> _{mtx_};
+    if (free_.size() < max_pooled) {
+      free_.push_back(std::move(packet));
+    }
+  }
+
+private:
+  // above what a window of responses, one packet each, leaves in flight
+  static constexpr size_t max_pooled = 4096;
+
+  std::mutex mtx_;
+  std::vector<Packet> free_;
 };
 
 Mesh::Domain resolve_rpc(Mesh &mesh, Request &request);
 RpcHandlerBase *reify_rpc(ActorPool &pool, ActorGroup &group, Request &request);
 
 struct Dispatcher {
-  void connect(Channel<Packet> &to, Channel<Packet> &from) {
+  // `pool` may be shared with the device side when it is in process
+  void connect(Channel<Packet> &to, Channel<Packet> &from,
+               PacketPool *pool = nullptr) {
     to_device = &to;
     from_device = &from;
+    packets = pool ? pool : &own_packets;
   }
 
-  void handle(Packet packet) {
+  // requests are moved out of the packet, which is then recycled
+  void handle(Packet &packet) {
     for (auto &&request : packet.requests) {
       auto result = resolve_rpc(mesh, request);
       switch (result.type) {
       case Mesh::Domain::Type::local: {
         auto handler = reify_rpc(actors, *result.local.group, request);
 
-        handler->rpc().set_on_complete([this, handler](auto error) {
-          auto &&response = handler->response();
-          response.error = error;
-
-          Packet packet;
-          packet.responses.push_back(response);
-          to_device->push(packet);
-        });
+        handler->rpc().set_on_complete(
+            Completion::bind<Dispatcher, &Dispatcher::respond>(this));
         handler->rpc().execute();
 
       } break;
@@ -397,11 +1000,26 @@ struct Dispatcher {
         break;
       }
     }
+    packets->recycle(std::move(packet));
+  }
+
+  // on the service's worker, the handler is released once answered
+  void respond(RpcHandlerBase &handler, ErrorCode error) {
+    auto &&response = handler.response();
+    response.error = error;
+
+    Packet packet = packets->acquire();
+    packet.responses.push_back(std::move(response));
+    to_device->push(std::move(packet));
+
+    handler.registry->release(handler.tag);
   }
 
   Channel<Packet> *to_device;
   Channel<Packet> *from_device;
   ActorPool actors;
+  PacketPool own_packets;
+  PacketPool *packets = &own_packets;
   Mesh mesh;
 };
 
@@ -423,8 +1041,7 @@ struct Server {
 
 // ==== RPC user implementation
 
-struct UserService : public Service,
-                     public std::enable_shared_from_this<UserService> {
+struct UserService : public Service {
   using Service::Service;
 
   UserSession Auth(UserAuth &request) {
@@ -438,8 +1055,7 @@ struct UserService : public Service,
   Result Ping(UserID &request) { return {}; }
 };
 
-struct SpaceService : public Service,
-                      public std::enable_shared_from_this<SpaceService> {
+struct SpaceService : public Service {
   using Service::Service;
 
   Result Join(UserID &request) { return {}; }
@@ -449,7 +1065,7 @@ struct SpaceService : public Service,
 // TODO to put the per-RPC options (traits?)
 
 template <typename Service, typename Method, typename Input, typename Output>
-class Rpc : public RpcBase {
+class Rpc : public RpcBase, private Mailbox::Node {
 public:
   Rpc(std::shared_ptr<Service> service, Method method, Input &input,
       Output &output)
@@ -462,29 +1078,38 @@ public:
   const Request &request() const { return m_request; }
   const Response &response() const { return m_response; }
 
+  // the rpc is itself the message posted to its service
   void execute() override {
     if (auto service = m_service.lock()) {
-      service->post([ this, ptr = service.get() ] {
-        m_response = (*ptr.*m_method)(m_request);
-        // TODO: fire+forget rpcs are always successful
-        // fibered rpcs may return failure cases
-        if (m_complete_handler) {
-          m_complete_handler(ErrorCode::success);
-        }
-      });
+      service->post_message(*this);
     }
   }
 
-  void set_on_complete(std::function<void(ErrorCode)> handler) override {
+  void set_on_complete(Completion handler) override {
     m_complete_handler = handler;
   }
 
 private:
+  void run() override {
+    if (auto service = m_service.lock()) {
+      m_response = (*service.*m_method)(m_request);
+    }
+    // TODO: fire+forget rpcs are always successful
+    // fibered rpcs may return failure cases
+    // (the completion may release the handler owning us, so copy it)
+    if (auto complete = m_complete_handler) {
+      complete(*owner, ErrorCode::success);
+    }
+  }
+
+  // the handler owns us, and releases us through the registry
+  void discard() override {}
+
   Input &m_request;
   Output &m_response;
   Method m_method = nullptr;
   std::weak_ptr<Service> m_service;
-  std::function<void(ErrorCode)> m_complete_handler;
+  Completion m_complete_handler;
 };
 
 template <typename T> class RpcHandler {};
@@ -494,9 +1119,26 @@ class RpcHandler<Output (Service::*)(Input &)> : public RpcHandlerBase {
 public:
   using RpcType = Rpc<Service, Output (Service::*)(Input &), Input, Output>;
 
-  RpcHandler(Request &request) : m_request{request} {}
+  RpcHandler(Request &&request) : m_request{std::move(request)} {}
+
+  ~RpcHandler() override {
+    if (m_rpc) {
+      m_rpc->~RpcType();
+    }
+  }
+
+  // handlers come and go with every request, so their memory is recycled
+  static void *operator new(size_t) { return BlockPool<RpcHandler>::allocate(); }
+  static void operator delete(void *pointer) {
+    BlockPool<RpcHandler>::deallocate(pointer);
+  }
 
-  void arm(std::unique_ptr<RpcType> &&rpc) { m_rpc = std::move(rpc); }
+  // constructs the rpc inside the handler
+  template <typename... Args> void arm(Args &&... args) {
+    assert(!m_rpc);
+    m_rpc = new (&m_storage) RpcType{std::forward<Args>(args)...};
+    m_rpc->owner = this;
+  }
 
   Request &request() override { return m_request; }
   Response &response() override { return m_response; }
@@ -510,7 +1152,9 @@ private:
   Request m_request;
   Response m_response;
 
-  std::unique_ptr<RpcType> m_rpc;
+  typename std::aligned_storage<sizeof(RpcType), alignof(RpcType)>::type
+      m_storage;
+  RpcType *m_rpc = nullptr;
 };
 
 // === Generated by RPC compiler
@@ -531,7 +1175,7 @@ RpcHandlerBase *reify_rpc(ActorPool &pool, ActorGroup &group,
   switch (request.which) {
   case 1: // user request
   {
-    auto uuid = request.user.target.user;
+    const auto &uuid = request.user.target.user;
     auto service = pool.get_or_create_actor<UserService>(group, uuid);
     auto user = std::static_pointer_cast<UserService>(service);
 
@@ -539,17 +1183,16 @@ RpcHandlerBase *reify_rpc(ActorPool &pool, ActorGroup &group,
     case 1: // auth
     {
       using HandlerType = RpcHandler<decltype(&UserService::Auth)>;
-      using RpcType = typename HandlerType::RpcType;
 
-      auto handler = std::make_unique<HandlerType>(request);
+      auto handler = std::make_unique<HandlerType>(std::move(request));
       auto ptr = handler.get();
 
       ptr->response().which = 1;
       ptr->response().user.which = 1;
 
-      handler->arm(std::make_unique<RpcType>(user, &UserService::Auth,
-                                             ptr->request().user.auth,
-                                             ptr->response().user.auth));
+      handler->arm(user, &UserService::Auth,
+                   ptr->request().user.auth,
+                   ptr->response().user.auth);
 
       user->rpcs.adopt(std::move(handler));
 
@@ -558,17 +1201,16 @@ RpcHandlerBase *reify_rpc(ActorPool &pool, ActorGroup &group,
     case 2: // get
     {
       using HandlerType = RpcHandler<decltype(&UserService::Get)>;
-      using RpcType = typename HandlerType::RpcType;
 
-      auto handler = std::make_unique<HandlerType>(request);
+      auto handler = std::make_unique<HandlerType>(std::move(request));
       auto ptr = handler.get();
 
       ptr->response().which = 1;
       ptr->response().user.which = 2;
 
-      handler->arm(std::make_unique<RpcType>(user, &UserService::Get,
-                                             ptr->request().user.get,
-                                             ptr->response().user.get));
+      handler->arm(user, &UserService::Get,
+                   ptr->request().user.get,
+                   ptr->response().user.get);
 
       user->rpcs.adopt(std::move(handler));
 
@@ -577,17 +1219,16 @@ RpcHandlerBase *reify_rpc(ActorPool &pool, ActorGroup &group,
     case 3: // ping
     {
       using HandlerType = RpcHandler<decltype(&UserService::Ping)>;
-      using RpcType = typename HandlerType::RpcType;
 
-      auto handler = std::make_unique<HandlerType>(request);
+      auto handler = std::make_unique<HandlerType>(std::move(request));
       auto ptr = handler.get();
 
       ptr->response().which = 1;
       ptr->response().user.which = 3;
 
-      handler->arm(std::make_unique<RpcType>(user, &UserService::Ping,
-                                             ptr->request().user.ping,
-                                             ptr->response().user.ping));
+      handler->arm(user, &UserService::Ping,
+                   ptr->request().user.ping,
+                   ptr->response().user.ping);
 
       user->rpcs.adopt(std::move(handler));
 
@@ -597,7 +1238,7 @@ RpcHandlerBase *reify_rpc(ActorPool &pool, ActorGroup &group,
   } break;
   case 2: // space request
   {
-    auto uuid = request.space.target.space;
+    const auto &uuid = request.space.target.space;
     auto service = pool.get_or_create_actor<SpaceService>(group, uuid);
     auto space = std::static_pointer_cast<SpaceService>(service);
 
@@ -605,17 +1246,16 @@ RpcHandlerBase *reify_rpc(ActorPool &pool, ActorGroup &group,
     case 1: // join
     {
       using HandlerType = RpcHandler<decltype(&SpaceService::Join)>;
-      using RpcType = typename HandlerType::RpcType;
 
-      auto handler = std::make_unique<HandlerType>(request);
+      auto handler = std::make_unique<HandlerType>(std::move(request));
       auto ptr = handler.get();
 
       ptr->response().which = 2;
       ptr->response().space.which = 1;
 
-      handler->arm(std::make_unique<RpcType>(space, &SpaceService::Join,
-                                             ptr->request().space.join,
-                                             ptr->response().space.join));
+      handler->arm(space, &SpaceService::Join,
+                   ptr->request().space.join,
+                   ptr->response().space.join);
 
       space->rpcs.adopt(std::move(handler));
 
@@ -651,7 +1291,214 @@ bool is_server_only_rpc(const RpcBase *rpc) {
 
 // ==== Run
 
-int main() {
+// every allocation in the process, to show what a request costs
+static std::atomic<size_t> allocations{0};
+
+// noinline, or GCC sees malloc() paired with operator delete and warns
+__attribute__((noinline)) void *operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc{};
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+  std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept {
+  std::free(p);
+}
+
+// the server side of the benchmarks: handles packets until `done`
+static void serve_pings(Channel<Packet> &from_device, Channel<Packet> &to_device,
+                        PacketPool &packets, const std::atomic<bool> &done) {
+  // the services live for the rest of the process, as they do in main()
+  auto dispatcher = new Dispatcher;
+  dispatcher->connect(to_device, from_device, &packets);
+
+  Packet packet;
+  while (!done.load()) {
+    if (from_device.pop(packet)) {
+      dispatcher->handle(packet);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+}
+
+// the device side: `total` pings in batches, with a window of them in flight
+static void send_pings(Channel<Packet> &to_server, Channel<Packet> &from_server,
+                       PacketPool &packets, size_t total) {
+  using clock = std::chrono::steady_clock;
+  const size_t batch = 16, window = 1024, users = 64;
+
+  std::vector<std::string> names;
+  for (size_t u = 0; u < users; ++u) {
+    names.push_back("user" + std::to_string(u));
+  }
+
+  auto round_trips = [&](size_t count) {
+    size_t sent = 0, received = 0;
+    Packet packet;
+    while (received < count) {
+      while (sent < count && sent - received < window) {
+        Packet out = packets.acquire();
+        for (size_t i = 0; i < batch; ++i, ++sent) {
+          out.requests.emplace_back();
+          Request &request = out.requests.back();
+          request.which = 1;
+          request.user.which = 3;
+          request.user.target.user = names[sent % users];
+        }
+        to_server.push(std::move(out));
+      }
+      if (from_server.pop(packet)) {
+        received += packet.responses.size();
+        packets.recycle(std::move(packet));
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  };
+
+  round_trips(total / 10); // warm up pools, slots and actors
+
+  size_t before = allocations.load();
+  auto start = clock::now();
+  round_trips(total);
+  std::chrono::duration<double, std::nano> elapsed = clock::now() - start;
+
+  std::cout << total << " pings: " << elapsed.count() / total
+            << " ns/request, " << total / (elapsed.count() / 1e9)
+            << " requests/s, "
+            << double(allocations.load() - before) / total
+            << " allocations/request\n";
+}
+
+// `rpc2 bench-rpc [requests]`: ping round trips through a Dispatcher, with
+// the device side on this thread and the server side on another
+static void run_rpc_benchmark(size_t total) {
+  Channel<Packet> from_device;
+  Channel<Packet> from_server;
+  std::atomic<bool> done{false};
+
+  PacketPool packets;
+
+  std::thread server{[&] { serve_pings(from_device, from_server, packets, done); }};
+  send_pings(from_device, from_server, packets, total);
+
+  done = true;
+  server.join();
+}
+
+// `rpc2 shm [requests]`: the same pings with the server in a child process,
+// the Channels carried by the two rings of a shared memory segment
+static void run_shm_benchmark(size_t total) {
+  auto segment = core::shm::Segment::Create(1 << 20);
+
+  // before any thread is started, so the child can have its own
+  pid_t child = fork();
+  if (child < 0) {
+    throw std::system_error{errno, std::generic_category(), "fork"};
+  }
+
+  auto side = child == 0 ? core::shm::Side::kSecond : core::shm::Side::kFirst;
+  auto rings = segment.Rings(side);
+
+  PacketPool packets;
+  auto recycle = [&](Packet &&packet) { packets.recycle(std::move(packet)); };
+  Channel<Packet> outgoing{std::unique_ptr<ChannelBackend<Packet>>{
+      new SharedMemoryQueue<Packet>{rings.first, recycle}}};
+  Channel<Packet> incoming{std::unique_ptr<ChannelBackend<Packet>>{
+      new SharedMemoryQueue<Packet>{rings.second}}};
+
+  if (child == 0) {
+    // killed by the parent when it's done
+    std::atomic<bool> done{false};
+    serve_pings(incoming, outgoing, packets, done);
+    _exit(0);
+  }
+
+  send_pings(outgoing, incoming, packets, total);
+
+  kill(child, SIGTERM);
+  waitpid(child, nullptr, 0);
+}
+
+// `rpc2 bench [actors] [threads]`: many idle actors on a few threads
+static void run_benchmark(size_t actor_count, size_t threads) {
+  using clock = std::chrono::steady_clock;
+  auto ns_per = [](clock::time_point start, size_t count) {
+    std::chrono::duration<double, std::nano> elapsed = clock::now() - start;
+    return elapsed.count() / count;
+  };
+
+  // declared first so the scheduler's workers are joined before they go
+  std::vector<std::shared_ptr<Actor>> actors;
+  Scheduler scheduler{threads};
+  std::atomic<size_t> handled{0};
+  auto wait_for = [&](size_t count) {
+    while (handled.load() < count) {
+      std::this_thread::yield();
+    }
+    handled = 0;
+  };
+
+  auto start = clock::now();
+  actors.reserve(actor_count);
+  for (size_t i = 0; i < actor_count; ++i) {
+    actors.push_back(std::make_shared<Actor>(std::to_string(i), scheduler));
+  }
+  std::cout << actor_count << " actors on " << threads << " threads, "
+            << sizeof(Actor) << " bytes each, " << ns_per(start, actor_count)
+            << " ns to create\n";
+
+  // one message to every actor: each is scheduled, drained and goes idle
+  start = clock::now();
+  for (auto &actor : actors) {
+    actor->post([&] { handled.fetch_add(1, std::memory_order_relaxed); });
+  }
+  wait_for(actor_count);
+  std::cout << "post + schedule + run, idle actors: " << ns_per(start, actor_count)
+            << " ns/message\n";
+
+  // a busy actor fed by several producers is drained in batches
+  const size_t producers = 4, messages = 1000000;
+  Actor &hot = *actors.front();
+  start = clock::now();
+  std::vector<std::thread> threads_;
+  for (size_t p = 0; p < producers; ++p) {
+    threads_.emplace_back([&] {
+      for (size_t i = 0; i < messages / producers; ++i) {
+        hot.post([&] { handled.fetch_add(1, std::memory_order_relaxed); });
+      }
+    });
+  }
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+  wait_for(messages);
+  std::cout << "post + run, one actor, " << producers
+            << " producers: " << ns_per(start, messages) << " ns/message\n";
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1 && std::string{argv[1]} == "bench") {
+    run_benchmark(argc > 2 ? std::stoul(argv[2]) : 1000000,
+                  argc > 3 ? std::stoul(argv[3]) : 4);
+    return 0;
+  }
+  if (argc > 1 && std::string{argv[1]} == "bench-rpc") {
+    run_rpc_benchmark(argc > 2 ? std::stoul(argv[2]) : 1000000);
+    return 0;
+  }
+  if (argc > 1 && std::string{argv[1]} == "shm") {
+    run_shm_benchmark(argc > 2 ? std::stoul(argv[2]) : 1000000);
+    return 0;
+  }
+
   Channel<Packet> from_device;
   Channel<Packet> from_server;
 
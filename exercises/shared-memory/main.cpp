@@ -1,548 +1,851 @@
 /* main.cpp -- main module
  *
  *			Ryan McDougall -- 2009
+ *
+ * Word based software transactional memory after TL2, and a benchmark of
+ * transactions over the fields of shared components
+ *
+ *      threads [components] [fields] [milliseconds]
+ *      threads readers [fields] [milliseconds]
+ *
+ * and a seqlock component layout for read-mostly fields, with a benchmark
+ * of snapshot reads as readers are added
+ *
+ * See: Dice, Shalev, Shavit -- Transactional Locking II, DISC 2006
  */
 
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
 
-#include <sys/times.h>
-#include <unistd.h>
 #include <signal.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <iostream>
-#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
 #include <vector>
-#include <algorithm>
-
-#include <boost/thread.hpp>
-#include <boost/utility.hpp>
-#include <boost/ref.hpp>
 
 using namespace std;
 
-struct event;
-struct eventlog;
-struct lock;
-struct component;
-struct component_transaction;
-struct test;
+struct transaction;
 
 struct component_transaction_exception {};
-struct component_transaction_inconsistent_exception {};
 
-typedef int                         field_t;
-typedef unsigned int                bit_string_t;
-typedef unsigned char               byte_t;
+typedef uintptr_t                   word_t;
+typedef atomic <word_t>             shared_word_t;
 
-typedef field_t                     field_shared_t;
-typedef bit_string_t                field_dirty_t;
-typedef boost::recursive_mutex      mutex_t;
-
-typedef bit_string_t                field_name_t;
-typedef map <field_name_t,field_t>  field_log_t;
-
-typedef vector <component_transaction *> component_transaction_list_t;
-
-const int NUM_THREADS = 3;
-const int NUM_FIELDS = 3;
-const int FIELD_X = 0;
-const int FIELD_Y = 1;
-const int FIELD_Z = 2;
+//=============================================================================
+// global version clock and versioned stripe locks
+//
+// every shared word maps by address to one of NUM_STRIPES lock words; a lock
+// word holds the clock value of the last commit to its stripe shifted left
+// one, or while a committer holds it, the committer's transaction with the
+// low bit set
 
-bool inconsistent (false);
-int transactions (0), aborts (0), inconsistencies (0), runs (0);
+const size_t NUM_STRIPES = 1 << 20;
+const int MAX_LOCK_SPINS = 64;
 
-inline void set_bits (bit_string_t &b, bit_string_t c) { b |= c; }
-inline void clear_bits (bit_string_t &b, bit_string_t c) { b &= ~c; }
-inline void clear_bits (bit_string_t &b) { b ^= b; }
-inline bit_string_t bits_from_field (field_name_t f) { return (1 << f); }
+alignas (64) shared_word_t global_clock (0);
+shared_word_t stripes [NUM_STRIPES];
 
-struct event
+inline shared_word_t &stripe_lock (const shared_word_t *address)
 {
-    int timestamp;
-    int id;
-    int value;
-    string msg;
-
-    event (int ts, int i, const string &m) 
-        : timestamp (ts), id (i), value (-1), msg (m) {}
+    word_t a = reinterpret_cast <word_t> (address);
+    return stripes [(a / sizeof (word_t)) & (NUM_STRIPES - 1)];
+}
 
-    event (int ts, int i, int v, const string &m) 
-        : timestamp (ts), id (i), value (v), msg (m) {}
+inline bool locked (word_t lock) { return lock & 1; }
+inline word_t version (word_t lock) { return lock >> 1; }
 
-    event (const event &e)
-        : timestamp (e.timestamp), id (e.id), value (e.value), msg (e.msg) {}
+//=============================================================================
+// a transactional value of any trivially copyable type, kept in words
 
-    bool operator< (const event &rhs) const { return (timestamp < rhs.timestamp); }
-};
-    
-ostream &operator<< (ostream &out, const event &e)
+template <typename T>
+struct field
 {
-    out << "(" << e.timestamp << ") [" << e.id << "] " << e.msg; 
-    if (e.value >= 0) out << " : " << e.value; 
-    return out;
-}
+    static_assert (is_trivially_copyable <T>::value, "fields are copied word by word");
 
-struct eventlog
-{
-    vector <event> log;
-    int threadid;
+    static const size_t NUM_WORDS = (sizeof (T) + sizeof (word_t) - 1) / sizeof (word_t);
+
+    mutable shared_word_t words [NUM_WORDS];
 
-    timeval begin;
-    timeval end;
+    field (const T &v = T ()) { store (v); }
 
-    eventlog (int id) 
-        : threadid (id)
-    { 
-        log.reserve (2048);
-        gettimeofday (&begin, NULL);
+    // outside of transactions only, e.g. before threads start or after they join
+    T load () const
+    {
+        word_t buffer [NUM_WORDS];
+        for (size_t i=0; i < NUM_WORDS; ++i)
+            buffer [i] = words [i].load (memory_order_relaxed);
+        return from_words (buffer);
     }
 
-    eventlog (const eventlog &e)
-        : log (e.log), threadid (e.threadid), begin (e.begin), end (e.end)
-    {}
+    void store (const T &v)
+    {
+        word_t buffer [NUM_WORDS];
+        to_words (v, buffer);
+        for (size_t i=0; i < NUM_WORDS; ++i)
+            words [i].store (buffer [i], memory_order_relaxed);
+    }
 
-    void post (const string &msg) 
-    { 
-        gettimeofday (&end, NULL); 
-        log.push_back (event ((end.tv_usec - begin.tv_usec), threadid, msg)); 
+    static T from_words (const word_t *buffer)
+    {
+        T v;
+        memcpy (&v, buffer, sizeof v);
+        return v;
     }
 
-    void post (int value, const string &msg) 
-    { 
-        gettimeofday (&end, NULL); 
-        log.push_back (event ((end.tv_usec - begin.tv_usec), threadid, value, msg)); 
+    static void to_words (const T &v, word_t *buffer)
+    {
+        buffer [NUM_WORDS - 1] = 0;
+        memcpy (buffer, &v, sizeof v);
     }
 };
 
-struct lock
-{
-    mutex_t *mutex;
-
-    lock (mutex_t &m) : mutex (&m) { mutex->lock(); }
-    ~lock () { mutex->unlock(); }
-};
+//=============================================================================
+// a component of any number of fields of one type
 
-struct component : boost::noncopyable
+template <typename T>
+struct component
 {
-    // <shared-data>
-    field_shared_t  fields [NUM_FIELDS];
-    mutex_t         fields_lock;
-
-    field_dirty_t   dirty;
-    mutex_t         dirty_lock;
+    typedef T field_value_t;
+    typedef field <T> field_t;
 
-    component_transaction_list_t    active;
-    mutex_t                         active_lock;
-    // </shared-data>
+    size_t                      num_fields;
+    unique_ptr <field_t []>     fields;
 
-    component () : dirty (0) { fill_n (fields, NUM_FIELDS, 0); }
-
-    void set_field (field_name_t f, field_t v) { fields [f] = v; }
-    field_t get_field (field_name_t f) const { return fields [f]; }
+    component (size_t n, const T &v = T ())
+        : num_fields (n), fields (new field_t [n])
+    {
+        for (size_t i=0; i < n; ++i)
+            fields [i].store (v);
+    }
 
-    void dirty_field (field_name_t f) { set_bits (dirty, bits_from_field (f)); }
-    void clean_field (field_name_t f) { clear_bits (dirty, bits_from_field (f)); }
-    void clean_fields (bit_string_t b) { clear_bits (dirty, b); }
+    component (const component &) = delete;
+    component &operator= (const component &) = delete;
 
-    void add_transaction (component_transaction *t) { active.push_back (t); }
-    void remove_transaction (component_transaction *t) { active.erase (find (active.begin(), active.end(), t)); }
+    field_t &operator[] (size_t f) { return fields [f]; }
 };
 
-struct component_transaction_view
+//=============================================================================
+// per-thread transaction state
+//
+// reads are validated against the clock sampled at begin, so a transaction
+// only ever sees a consistent snapshot, and are logged by stripe in a flat
+// read set; writes are buffered in a flat write set, with a bit filter over
+// their addresses so reads of words not written skip the search. at commit
+// the written stripes are locked, the clock advanced, the read set checked
+// without taking locks, and the writes published with the new version.
+// the arrays keep their capacity, so transactions stop allocating once warm.
+
+struct write_entry
 {
-    component       *comp;
+    shared_word_t  *address;
+    word_t          value;
+};
 
-    field_t         shadow_fields [NUM_FIELDS];
-    field_dirty_t   touched;
+struct lock_entry
+{
+    shared_word_t  *lock;
+    word_t          previous;
+};
 
-    component_transaction_view (component *c)
-        : comp (c), touched (0)
+struct transaction
+{
+    word_t                      read_version;
+    vector <shared_word_t *>    read_set;
+    vector <write_entry>        write_set;
+    vector <lock_entry>         lock_set;
+    uint64_t                    write_filter;
+    bool                        active;
+
+    unsigned long               commits;
+    unsigned long               aborts;
+
+    transaction ()
+        : read_version (0), write_filter (0), active (false), commits (0), aborts (0)
     {
-        copy (c->fields, c->fields+NUM_FIELDS, shadow_fields);
+        read_set.reserve (64);
+        write_set.reserve (16);
+        lock_set.reserve (16);
     }
 
-    field_t read (field_name_t f)
+    template <typename T>
+    T get (const field <T> &f)
     {
-        touched |= bits_from_field (f);
-        return shadow_fields [f] = comp-> fields [f];
+        word_t buffer [field <T>::NUM_WORDS];
+        for (size_t i=0; i < field <T>::NUM_WORDS; ++i)
+            buffer [i] = read_word (&f.words [i]);
+        return field <T>::from_words (buffer);
     }
 
-    void write (field_name_t f, field_t v)
+    template <typename T>
+    void set (field <T> &f, const T &v)
     {
-        comp-> fields [f] = shadow_fields [f] = v;
-        touched |= bits_from_field (f);
+        word_t buffer [field <T>::NUM_WORDS];
+        field <T>::to_words (v, buffer);
+        for (size_t i=0; i < field <T>::NUM_WORDS; ++i)
+            write_word (&f.words [i], buffer [i]);
     }
 
-    bool consistent (field_name_t f)
+    void begin ()
     {
-        if ((touched & bits_from_field (f)) && (comp-> fields[f] != shadow_fields[f]))
-            return false;
-        else
-            return true;
+        read_version = global_clock.load (memory_order_acquire);
+        read_set.clear ();
+        write_set.clear ();
+        write_filter = 0;
+        active = true;
     }
 
-    bool consistent ()
+    word_t read_word (shared_word_t *address)
     {
-        for (int i=0; i < NUM_FIELDS; ++i)
-            if (!consistent (i))
-                return false;
-        return true;
-    }
-};
+        if (write_filter & filter_bit (address))
+            for (auto w = write_set.rbegin (); w != write_set.rend (); ++w)
+                if (w-> address == address)
+                    return w-> value;
 
-struct component_transaction : boost::noncopyable
-{
-    component                   *comp;
-    component_transaction_view  view;
+        shared_word_t &lock = stripe_lock (address);
+
+        word_t before = lock.load (memory_order_acquire);
+        word_t value = address-> load (memory_order_acquire);
+        word_t after = lock.load (memory_order_relaxed);
 
-    eventlog        &el;
+        if (locked (before) || before != after || version (before) > read_version)
+            abort ();
 
-    bit_string_t    write_delta;
-    bit_string_t    read_delta;
-    bit_string_t    change_delta;
-    field_log_t     log;
-    
-    bool write_inconsistency;
-        
-    component_transaction (component *c, eventlog &log) 
-        : comp (c), view (c), el (log), 
-        write_delta (0), read_delta (0), change_delta (0),
-        write_inconsistency (false)
+        read_set.push_back (&lock);
+        return value;
+    }
+
+    void write_word (shared_word_t *address, word_t value)
     {
-        el.post ("locked for active add");
-        lock l (comp-> active_lock);
-        comp-> add_transaction (this);
+        uint64_t bit = filter_bit (address);
+
+        if (write_filter & bit)
+            for (auto &w : write_set)
+                if (w.address == address)
+                {
+                    w.value = value;
+                    return;
+                }
+
+        write_filter |= bit;
+        write_set.push_back ({address, value});
     }
 
-    ~component_transaction () 
+    void commit ()
     {
+        active = false;
+
+        if (write_set.empty ())
+        {
+            ++ commits;
+            return;
+        }
+
+        word_t self = reinterpret_cast <word_t> (this) | 1;
+
+        for (auto &w : write_set)
         {
-            el.post ("locked for active remove");
-            lock l (comp-> active_lock);
-            comp-> remove_transaction (this);
+            shared_word_t &lock = stripe_lock (w.address);
+            word_t current = lock.load (memory_order_relaxed);
+
+            if (current == self)
+                continue;
+
+            for (int spins = 0;; ++spins)
+            {
+                if (!locked (current) &&
+                    lock.compare_exchange_weak (current, self, memory_order_acquire, memory_order_relaxed))
+                    break;
+
+                if (spins == MAX_LOCK_SPINS)
+                    abort ();
+
+                current = lock.load (memory_order_relaxed);
+            }
+
+            lock_set.push_back ({&lock, current});
         }
 
-        if (write_delta) rollback(); // uncommitted writes
+        word_t write_version = global_clock.fetch_add (1, memory_order_acq_rel) + 1;
+
+        // nothing committed since begin, so nothing read can have changed
+        if (write_version != read_version + 1)
+            validate (self);
+
+        // readers that see a new word then see its stripe locked or newer
+        atomic_thread_fence (memory_order_release);
+
+        for (auto &w : write_set)
+            w.address-> store (w.value, memory_order_relaxed);
+
+        for (auto &l : lock_set)
+            l.lock-> store (write_version << 1, memory_order_release);
+
+        lock_set.clear ();
+        ++ commits;
     }
 
-    void log_write (field_name_t f)
+    // releases what commit() had locked; the caller retries
+    void rollback ()
     {
-        el.post ("log write");
-        set_bits (write_delta, bits_from_field (f));
-        log.insert (make_pair (f, comp-> get_field (f))); // log clean copy
+        for (auto &l : lock_set)
+            l.lock-> store (l.previous, memory_order_release);
+
+        lock_set.clear ();
+        active = false;
+        ++ aborts;
     }
 
-    void log_read (field_name_t f)
+    [[noreturn]] void abort ()
     {
-        el.post ("log read");
-        set_bits (read_delta, bits_from_field (f));
+        throw component_transaction_exception ();
     }
 
-    void check (bit_string_t b = 0)
+private:
+    void validate (word_t self)
     {
-        el.post ("check");
-        el.post (comp->dirty, "dirty");
-        el.post (write_delta, "write_delta");
-        el.post (read_delta, "read_delta");
-        el.post (change_delta, "change_delta");
-        el.post (b, "check delta");
+        for (shared_word_t *lock : read_set)
+        {
+            word_t current = lock-> load (memory_order_acquire);
 
-        bit_string_t foreign_writes (comp->dirty ^ write_delta);
-        bit_string_t local_delta (read_delta | write_delta);
+            if (current == self)
+                current = locked_previous (lock);
+            else if (locked (current))
+                abort ();
 
-        if ((change_delta & local_delta) || (foreign_writes & read_delta) || (foreign_writes & b)) 
-        {
-            rollback();
-            throw component_transaction_exception ();
+            if (version (current) > read_version)
+                abort ();
         }
     }
 
-    void get (field_name_t f, field_t &v)
+    word_t locked_previous (shared_word_t *lock) const
+    {
+        for (auto &l : lock_set)
+            if (l.lock == lock)
+                return l.previous;
+        return 0;
+    }
+
+    static uint64_t filter_bit (const shared_word_t *address)
     {
-        el.post ("get");
+        return uint64_t (1) << ((reinterpret_cast <word_t> (address) / sizeof (word_t)) & 63);
+    }
+};
+
+inline transaction &this_transaction ()
+{
+    thread_local transaction t;
+    return t;
+}
 
-        v = view.read (f);
-        log_read (f);
+// runs body (transaction &) until it commits; nested calls join the
+// enclosing transaction, and exceptions other than an abort end it
+template <typename Function>
+void atomically (Function body)
+{
+    transaction &t = this_transaction ();
 
-        check();
+    if (t.active)
+    {
+        body (t);
+        return;
     }
 
-    void set (field_name_t f, field_t v)
+    for (unsigned attempt = 0;; ++attempt)
     {
-        el.post ("set");
+        t.begin ();
 
+        try
         {
-            el.post ("locked for set");
-            lock l (comp->dirty_lock);
-
-            check (bits_from_field (f));
-            
-            if (!view.consistent(f))
-            {
-                el.post ("INCONSISTENCY DETECTED AFTER WRITE CHECK");
-                el.post (view.touched, "view touched");
-                el.post (view.shadow_fields [FIELD_X], "shadow X");
-                el.post (view.shadow_fields [FIELD_Y], "shadow Y");
-                el.post (view.shadow_fields [FIELD_Z], "shadow Z");
-                el.post (comp->dirty, "dirty");
-                el.post (comp->fields [FIELD_X], "X");
-                el.post (comp->fields [FIELD_Y], "Y");
-                el.post (comp->fields [FIELD_Z], "Z");
-
-                write_inconsistency = true;
-            }
-            
-            log_write (f);
-            view.write (f, v);
+            body (t);
+            t.commit ();
+            return;
+        }
 
-            comp-> dirty_field (f);
+        catch (component_transaction_exception &)
+        {
+            t.rollback ();
+        }
 
-            el.post (comp-> dirty, "new dirty");
-            el.post ("unlocked from set");
+        catch (...)
+        {
+            t.rollback ();
+            throw;
         }
+
+        if (attempt > 2)
+            this_thread::yield ();
     }
+}
 
-    void rollback ()
+//=============================================================================
+// seqlock component for read-mostly data
+//
+// fields are packed into cache line blocks, each led by a sequence that is
+// odd while a writer is in the block. readers copy optimistically and retry
+// if a sequence was odd or has moved on; they never write shared memory, so
+// any number of them read without contending for a line. sequences only
+// grow, so a snapshot of several blocks is checked by comparing their sums.
+// writers take the blocks of a range of fields in order, so updates of
+// several fields are seen whole as well.
+
+const size_t CACHE_LINE = 64;
+
+template <typename T>
+class seqlock_component
+{
+public:
+    typedef field <T> field_t;
+
+    static const size_t FIELDS_PER_BLOCK =
+        (CACHE_LINE - sizeof (shared_word_t)) / sizeof (field_t)?
+        (CACHE_LINE - sizeof (shared_word_t)) / sizeof (field_t) : 1;
+
+    struct alignas (CACHE_LINE) block
     {
-        el.post ("rollback");
+        shared_word_t   sequence {0};
+        field_t         fields [FIELDS_PER_BLOCK];
+    };
 
+    // fields [first, last) locked for writing until destroyed; an empty
+    // range locks no block
+    class writer
+    {
+    public:
+        writer (seqlock_component &c, size_t first, size_t last)
+            : c_ (c),
+            first_ (first < last? first / FIELDS_PER_BLOCK : 1),
+            last_ (first < last? (last - 1) / FIELDS_PER_BLOCK : 0)
         {
-            lock l1 (comp->dirty_lock); el.post ("locked for dirty rollback");
-            lock l2 (comp->fields_lock); el.post ("locked for field rollback");
+            for (size_t b = first_; b <= last_; ++b)
+                c_.lock (c_.blocks [b]);
 
-            field_log_t::iterator i (log.begin());
-            for (; i != log.end(); ++i)
-            {
-                comp-> set_field (i->first, i->second);
-                el.post (i->first, "rollback field");
-                el.post (i->second, "rollback value");
-            }
+            // readers that see a new field then see its block odd or moved on
+            atomic_thread_fence (memory_order_release);
+        }
 
-            notify_change ();
-        
-            comp-> clean_fields (write_delta);
-            el.post ("unlocked from rollback");
+        ~writer ()
+        {
+            for (size_t b = first_; b <= last_; ++b)
+                c_.blocks [b].sequence.fetch_add (1, memory_order_release);
         }
+
+        writer (const writer &) = delete;
+        writer &operator= (const writer &) = delete;
+
+        T get (size_t f) const { return c_.at (f).load (); }
+        void set (size_t f, const T &v) { c_.at (f).store (v); }
+
+    private:
+        seqlock_component  &c_;
+        size_t              first_;
+        size_t              last_;
+    };
+
+    seqlock_component (size_t n, const T &v = T ())
+        : num_fields (n), num_blocks ((n + FIELDS_PER_BLOCK - 1) / FIELDS_PER_BLOCK),
+        blocks (new block [num_blocks])
+    {
+        for (size_t i=0; i < n; ++i)
+            at (i).store (v);
     }
 
-    void commit ()
+    seqlock_component (const seqlock_component &) = delete;
+    seqlock_component &operator= (const seqlock_component &) = delete;
+
+    T read (size_t f) const
+    {
+        T v;
+        snapshot (f, f + 1, &v);
+        return v;
+    }
+
+    // copies fields [first, last) as they were at one instant
+    void snapshot (size_t first, size_t last, T *out) const
     {
-        el.post ("commit");
+        if (first >= last)
+            return;
 
+        size_t first_block = first / FIELDS_PER_BLOCK;
+        size_t last_block = (last - 1) / FIELDS_PER_BLOCK;
+
+        for (;;)
         {
-            lock l (comp->dirty_lock); el.post ("locked for dirty clean");
+            word_t before = 0;
+            bool writing = false;
 
-            check();
+            for (size_t b = first_block; b <= last_block; ++b)
+            {
+                word_t s = blocks [b].sequence.load (memory_order_acquire);
+                writing |= s & 1;
+                before += s;
+            }
 
-            if (!view.consistent() || write_inconsistency)
+            if (writing)
             {
-                el.post ("INCONSISTENCY DETECTED AFTER COMMIT CHECK");
-                el.post (view.touched, "view touched");
-                el.post (view.shadow_fields [FIELD_X], "shadow X");
-                el.post (view.shadow_fields [FIELD_Y], "shadow Y");
-                el.post (view.shadow_fields [FIELD_Z], "shadow Z");
-                el.post (comp->dirty, "dirty");
-                el.post (comp->fields [FIELD_X], "X");
-                el.post (comp->fields [FIELD_Y], "Y");
-                el.post (comp->fields [FIELD_Z], "Z");
-
-                inconsistent = true;
-                throw component_transaction_inconsistent_exception ();
+                this_thread::yield ();
+                continue;
             }
-            
-            notify_change ();
-        
-            comp-> clean_fields (write_delta);
-            el.post ("unlocked from commit");
-        }
 
-        clear_bits (write_delta);
+            for (size_t b = first_block, f = first; b <= last_block; ++b)
+            {
+                size_t base = b * FIELDS_PER_BLOCK;
+                for (size_t end = min (last, base + FIELDS_PER_BLOCK); f < end; ++f)
+                    out [f - first] = blocks [b].fields [f - base].load ();
+            }
+
+            atomic_thread_fence (memory_order_acquire);
+
+            word_t after = 0;
+            for (size_t b = first_block; b <= last_block; ++b)
+                after += blocks [b].sequence.load (memory_order_relaxed);
+
+            if (before == after)
+                return;
+        }
     }
 
-    void notify_change ()
+    void write (size_t f, const T &v)
     {
-        lock l (comp->active_lock); el.post ("locked for change notify");
+        writer w (*this, f, f + 1);
+        w.set (f, v);
+    }
 
-        el.post ("send change_deltas");
-        component_transaction_list_t::iterator i (comp-> active.begin());
-        for (; i != comp-> active.end(); ++i)
-            (*i)-> change_delta |= write_delta; 
-            
-        el.post ("unlocked from change notify");
+    size_t                  num_fields;
+    size_t                  num_blocks;
+
+private:
+    field_t &at (size_t f) const { return blocks [f / FIELDS_PER_BLOCK].fields [f % FIELDS_PER_BLOCK]; }
+
+    void lock (block &b)
+    {
+        for (;;)
+        {
+            word_t s = b.sequence.load (memory_order_relaxed);
+            if (!(s & 1) && b.sequence.compare_exchange_weak (s, s + 1, memory_order_acquire))
+                return;
+            this_thread::yield ();
+        }
     }
+
+    unique_ptr <block []>   blocks;
+};
+
+//=============================================================================
+// transfers between fields keep the sum of each component's fields, and
+// audits read them all to check it: an audit seeing any other sum has seen
+// a torn snapshot
+
+const int TOTAL = 1000;
+
+atomic <bool> running (false);
+atomic <unsigned long> transactions (0), aborts (0), inconsistencies (0);
+
+// the same transactions under a mutex per component, for comparison
+struct locked_access
+{
+    template <typename T>
+    T get (const field <T> &f) { return f.load (); }
+
+    template <typename T>
+    void set (field <T> &f, const T &v) { f.store (v); }
 };
 
+template <typename Access>
+bool transfer_or_audit (Access &a, component <int> &c, unsigned random)
+{
+    size_t from = random % c.num_fields;
+    size_t to = (random >> 8) % c.num_fields;
+
+    // one in five reads the whole component
+    if ((random >> 16) % 5 == 0)
+    {
+        int sum = 0;
+        for (size_t i=0; i < c.num_fields; ++i)
+            sum += a.get (c [i]);
+        return sum == TOTAL;
+    }
+
+    int amount = int ((random >> 20) % 10);
+    int x = a.get (c [from]);
+    a.set (c [from], x - amount);
+    int y = a.get (c [to]);
+    a.set (c [to], y + amount);
+    return true;
+}
 
 struct test
 {
-    eventlog log;
     int id;
+    bool use_locks;
 
-    int aborts;
-    int transactions;
-    int inconsistencies;
+    unsigned long transactions;
+    unsigned long aborts;
+    unsigned long inconsistencies;
 
-    test (int i) 
-        : log (i), id (i), 
-        aborts (0), transactions (0), 
-        inconsistencies (0) {}
+    test (int i, bool l)
+        : id (i), use_locks (l),
+        transactions (0), aborts (0), inconsistencies (0) {}
 
-    void operator() (component *c)
+    void operator() (vector <unique_ptr <component <int> > > &components, vector <mutex> &locks)
     {
-        for (;;)
+        minstd_rand random (id + 1);
+        transaction &t = this_transaction ();
+        unsigned long aborts_before = t.aborts;
+
+        while (running.load (memory_order_relaxed))
         {
-            if (inconsistent)
-                break;
+            size_t which = random () % components.size ();
+            component <int> &c = *components [which];
+            unsigned r = random ();
+            bool consistent = true;
+
+            if (use_locks)
+            {
+                lock_guard <mutex> l (locks [which]);
+                locked_access a;
+                consistent = transfer_or_audit (a, c, r);
+            }
+            else
+                atomically ([&] (transaction &t) { consistent = transfer_or_audit (t, c, r); });
 
-            if (transactions > 200)
-                break;
+            if (!consistent)
+                ++ inconsistencies;
 
-            if (aborts > 10)
-                break;
+            ++ transactions;
+        }
 
-            log.post (c->fields[0], "FIELD_X");
-            log.post (c->fields[1], "FIELD_Y");
-            log.post (c->fields[2], "FIELD_Z");
-            log.post (c->dirty, "dirty");
+        aborts = t.aborts - aborts_before;
+    }
+};
 
-            int x, y, r;
-            field_name_t read_field, readwrite_field;
+void run (int num_threads, size_t num_components, size_t num_fields, int milliseconds, bool use_locks)
+{
+    vector <unique_ptr <component <int> > > components;
+    vector <mutex> locks (num_components);
 
-            try
-            {
-                log.post ("===================");
-                component_transaction t (c, log);
-                log.post ("begin transaction");
+    for (size_t i=0; i < num_components; ++i)
+    {
+        components.emplace_back (new component <int> (num_fields));
+        (*components.back ()) [0].store (TOTAL);
+    }
 
-                read_field = rand() % NUM_FIELDS; 
-                readwrite_field = rand() % NUM_FIELDS; 
-                r = rand() % 100;
+    vector <test> tests;
+    vector <thread> threads;
 
-                log.post (read_field, "read_field");
-                log.post (readwrite_field, "readwrite_field");
+    for (int i=0; i < num_threads; ++i)
+        tests.push_back (test (i, use_locks));
 
-                log.post ("read section");
+    running = true;
+    for (auto &t : tests)
+        threads.emplace_back (ref (t), ref (components), ref (locks));
 
-                t.get (read_field, x);
-                t.get (readwrite_field, y);
+    this_thread::sleep_for (chrono::milliseconds (milliseconds));
+    running = false;
 
-                log.post ("write section");  
+    for (auto &t : threads)
+        t.join ();
 
-                t.set (readwrite_field, r);
+    unsigned long committed = 0, aborted = 0, torn = 0;
+    for (auto &t : tests)
+    {
+        committed += t.transactions;
+        aborted += t.aborts;
+        torn += t.inconsistencies;
+    }
 
-                log.post (readwrite_field, "readwrite_field");
-                log.post (r, "r");
+    // the sums must still hold once everything has committed
+    for (auto &c : components)
+    {
+        int sum = 0;
+        for (size_t i=0; i < c-> num_fields; ++i)
+            sum += (*c) [i].load ();
+        if (sum != TOTAL)
+            ++ torn;
+    }
 
-                log.post ("commit section");
+    transactions += committed;
+    aborts += aborted;
+    inconsistencies += torn;
 
-                log.post ("begin transaction commit");
-                t.commit ();
-                log.post ("end transaction commit");
+    cout << (use_locks? "locks " : "stm   ") << num_threads << " threads: "
+        << committed * 1000 / milliseconds / 1000 << " K transactions/s, "
+        << (committed? 100.0 * aborted / committed : 0) << " aborts per 100, "
+        << torn << " inconsistencies" << endl;
+}
 
-                ++ transactions;
-            }
+//=============================================================================
+// reader scaling on one read-mostly component: readers take whole snapshots
+// and check the sum, while one writer transfers between fields now and then
+
+enum read_path { SEQLOCK, MUTEX, STM };
+
+void run_readers (int num_readers, size_t num_fields, int milliseconds, read_path path)
+{
+    seqlock_component <int> sc (num_fields);
+    component <int> c (num_fields);
+    mutex m;
+
+    sc.write (0, TOTAL);
+    c [0].store (TOTAL);
+
+    vector <unsigned long> reads (num_readers, 0), torn (num_readers, 0);
+    vector <thread> threads;
+
+    running = true;
 
-            catch (component_transaction_exception &e)
+    for (int i=0; i < num_readers; ++i)
+        threads.emplace_back ([&, i]
+        {
+            vector <int> values (num_fields);
+            unsigned long n = 0, bad = 0;
+
+            while (running.load (memory_order_relaxed))
             {
-                log.post ("ABORTED transaction");
-                ++ aborts;
+                if (path == SEQLOCK)
+                    sc.snapshot (0, num_fields, values.data ());
+                else if (path == MUTEX)
+                {
+                    lock_guard <mutex> l (m);
+                    for (size_t f=0; f < num_fields; ++f)
+                        values [f] = c [f].load ();
+                }
+                else
+                    atomically ([&] (transaction &t)
+                    {
+                        for (size_t f=0; f < num_fields; ++f)
+                            values [f] = t.get (c [f]);
+                    });
+
+                int sum = 0;
+                for (int v : values)
+                    sum += v;
+                bad += sum != TOTAL;
+                ++ n;
             }
 
-            catch (component_transaction_inconsistent_exception &e)
-            {
-                log.post ("INCONSISTENT transaction");
-                ++ inconsistencies;
+            reads [i] = n;
+            torn [i] = bad;
+        });
+
+    unsigned long writes = 0;
+    thread writer ([&]
+    {
+        minstd_rand random (1);
 
-                log.post (c->get_field (read_field), "read_field");
-                log.post (c->get_field (readwrite_field), "readwrite_field");
-                log.post (x, "x");
-                log.post (y, "y");
-                log.post (r, "r");
+        while (running.load (memory_order_relaxed))
+        {
+            size_t from = random () % num_fields, to = random () % num_fields;
+            int amount = int (random () % 10);
+
+            if (path == SEQLOCK)
+            {
+                seqlock_component <int>::writer w (sc, min (from, to), max (from, to) + 1);
+                w.set (from, w.get (from) - amount);
+                w.set (to, w.get (to) + amount);
             }
+            else if (path == MUTEX)
+            {
+                lock_guard <mutex> l (m);
+                locked_access a;
+                a.set (c [from], a.get (c [from]) - amount);
+                a.set (c [to], a.get (c [to]) + amount);
+            }
+            else
+                atomically ([&] (transaction &t)
+                {
+                    t.set (c [from], t.get (c [from]) - amount);
+                    t.set (c [to], t.get (c [to]) + amount);
+                });
+
+            ++ writes;
+            this_thread::sleep_for (chrono::microseconds (50));
         }
+    });
+
+    this_thread::sleep_for (chrono::milliseconds (milliseconds));
+    running = false;
+
+    for (auto &t : threads)
+        t.join ();
+    writer.join ();
+
+    unsigned long total = 0, total_torn = 0;
+    for (int i=0; i < num_readers; ++i)
+    {
+        total += reads [i];
+        total_torn += torn [i];
     }
-};
+
+    inconsistencies += total_torn;
+
+    static const char *names [] = {"seqlock", "mutex  ", "stm    "};
+    cout << names [path] << " " << num_readers << " readers: "
+        << total * 1000 / milliseconds / 1000 << " K snapshots/s, "
+        << writes * 1000 / milliseconds << " writes/s, "
+        << total_torn << " inconsistencies" << endl;
+}
 
 void print ()
 {
-    cout << "runs: " << runs << endl;
     cout << "transactions: " << transactions << endl;
     cout << "aborts: " << aborts << endl;
     cout << "inconsistencies: " << inconsistencies << endl;
 }
 
-void siginthandle (int) 
-{ 
-    print (); 
+void siginthandle (int)
+{
+    print ();
     exit (0);
 }
 
 //=============================================================================
 // Main entry point
 int main (int argc, char** argv)
-{   
-	signal (SIGINT, siginthandle);
-
-    component c;
-
-    cout << "sizeof (field_t) : " << sizeof (field_t) << endl;
-    cout << "sizeof (mutex_t) : " << sizeof (mutex_t) << endl;
-    cout << "sizeof (field_log_t) : " << sizeof (field_log_t) << endl;
-    cout << "sizeof (component) : " << sizeof (component) << endl;
-    cout << "sizeof (component_transaction) : " << sizeof (component_transaction) << endl;
-    cout << "sizeof (component_transaction_view) : " << sizeof (component_transaction_view) << endl;
+{
+    signal (SIGINT, siginthandle);
 
-    while (inconsistencies < 1)
+    if (argc > 1 && string (argv [1]) == "readers")
     {
-        inconsistent = false;
-
-        vector <test> tests;
-        vector <test>::iterator it;
+        size_t num_fields = argc > 2? strtoul (argv [2], NULL, 10) : 3;
+        int milliseconds = argc > 3? atoi (argv [3]) : 500;
 
-        vector <boost::thread *> threads;
-        vector <boost::thread *>::iterator ith;
+        cout << "sizeof (seqlock_component <int>::block) : "
+            << sizeof (seqlock_component <int>::block) << endl;
+        cout << "1 component of " << num_fields << " fields" << endl;
 
-        for (int i=0; i < NUM_THREADS; ++i)
-            tests.push_back (test (i));
+        for (int num_readers : {1, 2, 4, 8})
+            for (read_path path : {SEQLOCK, MUTEX, STM})
+                run_readers (num_readers, num_fields, milliseconds, path);
 
-        for (it = tests.begin(); it != tests.end(); ++it)
-            threads.push_back (new boost::thread (boost::ref(*it), &c));
-
-        for (ith = threads.begin(); ith != threads.end(); ++ith)
-            (*ith)-> join();
-
-        for (ith = threads.begin(); ith != threads.end(); ++ith)
-            delete *ith;
-
-        if (inconsistent)
-        {
-            cout << "EXCEPTION THROWN" << endl;
-
-            vector <event> log;
-            for (it = tests.begin(); it < tests.end(); ++it)
-                log.insert (log.begin(), it->log.log.begin(), it->log.log.end());
-            sort (log.begin(), log.end());
-
-            vector <event>::iterator i (log.begin());
-            for (; i != log.end(); ++i)
-                cout << *i << endl;
-
-            ++ inconsistencies;
-        }
+        return inconsistencies? 1 : 0;
+    }
 
-        for (it = tests.begin(); it < tests.end(); ++it)
-            transactions += it-> transactions;
+    size_t num_components = argc > 1? strtoul (argv [1], NULL, 10) : 16;
+    size_t num_fields = argc > 2? strtoul (argv [2], NULL, 10) : 3;
+    int milliseconds = argc > 3? atoi (argv [3]) : 500;
 
-        for (it = tests.begin(); it < tests.end(); ++it)
-            aborts += it-> aborts;
+    cout << "sizeof (field <int>) : " << sizeof (field <int>) << endl;
+    cout << "sizeof (component <int>) : " << sizeof (component <int>) << endl;
+    cout << "sizeof (transaction) : " << sizeof (transaction) << endl;
+    cout << num_components << " components of " << num_fields << " fields" << endl;
 
-        ++ runs;
+    for (int num_threads : {1, 2, 4, 8})
+    {
+        run (num_threads, num_components, num_fields, milliseconds, false);
+        run (num_threads, num_components, num_fields, milliseconds, true);
     }
 
     print ();
 
-    return 0;
+    return inconsistencies? 1 : 0;
 }
-
-
@@ -0,0 +1,224 @@
+// Same host messaging: core/shm_ring.hpp frames vs loopback TCP
+//
+// g++ -std=c++20 -O2 -I.. shm-benchmark.cpp
+//
+// shm-benchmark [round trips] [megabytes]
+//
+// Each transport is measured between this process and a forked child: the
+// latency of a ping-pong of small messages, then the one-way throughput of
+// messages of a few sizes, the child acknowledging once it has them all.
+// TCP has TCP_NODELAY set and is sent one message per send() call, as a
+// transport would.
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "core/shm_ring.hpp"
+
+using clock_type = std::chrono::steady_clock;
+
+static const size_t message_sizes[] = {64, 1024, 16384};
+
+static int check(int result, const char *what) {
+  if (result < 0) {
+    throw std::system_error{errno, std::generic_category(), what};
+  }
+  return result;
+}
+
+// ==== Shared memory
+
+struct ShmEnd {
+  core::shm::Ring sending, receiving;
+
+  void send(const void *data, size_t size) { sending.Send(data, size); }
+
+  size_t recv(void *data) {
+    const uint8_t *frame;
+    size_t size;
+    receiving.Peek(&frame, &size);
+    std::memcpy(data, frame, size);
+    receiving.Release();
+    return size;
+  }
+
+  // consumes a frame without copying it out
+  size_t skip() {
+    const uint8_t *frame;
+    size_t size;
+    receiving.Peek(&frame, &size);
+    receiving.Release();
+    return size;
+  }
+};
+
+// ==== Loopback TCP
+
+struct TcpEnd {
+  int fd = -1;
+
+  void send(const void *data, size_t size) {
+    auto bytes = static_cast<const char *>(data);
+    while (size) {
+      auto sent = check(::send(fd, bytes, size, MSG_NOSIGNAL), "send");
+      bytes += sent;
+      size -= sent;
+    }
+  }
+
+  void recv_exactly(void *data, size_t size) {
+    auto bytes = static_cast<char *>(data);
+    while (size) {
+      auto received = check(::recv(fd, bytes, size, 0), "recv");
+      if (received == 0) {
+        throw std::runtime_error{"connection closed"};
+      }
+      bytes += received;
+      size -= received;
+    }
+  }
+};
+
+static void no_delay(int fd) {
+  int one = 1;
+  check(setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)), "setsockopt");
+}
+
+// ==== Benchmarks
+
+// child: echoes `round_trips` pings, then takes `count` messages of each size
+template <typename Echo, typename Drain, typename Ack>
+void serve(size_t round_trips, size_t megabytes, Echo echo, Drain drain, Ack ack) {
+  for (size_t i = 0; i < round_trips; ++i) {
+    echo();
+  }
+  for (size_t size : message_sizes) {
+    drain(size, (megabytes << 20) / size);
+    ack();
+  }
+}
+
+template <typename Ping, typename Send, typename WaitAck>
+void measure(const char *name, size_t round_trips, size_t megabytes, Ping ping, Send send,
+             WaitAck wait_ack) {
+  auto start = clock_type::now();
+  for (size_t i = 0; i < round_trips; ++i) {
+    ping();
+  }
+  std::chrono::duration<double, std::nano> elapsed = clock_type::now() - start;
+  std::cout << name << "  ping-pong 64 B: " << elapsed.count() / round_trips << " ns/round trip\n";
+
+  std::vector<char> message(message_sizes[sizeof(message_sizes) / sizeof(size_t) - 1], 'x');
+  for (size_t size : message_sizes) {
+    size_t count = (megabytes << 20) / size;
+    start = clock_type::now();
+    for (size_t i = 0; i < count; ++i) {
+      send(message.data(), size);
+    }
+    wait_ack();
+    std::chrono::duration<double> seconds = clock_type::now() - start;
+    std::cout << name << "  one-way " << size << " B: " << count / seconds.count() / 1e6
+              << " M messages/s, " << (count * size >> 20) / seconds.count() << " MiB/s\n";
+  }
+}
+
+static void run_shm(size_t round_trips, size_t megabytes) {
+  auto segment = core::shm::Segment::Create(4 << 20);
+
+  pid_t child = check(fork(), "fork");
+  auto rings = segment.Rings(child == 0 ? core::shm::Side::kSecond : core::shm::Side::kFirst);
+  ShmEnd end{rings.first, rings.second};
+  char buffer[64];
+
+  if (child == 0) {
+    serve(round_trips, megabytes,
+          [&] { end.send(buffer, end.recv(buffer)); },
+          [&](size_t, size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+              end.skip();
+            }
+          },
+          [&] { end.send(buffer, 1); });
+    _exit(0);
+  }
+
+  measure("shm", round_trips, megabytes,
+          [&] {
+            end.send(buffer, sizeof(buffer));
+            end.recv(buffer);
+          },
+          [&](const char *data, size_t size) { end.send(data, size); },
+          [&] { end.skip(); });
+  waitpid(child, nullptr, 0);
+}
+
+static void run_tcp(size_t round_trips, size_t megabytes) {
+  int listener = check(socket(AF_INET, SOCK_STREAM, 0), "socket");
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t length = sizeof(address);
+  check(bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)), "bind");
+  check(listen(listener, 1), "listen");
+  check(getsockname(listener, reinterpret_cast<sockaddr *>(&address), &length), "getsockname");
+
+  pid_t child = check(fork(), "fork");
+  TcpEnd end;
+  char buffer[64];
+
+  if (child == 0) {
+    close(listener);
+    end.fd = check(socket(AF_INET, SOCK_STREAM, 0), "socket");
+    check(connect(end.fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)), "connect");
+    no_delay(end.fd);
+
+    std::vector<char> sink(1 << 20);
+    serve(round_trips, megabytes,
+          [&] {
+            end.recv_exactly(buffer, sizeof(buffer));
+            end.send(buffer, sizeof(buffer));
+          },
+          [&](size_t size, size_t count) {
+            for (size_t left = size * count; left;) {
+              left -= check(::recv(end.fd, sink.data(), std::min(left, sink.size()), 0), "recv");
+            }
+          },
+          [&] { end.send(buffer, 1); });
+    _exit(0);
+  }
+
+  end.fd = check(accept(listener, nullptr, nullptr), "accept");
+  close(listener);
+  no_delay(end.fd);
+
+  measure("tcp", round_trips, megabytes,
+          [&] {
+            end.send(buffer, sizeof(buffer));
+            end.recv_exactly(buffer, sizeof(buffer));
+          },
+          [&](const char *data, size_t size) { end.send(data, size); },
+          [&] { end.recv_exactly(buffer, 1); });
+  waitpid(child, nullptr, 0);
+  close(end.fd);
+}
+
+int main(int argc, char *argv[]) {
+  size_t round_trips = argc > 1 ? std::stoul(argv[1]) : 100'000;
+  size_t megabytes = argc > 2 ? std::stoul(argv[2]) : 256;
+
+  run_shm(round_trips, megabytes);
+  run_tcp(round_trips, megabytes);
+}
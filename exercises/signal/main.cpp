@@ -1,237 +1,475 @@
 /* main.cpp -- main module
  *
  *			Ryan McDougall -- 2010
+ *
+ * g++ -std=c++17 -O2 -Wall -pthread main.cpp
+ *
+ * test               demonstration of the signal_manager interface
+ * test bench [signals] [threads]
+ *                    emit throughput over many named signals, while another
+ *                    thread connects and disconnects
  */
 
 #include <iostream>
-#include <tr1/functional>
-#include <tr1/memory>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
 #include <exception>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <thread>
+#include <typeinfo>
 #include <vector>
-#include <map>
 #include <cassert>
 
 #include "type_list.h"
 
 using namespace std;
-using namespace std::tr1;
-using namespace std::tr1::placeholders;
+using namespace std::placeholders;
 
 //=============================================================================
-// contains callable objects and associated filters
-template <typename Message>
-struct call_state
+// signal names are interned once into dense ids, so that a signal can be
+// found by indexing rather than by comparing strings
+// names are hashed as ceres::core::name does, crc32c seeded blocks of 4 bytes
+
+typedef uint32_t signal_id;
+
+const uint32_t crc32c = 0x1EDC6F41;
+
+inline uint32_t block_mix (uint32_t hash, uint32_t block)
 {
-    typedef Message message_type;
+    hash = ((hash << 16) |
+           ((hash & 0xF0000000) >> 24) |
+           ((hash & 0x0FF00000) >> 12) |
+           ((hash & 0x000F0000) >> 16));
 
-    typedef function <void(message_type)> slot_type;
-    typedef function <bool(message_type)> filter_type;
+    return hash ^ (block * ~crc32c) ^ ((~block * crc32c) >> 16);
+}
 
-    typedef vector <filter_type> filter_list;
+inline uint32_t name_hash (const char *str, size_t bytes)
+{
+    uint32_t hash = crc32c ^ (uint32_t (bytes) * 0xcc9e2d51) ^ 0x85ebca6b;
 
-    call_state (slot_type s) 
-        : slot (s)
-    {}
+    size_t i = 0;
+    for (; i + sizeof (uint32_t) <= bytes; i += sizeof (uint32_t))
+    {
+        uint32_t block;
+        memcpy (&block, str + i, sizeof block);
+        hash = block_mix (hash, block);
+    }
 
-    virtual ~call_state ()
-    {}
+    // unlike ceres, the tail is hashed too
+    for (; i < bytes; ++i)
+        hash = block_mix (hash, uint8_t (str[i]));
 
-    slot_type   slot;
-    filter_list filters;
-};
+    return hash ^ (hash * 0xc2b2ae35) ^ ((hash * 0x1b873593) >> 16);
+}
 
 //=============================================================================
-// contains the status of the connection
-// slot_type will be copied, so functors should define copy constructor
+// process-wide table of interned names
+// ids are handed out in order of first use and never released
+// open addressing over the name hashes; lookups share the lock
 
-template <typename Message>
-struct connection_state : public call_state <Message>
+class name_table
 {
-    typedef Message message_type;
+    public:
+        static name_table &instance ()
+        {
+            static name_table table;
+            return table;
+        }
 
-    typedef call_state <message_type> call_state_type;
-    typedef typename call_state_type::slot_type slot_type;
-    
-    connection_state (slot_type s)
-        : call_state <Message> (s), disconnect (false), block (false)
-    {}
+        signal_id intern (const string &name)
+        {
+            uint32_t hash = name_hash (name.data(), name.size());
 
-    virtual ~connection_state ()
-    {}
+            {
+                shared_lock <shared_mutex> lock (mutex_);
+                signal_id id;
+                if (find_ (name, hash, id))
+                    return id;
+            }
+
+            unique_lock <shared_mutex> lock (mutex_);
+            signal_id id;
+            if (find_ (name, hash, id))
+                return id;
+
+            id = signal_id (names_.size());
+            names_.push_back (name);
+            hashes_.push_back (hash);
+
+            if (2 * names_.size() > slots_.size())
+                rehash_ (2 * slots_.size());
+            else
+                insert_ (id);
 
-    bool disconnect;
-    bool block;
+            return id;
+        }
+
+        // references stay valid, names_ is a deque that only grows
+        const string &name (signal_id id) const
+        {
+            shared_lock <shared_mutex> lock (mutex_);
+            return names_[id];
+        }
+
+        size_t size () const
+        {
+            shared_lock <shared_mutex> lock (mutex_);
+            return names_.size();
+        }
+
+    private:
+        name_table () : slots_ (64, empty) {}
+
+        static constexpr signal_id empty = ~signal_id (0);
+
+        bool find_ (const string &name, uint32_t hash, signal_id &id) const
+        {
+            size_t mask = slots_.size() - 1;
+
+            for (size_t i = hash & mask;; i = (i + 1) & mask)
+            {
+                id = slots_[i];
+                if (id == empty)
+                    return false;
+                if (hashes_[id] == hash && names_[id] == name)
+                    return true;
+            }
+        }
+
+        void insert_ (signal_id id)
+        {
+            size_t mask = slots_.size() - 1;
+            size_t i = hashes_[id] & mask;
+
+            while (slots_[i] != empty)
+                i = (i + 1) & mask;
+
+            slots_[i] = id;
+        }
+
+        void rehash_ (size_t size)
+        {
+            slots_.assign (size, empty);
+            for (signal_id id = 0; id < names_.size(); ++id)
+                insert_ (id);
+        }
+
+        mutable shared_mutex    mutex_;
+        deque <string>          names_;
+        vector <uint32_t>       hashes_;
+        vector <signal_id>      slots_;
 };
 
+inline signal_id intern (const string &name)
+{
+    return name_table::instance ().intern (name);
+}
+
 //=============================================================================
-// simple interface for the connection state
-// owns connection_state through shared pointer
+// epoch based reclamation
+// emitters pin the current epoch while they walk subscribers; memory that
+// writers unlink is retired with the epoch it was unlinked in, and freed once
+// the global epoch is two ahead, when no emitter can still be reading it
 
-template <typename Message>
-class connection
+class epoch
 {
     public:
-        typedef Message message_type;
+        // pins the calling thread for its lifetime, nests
+        class guard
+        {
+            public:
+                guard () { epoch::enter_ (); }
+                ~guard () { epoch::leave_ (); }
 
-        typedef call_state <message_type> call_state_type;
-        typedef typename call_state_type::slot_type slot_type;
-        typedef typename call_state_type::filter_type filter_type;
+                guard (const guard &) = delete;
+                guard &operator= (const guard &) = delete;
+        };
 
-        typedef connection_state <message_type> connection_state_type;
-        typedef shared_ptr <connection_state_type> connection_state_pointer;
+        template <typename T>
+        static void retire (T *object)
+        {
+            domain_ ().retire (const_cast <void *> (static_cast <const void *> (object)),
+                               [] (void *p) { delete static_cast <T *> (p); });
+        }
 
-        connection (const string &n, connection_state_type *s)
-            : name_ (n), state_ (s)
-        {}
+        // frees what can be freed now, returns the number still waiting
+        static size_t collect ()
+        {
+            domain_type &d = domain_ ();
+            lock_guard <mutex> lock (d.retired_mutex);
+            d.collect_locked ();
+            return d.retired.size();
+        }
 
-        connection (const string &n, connection_state_pointer s)
-            : name_ (n), state_ (s)
-        {}
+        static size_t freed () { return domain_ ().freed.load (memory_order_relaxed); }
 
-        void disconnect () { state_-> disconnect = true; }
-        void block () { state_-> block = true; }
-        void unblock () { state_-> block = false; }
+    private:
+        static constexpr uint64_t idle = ~uint64_t (0);
 
-        void filter (filter_type f) { state_-> filters.push_back (f); }
+        // one per thread that has ever emitted, reused after the thread exits
+        struct participant
+        {
+            atomic <uint64_t>   pinned {idle};
+            atomic <bool>       active {true};
+            participant        *next = nullptr;
+            unsigned            depth = 0;
+        };
 
-    private:
-        string                      name_;
-        connection_state_pointer    state_;
-};
+        struct retired_item
+        {
+            uint64_t    epoch;
+            void       *object;
+            void      (*destroy) (void *);
+        };
 
-//=============================================================================
-// contains the callable connection state associated with a signal
-// slot_type will be copied, so functors should define copy constructor
+        struct domain_type
+        {
+            atomic <uint64_t>       global {0};
+            atomic <participant *>  participants {nullptr};
+            atomic <size_t>         freed {0};
 
-template <typename Message>
-struct emitter_state
-{
-    typedef Message message_type;
+            mutex                   retired_mutex;
+            vector <retired_item>   retired;
 
-    typedef connection_state <message_type> connection_state_type;
-    typedef shared_ptr <connection_state_type> connection_state_pointer;
-    typedef weak_ptr <connection_state_type> connection_state_weak_pointer;
-    typedef vector <connection_state_weak_pointer> connection_state_list;
+            ~domain_type ()
+            {
+                for (retired_item &r : retired)
+                    r.destroy (r.object);
 
-    typedef call_state <message_type> call_state_type;
-    typedef vector <call_state_type> call_state_list;
+                participant *p = participants.load ();
+                while (p)
+                {
+                    participant *next = p-> next;
+                    delete p;
+                    p = next;
+                }
+            }
 
-    emitter_state () {}
-    ~emitter_state () {}
+            participant *acquire ()
+            {
+                for (participant *p = participants.load (memory_order_acquire); p; p = p-> next)
+                {
+                    bool expected = false;
+                    if (!p-> active.load (memory_order_relaxed) &&
+                        p-> active.compare_exchange_strong (expected, true))
+                        return p;
+                }
 
-    call_state_list get_call_state ()
-    {
-        call_state_list active;
+                participant *p = new participant;
+                p-> next = participants.load (memory_order_relaxed);
+                while (!participants.compare_exchange_weak (p-> next, p, memory_order_release))
+                    ;
+                return p;
+            }
+
+            void retire (void *object, void (*destroy) (void *))
+            {
+                lock_guard <mutex> lock (retired_mutex);
+                retired.push_back ({global.load (memory_order_seq_cst), object, destroy});
+
+                if (retired.size() >= collect_threshold)
+                    collect_locked ();
+            }
+
+            // the epoch moves on only once every pinned thread has seen it
+            bool try_advance ()
+            {
+                uint64_t current = global.load (memory_order_seq_cst);
+
+                for (participant *p = participants.load (memory_order_acquire); p; p = p-> next)
+                {
+                    uint64_t pinned = p-> pinned.load (memory_order_seq_cst);
+                    if (pinned != idle && pinned != current)
+                        return false;
+                }
+
+                return global.compare_exchange_strong (current, current + 1);
+            }
+
+            void collect_locked ()
+            {
+                try_advance ();
+                uint64_t current = global.load (memory_order_seq_cst);
 
-        connection_state_weak_pointer conn_weak;
+                size_t kept = 0;
+                for (retired_item &r : retired)
+                {
+                    if (r.epoch + 2 <= current)
+                        r.destroy (r.object);
+                    else
+                        retired[kept++] = r;
+                }
+
+                freed.fetch_add (retired.size() - kept, memory_order_relaxed);
+                retired.resize (kept);
+            }
 
-        typename connection_state_list::iterator i = connections.begin();
-        typename connection_state_list::iterator e = connections.end();
+            static constexpr size_t collect_threshold = 64;
+        };
 
-        for (; i != e; ++i) 
+        // releases the participant record when the thread exits
+        struct local_type
         {
-            conn_weak = *i;
+            participant *record = nullptr;
 
-            if (!conn_weak.expired())
+            ~local_type ()
             {
-                connection_state_pointer conn (conn_weak.lock ());
+                if (record)
+                {
+                    record-> pinned.store (idle, memory_order_release);
+                    record-> active.store (false, memory_order_release);
+                }
+            }
+        };
+
+        static domain_type &domain_ ()
+        {
+            static domain_type domain;
+            return domain;
+        }
+
+        static participant *local_ ()
+        {
+            thread_local local_type local;
+
+            if (!local.record)
+                local.record = domain_ ().acquire ();
 
-                if (!conn-> disconnect && !conn-> block) 
-                    active.push_back (*conn);
+            return local.record;
+        }
+
+        static void enter_ ()
+        {
+            participant *p = local_ ();
+
+            if (p-> depth++ == 0)
+            {
+                // seq_cst, so the pin is visible before any pointer is loaded
+                domain_type &d = domain_ ();
+                uint64_t e = d.global.load (memory_order_seq_cst);
+                p-> pinned.store (e, memory_order_seq_cst);
             }
         }
 
-        return active;
-    }
+        static void leave_ ()
+        {
+            participant *p = local_ ();
 
-    connection_state_list connections;
+            if (--p-> depth == 0)
+                p-> pinned.store (idle, memory_order_release);
+        }
 };
 
 //=============================================================================
-// calls slots associated with a signal on its behalf
-// owns emitter_state through shared pointer
+// contains callable object, blocking flag and associated filters
 // slot_type will be copied, so functors should define copy constructor
-// TODO: create a queued emitter that queues call_state to be executed later
+// filters are copied on write and retired through epochs, as emitters read
+// them without locking
 
 template <typename Message>
-class emitter
+struct connection_state
 {
-    public:
-        typedef Message message_type;
-
-        typedef call_state <message_type> call_state_type;
-        typedef emitter_state <message_type> emitter_state_type;
-        typedef shared_ptr <emitter_state_type> emitter_state_pointer;
-
-        typedef typename call_state_type::slot_type slot_type;
-        typedef typename call_state_type::filter_type filter_type;
-        typedef typename call_state_type::filter_list filter_list;
+    typedef Message message_type;
 
-        typedef typename emitter_state_type::call_state_list call_state_list;
-        
-        emitter (emitter_state_type *s)
-            : state_ (s)
-        {}
+    typedef function <void(message_type)> slot_type;
+    typedef function <bool(message_type)> filter_type;
 
-        emitter (emitter_state_pointer s)
-            : state_ (s)
-        {}
+    typedef vector <filter_type> filter_list;
 
-        virtual void operator () (Message data)
-        {
-            call_state_list active = state_-> get_call_state ();
+    connection_state (signal_id i, slot_type s)
+        : id (i), slot (s)
+    {}
 
-            typename call_state_list::iterator conn = active.begin();
-            typename call_state_list::iterator end = active.end();
+    ~connection_state ()
+    {
+        delete filters.load (memory_order_relaxed);
+    }
 
-            for (; conn != end; ++conn) 
-            {
-                typename filter_list::iterator f = conn-> filters.begin();
-                typename filter_list::iterator e = conn-> filters.end();
-                bool filtered = false;
+    signal_id                       id;
+    slot_type                       slot;
+    atomic <bool>                   block {false};
+    atomic <const filter_list *>    filters {nullptr};
+};
 
-                for (; f != e; ++f)
-                    if (filtered = (*f) (data))
-                        break;
+//=============================================================================
+// emitters read subscriber lists without locking, writers replace them
+// whole; both the lists and the connections they point at are retired
 
-                if (filtered)
-                    break;
+template <typename Message>
+struct subscriber_list
+{
+    typedef connection_state <Message> connection_state_type;
+    typedef vector <connection_state_type *> connection_list;
 
-                conn-> slot (data);
-            }
-        }
+    connection_list connections;
+};
 
-    private:
-        emitter_state_pointer   state_;
+template <typename Message>
+struct signal_entry
+{
+    atomic <const subscriber_list <Message> *> subscribers {nullptr};
 };
 
 //=============================================================================
-// simple interface for emitter
+// handle of a named signal, cheap to copy
+// emits from any number of threads, slots may connect and disconnect
 
 template <typename Message>
 class signal
 {
     public:
         typedef Message message_type;
-        typedef emitter <message_type> emitter_type;
-        typedef emitter_state <message_type> emitter_state_type;
-        typedef shared_ptr <emitter_state_type> emitter_state_pointer;
 
-        signal (const string &n, emitter_state_type *s)
-            : name_ (n), emitter_ (s)
-        {}
+        typedef signal_entry <message_type> signal_entry_type;
+        typedef subscriber_list <message_type> subscriber_list_type;
+        typedef connection_state <message_type> connection_state_type;
+        typedef typename connection_state_type::filter_list filter_list;
 
-        signal (const string &n, emitter_state_pointer s)
-            : name_ (n), emitter_ (s)
+        signal (signal_id i, signal_entry_type *e)
+            : id_ (i), entry_ (e)
         {}
 
-        void emit (message_type data) { emitter_ (data); }
+        void emit (message_type data) const
+        {
+            epoch::guard pinned;
+
+            const subscriber_list_type *list = entry_-> subscribers.load (memory_order_acquire);
+            if (!list)
+                return;
+
+            for (connection_state_type *conn : list-> connections)
+            {
+                if (conn-> block.load (memory_order_relaxed))
+                    continue;
+
+                // a filter skips this connection only
+                const filter_list *filters = conn-> filters.load (memory_order_acquire);
+                bool filtered = false;
+
+                if (filters)
+                    for (auto &f : *filters)
+                        if ((filtered = f (data)))
+                            break;
+
+                if (!filtered)
+                    conn-> slot (data);
+            }
+        }
+
+        signal_id id () const { return id_; }
+        const string &name () const { return name_table::instance ().name (id_); }
 
     private:
-        string          name_;
-        emitter_type    emitter_;
+        signal_id           id_;
+        signal_entry_type  *entry_;
 };
 
 //=============================================================================
@@ -248,96 +486,235 @@ class signal_error : public exception
 };
 
 //=============================================================================
-// factory for signals and connecitons
-// enforces uniqueness of signal names
-// weak-references emitter_state to add new connections
-// TODO: not thread safe
+// factory for signals and connections
+// signals are entries of a table indexed by interned id, allocated in chunks
+// that never move, so signal handles stay valid while the table grows
+// writers serialize on a mutex; emitters never take it
+
+template <typename Message> class connection;
 
-class switchboard_base {};
+class switchboard_base
+{
+    public:
+        virtual ~switchboard_base () {}
+};
 
 template <typename Message>
 class switchboard : public switchboard_base
 {
-    typedef Message message_type;
+    public:
+        typedef Message message_type;
 
-    typedef signal <message_type> signal_type;
-    typedef connection <message_type> connection_type;
-    typedef emitter_state <message_type> emitter_state_type;
+        typedef signal <message_type> signal_type;
+        typedef connection <message_type> connection_type;
+        typedef signal_entry <message_type> signal_entry_type;
+        typedef subscriber_list <message_type> subscriber_list_type;
+        typedef connection_state <message_type> connection_state_type;
 
-    typedef typename emitter_state_type::connection_state_type connection_state_type;
-    typedef typename emitter_state_type::connection_state_pointer connection_state_pointer;
-    typedef typename emitter_state_type::connection_state_weak_pointer connection_state_weak_pointer;
+        typedef typename connection_state_type::slot_type slot_type;
+        typedef typename connection_state_type::filter_type filter_type;
+        typedef typename connection_state_type::filter_list filter_list;
 
-    typedef shared_ptr <emitter_state_type> emitter_state_pointer;
-    typedef weak_ptr <emitter_state_type> emitter_state_weak_pointer;
+        switchboard ()
+        {
+            for (auto &chunk : chunks_)
+                chunk.store (nullptr, memory_order_relaxed);
+        }
 
-    typedef map <string, emitter_state_weak_pointer> signal_state_type;
+        ~switchboard ()
+        {
+            // outstanding connections must not outlive their switchboard
+            for (auto &chunk : chunks_)
+            {
+                signal_entry_type *entries = chunk.load (memory_order_relaxed);
+                if (!entries)
+                    continue;
 
-    public:
-        switchboard ()
-        {}
+                for (size_t i = 0; i < chunk_size; ++i)
+                    delete entries[i].subscribers.load (memory_order_relaxed);
 
-        signal_type get_signal (string name)
+                delete [] entries;
+            }
+        }
+
+        signal_type get_signal (const string &name)
         {
-            emitter_state_pointer emit (signal_add_if_missing_ (name));
+            return get_signal (intern (name));
+        }
 
-            return signal_type (name, emit);
+        signal_type get_signal (signal_id id)
+        {
+            return signal_type (id, entry_ (id));
         }
 
+        // a signal need not have been asked for before it is connected to
         template <typename Callable>
-        connection_type connect (string name, Callable func)
+        connection_type connect (const string &name, Callable func)
         {
-            emitter_state_pointer emit (signal_exception_if_missing_ (name));
+            return connect (intern (name), slot_type (func));
+        }
+
+        connection_type connect (signal_id id, slot_type func)
+        {
+            signal_entry_type *entry = entry_ (id);
+            connection_state_type *conn = new connection_state_type (id, func);
+
+            lock_guard <mutex> lock (mutex_);
+            const subscriber_list_type *old = entry-> subscribers.load (memory_order_relaxed);
+
+            subscriber_list_type *list = new subscriber_list_type;
+            if (old)
+            {
+                list-> connections.reserve (old-> connections.size() + 1);
+                list-> connections = old-> connections;
+            }
+            list-> connections.push_back (conn);
 
-            connection_state_pointer conn (new connection_state_type (func));
-            emit-> connections.push_back (conn);
+            entry-> subscribers.store (list, memory_order_release);
+            if (old)
+                epoch::retire (old);
 
-            return connection_type (name, conn);
+            return connection_type (this, conn);
         }
 
     private:
-        emitter_state_pointer signal_add_if_missing_ (const string &name)
+        friend class connection <message_type>;
+
+        static constexpr size_t chunk_size = 256;
+        static constexpr size_t max_chunks = 4096;
+
+        signal_entry_type *entry_ (signal_id id)
         {
-            emitter_state_pointer state;
+            size_t index = id / chunk_size;
+
+            if (index >= max_chunks)
+                throw signal_error ("too many signals: " + name_table::instance ().name (id));
 
-            if (!signal_state_.count (name))
-                signal_state_.insert (make_pair 
-                        (name, emitter_state_weak_pointer ()));
-            
-            typename signal_state_type::iterator i = signal_state_.find (name);
+            signal_entry_type *entries = chunks_[index].load (memory_order_acquire);
 
-            if (i-> second.expired())
+            if (!entries)
             {
-                state = emitter_state_pointer (new emitter_state_type);
-                i-> second = state;
+                lock_guard <mutex> lock (mutex_);
+                entries = chunks_[index].load (memory_order_relaxed);
+
+                if (!entries)
+                {
+                    entries = new signal_entry_type [chunk_size];
+                    chunks_[index].store (entries, memory_order_release);
+                }
             }
-            else
-                state = emitter_state_pointer (i-> second);
 
-            return state;
+            return &entries[id % chunk_size];
         }
 
-        emitter_state_pointer signal_exception_if_missing_ (const string &name)
+        void disconnect_ (connection_state_type *conn)
         {
-            emitter_state_pointer state;
+            signal_entry_type *entry = entry_ (conn-> id);
 
-            typename signal_state_type::iterator i = signal_state_.find (name);
+            lock_guard <mutex> lock (mutex_);
+            const subscriber_list_type *old = entry-> subscribers.load (memory_order_relaxed);
 
-            if ((i == signal_state_.end()) || i-> second.expired())
-                throw signal_error ("signal missing: " + name);
-            else
-                state = emitter_state_pointer (i-> second);
+            subscriber_list_type *list = nullptr;
+            if (old-> connections.size() > 1)
+            {
+                list = new subscriber_list_type;
+                list-> connections.reserve (old-> connections.size() - 1);
+
+                for (connection_state_type *c : old-> connections)
+                    if (c != conn)
+                        list-> connections.push_back (c);
+            }
+
+            entry-> subscribers.store (list, memory_order_release);
+            epoch::retire (old);
+            epoch::retire (conn);
+        }
+
+        void filter_ (connection_state_type *conn, filter_type f)
+        {
+            lock_guard <mutex> lock (mutex_);
+            const filter_list *old = conn-> filters.load (memory_order_relaxed);
+
+            filter_list *filters = old? new filter_list (*old) : new filter_list;
+            filters-> push_back (f);
 
-            return state;
+            conn-> filters.store (filters, memory_order_release);
+            if (old)
+                epoch::retire (old);
         }
 
     private:
-        signal_state_type       signal_state_;
+        mutex                               mutex_;
+        atomic <signal_entry_type *>        chunks_ [max_chunks];
+};
+
+//=============================================================================
+// owns a connection; disconnects when it goes out of scope, or on request
+// emits already under way may still call the slot once after disconnect(),
+// block() or filter() return
+
+template <typename Message>
+class connection
+{
+    public:
+        typedef Message message_type;
+
+        typedef switchboard <message_type> switchboard_type;
+        typedef connection_state <message_type> connection_state_type;
+        typedef typename connection_state_type::filter_type filter_type;
+
+        connection ()
+            : switchboard_ (nullptr), state_ (nullptr)
+        {}
+
+        connection (switchboard_type *sb, connection_state_type *s)
+            : switchboard_ (sb), state_ (s)
+        {}
+
+        connection (connection &&r)
+            : switchboard_ (r.switchboard_), state_ (r.state_)
+        {
+            r.state_ = nullptr;
+        }
+
+        connection &operator= (connection &&r)
+        {
+            if (this != &r)
+            {
+                disconnect ();
+                switchboard_ = r.switchboard_;
+                state_ = r.state_;
+                r.state_ = nullptr;
+            }
+            return *this;
+        }
+
+        ~connection () { disconnect (); }
+
+        void disconnect ()
+        {
+            if (state_)
+                switchboard_-> disconnect_ (state_);
+
+            state_ = nullptr;
+        }
+
+        bool connected () const { return state_; }
+
+        void block () { state_-> block.store (true, memory_order_relaxed); }
+        void unblock () { state_-> block.store (false, memory_order_relaxed); }
+
+        void filter (filter_type f) { switchboard_-> filter_ (state_, f); }
+
+        const string &name () const { return name_table::instance ().name (state_-> id); }
+
+    private:
+        switchboard_type       *switchboard_;
+        connection_state_type  *state_;
 };
 
 //=============================================================================
 // type-safe interface to switchboard
-// TODO: thread safe?
 
 class signal_manager_base {};
 
@@ -369,26 +746,40 @@ class signal_manager : public signal_manager_base
             }
 
         template <typename Message>
-            signal <Message> get_signal (string name)
+            signal <Message> get_signal (const string &name)
             {
                 switchboard <Message> *sb = get_switchboard_ <Message> ();
                 return sb-> get_signal (name);
             }
 
+        template <typename Message>
+            signal <Message> get_signal (signal_id id)
+            {
+                switchboard <Message> *sb = get_switchboard_ <Message> ();
+                return sb-> get_signal (id);
+            }
+
         template <typename Message, typename Callable>
-            connection <Message> connect (string name, Callable func)
+            connection <Message> connect (const string &name, Callable func)
             {
                 switchboard <Message> *sb = get_switchboard_ <Message> ();
                 return sb-> connect (name, func);
             }
 
+        template <typename Message, typename Callable>
+            connection <Message> connect (signal_id id, Callable func)
+            {
+                switchboard <Message> *sb = get_switchboard_ <Message> ();
+                return sb-> connect (id, func);
+            }
+
     private:
         template <typename Message>
             switchboard <Message> *get_switchboard_ ()
             {
                  const int index = type_list::index_of <message_type_list, Message>::result;
 
-                 if (index < 0) throw signal_error 
+                 if (index < 0) throw signal_error
                      (string ("no switchboard for message ") + typeid(Message).name());
 
                  return static_cast <switchboard <Message> *> (dispatchers_ [index].get());
@@ -478,7 +869,7 @@ struct signal_manager_factory_1
     {
         return signal_manager <message_type_list> ();
     }
-    
+
     // extension factory method
     template <typename TypeList>
     static signal_manager <message_type_list> extend (const signal_manager <TypeList> &r)
@@ -500,7 +891,7 @@ struct signal_manager_factory_2
     {
         return signal_manager <message_type_list> ();
     }
-    
+
     // extension factory method
     template <typename TypeList>
     static signal_manager <message_type_list> extend (const signal_manager <TypeList> &r)
@@ -509,32 +900,153 @@ struct signal_manager_factory_2
     }
 };
 
+//=============================================================================
+// emit throughput: every thread emits round the named signals, each with a
+// few connections, while one more thread keeps connecting and disconnecting
+
+struct tick
+{
+    unsigned value;
+};
+
+thread_local unsigned ticks = 0;
+
+void count_tick (tick t) { ticks += t.value; }
+
+int
+bench (size_t n_signals, size_t n_threads)
+{
+    typedef chrono::steady_clock clock_type;
+
+    switchboard <tick> sb;
+    vector <signal <tick> > signals;
+    vector <connection <tick> > connections;
+
+    const size_t N_SLOTS = 4;
+    const size_t N_EMITS = 20000000 / n_threads;
+
+    // interning
+    vector <string> names;
+    for (size_t i=0; i < n_signals; ++i)
+        names.push_back ("bench/signal/" + to_string (i));
+
+    clock_type::time_point start = clock_type::now ();
+    for (const string &name : names)
+        signals.push_back (sb.get_signal (name));
+    chrono::duration <double, nano> first = clock_type::now () - start;
+
+    // ids summed outside the assert, so -DNDEBUG builds still do the lookups
+    size_t expected = 0, found = 0;
+    for (size_t i=0; i < n_signals; ++i)
+        expected += signals[i].id();
+
+    start = clock_type::now ();
+    for (const string &name : names)
+        found += sb.get_signal (name).id();
+    chrono::duration <double, nano> again = clock_type::now () - start;
+    assert (found == expected);
+
+    cout << n_signals << " signals: first get_signal " << first.count() / n_signals
+        << " ns, again " << again.count() / n_signals << " ns" << endl;
+
+    for (size_t i=0; i < n_signals; ++i)
+        for (size_t j=0; j < N_SLOTS; ++j)
+            connections.push_back (sb.connect (signals[i].id(), count_tick));
+
+    // emitters, with and without a writer
+    for (bool churn : {false, true})
+    {
+        atomic <bool> running {true};
+        atomic <size_t> churned {0};
+        atomic <unsigned> total {0};
+        size_t freed = epoch::freed ();
+
+        thread writer ([&]
+        {
+            size_t i = 0;
+            while (churn && running.load (memory_order_relaxed))
+            {
+                connection <tick> c = sb.connect (signals[i++ % n_signals].id(), [] (tick) {});
+                churned.fetch_add (1, memory_order_relaxed);
+            }
+        });
+
+        start = clock_type::now ();
+
+        vector <thread> emitters;
+        for (size_t t=0; t < n_threads; ++t)
+            emitters.emplace_back ([&, t]
+            {
+                for (size_t i=0; i < N_EMITS; ++i)
+                    signals[(i * 7 + t) % n_signals].emit (tick {1});
+
+                total.fetch_add (ticks, memory_order_relaxed);
+            });
+
+        for (thread &t : emitters)
+            t.join ();
+
+        chrono::duration <double> seconds = clock_type::now () - start;
+        running.store (false);
+        writer.join ();
+
+        size_t emits = N_EMITS * n_threads;
+        cout << n_threads << " threads" << (churn? ", with churn: " : ": ")
+            << emits / seconds.count() / 1e6 << " M emits/s, "
+            << seconds.count() * 1e9 / emits << " ns/emit";
+        if (churn)
+            cout << ", " << churned.load () << " connect + disconnect, "
+                << epoch::freed () - freed << " freed";
+        cout << endl;
+
+        if (total.load () != emits * N_SLOTS)
+            throw signal_error ("lost emits");
+    }
+
+    return 0;
+}
+
 //=============================================================================
 // Main entry point
 int
 main (int argc, char** argv)
 {
+    if (argc > 1 && string (argv[1]) == "bench")
+        return bench (argc > 2? stoul (argv[2]) : 4096,
+                      argc > 3? stoul (argv[3]) : thread::hardware_concurrency ());
+
     // test manager extension
     signal_manager_factory_1::type sm1 = signal_manager_factory_1::create ();
     signal_manager_factory_2::type sm2 = signal_manager_factory_2::extend (sm1);
-    
+
     // test signal creation
     signal <A> sig1 = sm1.get_signal <A> ("my signal 1");
     signal <A> sig11 = sm1.get_signal <A> ("my signal 1");
     signal <A> sig2 = sm1.get_signal <A> ("my signal 2");
 
+    // test interning
+    assert (sig1.id() == sig11.id() && sig1.id() != sig2.id());
+    assert (sig2.id() == intern ("my signal 2"));
+
     {
-        // test life-time management (shared_ptr)
+        // test life-time management (RAII)
         signal <int> s = sm2.get_signal <int> ("my signal 2");
         connection <int> c = sm2.connect <int> ("my signal 2", err);
         s.emit (101);
     }
 
+    // test connection before signal creation
+    connection <int> late = sm2.connect <int> ("my signal 3", err);
+    sm2.get_signal <int> ("my signal 3").emit (102);
+    late.disconnect ();
+    sm2.get_signal <int> ("my signal 3").emit (103);
+
     A a (5); handler_type handler (1);
 
     // test type safety
     connection <A> c1 = sm1.connect <A> ("my signal 1", handler);
     connection <A> c2 = sm1.connect <A> ("my signal 2", bind (callback, _1, 6));
+    connection <A> c3 = sm1.connect <A> ("my signal 2", bind (callback, _1, 7));
 
     // test copy by value semantics
     handler.b = 3;
@@ -547,7 +1059,7 @@ main (int argc, char** argv)
     // test duplicate emission
     sig11.emit (a);
 
-    // test filtering
+    // test filtering, which skips only the filtered connection
     c2.filter (filter_type (9));
     a.value = 9;
     sig2.emit (a);
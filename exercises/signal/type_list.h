@@ -9,7 +9,7 @@
 #define _TYPE_LIST_H_
 
 #include <typeinfo>
-#include <tr1/type_traits>
+#include <type_traits>
 
 namespace type_list
 {
@@ -141,7 +141,7 @@ namespace type_list
         struct extends <type_list <Head1, Tail1>, type_list <Head2, Tail2> >
         {
                 enum { result = (extends <Tail1, Tail2>::result && 
-                        std::tr1::is_same <Head1, Head2>::value)? 1 : 0 };
+                        std::is_same <Head1, Head2>::value)? 1 : 0 };
         };
 
     //=============================================================================